@@ -30,6 +30,7 @@
 #include <unistd.h>
 
 #include "acvpproxy.h"
+#include "acvp_meta_internal.h"
 #include "acv_protocol.h"
 #include "esv_proto.h"
 #include "fips.h"
@@ -694,6 +695,7 @@ DSO_PUBLIC
 void acvp_release(void)
 {
 	acvp_def_release_all();
+	acvp_meta_mirror_release();
 	if (!acvp_library_initialized())
 		return;
 
@@ -131,24 +131,25 @@ out:
 int acvp_get_algoinfo_json(const struct acvp_buf *buf,
 			   struct acvp_test_verdict_status *verdict)
 {
-	struct json_object *algo_full = NULL, *algo;
+	struct json_scan_key keys[] = { { .name = "algorithm" },
+					{ .name = "mode" } };
 	int ret;
-	const char *tmp;
 
-	CKINT_LOG(acvp_req_strip_version(buf, &algo_full, &algo),
+	/*
+	 * The buffer may hold an entire vector set - only scan for the
+	 * algorithm information instead of parsing all test vectors.
+	 */
+	CKINT_LOG(acvp_req_scan_keys(buf, keys, ARRAY_SIZE(keys), true),
 		  "JSON parser cannot parse verdict data\n");
 
-	CKINT(json_get_string(algo, "algorithm", &tmp));
-	CKINT(acvp_duplicate(&verdict->cipher_name, tmp));
+	ACVP_PTR_FREE_NULL(verdict->cipher_name);
+	CKINT(json_scan_get_string(&keys[0], &verdict->cipher_name));
 
-	ret = json_get_string(algo, "mode", &tmp);
-	if (!ret) {
-		CKINT(acvp_duplicate(&verdict->cipher_mode, tmp));
-	} else {
+	ACVP_PTR_FREE_NULL(verdict->cipher_mode);
+	ret = json_scan_get_string(&keys[1], &verdict->cipher_mode);
+	if (ret == -ENOENT)
 		ret = 0;
-	}
 
 out:
-	ACVP_JSON_PUT_NULL(algo_full);
 	return ret;
 }
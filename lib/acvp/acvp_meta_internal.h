@@ -58,6 +58,57 @@ int acvp_person_handle_open_requests(const struct acvp_testid_ctx *testid_ctx);
 int acvp_oe_handle_open_requests(const struct acvp_testid_ctx *testid_ctx);
 int acvp_module_handle_open_requests(const struct acvp_testid_ctx *testid_ctx);
 
+/******************************************************************************
+ * Local mirror of the ACVP server meta data
+ ******************************************************************************/
+
+enum acvp_meta_mirror_type {
+	acvp_meta_mirror_dependencies,
+	acvp_meta_mirror_oes,
+	acvp_meta_mirror_vendors,
+	acvp_meta_mirror_persons,
+	acvp_meta_mirror_modules,
+};
+
+/**
+ * @brief Search the ACVP server data base with the help of the local mirror.
+ *
+ * All fresh mirrored entries whose search key (e.g. the name) is identical to
+ * the search string are offered to the callback first. Only if the callback
+ * does not report a match, the paged search is sent to the ACVP server and
+ * all received entries are added to the mirror. The semantics of the
+ * callback and the return code are identical to acvp_paging_get.
+ *
+ * @param testid_ctx TestID context with set credentials
+ * @param type Collection that is searched
+ * @param url URL of the server search
+ * @param searchstr Value of the search key the server search looks for - if
+ *		    NULL, the mirror is not used
+ * @param show_type type of the caller
+ * @param private Private buffer pointer handed to callback
+ * @param cb Callback function to invoke for each found data entry
+ *
+ * @return 0 on success (no match), < 0 on error, EINTR (match found)
+ */
+int acvp_meta_mirror_paging_get(const struct acvp_testid_ctx *testid_ctx,
+				enum acvp_meta_mirror_type type,
+				const char *url, const char *searchstr,
+				const unsigned int show_type, void *private,
+				int (*cb)(void *private,
+					  struct json_object *dataentry));
+
+/**
+ * @brief Remove the entry referenced by the URL from the mirror. This must be
+ *	  called when the entry is altered on the ACVP server.
+ */
+void acvp_meta_mirror_invalidate(const struct acvp_testid_ctx *testid_ctx,
+				 const char *url);
+
+/**
+ * @brief Release the in-memory copy of the mirror
+ */
+void acvp_meta_mirror_release(void);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,702 @@
+/* Local mirror of the ACVP server meta data database
+ *
+ * Copyright (C) 2019 - 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "acvp_meta_internal.h"
+#include "internal.h"
+#include "json_wrapper.h"
+#include "mutex_w.h"
+#include "request_helper.h"
+
+/*
+ * Meta data mirror
+ * ================
+ *
+ * Searching the ACVP server for a vendor, person, OE, dependency or module
+ * requires a paged request which returns all entries whose name contains the
+ * search string. Such searches are issued for every definition that has no
+ * ID on file and take a significant amount of time.
+ *
+ * All entries returned by such server searches are recorded in a local
+ * mirror which is stored in the secure data store with one JSON file per
+ * collection. Each collection is indexed by the ID and the name of the
+ * entries. A search first offers all fresh mirrored entries with the searched
+ * name to the matcher. Only if none of them matches, the search is sent to
+ * the server and all entries received are added to the mirror. Thus, the
+ * mirror is refreshed incrementally by each server search.
+ *
+ * Entries older than ACVP_META_MIRROR_MAX_AGE are not used. Entries that are
+ * updated or deleted on the ACVP server by this application are removed from
+ * the mirror.
+ */
+
+/* Directory in the secure data store holding the mirror */
+#define ACVP_META_MIRROR_DIR "meta-mirror"
+/* Version of the mirror file format */
+#define ACVP_META_MIRROR_VERSION 1
+/* Maximum age in seconds of an entry to be used for a search */
+#define ACVP_META_MIRROR_MAX_AGE (7 * 24 * 60 * 60)
+/* Initial number of hash buckets of each index */
+#define ACVP_META_MIRROR_BUCKETS 256
+
+struct acvp_meta_mirror_entry {
+	struct acvp_meta_mirror_entry *next_id;
+	struct acvp_meta_mirror_entry *next_name;
+	uint32_t id;
+	uint32_t name_hash;
+	time_t fetched;
+	char *name;
+	/* JSON representation of the entry as returned by the ACVP server */
+	char *data;
+};
+
+struct acvp_meta_mirror_coll {
+	/* URL path element of the collection */
+	const char *op;
+	/* Key of the entries the server search is applied to */
+	const char *key;
+
+	struct acvp_meta_mirror_entry **by_id;
+	struct acvp_meta_mirror_entry **by_name;
+	unsigned int buckets;
+	unsigned int entries;
+
+	bool loaded;
+	char pathname[FILENAME_MAX];
+};
+
+static struct acvp_meta_mirror_coll acvp_meta_mirror[] = {
+	[acvp_meta_mirror_dependencies] = { .op = NIST_VAL_OP_DEPENDENCY,
+					    .key = "name" },
+	[acvp_meta_mirror_oes] = { .op = NIST_VAL_OP_OE, .key = "name" },
+	[acvp_meta_mirror_vendors] = { .op = NIST_VAL_OP_VENDOR,
+				       .key = "name" },
+	[acvp_meta_mirror_persons] = { .op = NIST_VAL_OP_PERSONS,
+				       .key = "fullName" },
+	[acvp_meta_mirror_modules] = { .op = NIST_VAL_OP_MODULE,
+				       .key = "name" },
+};
+
+/* Lock protecting all collections */
+static DEFINE_MUTEX_W_UNLOCKED(acvp_meta_mirror_lock);
+
+/* FNV-1a hash of a string */
+static uint32_t acvp_meta_mirror_hash(const char *str)
+{
+	uint32_t hash = 2166136261U;
+
+	while (*str) {
+		hash ^= (uint8_t)*str++;
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/*****************************************************************************
+ * Index maintenance - caller must hold acvp_meta_mirror_lock
+ *****************************************************************************/
+static void acvp_meta_mirror_free_entry(struct acvp_meta_mirror_entry *entry)
+{
+	if (!entry)
+		return;
+	ACVP_PTR_FREE_NULL(entry->name);
+	ACVP_PTR_FREE_NULL(entry->data);
+	free(entry);
+}
+
+static void acvp_meta_mirror_unlink(struct acvp_meta_mirror_coll *coll,
+				    struct acvp_meta_mirror_entry *entry)
+{
+	struct acvp_meta_mirror_entry **iter;
+
+	for (iter = &coll->by_id[entry->id & (coll->buckets - 1)]; *iter;
+	     iter = &(*iter)->next_id) {
+		if (*iter == entry) {
+			*iter = entry->next_id;
+			break;
+		}
+	}
+
+	if (entry->name) {
+		for (iter = &coll->by_name[entry->name_hash &
+					   (coll->buckets - 1)];
+		     *iter; iter = &(*iter)->next_name) {
+			if (*iter == entry) {
+				*iter = entry->next_name;
+				break;
+			}
+		}
+	}
+
+	coll->entries--;
+}
+
+static void acvp_meta_mirror_link(struct acvp_meta_mirror_coll *coll,
+				  struct acvp_meta_mirror_entry *entry)
+{
+	unsigned int bucket = entry->id & (coll->buckets - 1);
+
+	entry->next_id = coll->by_id[bucket];
+	coll->by_id[bucket] = entry;
+
+	entry->next_name = NULL;
+	if (entry->name) {
+		bucket = entry->name_hash & (coll->buckets - 1);
+		entry->next_name = coll->by_name[bucket];
+		coll->by_name[bucket] = entry;
+	}
+
+	coll->entries++;
+}
+
+static int acvp_meta_mirror_resize(struct acvp_meta_mirror_coll *coll,
+				   unsigned int buckets)
+{
+	struct acvp_meta_mirror_entry **by_id, **by_name, **old_id;
+	unsigned int i, old_buckets = coll->buckets;
+
+	by_id = calloc(buckets, sizeof(*by_id));
+	by_name = calloc(buckets, sizeof(*by_name));
+	if (!by_id || !by_name) {
+		free(by_id);
+		free(by_name);
+		return -ENOMEM;
+	}
+
+	old_id = coll->by_id;
+	free(coll->by_name);
+
+	coll->by_id = by_id;
+	coll->by_name = by_name;
+	coll->buckets = buckets;
+	coll->entries = 0;
+
+	for (i = 0; i < old_buckets; i++) {
+		struct acvp_meta_mirror_entry *entry = old_id[i];
+
+		while (entry) {
+			struct acvp_meta_mirror_entry *next = entry->next_id;
+
+			acvp_meta_mirror_link(coll, entry);
+			entry = next;
+		}
+	}
+
+	free(old_id);
+
+	return 0;
+}
+
+static struct acvp_meta_mirror_entry *
+acvp_meta_mirror_find_id(const struct acvp_meta_mirror_coll *coll,
+			 const uint32_t id)
+{
+	struct acvp_meta_mirror_entry *entry;
+
+	if (!coll->buckets)
+		return NULL;
+
+	for (entry = coll->by_id[id & (coll->buckets - 1)]; entry;
+	     entry = entry->next_id) {
+		if (entry->id == id)
+			return entry;
+	}
+
+	return NULL;
+}
+
+/*
+ * Add the entry to the collection replacing an older entry with the same ID.
+ * The collection takes ownership of the entry.
+ */
+static int acvp_meta_mirror_insert(struct acvp_meta_mirror_coll *coll,
+				   struct acvp_meta_mirror_entry *entry)
+{
+	struct acvp_meta_mirror_entry *old;
+	int ret;
+
+	if (coll->entries >= coll->buckets) {
+		ret = acvp_meta_mirror_resize(
+			coll, coll->buckets ? coll->buckets * 2 :
+					      ACVP_META_MIRROR_BUCKETS);
+		if (ret) {
+			acvp_meta_mirror_free_entry(entry);
+			return ret;
+		}
+	}
+
+	old = acvp_meta_mirror_find_id(coll, entry->id);
+	if (old) {
+		acvp_meta_mirror_unlink(coll, old);
+		acvp_meta_mirror_free_entry(old);
+	}
+
+	acvp_meta_mirror_link(coll, entry);
+
+	return 0;
+}
+
+/* Create a mirror entry from an entry returned by the ACVP server */
+static int acvp_meta_mirror_insert_json(struct acvp_meta_mirror_coll *coll,
+					struct json_object *data,
+					const time_t fetched)
+{
+	struct acvp_meta_mirror_entry *entry;
+	const char *str;
+	int ret;
+
+	entry = calloc(1, sizeof(*entry));
+	CKNULL(entry, -ENOMEM);
+
+	CKINT(json_get_string(data, "url", &str));
+	CKINT(acvp_get_trailing_number(str, &entry->id));
+
+	/* An entry without name is only reachable by its ID */
+	if (json_object_object_get_ex(data, coll->key, NULL)) {
+		CKINT(json_get_string(data, coll->key, &str));
+		CKINT(acvp_duplicate(&entry->name, str));
+		entry->name_hash = acvp_meta_mirror_hash(str);
+	}
+
+	str = json_object_to_json_string_ext(data,
+					     JSON_C_TO_STRING_PLAIN |
+						     JSON_C_TO_STRING_NOSLASHESCAPE);
+	CKNULL(str, -ENOMEM);
+	CKINT(acvp_duplicate(&entry->data, str));
+
+	entry->fetched = fetched;
+
+	ret = acvp_meta_mirror_insert(coll, entry);
+	entry = NULL;
+
+out:
+	acvp_meta_mirror_free_entry(entry);
+	return ret;
+}
+
+static void acvp_meta_mirror_release_coll(struct acvp_meta_mirror_coll *coll)
+{
+	unsigned int i;
+
+	for (i = 0; i < coll->buckets; i++) {
+		struct acvp_meta_mirror_entry *entry = coll->by_id[i];
+
+		while (entry) {
+			struct acvp_meta_mirror_entry *next = entry->next_id;
+
+			acvp_meta_mirror_free_entry(entry);
+			entry = next;
+		}
+	}
+
+	ACVP_PTR_FREE_NULL(coll->by_id);
+	ACVP_PTR_FREE_NULL(coll->by_name);
+	coll->buckets = 0;
+	coll->entries = 0;
+	coll->loaded = false;
+}
+
+/*****************************************************************************
+ * Persistent storage - caller must hold acvp_meta_mirror_lock
+ *****************************************************************************/
+static int acvp_meta_mirror_load(const struct acvp_testid_ctx *testid_ctx,
+				 struct acvp_meta_mirror_coll *coll)
+{
+	const struct acvp_ctx *ctx = testid_ctx->ctx;
+	const struct acvp_datastore_ctx *datastore = &ctx->datastore;
+	struct json_object *mirror = NULL, *entries;
+	uint32_t version;
+	size_t i;
+	int ret = 0;
+	char pathname[FILENAME_MAX - 64];
+
+	if (coll->loaded)
+		return 0;
+
+	CKNULL(datastore->secure_basedir, -EINVAL);
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", datastore->secure_basedir,
+		 ACVP_META_MIRROR_DIR);
+	if (mkdir(pathname, 0700) && errno != EEXIST) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "Cannot create meta data mirror directory %s (%d)\n",
+		       pathname, ret);
+		goto out;
+	}
+
+	snprintf(coll->pathname, sizeof(coll->pathname), "%s/%s.json",
+		 pathname, coll->op);
+	coll->loaded = true;
+
+	if (access(coll->pathname, F_OK))
+		goto out;
+
+	mirror = json_object_from_file(coll->pathname);
+	if (!mirror) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "Meta data mirror %s cannot be parsed - discarding it\n",
+		       coll->pathname);
+		goto out;
+	}
+
+	if (json_get_uint(mirror, "version", &version) ||
+	    version != ACVP_META_MIRROR_VERSION) {
+		logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+		       "Meta data mirror %s has unknown format - discarding it\n",
+		       coll->pathname);
+		goto out;
+	}
+
+	if (json_find_key(mirror, "entries", &entries, json_type_array))
+		goto out;
+
+	for (i = 0; i < json_object_array_length(entries); i++) {
+		struct json_object *entry = json_object_array_get_idx(entries,
+								      i);
+		struct json_object *data;
+		uint64_t fetched;
+
+		/* Skip damaged entries, they are fetched again if needed */
+		if (json_get_uint64(entry, "fetched", &fetched) ||
+		    json_find_key(entry, "data", &data, json_type_object) ||
+		    acvp_meta_mirror_insert_json(coll, data,
+						 (time_t)fetched)) {
+			logger(LOGGER_DEBUG, LOGGER_C_ANY,
+			       "Skipping entry %zu of meta data mirror %s\n",
+			       i, coll->pathname);
+		}
+	}
+
+	logger(LOGGER_DEBUG, LOGGER_C_ANY,
+	       "Meta data mirror %s loaded with %u entries\n", coll->pathname,
+	       coll->entries);
+
+out:
+	ACVP_JSON_PUT_NULL(mirror);
+	return ret;
+}
+
+static int acvp_meta_mirror_store(struct acvp_meta_mirror_coll *coll)
+{
+	struct json_object *mirror = NULL, *entries, *entry, *data;
+	unsigned int i;
+	int ret;
+	char tmpname[FILENAME_MAX + 4];
+
+	if (!coll->loaded)
+		return 0;
+
+	mirror = json_object_new_object();
+	CKNULL(mirror, -ENOMEM);
+	CKINT(json_object_object_add(
+		mirror, "version",
+		json_object_new_int(ACVP_META_MIRROR_VERSION)));
+	entries = json_object_new_array();
+	CKNULL(entries, -ENOMEM);
+	CKINT(json_object_object_add(mirror, "entries", entries));
+
+	for (i = 0; i < coll->buckets; i++) {
+		struct acvp_meta_mirror_entry *iter;
+
+		for (iter = coll->by_id[i]; iter; iter = iter->next_id) {
+			data = json_tokener_parse(iter->data);
+			CKNULL(data, -EFAULT);
+
+			entry = json_object_new_object();
+			if (!entry) {
+				json_object_put(data);
+				ret = -ENOMEM;
+				goto out;
+			}
+			CKINT(json_object_array_add(entries, entry));
+			CKINT(json_object_object_add(entry, "data", data));
+			CKINT(json_object_object_add(
+				entry, "fetched",
+				json_object_new_int64((int64_t)iter->fetched)));
+		}
+	}
+
+	/* Replace the mirror atomically */
+	snprintf(tmpname, sizeof(tmpname), "%s.tmp", coll->pathname);
+	if (json_object_to_file_ext(tmpname, mirror,
+				    JSON_C_TO_STRING_PLAIN |
+					    JSON_C_TO_STRING_NOSLASHESCAPE)) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "Cannot write meta data mirror %s\n", tmpname);
+		ret = -EFAULT;
+		goto out;
+	}
+
+	if (rename(tmpname, coll->pathname)) {
+		ret = -errno;
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "Cannot rename meta data mirror %s (%d)\n", tmpname,
+		       ret);
+		unlink(tmpname);
+	}
+
+out:
+	ACVP_JSON_PUT_NULL(mirror);
+	return ret;
+}
+
+/*****************************************************************************
+ * Search
+ *****************************************************************************/
+
+/*
+ * Collect copies of all fresh entries with the given name so that the
+ * matcher can be invoked without holding the lock.
+ */
+static int acvp_meta_mirror_candidates(const struct acvp_meta_mirror_coll *coll,
+				       const char *searchstr, char ***out,
+				       unsigned int *num)
+{
+	struct acvp_meta_mirror_entry *entry;
+	uint32_t hash = acvp_meta_mirror_hash(searchstr);
+	time_t now = time(NULL);
+	char **candidates = NULL, **tmp;
+	unsigned int n = 0;
+	int ret = 0;
+
+	if (!coll->buckets)
+		goto out;
+
+	for (entry = coll->by_name[hash & (coll->buckets - 1)]; entry;
+	     entry = entry->next_name) {
+		if (entry->name_hash != hash || strcmp(entry->name, searchstr))
+			continue;
+		if (now == (time_t)-1 || now < entry->fetched ||
+		    now - entry->fetched > ACVP_META_MIRROR_MAX_AGE)
+			continue;
+
+		tmp = realloc(candidates, (n + 1) * sizeof(*candidates));
+		CKNULL(tmp, -ENOMEM);
+		candidates = tmp;
+		candidates[n] = NULL;
+		CKINT(acvp_duplicate(&candidates[n], entry->data));
+		n++;
+	}
+
+out:
+	if (ret) {
+		while (n)
+			free(candidates[--n]);
+		ACVP_PTR_FREE_NULL(candidates);
+	}
+	*out = candidates;
+	*num = n;
+	return ret;
+}
+
+static int acvp_meta_mirror_search_local(const struct acvp_testid_ctx *testid_ctx,
+					 struct acvp_meta_mirror_coll *coll,
+					 const char *searchstr, void *private,
+					 int (*cb)(void *private,
+						   struct json_object *entry))
+{
+	struct json_object *data;
+	char **candidates = NULL;
+	unsigned int i, num = 0;
+	int ret;
+
+	mutex_w_lock(&acvp_meta_mirror_lock);
+	ret = acvp_meta_mirror_load(testid_ctx, coll);
+	if (!ret) {
+		ret = acvp_meta_mirror_candidates(coll, searchstr, &candidates,
+						  &num);
+	}
+	mutex_w_unlock(&acvp_meta_mirror_lock);
+
+	/* Without the mirror, the search is served by the ACVP server */
+	if (ret) {
+		logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+		       "Local %s mirror unavailable (%d)\n", coll->op, ret);
+		ret = 0;
+		goto out;
+	}
+
+	for (i = 0; i < num; i++) {
+		data = json_tokener_parse(candidates[i]);
+		CKNULL(data, -EFAULT);
+
+		ret = cb(private, data);
+		json_object_put(data);
+
+		/* Match found or error */
+		if (ret)
+			break;
+	}
+
+	if (ret == EINTR) {
+		logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+		       "Entry %s found in local %s mirror\n", searchstr,
+		       coll->op);
+	}
+
+out:
+	for (i = 0; i < num; i++)
+		free(candidates[i]);
+	free(candidates);
+	return ret;
+}
+
+struct acvp_meta_mirror_paging {
+	struct acvp_meta_mirror_coll *coll;
+	time_t now;
+	bool updated;
+	void *private;
+	int (*cb)(void *private, struct json_object *entry);
+};
+
+static int acvp_meta_mirror_paging_cb(void *private, struct json_object *entry)
+{
+	struct acvp_meta_mirror_paging *paging = private;
+	int ret;
+
+	mutex_w_lock(&acvp_meta_mirror_lock);
+	ret = acvp_meta_mirror_insert_json(paging->coll, entry, paging->now);
+	mutex_w_unlock(&acvp_meta_mirror_lock);
+
+	/* An entry that cannot be mirrored is still offered to the caller */
+	if (ret) {
+		logger(LOGGER_DEBUG, LOGGER_C_ANY,
+		       "Entry cannot be added to %s mirror (%d)\n",
+		       paging->coll->op, ret);
+	} else {
+		paging->updated = true;
+	}
+
+	return paging->cb(paging->private, entry);
+}
+
+int acvp_meta_mirror_paging_get(const struct acvp_testid_ctx *testid_ctx,
+				enum acvp_meta_mirror_type type,
+				const char *url, const char *searchstr,
+				const unsigned int show_type, void *private,
+				int (*cb)(void *private,
+					  struct json_object *dataentry))
+{
+	const struct acvp_ctx *ctx;
+	const struct acvp_opts_ctx *opts;
+	struct acvp_meta_mirror_coll *coll;
+	struct acvp_meta_mirror_paging paging;
+	int ret, ret2;
+
+	CKNULL(testid_ctx, -EINVAL);
+	CKNULL(cb, -EINVAL);
+	if (type >= ARRAY_SIZE(acvp_meta_mirror))
+		return -EINVAL;
+
+	ctx = testid_ctx->ctx;
+	opts = &ctx->options;
+	coll = &acvp_meta_mirror[type];
+
+	/* Listing the server data base always requires the server data */
+	if (opts->show_db_entries || !searchstr)
+		return acvp_paging_get(testid_ctx, url, show_type, private, cb);
+
+	ret = acvp_meta_mirror_search_local(testid_ctx, coll, searchstr,
+					    private, cb);
+	if (ret)
+		goto out;
+
+	/* Cache miss: search the ACVP server and mirror all entries found */
+	paging.coll = coll;
+	paging.now = time(NULL);
+	paging.updated = false;
+	paging.private = private;
+	paging.cb = cb;
+	ret = acvp_paging_get(testid_ctx, url, show_type, &paging,
+			      acvp_meta_mirror_paging_cb);
+
+	if (paging.updated) {
+		mutex_w_lock(&acvp_meta_mirror_lock);
+		ret2 = acvp_meta_mirror_store(coll);
+		mutex_w_unlock(&acvp_meta_mirror_lock);
+
+		/* The mirror is an optimization only, do not fail */
+		if (ret2) {
+			logger(LOGGER_WARN, LOGGER_C_ANY,
+			       "Cannot store %s mirror (%d)\n", coll->op,
+			       ret2);
+		}
+	}
+
+out:
+	return ret;
+}
+
+void acvp_meta_mirror_invalidate(const struct acvp_testid_ctx *testid_ctx,
+				 const char *url)
+{
+	unsigned int i;
+	uint32_t id;
+	char path[64];
+
+	if (!testid_ctx || !url || acvp_get_trailing_number(url, &id))
+		return;
+
+	mutex_w_lock(&acvp_meta_mirror_lock);
+
+	for (i = 0; i < ARRAY_SIZE(acvp_meta_mirror); i++) {
+		struct acvp_meta_mirror_coll *coll = &acvp_meta_mirror[i];
+		struct acvp_meta_mirror_entry *entry;
+
+		snprintf(path, sizeof(path), "/%s/", coll->op);
+		if (!strstr(url, path))
+			continue;
+
+		if (acvp_meta_mirror_load(testid_ctx, coll))
+			break;
+
+		entry = acvp_meta_mirror_find_id(coll, id);
+		if (!entry)
+			break;
+
+		logger(LOGGER_DEBUG, LOGGER_C_ANY,
+		       "Removing entry %u from %s mirror\n", id, coll->op);
+		acvp_meta_mirror_unlink(coll, entry);
+		acvp_meta_mirror_free_entry(entry);
+		acvp_meta_mirror_store(coll);
+		break;
+	}
+
+	mutex_w_unlock(&acvp_meta_mirror_lock);
+}
+
+void acvp_meta_mirror_release(void)
+{
+	unsigned int i;
+
+	mutex_w_lock(&acvp_meta_mirror_lock);
+	for (i = 0; i < ARRAY_SIZE(acvp_meta_mirror); i++)
+		acvp_meta_mirror_release_coll(&acvp_meta_mirror[i]);
+	mutex_w_unlock(&acvp_meta_mirror_lock);
+}
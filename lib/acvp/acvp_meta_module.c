@@ -522,8 +522,10 @@ static int acvp_module_validate_all(const struct acvp_testid_ctx *testid_ctx,
 		 modulestr);
 	CKINT(acvp_append_urloptions(queryoptions, url, sizeof(url)));
 
-	CKINT(acvp_paging_get(testid_ctx, url, ACVP_OPTS_SHOW_MODULE, def_info,
-			      &acvp_module_match_cb));
+	CKINT(acvp_meta_mirror_paging_get(testid_ctx, acvp_meta_mirror_modules,
+					  url, def_info->module_name,
+					  ACVP_OPTS_SHOW_MODULE, def_info,
+					  &acvp_module_match_cb));
 
 	/* We found an entry and do not need to do anything */
 	if (ret > 0 || opts->show_db_entries) {
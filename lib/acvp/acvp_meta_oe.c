@@ -1093,6 +1093,7 @@ static int acvp_oe_match_cb(void *private, struct json_object *json_oe)
 static int _acvp_oe_validate_all(
 	const struct acvp_testid_ctx *testid_ctx, struct def_oe *def_oe,
 	struct def_dependency *def_dep, const char *url,
+	enum acvp_meta_mirror_type type, const char *searchstr,
 	int (*matcher)(const struct acvp_testid_ctx *testid_ctx,
 		       struct def_oe *def_oe, struct def_dependency *def_dep,
 		       struct json_object *json_oe))
@@ -1105,8 +1106,9 @@ static int _acvp_oe_validate_all(
 	match_def.def_dep = def_dep;
 	match_def.matcher = matcher;
 
-	CKINT(acvp_paging_get(testid_ctx, url, ACVP_OPTS_SHOW_OE, &match_def,
-			      &acvp_oe_match_cb));
+	CKINT(acvp_meta_mirror_paging_get(testid_ctx, type, url, searchstr,
+					  ACVP_OPTS_SHOW_OE, &match_def,
+					  &acvp_oe_match_cb));
 
 out:
 	return ret;
@@ -1158,14 +1160,18 @@ static int acvp_oe_validate_all_dep(const struct acvp_testid_ctx *testid_ctx,
 		case def_dependency_software:
 			CKINT(acvp_oe_validate_add_searchopts(
 				def_dep->name, url, sizeof(url)));
-			CKINT(_acvp_oe_validate_all(testid_ctx, def_oe, def_dep,
-						    url, acvp_oe_match_dep));
+			CKINT(_acvp_oe_validate_all(
+				testid_ctx, def_oe, def_dep, url,
+				acvp_meta_mirror_dependencies, def_dep->name,
+				acvp_oe_match_dep));
 			break;
 		case def_dependency_hardware:
 			CKINT(acvp_oe_validate_add_searchopts(
 				def_dep->proc_name, url, sizeof(url)));
-			CKINT(_acvp_oe_validate_all(testid_ctx, def_oe, def_dep,
-						    url, acvp_oe_match_dep));
+			CKINT(_acvp_oe_validate_all(
+				testid_ctx, def_oe, def_dep, url,
+				acvp_meta_mirror_dependencies,
+				def_dep->proc_name, acvp_oe_match_dep));
 			break;
 		default:
 			logger(LOGGER_ERR, LOGGER_C_ANY, "Unknown type\n");
@@ -1467,6 +1473,7 @@ static int acvp_oe_validate_all_oe(const struct acvp_testid_ctx *testid_ctx,
 	CKINT(acvp_append_urloptions(queryoptions, url, sizeof(url)));
 
 	CKINT(_acvp_oe_validate_all(testid_ctx, def_oe, NULL, url,
+				    acvp_meta_mirror_oes, oe_name,
 				    acvp_oe_match_oe));
 
 	/* We found an entry and do not need to do anything */
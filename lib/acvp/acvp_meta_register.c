@@ -166,6 +166,7 @@ int acvp_meta_register(const struct acvp_testid_ctx *testid_ctx,
 	ACVP_EXT_BUFFER_INIT(submit);
 	ACVP_BUFFER_INIT(response);
 	ACVP_BUFFER_INIT(tmpbuf);
+	size_t json_request_len;
 	int ret;
 	const char *json_request;
 
@@ -173,15 +174,10 @@ int acvp_meta_register(const struct acvp_testid_ctx *testid_ctx,
 
 	/* Provided ID is a request ID */
 	if (acvp_request_id(*id)) {
-		if (req_details->dump_register && json) {
-			fprintf(stdout, "%s\n",
-				json_object_to_json_string_ext(
-					json,
-					JSON_C_TO_STRING_PRETTY |
-						JSON_C_TO_STRING_NOSLASHESCAPE));
-
-			return 0;
-		}
+		if (req_details->dump_register && json)
+			return json_print(stdout, json,
+					  JSON_C_TO_STRING_PRETTY |
+						  JSON_C_TO_STRING_NOSLASHESCAPE);
 		return acvp_meta_obtain_request_result(testid_ctx, id);
 	}
 
@@ -211,40 +207,41 @@ int acvp_meta_register(const struct acvp_testid_ctx *testid_ctx,
 		CKINT(json_object_array_add(json_submission, json));
 
 		if (req_details->dump_register) {
-			fprintf(stdout, "%s\n",
-				json_object_to_json_string_ext(
-					json_submission,
-					JSON_C_TO_STRING_PRETTY |
-						JSON_C_TO_STRING_NOSLASHESCAPE));
-			ret = 0;
+			CKINT(json_print(stdout, json_submission,
+					 JSON_C_TO_STRING_PRETTY |
+						 JSON_C_TO_STRING_NOSLASHESCAPE));
 			goto out;
 		}
 
-		tmpbuf.buf = (uint8_t *)json_object_to_json_string_ext(
-			json_submission,
-			JSON_C_TO_STRING_PRETTY |
-				JSON_C_TO_STRING_NOSLASHESCAPE);
-		tmpbuf.len = (uint32_t)strlen((char *)tmpbuf.buf);
+		CKINT(json_to_buf(json_submission,
+				  JSON_C_TO_STRING_PRETTY |
+					  JSON_C_TO_STRING_NOSLASHESCAPE,
+				  &tmpbuf));
 		CKINT(ds->acvp_datastore_write_testid(
 			testid_ctx, "operational_environment.json", true,
 			&tmpbuf));
 
 		/* Convert the JSON buffer into a string */
-		json_request = json_object_to_json_string_ext(
+		json_request = json_object_to_json_string_length(
 			json_submission,
 			JSON_C_TO_STRING_PLAIN |
-				JSON_C_TO_STRING_NOSLASHESCAPE);
+				JSON_C_TO_STRING_NOSLASHESCAPE,
+			&json_request_len);
 		CKNULL_LOG(json_request, -ENOMEM,
 			   "JSON object conversion into string failed\n");
 
 		submit.buf = (uint8_t *)json_request;
-		submit.len = (uint32_t)strlen(json_request);
+		submit.len = (uint32_t)json_request_len;
 	}
 
 #if 0
 	CKINT(ask_yes("Shall request to alter ACVP data base be sent to the ACVP Server?"));
 #endif
 
+	/* The mirrored copy of an altered entry is stale */
+	if (submit_type == acvp_http_put || submit_type == acvp_http_delete)
+		acvp_meta_mirror_invalidate(testid_ctx, url);
+
 	CKINT(acvp_net_op(testid_ctx, url, &submit, &response, submit_type));
 
 	CKINT(acvp_meta_register_get_id(&response, id));
@@ -252,6 +249,7 @@ int acvp_meta_register(const struct acvp_testid_ctx *testid_ctx,
 out:
 	ACVP_JSON_PUT_NULL(json_submission);
 	acvp_free_buf(&response);
+	acvp_free_buf(&tmpbuf);
 	return ret;
 }
 
@@ -462,8 +462,10 @@ static int acvp_vendor_validate_all(const struct acvp_testid_ctx *testid_ctx,
 		 vendorstr);
 	CKINT(acvp_append_urloptions(queryoptions, url, sizeof(url)));
 
-	CKINT(acvp_paging_get(testid_ctx, url, ACVP_OPTS_SHOW_VENDOR,
-			      def_vendor, &acvp_vendor_match_cb));
+	CKINT(acvp_meta_mirror_paging_get(testid_ctx, acvp_meta_mirror_vendors,
+					  url, def_vendor->vendor_name,
+					  ACVP_OPTS_SHOW_VENDOR, def_vendor,
+					  &acvp_vendor_match_cb));
 
 	/* We found an entry and do not need to do anything */
 	if (ret > 0 || opts->show_db_entries) {
@@ -18,12 +18,70 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "internal.h"
 #include "json_wrapper.h"
 #include "logger.h"
+#include "mutex_w.h"
 #include "request_helper.h"
+#include "threading_support.h"
+
+/*
+ * Pipelined paging
+ * ================
+ *
+ * The first page is fetched by the caller. It reports the total number of
+ * entries and thus the number of pages. All remaining pages are addressed
+ * with the offset parameter and fetched by jobs of the thread group 1 while
+ * the caller processes the previous pages. At most ACVP_PAGING_PREFETCH
+ * pages are fetched ahead of the page processed by the caller.
+ *
+ * The callbacks are always invoked by the caller in the order of the entries
+ * on the server. If the caller needs a page whose job did not start yet, the
+ * caller fetches the page itself. Thus, the caller never depends on the
+ * availability of a worker thread.
+ */
+
+/* Number of pages fetched ahead of the page being processed */
+#define ACVP_PAGING_PREFETCH 4
+
+enum acvp_paging_state {
+	acvp_paging_queued,
+	acvp_paging_running,
+	acvp_paging_done,
+	acvp_paging_claimed,
+};
+
+struct acvp_paging_page {
+	char url[FILENAME_MAX];
+	struct acvp_buf buf;
+	int ret;
+	enum acvp_paging_state state;
+};
+
+struct acvp_paging_prefetch {
+	const struct acvp_testid_ctx *testid_ctx;
+	mutex_w_t lock;
+	pthread_cond_t completion;
+	/* References held by the caller and the queued jobs */
+	unsigned int refcnt;
+	/* Number of jobs currently accessing the testid_ctx */
+	unsigned int running;
+	bool abort;
+	unsigned int npages;
+	struct acvp_paging_page pages[];
+};
+
+struct acvp_paging_job {
+	struct acvp_paging_prefetch *prefetch;
+	struct acvp_paging_page *page;
+};
 
 static int acvp_paging_get_url_parameters(const char **url)
 {
@@ -54,24 +112,332 @@ static int acvp_paging_get_url_parameters(const char **url)
 	return *url ? ret : -EINVAL;
 }
 
+/* Number of entries requested per page */
+static unsigned int acvp_paging_limit(void)
+{
+	const char *env;
+	unsigned long limit;
+
+#ifdef HAVE_SECURE_GETENV
+	env = secure_getenv(ACVP_PAGING_LIMIT_ENV);
+#else
+	env = getenv(ACVP_PAGING_LIMIT_ENV);
+#endif
+	if (!env)
+		return ACVP_PAGING_LIMIT;
+
+	limit = strtoul(env, NULL, 10);
+	if (!limit || limit > UINT_MAX)
+		return ACVP_PAGING_LIMIT;
+
+	return (unsigned int)limit;
+}
+
+/*****************************************************************************
+ * Page prefetching
+ *****************************************************************************/
+static void acvp_paging_prefetch_free(struct acvp_paging_prefetch *prefetch)
+{
+	unsigned int i;
+
+	for (i = 0; i < prefetch->npages; i++)
+		acvp_free_buf(&prefetch->pages[i].buf);
+	pthread_cond_destroy(&prefetch->completion);
+	mutex_w_destroy(&prefetch->lock);
+	free(prefetch);
+}
+
+/* Drop a reference - the caller must hold the lock which is released */
+static void acvp_paging_prefetch_put(struct acvp_paging_prefetch *prefetch)
+{
+	bool last = !(--prefetch->refcnt);
+
+	mutex_w_unlock(&prefetch->lock);
+	if (last)
+		acvp_paging_prefetch_free(prefetch);
+}
+
+static int acvp_paging_prefetch_thread(void *arg)
+{
+	struct acvp_paging_job *job = arg;
+	struct acvp_paging_prefetch *prefetch = job->prefetch;
+	struct acvp_paging_page *page = job->page;
+	int ret;
+
+	free(job);
+
+	mutex_w_lock(&prefetch->lock);
+	/* The caller either fetched the page itself or is gone */
+	if (prefetch->abort || page->state != acvp_paging_queued) {
+		acvp_paging_prefetch_put(prefetch);
+		return 0;
+	}
+	page->state = acvp_paging_running;
+	prefetch->running++;
+	mutex_w_unlock(&prefetch->lock);
+
+	logger(LOGGER_DEBUG, LOGGER_C_ANY, "Paging: prefetching URL %s\n",
+	       page->url);
+	ret = acvp_process_retry_testid(prefetch->testid_ctx, &page->buf,
+					page->url);
+
+	mutex_w_lock(&prefetch->lock);
+	page->ret = ret;
+	page->state = acvp_paging_done;
+	prefetch->running--;
+	pthread_cond_broadcast(&prefetch->completion);
+	acvp_paging_prefetch_put(prefetch);
+
+	/* The result is consumed by the caller from the page */
+	return 0;
+}
+
+static void acvp_paging_prefetch_start(struct acvp_paging_prefetch *prefetch,
+				       unsigned int idx)
+{
+#ifdef ACVP_USE_PTHREAD
+	const struct acvp_ctx *ctx = prefetch->testid_ctx->ctx;
+	const struct acvp_opts_ctx *opts = &ctx->options;
+	struct acvp_paging_job *job;
+
+	/*
+	 * Without threading, or if no job can be started, the page is fetched
+	 * by the caller once it is needed.
+	 */
+	if (opts->threading_disabled || idx >= prefetch->npages)
+		return;
+
+	job = calloc(1, sizeof(*job));
+	if (!job)
+		return;
+	job->prefetch = prefetch;
+	job->page = &prefetch->pages[idx];
+
+	mutex_w_lock(&prefetch->lock);
+	prefetch->refcnt++;
+	mutex_w_unlock(&prefetch->lock);
+
+	if (thread_start(acvp_paging_prefetch_thread, job, 1, NULL)) {
+		free(job);
+		mutex_w_lock(&prefetch->lock);
+		prefetch->refcnt--;
+		mutex_w_unlock(&prefetch->lock);
+	}
+#else
+	(void)prefetch;
+	(void)idx;
+#endif
+}
+
+/* Obtain the page, either from its job or by fetching it */
+static struct acvp_paging_page *
+acvp_paging_prefetch_get(struct acvp_paging_prefetch *prefetch,
+			 unsigned int idx)
+{
+	struct acvp_paging_page *page = &prefetch->pages[idx];
+	bool fetch = false;
+
+	mutex_w_lock(&prefetch->lock);
+	if (page->state == acvp_paging_queued) {
+		page->state = acvp_paging_claimed;
+		fetch = true;
+	}
+	while (page->state == acvp_paging_running)
+		pthread_cond_wait(&prefetch->completion, &prefetch->lock);
+	mutex_w_unlock(&prefetch->lock);
+
+	if (fetch) {
+		logger(LOGGER_DEBUG, LOGGER_C_ANY, "Paging: using URL %s\n",
+		       page->url);
+		page->ret = acvp_process_retry_testid(prefetch->testid_ctx,
+						      &page->buf, page->url);
+	}
+
+	return page;
+}
+
+static int acvp_paging_prefetch_alloc(const struct acvp_testid_ctx *testid_ctx,
+				      const char *limit_url,
+				      unsigned int pagesize,
+				      unsigned int npages,
+				      struct acvp_paging_prefetch **out)
+{
+	struct acvp_paging_prefetch *prefetch;
+	unsigned int i;
+	int ret = 0;
+	char offset[32];
+
+	prefetch = calloc(1, sizeof(*prefetch) + npages * sizeof(prefetch->pages[0]));
+	CKNULL(prefetch, -ENOMEM);
+
+	prefetch->testid_ctx = testid_ctx;
+	mutex_w_init(&prefetch->lock, 0);
+	pthread_cond_init(&prefetch->completion, NULL);
+	prefetch->refcnt = 1;
+	prefetch->npages = npages;
+
+	/* The first page was fetched by the caller, page i has offset i + 1 */
+	for (i = 0; i < npages; i++) {
+		struct acvp_paging_page *page = &prefetch->pages[i];
+
+		page->state = acvp_paging_queued;
+		snprintf(page->url, sizeof(page->url), "%s", limit_url);
+		snprintf(offset, sizeof(offset), "offset=%u",
+			 (i + 1) * pagesize);
+		ret = acvp_append_urloptions(offset, page->url,
+					     sizeof(page->url));
+		if (ret) {
+			acvp_paging_prefetch_free(prefetch);
+			goto out;
+		}
+	}
+
+	*out = prefetch;
+
+out:
+	return ret;
+}
+
+/* Release the caller's reference after all running jobs completed */
+static void acvp_paging_prefetch_release(struct acvp_paging_prefetch *prefetch)
+{
+	if (!prefetch)
+		return;
+
+	/*
+	 * Running jobs use the testid_ctx of the caller, jobs that did not
+	 * start yet return immediately.
+	 */
+	mutex_w_lock(&prefetch->lock);
+	prefetch->abort = true;
+	while (prefetch->running)
+		pthread_cond_wait(&prefetch->completion, &prefetch->lock);
+	acvp_paging_prefetch_put(prefetch);
+}
+
+/*****************************************************************************
+ * Page processing
+ *****************************************************************************/
+struct acvp_paging_walk {
+	const struct acvp_testid_ctx *testid_ctx;
+	unsigned int show_type;
+	void *private;
+	int (*cb)(void *private, struct json_object *dataentry);
+
+	/* Entries not yet processed */
+	uint32_t totalcount;
+	/* Status of the last processed page */
+	bool incomplete;
+	bool has_next;
+	unsigned int entries;
+	/* URL of the next page as announced by the server */
+	char next_url[FILENAME_MAX];
+};
+
+static int acvp_paging_process(struct acvp_paging_walk *walk,
+			       const struct acvp_buf *buf, const int fetch_ret,
+			       const char *url)
+{
+	const struct acvp_ctx *ctx = walk->testid_ctx->ctx;
+	const struct acvp_opts_ctx *opts = &ctx->options;
+	struct json_object *resp = NULL, *pagingdata, *links, *dataarray;
+	size_t i;
+	int ret;
+
+	walk->entries = 0;
+	snprintf(walk->next_url, sizeof(walk->next_url), "%s", url);
+
+	CKINT(acvp_store_file(walk->testid_ctx, buf, fetch_ret, url));
+
+	if (fetch_ret) {
+		ret = fetch_ret;
+		goto out;
+	}
+
+	CKINT(acvp_req_strip_version(buf, &resp, &pagingdata));
+
+	CKINT(json_get_bool(pagingdata, "incomplete", &walk->incomplete));
+
+	/* The first page reports the number of entries */
+	if (!walk->totalcount)
+		CKINT(json_get_uint(pagingdata, "totalCount",
+				    &walk->totalcount));
+
+	logger_status(LOGGER_C_ANY, "Paging: %u entries to process\n",
+		      walk->totalcount);
+
+	/* Iterate over data array */
+	CKINT(json_find_key(pagingdata, "data", &dataarray, json_type_array));
+	walk->entries = (unsigned int)json_object_array_length(dataarray);
+	for (i = 0; i < walk->entries; i++) {
+		struct json_object *entry =
+			json_object_array_get_idx(dataarray, i);
+
+		if (opts->show_db_entries & walk->show_type) {
+			CKINT(json_print(stdout, entry,
+					 JSON_C_TO_STRING_PRETTY |
+						 JSON_C_TO_STRING_NOSLASHESCAPE));
+		} else if (walk->cb) {
+			CKINT(walk->cb(walk->private, entry));
+		}
+
+		/* Callback indicated that we shall interrupt loop */
+		if (ret == EINTR)
+			goto out;
+
+		walk->totalcount--;
+
+		/*
+		 * Sanity operation to not loop indefinitely if server
+		 * has an issue
+		 */
+		if (!walk->totalcount)
+			break;
+	}
+
+	/* The next keyword may contain a string or NULL */
+	walk->has_next = false;
+	if (walk->incomplete) {
+		const char *next;
+
+		CKINT(json_find_key(pagingdata, "links", &links,
+				    json_type_object));
+		if (!json_get_string(links, "nextPage", &next)) {
+			/*
+			 * Defensive programming: we only honor the HTTP
+			 * parameters
+			 */
+			CKINT(acvp_paging_get_url_parameters(&next));
+			CKINT(acvp_replace_urloptions(next, walk->next_url,
+						      sizeof(walk->next_url)));
+			walk->has_next = true;
+		}
+	}
+
+out:
+	ACVP_JSON_PUT_NULL(resp);
+	return ret;
+}
+
 int acvp_paging_get(const struct acvp_testid_ctx *testid_ctx, const char *url,
 		    const unsigned int show_type, void *private,
 		    int (*cb)(void *private, struct json_object *dataentry))
 {
-	const struct acvp_ctx *ctx = testid_ctx->ctx;
-	const struct acvp_opts_ctx *opts = &ctx->options;
+	const struct acvp_ctx *ctx;
+	const struct acvp_opts_ctx *opts;
+	struct acvp_paging_prefetch *prefetch = NULL;
+	struct acvp_paging_walk walk;
 	ACVP_BUFFER_INIT(buf);
-	struct json_object *resp = NULL, *pagingdata, *links, *dataarray;
-	uint32_t totalcount = 0;
-	unsigned int i;
+	unsigned int i, npages, pagesize = acvp_paging_limit();
 	int ret = 0, ret2;
-	const char *next = NULL;
-	char parametrized_url[FILENAME_MAX];
-	bool incomplete;
+	char parametrized_url[FILENAME_MAX], limit[32];
 
 	CKNULL(url, -EINVAL);
 	CKNULL(testid_ctx, -EINVAL);
 
+	ctx = testid_ctx->ctx;
+	opts = &ctx->options;
+
 	/*
 	 * If there is one ACVP server database retrieval option set, this
 	 * function does not perform any actions if the show type does not
@@ -84,94 +450,110 @@ int acvp_paging_get(const struct acvp_testid_ctx *testid_ctx, const char *url,
 	strncpy(parametrized_url, url, sizeof(parametrized_url) - 1);
 	/* Safety measure */
 	parametrized_url[FILENAME_MAX - 1] = '\0';
-	CKINT(acvp_append_urloptions("limit=100", parametrized_url,
+	snprintf(limit, sizeof(limit), "limit=%u", pagesize);
+	CKINT(acvp_append_urloptions(limit, parametrized_url,
 				     sizeof(parametrized_url)));
 
-	/* Loop over paging reply as long as there is a next pointer */
-	do {
-		next = NULL;
+	memset(&walk, 0, sizeof(walk));
+	walk.testid_ctx = testid_ctx;
+	walk.show_type = show_type;
+	walk.private = private;
+	walk.cb = cb;
 
-		logger(LOGGER_DEBUG, LOGGER_C_ANY, "Paging: using URL %s\n",
-		       parametrized_url);
-		ret2 = acvp_process_retry_testid(testid_ctx, &buf,
-						 parametrized_url);
+	logger(LOGGER_DEBUG, LOGGER_C_ANY, "Paging: using URL %s\n",
+	       parametrized_url);
+	ret2 = acvp_process_retry_testid(testid_ctx, &buf, parametrized_url);
+
+	/*
+	 * Prepare the fetching of all remaining pages before processing the
+	 * first page so that they are transferred while the callbacks of the
+	 * first page execute. The server may use a smaller page size than
+	 * requested which is detected from the first page.
+	 */
+	if (!ret2) {
+		struct json_object *resp = NULL, *pagingdata = NULL, *dataarray;
+		uint32_t total = 0;
+		bool incomplete = false;
 
-		CKINT(acvp_store_file(testid_ctx, &buf, ret2,
-				      parametrized_url));
+		if (!acvp_req_strip_version(&buf, &resp, &pagingdata) &&
+		    !json_get_bool(pagingdata, "incomplete", &incomplete) &&
+		    incomplete &&
+		    !json_get_uint(pagingdata, "totalCount", &total) &&
+		    !json_find_key(pagingdata, "data", &dataarray,
+				   json_type_array) &&
+		    json_object_array_length(dataarray)) {
+			unsigned int first = (unsigned int)
+				json_object_array_length(dataarray);
 
-		if (ret2) {
-			ret = ret2;
-			goto out;
-		}
+			if (first < pagesize) {
+				pagesize = first;
 
-		CKINT(acvp_req_strip_version(&buf, &resp, &pagingdata));
-
-		CKINT(json_get_bool(pagingdata, "incomplete", &incomplete));
-		if (incomplete) {
-			/* Get the links */
-			CKINT(json_find_key(pagingdata, "links", &links,
-					    json_type_object));
-
-			/* The next keyword may contain a string or NULL */
-			ret = json_get_string(links, "nextPage", &next);
-			if (!ret) {
-				/*
-				* Defensive programming: we only honor the HTTP
-				* parameters
-				*/
-				CKINT(acvp_paging_get_url_parameters(&next));
-				CKINT(acvp_replace_urloptions(
-					next, parametrized_url,
+				/* Request the page size the server uses */
+				strncpy(parametrized_url, url,
+					sizeof(parametrized_url) - 1);
+				snprintf(limit, sizeof(limit), "limit=%u",
+					 pagesize);
+				CKINT(acvp_append_urloptions(
+					limit, parametrized_url,
 					sizeof(parametrized_url)));
 			}
-		}
 
-		if (!totalcount)
-			CKINT(json_get_uint(pagingdata, "totalCount",
-					    &totalcount));
-
-		logger_status(LOGGER_C_ANY, "Paging: %u entries to process\n",
-			      totalcount);
-
-		/* Iterate over data array */
-		CKINT(json_find_key(pagingdata, "data", &dataarray,
-				    json_type_array));
-		for (i = 0; i < json_object_array_length(dataarray); i++) {
-			struct json_object *entry =
-				json_object_array_get_idx(dataarray, i);
-
-			if (opts->show_db_entries & show_type) {
-				fprintf(stdout, "%s\n",
-					json_object_to_json_string_ext(
-						entry,
-						JSON_C_TO_STRING_PRETTY |
-							JSON_C_TO_STRING_NOSLASHESCAPE));
-			} else if (cb) {
-				CKINT(cb(private, entry));
+			npages = (total > first) ?
+					 (total - first + pagesize - 1) /
+						 pagesize :
+					 0;
+			if (npages) {
+				CKINT(acvp_paging_prefetch_alloc(
+					testid_ctx, parametrized_url, pagesize,
+					npages, &prefetch));
+				for (i = 0; i < ACVP_PAGING_PREFETCH; i++)
+					acvp_paging_prefetch_start(prefetch,
+								   i);
 			}
+		}
+		ACVP_JSON_PUT_NULL(resp);
+	}
 
-			/* Callback indicated that we shall interrupt loop */
-			if (ret == EINTR) {
-				goto out;
-			}
+	CKINT(acvp_paging_process(&walk, &buf, ret2, parametrized_url));
+	acvp_free_buf(&buf);
 
-			totalcount--;
+	if (!prefetch) {
+		/* Loop over paging reply as long as there is a next pointer */
+		while (ret != EINTR && walk.has_next && walk.totalcount) {
+			memcpy(parametrized_url, walk.next_url,
+			       sizeof(parametrized_url));
 
-			/*
-			 * Sanity operation to not loop indefinitely if server
-			 * has an issue
-			 */
-			if (!totalcount)
-				break;
+			logger(LOGGER_DEBUG, LOGGER_C_ANY,
+			       "Paging: using URL %s\n", parametrized_url);
+			ret2 = acvp_process_retry_testid(testid_ctx, &buf,
+							 parametrized_url);
+			CKINT(acvp_paging_process(&walk, &buf, ret2,
+						  parametrized_url));
+			acvp_free_buf(&buf);
 		}
 
-		ACVP_JSON_PUT_NULL(resp);
-		acvp_free_buf(&buf);
+		goto out;
+	}
+
+	/* Process the remaining pages in order */
+	for (i = 0; i < prefetch->npages; i++) {
+		struct acvp_paging_page *page;
+
+		if (ret == EINTR || !walk.totalcount || !walk.has_next ||
+		    !walk.entries)
+			break;
+
+		/* Keep the prefetch window filled */
+		acvp_paging_prefetch_start(prefetch, i + ACVP_PAGING_PREFETCH);
 
-	} while (next != NULL && totalcount);
+		page = acvp_paging_prefetch_get(prefetch, i);
+		CKINT(acvp_paging_process(&walk, &page->buf, page->ret,
+					  page->url));
+		acvp_free_buf(&page->buf);
+	}
 
 out:
-	ACVP_JSON_PUT_NULL(resp);
+	acvp_paging_prefetch_release(prefetch);
 	acvp_free_buf(&buf);
 	return ret;
 }
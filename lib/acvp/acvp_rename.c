@@ -53,6 +53,9 @@ static int acvp_rename_generic(const struct acvp_testid_ctx *testid_ctx,
 		"If the name is already registered with the ACVP server and you want to update it with \"--update-definition oe\" remember to perform TWO rounds of update, one for the software dependency and one for the OE name!\n");
 
 out:
+	/* The names are part of the definition search index */
+	acvp_def_index_invalidate();
+
 	if (ret) {
 		if (newname_modify)
 			free(newname_modify);
@@ -228,6 +231,8 @@ static int acvp_rename_name(const struct acvp_testid_ctx *testid_ctx,
 	 */
 
 out:
+	acvp_def_index_invalidate();
+
 	if (ret) {
 		if (newname_modify)
 			free(newname_modify);
@@ -290,6 +295,8 @@ static int acvp_rename_version(const struct acvp_testid_ctx *testid_ctx,
 	 */
 
 out:
+	acvp_def_index_invalidate();
+
 	if (ret) {
 		if (newversion_modify)
 			free(newversion_modify);
@@ -21,6 +21,7 @@
 #include <string.h>
 
 #include "acvpproxy.h"
+#include "acvp_meta_internal.h"
 #include "internal.h"
 #include "json_wrapper.h"
 #include "logger.h"
@@ -757,13 +758,198 @@ out:
 	return ret;
 }
 
+/*
+ * Concurrent meta data synchronization
+ * ====================================
+ *
+ * Many definitions share the same vendor, OE and module configuration
+ * files and therefore the same entries in the ACVP server data base. Instead
+ * of processing every definition on its own, the unique set of these
+ * entities is built and each entity is validated / registered exactly once
+ * using one definition referencing it. The entities are processed in
+ * two stages:
+ *
+ * 1. The vendor with its contact person and the OE with its dependencies.
+ *
+ * 2. The module which requires the vendor and person IDs of the first stage.
+ *    It is only processed for definitions whose vendor and OE are known to
+ *    the ACVP server, i.e. for which no error and no pending registration
+ *    request was reported.
+ *
+ * All entities of one stage are processed concurrently. The IDs are written
+ * to the configuration files by the handlers with the def_lock held.
+ */
+enum acvp_sync_entity_type {
+	acvp_sync_vendor,
+	acvp_sync_oe,
+	acvp_sync_module,
+};
+
+struct acvp_sync_entity {
+	const struct acvp_ctx *ctx;
+	const struct definition *def;
+	enum acvp_sync_entity_type type;
+	int ret;
+};
+
+struct acvp_sync_def {
+	const struct definition *def;
+	struct acvp_sync_entity *vendor;
+	struct acvp_sync_entity *oe;
+};
+
+static int acvp_sync_entity_process(struct acvp_sync_entity *entity)
+{
+	struct acvp_testid_ctx *testid_ctx;
+	int ret;
+
+	testid_ctx = calloc(1, sizeof(struct acvp_testid_ctx));
+	CKNULL(testid_ctx, -ENOMEM);
+
+	testid_ctx->ctx = entity->ctx;
+	testid_ctx->def = entity->def;
+
+	CKINT(acvp_init_auth(testid_ctx));
+
+	switch (entity->type) {
+	case acvp_sync_vendor:
+		CKINT(acvp_vendor_handle(testid_ctx));
+		CKINT(acvp_person_handle(testid_ctx));
+		break;
+	case acvp_sync_oe:
+		CKINT(acvp_oe_handle(testid_ctx));
+		break;
+	case acvp_sync_module:
+		CKINT(acvp_module_handle(testid_ctx));
+		break;
+	default:
+		ret = -EINVAL;
+		goto out;
+	}
+
+out:
+	acvp_release_auth(testid_ctx);
+	ACVP_PTR_FREE_NULL(testid_ctx);
+	entity->ret = ret;
+	return ret;
+}
+
+#ifdef ACVP_USE_PTHREAD
+static int acvp_sync_entity_thread(void *arg)
+{
+	struct acvp_sync_entity *entity = arg;
+
+	acvp_sync_entity_process(entity);
+
+	/* The result is evaluated by the caller from the entity */
+	return 0;
+}
+#endif
+
+/* Process all entities of one stage and wait for their completion */
+static int acvp_sync_entities(const struct acvp_ctx *ctx,
+			      struct acvp_sync_entity *entities,
+			      const unsigned int num)
+{
+	unsigned int i;
+	int ret = 0;
+
+#ifdef ACVP_USE_PTHREAD
+	const struct acvp_opts_ctx *opts = &ctx->options;
+
+	/* Disable threading in DEBUG mode */
+	if (!opts->threading_disabled) {
+		/*
+		 * The results are reported through the entities, the return
+		 * codes of the jobs are not of interest.
+		 */
+		for (i = 0; i < num; i++) {
+			ret = thread_start(acvp_sync_entity_thread,
+					   &entities[i], 0, NULL);
+			if (ret)
+				break;
+		}
+
+		/* Entities which could not be started are marked as failed */
+		for (; i < num; i++)
+			entities[i].ret = ret;
+
+		/* The jobs reference the entities - always wait for them */
+		ret |= thread_wait();
+
+		return ret;
+	}
+#else
+	(void)ctx;
+#endif
+
+	for (i = 0; i < num; i++)
+		acvp_sync_entity_process(&entities[i]);
+
+	return ret;
+}
+
+/*
+ * Find the entity the definition references or add a new one. The entities
+ * are compared by the configuration file and, for modules, the module name.
+ */
+static struct acvp_sync_entity *
+acvp_sync_entity_get(const struct acvp_ctx *ctx, const struct definition *def,
+		     const enum acvp_sync_entity_type type,
+		     struct acvp_sync_entity *entities, unsigned int *num)
+{
+	unsigned int i;
+
+	for (i = 0; i < *num; i++) {
+		const struct definition *found = entities[i].def;
+
+		switch (type) {
+		case acvp_sync_vendor:
+			if (!strcmp(found->vendor->def_vendor_file,
+				    def->vendor->def_vendor_file))
+				return &entities[i];
+			break;
+		case acvp_sync_oe:
+			if (!strcmp(found->oe->def_oe_file,
+				    def->oe->def_oe_file))
+				return &entities[i];
+			break;
+		case acvp_sync_module:
+			if (!strcmp(found->info->def_module_file,
+				    def->info->def_module_file) &&
+			    !strcmp(found->info->module_name,
+				    def->info->module_name))
+				return &entities[i];
+			break;
+		default:
+			return NULL;
+		}
+	}
+
+	entities[i].ctx = ctx;
+	entities[i].def = def;
+	entities[i].type = type;
+	entities[i].ret = 0;
+	(*num)++;
+
+	return &entities[i];
+}
+
+/* A pending registration request is not an error */
+static int acvp_sync_entity_ret(const struct acvp_sync_entity *entity)
+{
+	return (entity->ret == -EAGAIN) ? 0 : entity->ret;
+}
+
 DSO_PUBLIC
 int acvp_synchronize_metadata(const struct acvp_ctx *ctx)
 {
 	const struct acvp_datastore_ctx *datastore;
 	const struct acvp_search_ctx *search;
 	const struct definition *def;
-	struct acvp_testid_ctx *testid_ctx = NULL;
+	struct acvp_sync_def *defs = NULL, *tmp;
+	struct acvp_sync_entity *stage1 = NULL, *modules = NULL;
+	unsigned int i, num_defs = 0, num_stage1 = 0, num_modules = 0;
 	int ret = 0;
 
 	CKNULL_LOG(ctx, -EINVAL, "ACVP request context missing\n");
@@ -777,61 +963,94 @@ int acvp_synchronize_metadata(const struct acvp_ctx *ctx)
 	datastore = &ctx->datastore;
 	search = &datastore->search;
 
-	/* Find a module definition */
-	def = acvp_find_def(search, NULL);
-	if (!def) {
+	/* Collect all module definitions */
+	for (def = acvp_find_def(search, NULL); def;
+	     def = acvp_find_def(search, def)) {
+		if (!def->vendor || !def->oe || !def->info) {
+			logger(LOGGER_ERR, LOGGER_C_ANY,
+			       "Definition without vendor, OE or module information found\n");
+			ret = -EINVAL;
+			goto out;
+		}
+
+		tmp = realloc(defs, (num_defs + 1) * sizeof(*defs));
+		CKNULL(tmp, -ENOMEM);
+		defs = tmp;
+		defs[num_defs].def = def;
+		num_defs++;
+	}
+
+	if (!num_defs) {
 		logger(LOGGER_ERR, LOGGER_C_ANY,
 		       "No cipher implementation found for search criteria\n");
 		return -EINVAL;
 	}
 
+	/* Each definition adds at most one vendor and one OE */
+	stage1 = calloc(2 * num_defs, sizeof(*stage1));
+	CKNULL(stage1, -ENOMEM);
+	modules = calloc(num_defs, sizeof(*modules));
+	CKNULL(modules, -ENOMEM);
+
+	for (i = 0; i < num_defs; i++) {
+		defs[i].vendor = acvp_sync_entity_get(ctx, defs[i].def,
+						      acvp_sync_vendor, stage1,
+						      &num_stage1);
+		defs[i].oe = acvp_sync_entity_get(ctx, defs[i].def,
+						  acvp_sync_oe, stage1,
+						  &num_stage1);
+	}
+
+	logger_status(LOGGER_C_ANY,
+		      "Synchronizing %u vendor and OE entries referenced by %u definitions\n",
+		      num_stage1, num_defs);
+
+	CKINT(acvp_sync_entities(ctx, stage1, num_stage1));
+
+	for (i = 0; i < num_stage1; i++) {
+		ret = acvp_sync_entity_ret(&stage1[i]);
+		if (ret)
+			goto out;
+	}
+
 	/*
-	 * Use thread group 0 for the register of cipher definitions and
-	 * thread group 1 for the vsID downloads.
-	 *
-	 * We have threads to register one cipher definition. While the thread
-	 * for registering one cipher definition is still running, threads are
-	 * spawned to download the vsIDs.
-	 *
-	 * The threads for registering cipher definitions are spawned all at
-	 * the beginning (to the extent possible). Thus, if we have more cipher
-	 * definitions to be registered at the same time as threads, we will
-	 * not be able to spawn any thread for downloading a vsID which will
-	 * cause a deadlock. Thus, we use different thread groups for
-	 * these interdependent threads to prevent that there can be a deadlock.
+	 * Collect the modules of all definitions whose vendor and OE are
+	 * known to the ACVP server.
 	 */
-	while (def) {
-		testid_ctx = calloc(1, sizeof(struct acvp_testid_ctx));
-		CKNULL(testid_ctx, -ENOMEM);
+	for (i = 0; i < num_defs; i++) {
+		const struct def_vendor *found = defs[i].vendor->def->vendor;
+		struct def_vendor *def_vendor = defs[i].def->vendor;
 
-		testid_ctx->ctx = ctx;
-		testid_ctx->def = def;
-
-		CKINT(acvp_init_auth(testid_ctx));
+		if (defs[i].vendor->ret || defs[i].oe->ret)
+			continue;
 
 		/*
-		 * No threading as this is a synchronous request -
-		 * see comment in acvp_publish.
-		 */
-		ret = acvp_sync_metadata(testid_ctx);
-		/*
-		 * -EAGAIN means that something was registered - this is an
-		 * expected return code and does not indicate an error here.
+		 * The vendor handler only updated the definition used for
+		 * the processing - all definitions with the same vendor
+		 * configuration file share its IDs.
 		 */
-		if (ret == -EAGAIN)
-			ret = 0;
-		else if (ret < 0)
-			goto out;
+		def_vendor->acvp_vendor_id = found->acvp_vendor_id;
+		def_vendor->acvp_person_id = found->acvp_person_id;
+		def_vendor->acvp_addr_id = found->acvp_addr_id;
 
-		acvp_release_auth(testid_ctx);
-		ACVP_PTR_FREE_NULL(testid_ctx);
+		acvp_sync_entity_get(ctx, defs[i].def, acvp_sync_module,
+				     modules, &num_modules);
+	}
+
+	logger_status(LOGGER_C_ANY, "Synchronizing %u module entries\n",
+		      num_modules);
+
+	CKINT(acvp_sync_entities(ctx, modules, num_modules));
 
-		/* Check if we find another module definition. */
-		def = acvp_find_def(search, def);
+	for (i = 0; i < num_modules; i++) {
+		ret = acvp_sync_entity_ret(&modules[i]);
+		if (ret)
+			goto out;
 	}
 
 out:
-	acvp_release_auth(testid_ctx);
-	ACVP_PTR_FREE_NULL(testid_ctx);
+	free(defs);
+	free(stage1);
+	free(modules);
 	return ret;
 }
@@ -150,6 +150,10 @@ void acvp_release_testid(struct acvp_testid_ctx *testid_ctx)
 	if (!testid_ctx)
 		return;
 
+	/* Changes the data store holds back for the test session are written */
+	if (ds && ds->acvp_datastore_release_testid)
+		ds->acvp_datastore_release_testid(testid_ctx);
+
 	acvp_release_verdict(&testid_ctx->verdict);
 
 	free(testid_ctx);
@@ -418,18 +422,28 @@ out:
 }
 
 /*
- * Fetch data and process potential retry responses
+ * Fetch data and process potential retry responses - if defer is true and
+ * the caller is a job that can be deferred, a retry response is not waited
+ * for but -EINPROGRESS is returned and the caller is started again later.
+ *
+ * If fd is a valid file descriptor, the response is written to the file. A
+ * large response is only written to the file while result_data merely holds
+ * its beginning. As a retry response is always small, only responses held
+ * completely in memory are checked for a retry statement.
  */
-int acvp_process_retry(const struct acvp_vsid_ctx *vsid_ctx,
-		       struct acvp_buf *result_data, const char *url,
-		       int (*debug_logger)(const struct acvp_vsid_ctx *vsid_ctx,
-					   const struct acvp_buf *buf, int err))
+static int
+_acvp_process_retry(const struct acvp_vsid_ctx *vsid_ctx,
+		    struct acvp_buf *result_data, const char *url,
+		    int (*debug_logger)(const struct acvp_vsid_ctx *vsid_ctx,
+					const struct acvp_buf *buf, int err),
+		    bool defer, int fd)
 {
 	const struct acvp_testid_ctx *testid_ctx = vsid_ctx->testid_ctx;
 	const struct definition *def = testid_ctx->def;
 	const struct def_info *info = def ? def->info : NULL;
-	struct json_object *resp = NULL, *data = NULL;
+	struct json_scan_key retry = { .name = "retry" };
 	uint32_t sleep_time = 0;
+	bool is_streamed = false;
 	int ret, ret2;
 
 	while (1) {
@@ -445,11 +459,19 @@ int acvp_process_retry(const struct acvp_vsid_ctx *vsid_ctx,
 			       "(Re)Try testID %u\n", testid_ctx->testid);
 		}
 
-		ret2 = acvp_net_op(testid_ctx, url, NULL, result_data,
-				   acvp_http_get);
+		if (fd < 0) {
+			ret2 = acvp_net_op(testid_ctx, url, NULL, result_data,
+					   acvp_http_get);
+		} else {
+			ret2 = acvp_net_op_stream(testid_ctx, url, result_data,
+						  fd, &is_streamed);
+		}
 
-		/* Store the debug version of the result unconditionally. */
-		if (debug_logger) {
+		/*
+		 * Store the debug version of the result unconditionally - a
+		 * streamed result is only present in its file.
+		 */
+		if (debug_logger && (!is_streamed || ret2)) {
 			CKINT(debug_logger(vsid_ctx, result_data, ret2));
 		}
 
@@ -458,22 +480,39 @@ int acvp_process_retry(const struct acvp_vsid_ctx *vsid_ctx,
 			goto out;
 		}
 
-		/* Strip the version array entry and get the data. */
-		CKINT(acvp_req_strip_version(result_data, &resp, &data));
+		/* A streamed response is too large to be a retry statement */
+		if (is_streamed) {
+			ret = 0;
+			break;
+		}
+
+		/*
+		 * Look for the retry statement in the data without parsing
+		 * the response into JSON objects.
+		 */
+		CKINT(acvp_req_scan_keys(result_data, &retry, 1, false));
 
 		/*
 		 * Terminate the loop when the server did not return a
 		 * retry statement.
 		 */
-		if (json_get_uint(data, "retry", &sleep_time))
+		if (json_scan_get_uint(&retry, &sleep_time))
 			break;
 
 		/* Server asked us to retry in given number of seconds */
 
-		/* Clear the buffers for the next loop iteration. */
-		ACVP_JSON_PUT_NULL(resp);
+		/* Clear the buffer for the next loop iteration. */
 		acvp_free_buf(result_data);
 
+		/* Do not block a thread while waiting for the server */
+		if (defer && !thread_defer(sleep_time)) {
+			logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+			       "ACVP server requested retry - deferring vsID %u for %u seconds\n",
+			       vsid_ctx->vsid, sleep_time);
+			ret = -EINPROGRESS;
+			goto out;
+		}
+
 		if (vsid_ctx->vsid) {
 			logger(LOGGER_VERBOSE, LOGGER_C_ANY,
 			       "ACVP server requested retry - sleeping for %u seconds for vsID %u again\n",
@@ -489,7 +528,7 @@ int acvp_process_retry(const struct acvp_vsid_ctx *vsid_ctx,
 	}
 
 out:
-	if (ret) {
+	if (ret && ret != -EINPROGRESS) {
 		if (ret == -EINTR || ret == -ESHUTDOWN) {
 			logger_status(
 				LOGGER_C_ANY,
@@ -506,10 +545,18 @@ out:
 		}
 	}
 
-	ACVP_JSON_PUT_NULL(resp);
 	return ret;
 }
 
+int acvp_process_retry(const struct acvp_vsid_ctx *vsid_ctx,
+		       struct acvp_buf *result_data, const char *url,
+		       int (*debug_logger)(const struct acvp_vsid_ctx *vsid_ctx,
+					   const struct acvp_buf *buf, int err))
+{
+	return _acvp_process_retry(vsid_ctx, result_data, url, debug_logger,
+				   false, -1);
+}
+
 int acvp_process_retry_testid(const struct acvp_testid_ctx *testid_ctx,
 			      struct acvp_buf *result_data, const char *url)
 {
@@ -573,23 +620,28 @@ void acvp_record_vsid_duration(const struct acvp_vsid_ctx *vsid_ctx,
 	ds->acvp_datastore_write_vsid(vsid_ctx, pathname, false, &buf);
 }
 
-/* GET /testSessions/<testSessionId>/vectorSets/<vectorSetId> */
-int acvp_get_testvectors(const struct acvp_vsid_ctx *vsid_ctx)
+struct acvp_get_testvectors_stream {
+	const char *url;
+	bool defer;
+};
+
+/* Download the vsID into the file provided by the data store */
+static int acvp_get_testvectors_stream(const struct acvp_vsid_ctx *vsid_ctx,
+				       int fd, void *data)
 {
-	const struct acvp_testid_ctx *testid_ctx = vsid_ctx->testid_ctx;
-	const struct acvp_ctx *ctx = testid_ctx->ctx;
-	const struct acvp_datastore_ctx *datastore = &ctx->datastore;
-	const struct acvp_net_ctx *net;
+	struct acvp_get_testvectors_stream *stream = data;
 	ACVP_BUFFER_INIT(buf);
-	ACVP_BUFFER_INIT(tmp);
-	char url[ACVP_NET_URL_MAXLEN];
 	int ret, ret2;
 
-	/* Prepare the URL to be used for downloading the vsID */
-	CKINT(acvp_vsid_url(vsid_ctx, url, sizeof(url), false));
-
 	/* Do the actual download of the vsID */
-	ret2 = acvp_process_retry(vsid_ctx, &buf, url, acvp_store_vector_debug);
+	ret2 = _acvp_process_retry(vsid_ctx, &buf, stream->url,
+				   acvp_store_vector_debug, stream->defer, fd);
+
+	/* The download is started again once the retry time passed */
+	if (ret2 == -EINPROGRESS) {
+		ret = ret2;
+		goto out;
+	}
 
 	/* Initialize the vsID directory for later potential re-load. */
 	CKINT(acvp_store_vector_status(
@@ -597,14 +649,45 @@ int acvp_get_testvectors(const struct acvp_vsid_ctx *vsid_ctx)
 		"vsID HTTP GET operation completed with return code %d\n",
 		ret2));
 
-	if (ret2 < 0) {
+	if (ret2 < 0)
 		ret = ret2;
-		goto out;
-	}
 
-	/* Store the vsID data in data store */
-	CKINT(ds->acvp_datastore_write_vsid(vsid_ctx, datastore->vectorfile,
-					    false, &buf));
+out:
+	acvp_free_buf(&buf);
+	return ret;
+}
+
+/* GET /testSessions/<testSessionId>/vectorSets/<vectorSetId> */
+static int _acvp_get_testvectors(const struct acvp_vsid_ctx *vsid_ctx,
+				 bool defer)
+{
+	const struct acvp_testid_ctx *testid_ctx = vsid_ctx->testid_ctx;
+	const struct acvp_ctx *ctx = testid_ctx->ctx;
+	const struct acvp_datastore_ctx *datastore = &ctx->datastore;
+	const struct acvp_net_ctx *net;
+	struct acvp_get_testvectors_stream stream;
+	ACVP_BUFFER_INIT(tmp);
+	char url[ACVP_NET_URL_MAXLEN];
+	int ret;
+
+	/* The files of the vsID are written together */
+	if (ds->acvp_datastore_batch)
+		ds->acvp_datastore_batch(true);
+
+	/* Prepare the URL to be used for downloading the vsID */
+	CKINT(acvp_vsid_url(vsid_ctx, url, sizeof(url), false));
+
+	/*
+	 * Download the vsID and store it in the data store - the data is
+	 * written to the data store while it is received to avoid holding
+	 * large vector sets in memory.
+	 */
+	stream.url = url;
+	stream.defer = defer;
+	CKINT(ds->acvp_datastore_stream_vsid(vsid_ctx, datastore->vectorfile,
+					     false,
+					     acvp_get_testvectors_stream,
+					     &stream));
 
 	CKINT(acvp_get_net(&net));
 	tmp.buf = (uint8_t *)net->server_name;
@@ -631,10 +714,16 @@ int acvp_get_testvectors(const struct acvp_vsid_ctx *vsid_ctx)
 	acvp_record_vsid_duration(vsid_ctx, ACVP_DS_DOWNLOADDURATION);
 
 out:
-	acvp_free_buf(&buf);
+	if (ds->acvp_datastore_batch)
+		ds->acvp_datastore_batch(false);
 	return ret;
 }
 
+int acvp_get_testvectors(const struct acvp_vsid_ctx *vsid_ctx)
+{
+	return _acvp_get_testvectors(vsid_ctx, false);
+}
+
 #ifdef ACVP_USE_PTHREAD
 static int acvp_process_req_thread(void *arg)
 {
@@ -642,12 +731,17 @@ static int acvp_process_req_thread(void *arg)
 	struct acvp_vsid_ctx *vsid_ctx = tdata->vsid_ctx;
 	int ret;
 
-	free(tdata);
-
 	thread_set_name(acvp_vsid, vsid_ctx->vsid);
 
-	ret = acvp_get_testvectors(vsid_ctx);
+	/*
+	 * If the ACVP server asks for a retry, the job is parked and started
+	 * again with the same tdata once the retry time passed.
+	 */
+	ret = _acvp_get_testvectors(vsid_ctx, true);
+	if (ret == -EINPROGRESS)
+		return 0;
 
+	free(tdata);
 	acvp_release_vsid_ctx(vsid_ctx);
 
 	return ret;
@@ -790,7 +884,6 @@ static int acvp_process_vectors(const struct acvp_testid_ctx *testid_ctx,
 				goto out;
 		} else {
 			struct acvp_thread_ctx *tdata;
-			int ret_ancestor;
 
 			tdata = calloc(1, sizeof(*tdata));
 			if (!tdata) {
@@ -800,8 +893,7 @@ static int acvp_process_vectors(const struct acvp_testid_ctx *testid_ctx,
 			}
 			tdata->vsid_ctx = vsid_ctx;
 			CKINT(thread_start(acvp_process_req_thread, tdata, 1,
-					   &ret_ancestor));
-			ret |= ret_ancestor;
+					   NULL));
 		}
 #else
 		ret = acvp_get_testvectors(vsid_ctx);
@@ -869,7 +961,6 @@ static int acvp_register_dump_request(const struct acvp_testid_ctx *testid_ctx,
 	time_t now;
 	ACVP_BUFFER_INIT(register_buf);
 	char filename[FILENAME_MAX];
-	const char *json_request;
 	int ret;
 
 	now = time(NULL);
@@ -886,19 +977,16 @@ static int acvp_register_dump_request(const struct acvp_testid_ctx *testid_ctx,
 		 now_detail.tm_mday, now_detail.tm_hour, now_detail.tm_min,
 		 now_detail.tm_sec);
 
-	json_request = json_object_to_json_string_ext(
-		request,
-		JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE);
-	CKNULL_LOG(json_request, -ENOMEM,
-		   "JSON object conversion into string failed\n");
-
-	register_buf.buf = (uint8_t *)json_request;
-	register_buf.len = (uint32_t)strlen(json_request);
+	CKINT(json_to_buf(request,
+			  JSON_C_TO_STRING_PRETTY |
+				  JSON_C_TO_STRING_NOSLASHESCAPE,
+			  &register_buf));
 	CKINT_LOG(ds->acvp_datastore_write_testid(testid_ctx, filename, true,
 						  &register_buf),
 		  "Cannot write file (%d) %s\n", ret, filename);
 
 out:
+	acvp_free_buf(&register_buf);
 	return ret;
 }
 
@@ -995,48 +1083,64 @@ static int acvp_register_op(struct acvp_testid_ctx *testid_ctx)
 	const struct definition *def = testid_ctx->def;
 	const struct def_info *info = def->info;
 	struct json_object *request = NULL;
+	struct json_arena *arena, *prev;
 	ACVP_EXT_BUFFER_INIT(register_buf);
 	ACVP_BUFFER_INIT(response_buf);
 	const char *json_request;
+	size_t json_request_len;
 	char url[ACVP_NET_URL_MAXLEN];
 	int ret = 0, ret2;
 
 	CKINT_LOG(acvp_init_auth(testid_ctx),
 		  "Failure to initialize authtoken\n");
 
+	/*
+	 * The registration message is allocated from an arena owned by the
+	 * request object.
+	 */
+	arena = json_arena_new();
+	CKNULL(arena, -ENOMEM);
+	prev = json_arena_set(arena);
 	request = json_object_new_array();
-	CKNULL(request, -ENOMEM);
+	if (!request || json_arena_set_owner(request)) {
+		json_arena_set(prev);
+		json_arena_free(arena);
+		request = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
 
 	/* Construct the registration message. */
-	CKINT_LOG(acvp_req_build(testid_ctx, request),
-		  "Failure to create registration message\n");
+	ret = acvp_req_build(testid_ctx, request);
+	json_arena_set(prev);
+	CKINT_LOG(ret, "Failure to create registration message\n");
 
-	if (!req_details->dump_register)
+	if (!req_details->dump_register) {
 		sig_enqueue_ctx(testid_ctx);
+		acvp_jwt_renew_enqueue(testid_ctx);
+	}
 
 	/*
 	 * Dump the constructed message if requested and return (i.e. no
 	 * submission).
 	 */
 	if (req_details->dump_register) {
-		fprintf(stdout, "%s\n",
-			json_object_to_json_string_ext(
-				request,
-				JSON_C_TO_STRING_PRETTY |
-					JSON_C_TO_STRING_NOSLASHESCAPE));
-		ret = 0;
+		CKINT(json_print(stdout, request,
+				 JSON_C_TO_STRING_PRETTY |
+					 JSON_C_TO_STRING_NOSLASHESCAPE));
 		goto out;
 	}
 
 	/* Convert the JSON buffer into a string */
-	json_request = json_object_to_json_string_ext(
+	json_request = json_object_to_json_string_length(
 		request,
-		JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE);
+		JSON_C_TO_STRING_PLAIN | JSON_C_TO_STRING_NOSLASHESCAPE,
+		&json_request_len);
 	CKNULL_LOG(json_request, -ENOMEM,
 		   "JSON object conversion into string failed\n");
 
 	register_buf.buf = (uint8_t *)json_request;
-	register_buf.len = (uint32_t)strlen(json_request);
+	register_buf.len = (uint32_t)json_request_len;
 
 	CKINT_LOG(acvp_create_url(NIST_VAL_OP_REG, url, sizeof(url)),
 		  "Creation of request URL failed\n");
@@ -1056,8 +1160,10 @@ static int acvp_register_op(struct acvp_testid_ctx *testid_ctx)
 	CKINT(acvp_process_req(testid_ctx, request, &response_buf));
 
 out:
-	if (!req_details->dump_register)
+	if (!req_details->dump_register) {
+		acvp_jwt_renew_dequeue(testid_ctx);
 		sig_dequeue_ctx(testid_ctx);
+	}
 
 	if (ret && testid_ctx)
 		logger(LOGGER_ERR, LOGGER_C_ANY,
@@ -1216,7 +1322,6 @@ int acvp_register_cb(const struct acvp_ctx *ctx,
 			CKINT(cb(ctx, def, 0));
 		} else {
 			struct acvp_thread_reqresp_ctx *tdata;
-			int ret_ancestor;
 
 			tdata = calloc(1, sizeof(*tdata));
 			CKNULL_LOG(tdata, -ENOMEM,
@@ -1225,13 +1330,11 @@ int acvp_register_cb(const struct acvp_ctx *ctx,
 			tdata->def = def;
 			tdata->cb = cb;
 			ret = thread_start(acvp_register_thread, tdata, 0,
-					   &ret_ancestor);
+					   NULL);
 			if (ret) {
 				free(tdata);
 				goto out;
 			}
-
-			ret |= ret_ancestor;
 		}
 #else
 		CKINT(cb(ctx, def, 0));
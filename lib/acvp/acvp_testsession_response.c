@@ -18,6 +18,8 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
+#include <ctype.h>
 #include <errno.h>
 #include <stdlib.h>
 #include <string.h>
@@ -320,12 +322,12 @@ out:
 #ifdef ACVP_LARGE_ENDPOINT
 /* POST /large */
 static int acvp_get_large_endpoint(const struct acvp_vsid_ctx *vsid_ctx,
-				   const struct acvp_buf *submit_buf,
+				   const struct acvp_ext_buf *submit_buf,
 				   struct acvp_buf *received_buf)
 {
 	const struct acvp_testid_ctx *testid_ctx = vsid_ctx->testid_ctx;
 	struct json_object *entry = NULL, *large = NULL;
-	ACVP_BUFFER_INIT(large_req_buf);
+	ACVP_EXT_BUFFER_INIT(large_req_buf);
 	int ret;
 	char url[ACVP_NET_URL_MAXLEN], urlpath[ACVP_NET_URL_MAXLEN];
 	const char *json_large;
@@ -343,8 +345,9 @@ static int acvp_get_large_endpoint(const struct acvp_vsid_ctx *vsid_ctx,
 	entry = json_object_new_object();
 	CKNULL(entry, ENOMEM);
 
-	CKINT(json_object_object_add(entry, "submissionSize",
-				     json_object_new_int((int)submit_buf->len)));
+	CKINT(json_object_object_add(
+		entry, "submissionSize",
+		json_object_new_int((int)acvp_ext_buf_len(submit_buf))));
 
 	CKINT(acvp_vsid_url(vsid_ctx, urlpath, sizeof(urlpath), true));
 	CKINT(json_object_object_add(entry, "vectorSetUrl",
@@ -360,7 +363,8 @@ static int acvp_get_large_endpoint(const struct acvp_vsid_ctx *vsid_ctx,
 		   "JSON object conversion into string failed\n");
 
 	logger(LOGGER_VERBOSE, LOGGER_C_ANY,
-	       "Requesting large endpoint for data size %u\n", submit_buf->len);
+	       "Requesting large endpoint for data size %u\n",
+	       acvp_ext_buf_len(submit_buf));
 
 	large_req_buf.buf = (uint8_t *)json_large;
 	large_req_buf.len = (uint32_t)strlen(json_large);
@@ -377,7 +381,7 @@ out:
 /* POST to large endpoint */
 static int acvp_submit_large_endpoint(const struct acvp_vsid_ctx *vsid_ctx,
 				      const struct acvp_buf *large_endpoint,
-				      const struct acvp_buf *submit_buf)
+				      const struct acvp_ext_buf *submit_buf)
 {
 	const struct acvp_testid_ctx *testid_ctx = vsid_ctx->testid_ctx;
 	struct acvp_auth_ctx *auth = testid_ctx->server_auth;
@@ -448,7 +452,7 @@ static int acvp_check_large_endpoint(const struct acvp_vsid_ctx *vsid_ctx,
 	CKINT(acvp_get_max_msg_size(testid_ctx, &max_msg_size));
 
 	/* Check whether we need to request a /large endpoint communication */
-	if (!submit_buf || max_msg_size >= submit_buf->len) {
+	if (!submit_buf || max_msg_size >= acvp_ext_buf_len(submit_buf)) {
 #endif
 		/*
 		 * Construct the URL to submit the results for the given
@@ -471,12 +475,12 @@ out:
 	return ret;
 }
 
-static int acvp_request_sample_vsid(const struct acvp_vsid_ctx *vsid_ctx,
-				    const struct acvp_ext_buf *buf)
+static int acvp_request_sample_vsid_json(const struct acvp_vsid_ctx *vsid_ctx,
+					 const struct acvp_ext_buf *buf)
 {
 	struct json_object *full = NULL, *response;
-	const char *new_str;
 	ACVP_BUFFER_INIT(tmp_buf);
+	ACVP_BUFFER_INIT(json_buf);
 	ACVP_EXT_BUFFER_INIT(new_buf);
 	int ret;
 
@@ -487,19 +491,123 @@ static int acvp_request_sample_vsid(const struct acvp_vsid_ctx *vsid_ctx,
 	CKINT(json_object_object_add(response, "showExpected",
 				     json_object_new_boolean(true)));
 
-	new_str = json_object_to_json_string_ext(
-		full, JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE);
-	CKNULL(new_str, -EFAULT);
-	new_buf.buf = (uint8_t *)new_str;
-	new_buf.len = (uint32_t)strlen(new_str);
+	CKINT(json_to_buf(full,
+			  JSON_C_TO_STRING_PRETTY |
+				  JSON_C_TO_STRING_NOSLASHESCAPE,
+			  &json_buf));
+	new_buf.buf = json_buf.buf;
+	new_buf.len = json_buf.len;
 
 	CKINT(acvp_check_large_endpoint(vsid_ctx, &new_buf));
 
 out:
 	ACVP_JSON_PUT_NULL(full);
+	acvp_free_buf(&json_buf);
 	return ret;
 }
 
+static uint32_t acvp_response_skip_ws(const struct acvp_ext_buf *buf,
+				      uint32_t i)
+{
+	while (i < buf->len && isspace(buf->buf[i]))
+		i++;
+	return i;
+}
+
+/*
+ * Find the offset of the first byte after the opening brace of the test
+ * response object in the response data of the form
+ * [ { <version> }, { <test response> } ].
+ */
+static int acvp_response_data_offset(const struct acvp_ext_buf *buf,
+				     uint32_t *offset, bool *empty)
+{
+	const uint8_t *data = buf->buf;
+	uint32_t i, depth = 0;
+	bool string = false, escape = false;
+
+	i = acvp_response_skip_ws(buf, 0);
+	if (i >= buf->len || data[i] != '[')
+		return -EINVAL;
+
+	i = acvp_response_skip_ws(buf, i + 1);
+	if (i >= buf->len || data[i] != '{')
+		return -EINVAL;
+
+	/* Skip the version object */
+	for (; i < buf->len; i++) {
+		if (string) {
+			if (escape)
+				escape = false;
+			else if (data[i] == '\\')
+				escape = true;
+			else if (data[i] == '"')
+				string = false;
+			continue;
+		}
+
+		if (data[i] == '"') {
+			string = true;
+		} else if (data[i] == '{' || data[i] == '[') {
+			depth++;
+		} else if (data[i] == '}' || data[i] == ']') {
+			if (!--depth)
+				break;
+		}
+	}
+
+	i = acvp_response_skip_ws(buf, i + 1);
+	if (i >= buf->len || data[i] != ',')
+		return -EINVAL;
+
+	i = acvp_response_skip_ws(buf, i + 1);
+	if (i >= buf->len || data[i] != '{')
+		return -EINVAL;
+
+	*offset = i + 1;
+	i = acvp_response_skip_ws(buf, i + 1);
+	*empty = (i < buf->len && data[i] == '}');
+
+	return 0;
+}
+
+/*
+ * Request the expected results by adding the showExpected keyword to the
+ * test response. The keyword is spliced into the response data with a chain
+ * of submit buffers which avoids parsing and re-serializing the potentially
+ * large test response. Only if the data has an unexpected form or already
+ * contains the keyword, the JSON data is modified.
+ */
+static int acvp_request_sample_vsid(const struct acvp_vsid_ctx *vsid_ctx,
+				    const struct acvp_ext_buf *buf)
+{
+	static const char show_expected[] = "\"showExpected\": true,";
+	static const char keyword[] = "\"showExpected\"";
+	ACVP_EXT_BUFFER_INIT(head);
+	ACVP_EXT_BUFFER_INIT(expected);
+	ACVP_EXT_BUFFER_INIT(tail);
+	uint32_t offset;
+	bool empty;
+
+	if (acvp_response_data_offset(buf, &offset, &empty) ||
+	    memmem(buf->buf, buf->len, keyword, sizeof(keyword) - 1))
+		return acvp_request_sample_vsid_json(vsid_ctx, buf);
+
+	head.buf = buf->buf;
+	head.len = offset;
+	head.next = &expected;
+
+	/* An empty object must not receive the separating comma */
+	expected.buf = (uint8_t *)show_expected;
+	expected.len = (uint32_t)(sizeof(show_expected) - (empty ? 2 : 1));
+	expected.next = &tail;
+
+	tail.buf = buf->buf + offset;
+	tail.len = buf->len - offset;
+
+	return acvp_check_large_endpoint(vsid_ctx, &head);
+}
+
 static int acvp_response_submit_one(const struct acvp_vsid_ctx *vsid_ctx,
 				    const struct acvp_ext_buf *buf)
 {
@@ -705,11 +813,13 @@ static int acvp_respond_testid(struct acvp_testid_ctx *testid_ctx)
 	acvp_handle_open_requests(testid_ctx);
 
 	sig_enqueue_ctx(testid_ctx);
+	acvp_jwt_renew_enqueue(testid_ctx);
 
 	CKINT(ds->acvp_datastore_find_responses(testid_ctx,
 						acvp_process_one_vsid));
 
 out:
+	acvp_jwt_renew_dequeue(testid_ctx);
 	sig_dequeue_ctx(testid_ctx);
 	acvp_release_auth(testid_ctx);
 
@@ -952,7 +1062,6 @@ int acvp_process_testids(const struct acvp_ctx *ctx,
 				CKINT(cb(ctx, def, testids[i]));
 			} else {
 				struct acvp_thread_reqresp_ctx *tdata;
-				int ret_ancestor;
 
 				tdata = calloc(1, sizeof(*tdata));
 				CKNULL(tdata, -ENOMEM);
@@ -961,8 +1070,7 @@ int acvp_process_testids(const struct acvp_ctx *ctx,
 				tdata->testid = testids[i];
 				tdata->cb = cb;
 				CKINT(thread_start(acvp_process_testids_thread,
-						   tdata, 0, &ret_ancestor));
-				ret |= ret_ancestor;
+						   tdata, 0, NULL));
 			}
 #else
 			CKINT(cb(ctx, new_def, testids[i]));
@@ -1132,6 +1240,7 @@ static int acvp_fetch_verdict_vsid(struct acvp_testid_ctx *testid_ctx)
 	acvp_handle_open_requests(testid_ctx);
 
 	sig_enqueue_ctx(testid_ctx);
+	acvp_jwt_renew_enqueue(testid_ctx);
 
 	/* Get verdicts for all vsIDs */
 	CKINT(ds->acvp_datastore_find_responses(testid_ctx,
@@ -1155,6 +1264,7 @@ static int acvp_fetch_verdict_vsid(struct acvp_testid_ctx *testid_ctx)
 	}
 
 out:
+	acvp_jwt_renew_dequeue(testid_ctx);
 	sig_dequeue_ctx(testid_ctx);
 	acvp_release_auth(testid_ctx);
 	acvp_free_buf(&response);
@@ -63,6 +63,8 @@ extern "C" {
 #define ACVP_JWT_TOKEN_MAX 16384
 /* lifetime of token in seconds - we subtract some grace time */
 #define ACVP_JWT_TOKEN_LIFETIME (1800 - 300)
+/* seconds before the end of the lifetime the token is renewed proactively */
+#define ACVP_JWT_TOKEN_RENEW_AHEAD 120
 
 struct acvp_auth_ctx {
 	char *jwt_token; /* JWT token provided by server */
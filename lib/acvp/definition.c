@@ -19,13 +19,17 @@
  */
 
 #include <sys/types.h>
+#include <ctype.h>
 #include <dirent.h>
+#include <limits.h>
+#include <stdint.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <unistd.h>
 
 #include "acvpproxy.h"
+#include "atomic.h"
 #include "definition.h"
 #include "internal.h"
 #include "json_wrapper.h"
@@ -153,6 +157,530 @@ static void acvp_def_dealloc_unused_lock(struct def_lock *lock)
 	}
 }
 
+/*****************************************************************************
+ * Search index of the registered definitions
+ *****************************************************************************/
+
+/*
+ * The registered definitions are searched for every module selected by the
+ * user as well as for every dependency when wiring the definitions. With a
+ * large number of definitions, comparing all search strings of every
+ * definition becomes the dominating cost. Thus, an index is maintained which
+ * maps the search strings to the definitions carrying them:
+ *
+ * - exact searches use a hash table keyed by the hash of the full string,
+ *
+ * - fuzzy searches use a hash table keyed by the lower-case trigrams of the
+ *   string - a definition can only contain the search string if it contains
+ *   all trigrams of the search string,
+ *
+ * - definitions matching any search string of a field (the string is NULL or
+ *   no dependency of the respective type exists) are held in a separate
+ *   wildcard list per field.
+ *
+ * All lists hold the registry positions of the definitions in ascending
+ * order. The index only narrows down the set of candidates, each candidate is
+ * verified with acvp_match_def_search. Thus, the search result and its order
+ * are identical to a linear scan of the definition list.
+ *
+ * The index is created at the first search after the registry changed. All
+ * index data is protected by def_mutex.
+ */
+enum acvp_def_index_field {
+	acvp_def_index_modulename,
+	acvp_def_index_moduleversion,
+	acvp_def_index_orig_modulename,
+	acvp_def_index_vendorname,
+	acvp_def_index_execenv,
+	acvp_def_index_processor,
+
+	acvp_def_index_fields,
+};
+
+/* Minimum length of a fuzzy search string that can use the trigram index */
+#define ACVP_DEF_INDEX_TRIGRAM 3
+
+/* Initial number of hash table slots - must be a power of 2 */
+#define ACVP_DEF_INDEX_SLOTS 64
+
+struct acvp_def_postings {
+	unsigned int *pos;
+	unsigned int len;
+	unsigned int size;
+};
+
+struct acvp_def_hash_slot {
+	uint64_t key;
+	bool used;
+	struct acvp_def_postings postings;
+};
+
+struct acvp_def_hash {
+	struct acvp_def_hash_slot *slots;
+	unsigned int mask;
+	unsigned int used;
+};
+
+struct acvp_def_index {
+	struct definition **defs;
+	unsigned int nr_defs;
+	struct acvp_def_hash exact[acvp_def_index_fields];
+	struct acvp_def_hash trigram[acvp_def_index_fields];
+	struct acvp_def_postings wildcard[acvp_def_index_fields];
+	bool valid;
+};
+
+/*
+ * Candidates of a search: the union of up to two sorted lists or, if the
+ * search criteria do not narrow down the search, all definitions.
+ */
+struct acvp_def_candidates {
+	const struct acvp_def_postings *list[2];
+	unsigned int idx[2];
+	unsigned int next;
+	bool filtered;
+};
+
+static struct definition *def_tail = NULL;
+static unsigned int def_registered = 0;
+static struct acvp_def_index def_index;
+
+/* FNV-1a */
+static uint64_t acvp_def_index_hash(const char *str)
+{
+	uint64_t hash = 0xcbf29ce484222325ULL;
+
+	while (*str) {
+		hash ^= (unsigned char)*str++;
+		hash *= 0x100000001b3ULL;
+	}
+
+	return hash;
+}
+
+static uint64_t acvp_def_index_trigram(const char *str)
+{
+	return ((uint64_t)tolower((unsigned char)str[0]) << 16) |
+	       ((uint64_t)tolower((unsigned char)str[1]) << 8) |
+	       (uint64_t)tolower((unsigned char)str[2]);
+}
+
+static unsigned int acvp_def_hash_idx(uint64_t key, unsigned int mask)
+{
+	return (unsigned int)((key * 0x9e3779b97f4a7c15ULL) >> 32) & mask;
+}
+
+static struct acvp_def_hash_slot *
+acvp_def_hash_find(const struct acvp_def_hash *hash, uint64_t key)
+{
+	unsigned int i;
+
+	if (!hash->slots)
+		return NULL;
+
+	for (i = acvp_def_hash_idx(key, hash->mask); hash->slots[i].used;
+	     i = (i + 1) & hash->mask) {
+		if (hash->slots[i].key == key)
+			return &hash->slots[i];
+	}
+
+	return NULL;
+}
+
+static int acvp_def_hash_grow(struct acvp_def_hash *hash)
+{
+	struct acvp_def_hash_slot *slots;
+	unsigned int i, mask;
+
+	mask = hash->slots ? (hash->mask << 1) | 1 : ACVP_DEF_INDEX_SLOTS - 1;
+	slots = calloc((size_t)mask + 1, sizeof(*slots));
+	if (!slots)
+		return -ENOMEM;
+
+	for (i = 0; hash->slots && i <= hash->mask; i++) {
+		unsigned int j;
+
+		if (!hash->slots[i].used)
+			continue;
+
+		for (j = acvp_def_hash_idx(hash->slots[i].key, mask);
+		     slots[j].used; j = (j + 1) & mask)
+			;
+		slots[j] = hash->slots[i];
+	}
+
+	free(hash->slots);
+	hash->slots = slots;
+	hash->mask = mask;
+
+	return 0;
+}
+
+static void acvp_def_hash_free(struct acvp_def_hash *hash)
+{
+	unsigned int i;
+
+	for (i = 0; hash->slots && i <= hash->mask; i++)
+		free(hash->slots[i].postings.pos);
+	free(hash->slots);
+	memset(hash, 0, sizeof(*hash));
+}
+
+static int acvp_def_postings_add(struct acvp_def_postings *postings,
+				 unsigned int pos)
+{
+	/* Positions are added in ascending order, skip duplicates */
+	if (postings->len && postings->pos[postings->len - 1] == pos)
+		return 0;
+
+	if (postings->len == postings->size) {
+		unsigned int size = postings->size ? postings->size << 1 : 4;
+		unsigned int *tmp;
+
+		tmp = realloc(postings->pos, size * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		postings->pos = tmp;
+		postings->size = size;
+	}
+
+	postings->pos[postings->len++] = pos;
+
+	return 0;
+}
+
+static int acvp_def_hash_add(struct acvp_def_hash *hash, uint64_t key,
+			     unsigned int pos)
+{
+	struct acvp_def_hash_slot *slot = acvp_def_hash_find(hash, key);
+	int ret;
+
+	if (!slot) {
+		unsigned int i;
+
+		/* Keep the load factor at or below 1/2 */
+		if ((hash->used + 1) * 2 > hash->mask + 1)
+			CKINT(acvp_def_hash_grow(hash));
+
+		for (i = acvp_def_hash_idx(key, hash->mask);
+		     hash->slots[i].used; i = (i + 1) & hash->mask)
+			;
+
+		slot = &hash->slots[i];
+		slot->key = key;
+		slot->used = true;
+		hash->used++;
+	}
+
+	CKINT(acvp_def_postings_add(&slot->postings, pos));
+
+out:
+	return ret;
+}
+
+static int acvp_def_index_add_str(enum acvp_def_index_field field,
+				  const char *str, unsigned int pos)
+{
+	size_t i, len;
+	int ret;
+
+	/* A NULL string matches any search string */
+	if (!str)
+		return acvp_def_postings_add(&def_index.wildcard[field], pos);
+
+	CKINT(acvp_def_hash_add(&def_index.exact[field],
+				acvp_def_index_hash(str), pos));
+
+	/* The original module name is only searched for exactly */
+	if (field == acvp_def_index_orig_modulename)
+		goto out;
+
+	len = strlen(str);
+	for (i = 0; i + ACVP_DEF_INDEX_TRIGRAM <= len; i++) {
+		CKINT(acvp_def_hash_add(&def_index.trigram[field],
+					acvp_def_index_trigram(str + i), pos));
+	}
+
+out:
+	return ret;
+}
+
+static void acvp_def_index_free(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < acvp_def_index_fields; i++) {
+		acvp_def_hash_free(&def_index.exact[i]);
+		acvp_def_hash_free(&def_index.trigram[i]);
+		free(def_index.wildcard[i].pos);
+	}
+	free(def_index.defs);
+	memset(&def_index, 0, sizeof(def_index));
+}
+
+/* Caller must hold def_mutex as writer */
+static int acvp_def_index_build(void)
+{
+	struct definition *def;
+	unsigned int pos = 0;
+	int ret = 0;
+
+	if (def_index.valid)
+		return 0;
+
+	acvp_def_index_free();
+
+	if (def_registered) {
+		def_index.defs = calloc(def_registered,
+					sizeof(*def_index.defs));
+		CKNULL(def_index.defs, -ENOMEM);
+	}
+
+	for (def = def_head; def != NULL; def = def->next, pos++) {
+		const struct def_info *info = def->info;
+		const struct def_dependency *def_dep;
+		bool execenv_found = false, processor_found = false;
+
+		CKNULL(info, -EFAULT);
+		CKNULL(def->vendor, -EFAULT);
+		CKNULL(def->oe, -EFAULT);
+		if (pos >= def_registered || def->registry_pos != pos + 1) {
+			logger(LOGGER_ERR, LOGGER_C_ANY,
+			       "Programming bug: definition registry inconsistent\n");
+			ret = -EFAULT;
+			goto out;
+		}
+
+		def_index.defs[pos] = def;
+
+		CKINT(acvp_def_index_add_str(acvp_def_index_modulename,
+					     info->module_name, pos));
+		CKINT(acvp_def_index_add_str(acvp_def_index_moduleversion,
+					     info->module_version, pos));
+		CKINT(acvp_def_index_add_str(acvp_def_index_orig_modulename,
+					     info->orig_module_name, pos));
+		CKINT(acvp_def_index_add_str(acvp_def_index_vendorname,
+					     def->vendor->vendor_name, pos));
+
+		for (def_dep = def->oe->def_dep; def_dep != NULL;
+		     def_dep = def_dep->next) {
+			switch (def_dep->def_dependency_type) {
+			case def_dependency_firmware:
+			case def_dependency_os:
+			case def_dependency_software:
+				CKINT(acvp_def_index_add_str(
+					acvp_def_index_execenv, def_dep->name,
+					pos));
+				execenv_found = true;
+				break;
+			case def_dependency_hardware:
+				CKINT(acvp_def_index_add_str(
+					acvp_def_index_processor,
+					def_dep->proc_name, pos));
+				processor_found = true;
+				break;
+			default:
+				/* Rejected by acvp_match_def_search */
+				break;
+			}
+		}
+
+		/* Definitions without a dependency type match trivially */
+		if (!execenv_found) {
+			CKINT(acvp_def_postings_add(
+				&def_index.wildcard[acvp_def_index_execenv],
+				pos));
+		}
+		if (!processor_found) {
+			CKINT(acvp_def_postings_add(
+				&def_index.wildcard[acvp_def_index_processor],
+				pos));
+		}
+	}
+
+	def_index.nr_defs = pos;
+	def_index.valid = true;
+
+out:
+	if (ret)
+		acvp_def_index_free();
+	return ret;
+}
+
+/*
+ * Take def_mutex as reader and make sure that the index is created. If the
+ * index cannot be created, the searches fall back to a linear scan.
+ */
+static void acvp_def_index_reader_lock(void)
+{
+	mutex_reader_lock(&def_mutex);
+	if (def_index.valid)
+		return;
+	mutex_reader_unlock(&def_mutex);
+
+	mutex_lock(&def_mutex);
+	if (acvp_def_index_build()) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "Creation of definition search index failed, using linear search\n");
+	}
+	mutex_unlock(&def_mutex);
+
+	mutex_reader_lock(&def_mutex);
+}
+
+void acvp_def_index_invalidate(void)
+{
+	mutex_lock(&def_mutex);
+	def_index.valid = false;
+	mutex_unlock(&def_mutex);
+}
+
+/*
+ * Get the candidates for one search field - returns false if the field does
+ * not narrow down the search.
+ */
+static bool acvp_def_index_candidates(enum acvp_def_index_field field,
+				      const char *searchstr, bool fuzzy,
+				      struct acvp_def_candidates *cand)
+{
+	const struct acvp_def_hash_slot *slot;
+	size_t i, len;
+
+	if (!searchstr)
+		return false;
+
+	memset(cand, 0, sizeof(*cand));
+	cand->list[1] = &def_index.wildcard[field];
+	cand->filtered = true;
+
+	if (!fuzzy) {
+		slot = acvp_def_hash_find(&def_index.exact[field],
+					  acvp_def_index_hash(searchstr));
+		cand->list[0] = slot ? &slot->postings : NULL;
+		return true;
+	}
+
+	len = strlen(searchstr);
+	if (len < ACVP_DEF_INDEX_TRIGRAM)
+		return false;
+
+	/* Use the rarest trigram of the search string */
+	for (i = 0; i + ACVP_DEF_INDEX_TRIGRAM <= len; i++) {
+		slot = acvp_def_hash_find(&def_index.trigram[field],
+					  acvp_def_index_trigram(searchstr + i));
+
+		/* No definition contains the search string */
+		if (!slot) {
+			cand->list[0] = NULL;
+			break;
+		}
+
+		if (!cand->list[0] || slot->postings.len < cand->list[0]->len)
+			cand->list[0] = &slot->postings;
+	}
+
+	return true;
+}
+
+static unsigned int
+acvp_def_candidates_len(const struct acvp_def_candidates *cand)
+{
+	unsigned int i, len = 0;
+
+	if (!cand->filtered)
+		return def_index.nr_defs;
+
+	for (i = 0; i < ARRAY_SIZE(cand->list); i++) {
+		if (cand->list[i])
+			len += cand->list[i]->len;
+	}
+
+	return len;
+}
+
+/* Position the candidates at the first entry at or after pos */
+static void acvp_def_candidates_seek(struct acvp_def_candidates *cand,
+				     unsigned int pos)
+{
+	unsigned int i;
+
+	cand->next = pos;
+
+	for (i = 0; i < ARRAY_SIZE(cand->list); i++) {
+		const struct acvp_def_postings *postings = cand->list[i];
+		unsigned int low = 0, high;
+
+		if (!postings)
+			continue;
+
+		high = postings->len;
+		while (low < high) {
+			unsigned int mid = low + ((high - low) >> 1);
+
+			if (postings->pos[mid] < pos)
+				low = mid + 1;
+			else
+				high = mid;
+		}
+		cand->idx[i] = low;
+	}
+}
+
+static bool acvp_def_candidates_next(struct acvp_def_candidates *cand,
+				     unsigned int *pos)
+{
+	unsigned int i, next = UINT_MAX;
+
+	if (!cand->filtered) {
+		if (cand->next >= def_index.nr_defs)
+			return false;
+		*pos = cand->next++;
+		return true;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(cand->list); i++) {
+		const struct acvp_def_postings *postings = cand->list[i];
+
+		if (postings && cand->idx[i] < postings->len &&
+		    postings->pos[cand->idx[i]] < next)
+			next = postings->pos[cand->idx[i]];
+	}
+
+	if (next == UINT_MAX)
+		return false;
+
+	/* A definition may be part of both lists */
+	for (i = 0; i < ARRAY_SIZE(cand->list); i++) {
+		const struct acvp_def_postings *postings = cand->list[i];
+
+		if (postings && cand->idx[i] < postings->len &&
+		    postings->pos[cand->idx[i]] == next)
+			cand->idx[i]++;
+	}
+
+	*pos = next;
+	return true;
+}
+
+/* Caller must hold def_mutex */
+static bool acvp_def_registered(const struct definition *def)
+{
+	const struct definition *tmp_def;
+
+	if (def_index.valid) {
+		return (def->registry_pos &&
+			def->registry_pos <= def_index.nr_defs &&
+			def_index.defs[def->registry_pos - 1] == def);
+	}
+
+	for (tmp_def = def_head; tmp_def != NULL; tmp_def = tmp_def->next) {
+		if (tmp_def == def)
+			return true;
+	}
+
+	return false;
+}
+
 /*****************************************************************************
  * Runtime registering code for cipher definitions
  *****************************************************************************/
@@ -168,30 +696,26 @@ static void acvp_def_dealloc_unused_lock(struct def_lock *lock)
  */
 static void acvp_register_def(struct definition *curr_def)
 {
-	struct definition *tmp_def;
+	mutex_lock(&def_mutex);
+
+	/* do not re-register */
+	if (curr_def->registry_pos) {
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "Programming bug: re-registering definition!\n");
+		goto out;
+	}
 
 	/* Safety-measure to prevent programming bugs to affect us. */
 	curr_def->next = NULL;
 
-	mutex_lock(&def_mutex);
-	if (!def_head) {
+	if (def_tail)
+		def_tail->next = curr_def;
+	else
 		def_head = curr_def;
-		goto out;
-	}
+	def_tail = curr_def;
 
-	for (tmp_def = def_head; tmp_def != NULL; tmp_def = tmp_def->next) {
-		/* do not re-register */
-		if (curr_def == tmp_def) {
-			logger(LOGGER_ERR, LOGGER_C_ANY,
-			       "Programming bug: re-registering definition!\n");
-			goto out;
-		}
-
-		if (!tmp_def->next) {
-			tmp_def->next = curr_def;
-			goto out;
-		}
-	}
+	curr_def->registry_pos = ++def_registered;
+	def_index.valid = false;
 
 out:
 	mutex_unlock(&def_mutex);
@@ -257,51 +781,123 @@ static int acvp_match_def_search(const struct acvp_search_ctx *search,
 	return 0;
 }
 
+static int acvp_def_search_verify(const struct acvp_search_ctx *search,
+				  const struct definition *def)
+{
+	int ret = acvp_match_def_search(search, def);
+
+	if (ret)
+		return ret;
+
+	if (search->with_es_def && !def->es)
+		return -ENOENT;
+
+	return 0;
+}
+
+/*
+ * Find the next definition matching the search criteria starting at the
+ * registry position *pos (0 is the first definition). Upon return, *pos
+ * points to the definition following the returned one.
+ *
+ * Caller must hold def_mutex.
+ */
+static struct definition *
+acvp_def_search_next(const struct acvp_search_ctx *search, unsigned int *pos)
+{
+	const char *searchstr[acvp_def_index_fields] = {
+		search->modulename,	 search->moduleversion,
+		search->orig_modulename, search->vendorname,
+		search->execenv,	 search->processor,
+	};
+	const bool fuzzy[acvp_def_index_fields] = {
+		search->modulename_fuzzy_search,
+		search->moduleversion_fuzzy_search,
+		false,
+		search->vendorname_fuzzy_search,
+		search->execenv_fuzzy_search,
+		search->processor_fuzzy_search,
+	};
+	struct acvp_def_candidates best, cand;
+	struct definition *def;
+	unsigned int i, p;
+	int ret;
+
+	if (!def_index.valid) {
+		p = 0;
+		for (def = def_head; def != NULL; def = def->next, p++) {
+			if (p < *pos)
+				continue;
+
+			ret = acvp_def_search_verify(search, def);
+			if (ret == -ENOENT)
+				continue;
+			else if (ret)
+				return NULL;
+
+			*pos = p + 1;
+			return def;
+		}
+
+		*pos = p;
+		return NULL;
+	}
+
+	/* Select the search field with the smallest set of candidates */
+	memset(&best, 0, sizeof(best));
+	for (i = 0; i < acvp_def_index_fields; i++) {
+		if (!acvp_def_index_candidates((enum acvp_def_index_field)i,
+					       searchstr[i], fuzzy[i], &cand))
+			continue;
+
+		if (acvp_def_candidates_len(&cand) <
+		    acvp_def_candidates_len(&best))
+			best = cand;
+	}
+
+	acvp_def_candidates_seek(&best, *pos);
+
+	while (acvp_def_candidates_next(&best, &p)) {
+		def = def_index.defs[p];
+
+		ret = acvp_def_search_verify(search, def);
+		if (ret == -ENOENT)
+			continue;
+		else if (ret)
+			return NULL;
+
+		*pos = p + 1;
+		return def;
+	}
+
+	*pos = def_index.nr_defs;
+	return NULL;
+}
+
 const struct definition *acvp_find_def(const struct acvp_search_ctx *search,
 				       const struct definition *processed_ptr)
 {
 	const struct definition *tmp_def = NULL;
+	unsigned int pos = 0;
 
-	mutex_reader_lock(&def_mutex);
+	acvp_def_index_reader_lock();
 
 	if (processed_ptr) {
 		/*
 		 * Guarantee that the pointer is valid as we unlock the mutex
 		 * when returning.
 		 */
-		for (tmp_def = def_head; tmp_def != NULL;
-		     tmp_def = tmp_def->next) {
-			if (tmp_def == processed_ptr)
-				break;
-		}
-
-		if (!tmp_def) {
+		if (!acvp_def_registered(processed_ptr)) {
 			logger(LOGGER_WARN, LOGGER_C_ANY,
 			       "Processed pointer is not known to definition list! - Programming Bug at file %s line %d\n",
 			       __FILE__, __LINE__);
 			goto out;
 		}
 
-		tmp_def = processed_ptr->next;
-	} else {
-		tmp_def = def_head;
+		pos = processed_ptr->registry_pos;
 	}
 
-	for (; tmp_def != NULL; tmp_def = tmp_def->next) {
-		int ret = acvp_match_def_search(search, tmp_def);
-
-		if (ret == -ENOENT)
-			continue;
-		else if (ret) {
-			tmp_def = NULL;
-			goto out;
-		}
-
-		if (search->with_es_def && !tmp_def->es)
-			continue;
-
-		break;
-	}
+	tmp_def = acvp_def_search_next(search, &pos);
 
 out:
 	mutex_reader_unlock(&def_mutex);
@@ -1098,6 +1694,11 @@ static int acvp_def_wire_deps(void)
 	if (!def_head)
 		goto out;
 
+	if (acvp_def_index_build()) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "Creation of definition search index failed, using linear search\n");
+	}
+
 	/* Iterate through the linked list of the registered definitions. */
 	for (curr_def = def_head; curr_def != NULL; curr_def = curr_def->next) {
 		const struct def_vendor *vendor;
@@ -1137,6 +1738,7 @@ static int acvp_def_wire_deps(void)
 		/* Iterate through the dependencies */
 		for (deps = curr_def->deps; deps != NULL; deps = deps->next) {
 			struct definition *s_def;
+			unsigned int pos = 0;
 
 			/*
 			 * We have an external certificate reference. The user
@@ -1147,11 +1749,10 @@ static int acvp_def_wire_deps(void)
 				continue;
 
 			/*
-			 * Search through all definitions for a match of the
-			 * impl_name.
+			 * Search through all definitions applicable to our
+			 * environment for a match of the impl_name.
 			 */
-			for (s_def = def_head; s_def != NULL;
-			     s_def = s_def->next) {
+			while ((s_def = acvp_def_search_next(&search, &pos))) {
 				struct def_info *info = s_def->info;
 
 				CKNULL(info, -EFAULT);
@@ -1173,13 +1774,6 @@ static int acvp_def_wire_deps(void)
 				if (s_def == curr_def)
 					continue;
 
-				/*
-				 * Make sure that the dependency applies to our
-				 * environment.
-				 */
-				if (acvp_match_def_search(&search, s_def))
-					continue;
-
 				/* We found a match, wire it up */
 				deps->dependency = s_def;
 				logger(LOGGER_DEBUG, LOGGER_C_ANY,
@@ -1267,6 +1861,9 @@ void acvp_def_release_all(void)
 	}
 
 	def_head = NULL;
+	def_tail = NULL;
+	def_registered = 0;
+	acvp_def_index_free();
 
 out:
 	mutex_unlock(&def_mutex);
@@ -1302,8 +1899,10 @@ static int acvp_def_read_json(struct json_object **config, const char *pathname)
 	mutex_reader_lock(&def_file_access_mutex);
 
 	fd = open(pathname, O_RDONLY);
-	if (fd < 0)
-		return -errno;
+	if (fd < 0) {
+		ret = -errno;
+		goto out;
+	}
 
 	filecontent = json_object_from_fd(fd);
 
@@ -2435,13 +3034,53 @@ out:
 	return ret;
 }
 
-static int acvp_def_load_config(const char *basedir, const char *oe_file,
-				const char *vendor_file, const char *info_file,
-				const char *impl_file)
+/*
+ * Configuration file of a module definition directory - each file is parsed
+ * once and used for all permutations it is part of.
+ */
+struct acvp_def_cfg_file {
+	char *pathname;
+	struct json_object *config;
+	int ret;
+};
+
+enum acvp_def_cfg_type {
+	acvp_def_cfg_oe,
+	acvp_def_cfg_vendor,
+	acvp_def_cfg_info,
+	acvp_def_cfg_impl,
+
+	acvp_def_cfg_num
+};
+
+/* Files of one module definition directory in the order of readdir */
+struct acvp_def_cfg {
+	const char *directory;
+	struct acvp_def_cfg_file *files[acvp_def_cfg_num];
+	unsigned int num[acvp_def_cfg_num];
+};
+
+static int acvp_def_cfg_file_check(const struct acvp_def_cfg_file *file,
+				   const char *type)
+{
+	if (file->ret) {
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "Cannot parse %s config file %s\n", type,
+		       file->pathname);
+	}
+
+	return file->ret;
+}
+
+static int acvp_def_load_config(const char *basedir,
+				const struct acvp_def_cfg_file *oe_cfg,
+				const struct acvp_def_cfg_file *vendor_cfg,
+				const struct acvp_def_cfg_file *info_cfg,
+				const struct acvp_def_cfg_file *impl_cfg)
 {
-	struct json_object *oe_config = NULL, *vendor_config = NULL,
-			   *info_config = NULL, *impl_config = NULL,
-			   *impl_array = NULL;
+	const char *oe_file, *vendor_file, *info_file, *impl_file;
+	struct json_object *oe_config, *vendor_config, *info_config,
+		*impl_config = NULL, *impl_array = NULL;
 	struct def_algo_map *map = NULL;
 	struct definition *def = NULL;
 	struct def_oe oe;
@@ -2456,6 +3095,11 @@ static int acvp_def_load_config(const char *basedir, const char *oe_file,
 	memset(&info, 0, sizeof(info));
 	memset(&vendor, 0, sizeof(vendor));
 
+	oe_file = oe_cfg ? oe_cfg->pathname : NULL;
+	vendor_file = vendor_cfg ? vendor_cfg->pathname : NULL;
+	info_file = info_cfg ? info_cfg->pathname : NULL;
+	impl_file = impl_cfg ? impl_cfg->pathname : NULL;
+
 	CKNULL_LOG(
 		oe_file, -EINVAL,
 		"No operational environment file name given for definition config\n");
@@ -2472,9 +3116,8 @@ static int acvp_def_load_config(const char *basedir, const char *oe_file,
 				"Implementation definition not provided");
 
 	/* Load OE configuration */
-	CKINT_LOG(acvp_def_read_json(&oe_config, oe_file),
-		  "Cannot parse operational environment config file %s\n",
-		  oe_file);
+	CKINT(acvp_def_cfg_file_check(oe_cfg, "operational environment"));
+	oe_config = oe_cfg->config;
 	CKINT_LOG(acvp_def_load_config_oe(oe_config, &oe, &local_proc_family),
 		  "Loading of OE configuration file %s failed\n", oe_file);
 	if (!local_proc_family)
@@ -2483,9 +3126,8 @@ static int acvp_def_load_config(const char *basedir, const char *oe_file,
 	oe.def_oe_file = (char *)oe_file;
 
 	/* Load module configuration */
-	CKINT_LOG(acvp_def_read_json(&info_config, info_file),
-		  "Cannot parse module information config file %s\n",
-		  info_file);
+	CKINT(acvp_def_cfg_file_check(info_cfg, "module information"));
+	info_config = info_cfg->config;
 	CKINT_LOG(acvp_def_load_config_module(info_config, &info,
 					      &local_module_name),
 		  "Loading of module configuration file %s failed\n",
@@ -2494,9 +3136,8 @@ static int acvp_def_load_config(const char *basedir, const char *oe_file,
 	info.def_module_file = (char *)info_file;
 
 	/* Load vendor configuration */
-	CKINT_LOG(acvp_def_read_json(&vendor_config, vendor_file),
-		  "Cannot parse vendor information config file %s\n",
-		  vendor_file);
+	CKINT(acvp_def_cfg_file_check(vendor_cfg, "vendor information"));
+	vendor_config = vendor_cfg->config;
 	CKINT_LOG(acvp_def_load_config_vendor(vendor_config, &vendor),
 		  "Loading of vendor configuration file %s failed\n",
 		  vendor_file);
@@ -2505,9 +3146,9 @@ static int acvp_def_load_config(const char *basedir, const char *oe_file,
 
 	/* Allow an empty impl file, for example when we simply sync-meta */
 	if (impl_file) {
-		CKINT_LOG(acvp_def_read_json(&impl_config, impl_file),
-			  "Cannot parse cipher implementations config file %s\n",
-			  impl_file);
+		CKINT(acvp_def_cfg_file_check(impl_cfg,
+					      "cipher implementations"));
+		impl_config = impl_cfg->config;
 		CKINT(json_find_key(impl_config, "implementations", &impl_array,
 				    json_type_array));
 	}
@@ -2604,10 +3245,7 @@ static int acvp_def_load_config(const char *basedir, const char *oe_file,
 unlock:
 	mutex_unlock(&def_uninstantiated_mutex);
 out:
-	ACVP_JSON_PUT_NULL(oe_config);
-	ACVP_JSON_PUT_NULL(vendor_config);
-	ACVP_JSON_PUT_NULL(info_config);
-	ACVP_JSON_PUT_NULL(impl_config);
+	/* The configurations are owned by the cache of the directory */
 	acvp_def_free_dep(&oe);
 
 	/*
@@ -2629,107 +3267,208 @@ static int acvp_def_usable_dirent(const struct dirent *dirent)
 	return acvp_usable_dirent(dirent, ACVP_DEF_CONFIG_FILE_EXTENSION);
 }
 
-DSO_PUBLIC
-int acvp_def_config(const char *directory)
+static void acvp_def_cfg_free(struct acvp_def_cfg *cfg)
 {
-	struct dirent *oe_dirent, *vendor_dirent, *info_dirent, *impl_dirent;
-	DIR *oe_dir = NULL, *vendor_dir = NULL, *info_dir = NULL,
-	    *impl_dir = NULL;
-	char oe_pathname[FILENAME_MAX - 257],
-		vendor_pathname[FILENAME_MAX - 257],
-		info_pathname[FILENAME_MAX - 257],
-		impl_pathname[FILENAME_MAX - 257];
-	char oe[FILENAME_MAX], vendor[FILENAME_MAX], info[FILENAME_MAX],
-		impl[FILENAME_MAX];
-	int ret = 0;
+	unsigned int i, j;
 
-	CKNULL_LOG(directory, -EINVAL, "Configuration directory missing\n");
+	for (i = 0; i < acvp_def_cfg_num; i++) {
+		for (j = 0; j < cfg->num[i]; j++) {
+			ACVP_JSON_PUT_NULL(cfg->files[i][j].config);
+			free(cfg->files[i][j].pathname);
+		}
+		free(cfg->files[i]);
+		cfg->files[i] = NULL;
+		cfg->num[i] = 0;
+	}
+}
 
-	snprintf(oe_pathname, sizeof(oe_pathname) - 256, "%s/%s", directory,
-		 ACVP_DEF_DIR_OE);
-	oe_dir = opendir(oe_pathname);
-	CKNULL_LOG(oe_dir, -errno, "Failed to open directory %s\n",
-		   oe_pathname);
-
-	snprintf(vendor_pathname, sizeof(vendor_pathname) - 256, "%s/%s",
-		 directory, ACVP_DEF_DIR_VENDOR);
-	vendor_dir = opendir(vendor_pathname);
-	CKNULL_LOG(vendor_dir, -errno, "Failed to open directory %s\n",
-		   vendor_pathname);
-
-	snprintf(info_pathname, sizeof(info_pathname) - 256, "%s/%s", directory,
-		 ACVP_DEF_DIR_MODINFO);
-	info_dir = opendir(info_pathname);
-	CKNULL_LOG(info_dir, -errno, "Failed to open directory %s\n",
-		   info_pathname);
-
-	snprintf(impl_pathname, sizeof(impl_pathname) - 256, "%s/%s", directory,
-		 ACVP_DEF_DIR_IMPLEMENTATIONS);
-	impl_dir = opendir(impl_pathname);
-	/* we allow implementation to be non-existant */
-	if (!impl_dir) {
+/* Record the configuration files of one subdirectory */
+static int acvp_def_cfg_scan_dir(struct acvp_def_cfg *cfg,
+				 enum acvp_def_cfg_type type,
+				 const char *subdir, bool optional)
+{
+	struct acvp_def_cfg_file *files, *file;
+	struct dirent *dirent;
+	DIR *dir = NULL;
+	char pathname[FILENAME_MAX - 257], file_pathname[FILENAME_MAX];
+	unsigned int size = 0;
+	int ret = 0;
+
+	snprintf(pathname, sizeof(pathname) - 256, "%s/%s", cfg->directory,
+		 subdir);
+	dir = opendir(pathname);
+	if (!dir && optional) {
 		logger(LOGGER_WARN, LOGGER_C_ANY,
 		       "No implementation directory found - only meta data synchronization possible!\n");
+		return 0;
 	}
+	CKNULL_LOG(dir, -errno, "Failed to open directory %s\n", pathname);
 
-	/* Process all permutations of configuration files. */
-	while ((vendor_dirent = readdir(vendor_dir)) != NULL) {
-		if (!acvp_def_usable_dirent(vendor_dirent))
+	while ((dirent = readdir(dir)) != NULL) {
+		if (!acvp_def_usable_dirent(dirent))
 			continue;
 
-		snprintf(vendor, sizeof(vendor), "%s/%s", vendor_pathname,
-			 vendor_dirent->d_name);
+		if (cfg->num[type] >= size) {
+			size = size ? size * 2 : 16;
+			files = realloc(cfg->files[type],
+					size * sizeof(*files));
+			CKNULL(files, -ENOMEM);
+			cfg->files[type] = files;
+		}
 
-		while ((info_dirent = readdir(info_dir)) != NULL) {
-			if (!acvp_def_usable_dirent(info_dirent))
-				continue;
+		snprintf(file_pathname, sizeof(file_pathname), "%s/%s",
+			 pathname, dirent->d_name);
+
+		file = &cfg->files[type][cfg->num[type]];
+		memset(file, 0, sizeof(*file));
+		CKINT(acvp_duplicate(&file->pathname, file_pathname));
+		cfg->num[type]++;
+	}
+
+out:
+	if (dir)
+		closedir(dir);
+	return ret;
+}
 
-			snprintf(info, sizeof(info), "%s/%s", info_pathname,
-				 info_dirent->d_name);
+static int acvp_def_cfg_scan(struct acvp_def_cfg *cfg, const char *directory)
+{
+	int ret;
 
-			while ((oe_dirent = readdir(oe_dir)) != NULL) {
-				bool impl_found = false;
+	memset(cfg, 0, sizeof(*cfg));
+	cfg->directory = directory;
 
-				if (!acvp_def_usable_dirent(oe_dirent))
-					continue;
+	CKINT(acvp_def_cfg_scan_dir(cfg, acvp_def_cfg_oe, ACVP_DEF_DIR_OE,
+				    false));
+	CKINT(acvp_def_cfg_scan_dir(cfg, acvp_def_cfg_vendor,
+				    ACVP_DEF_DIR_VENDOR, false));
+	CKINT(acvp_def_cfg_scan_dir(cfg, acvp_def_cfg_info,
+				    ACVP_DEF_DIR_MODINFO, false));
 
-				snprintf(oe, sizeof(oe), "%s/%s", oe_pathname,
-					 oe_dirent->d_name);
+	/* we allow implementation to be non-existant */
+	CKINT(acvp_def_cfg_scan_dir(cfg, acvp_def_cfg_impl,
+				    ACVP_DEF_DIR_IMPLEMENTATIONS, true));
 
-				if (!impl_dir) {
-					CKINT(acvp_def_load_config(directory,
-								   oe, vendor,
-								   info, NULL));
-					continue;
-				}
+out:
+	return ret;
+}
 
-				while ((impl_dirent = readdir(impl_dir)) !=
-				       NULL) {
-					if (!acvp_def_usable_dirent(
-						    impl_dirent))
-						continue;
+/* Parsing of the configuration files of all scanned directories */
+struct acvp_def_cfg_parse {
+	struct acvp_def_cfg_file **files;
+	unsigned int num;
+	atomic_t next;
+};
 
-					impl_found = true;
+/* Maximum number of threads parsing configuration files */
+#define ACVP_DEF_CFG_PARSE_THREADS 8
 
-					snprintf(impl, sizeof(impl), "%s/%s",
-						 impl_pathname,
-						 impl_dirent->d_name);
-					CKINT(acvp_def_load_config(directory,
-								   oe, vendor,
-								   info, impl));
-				}
+static void *acvp_def_cfg_parse_worker(void *arg)
+{
+	struct acvp_def_cfg_parse *parse = arg;
+	unsigned int i;
+
+	while ((i = (unsigned int)atomic_inc(&parse->next) - 1) < parse->num) {
+		struct acvp_def_cfg_file *file = parse->files[i];
+
+		file->ret = acvp_def_read_json(&file->config, file->pathname);
+	}
+
+	return NULL;
+}
+
+static int acvp_def_cfg_parse(struct acvp_def_cfg *cfgs, unsigned int ncfgs)
+{
+	struct acvp_def_cfg_parse parse = { .next = ATOMIC_INIT(0) };
+	unsigned int i, j, k, num = 0;
+	int ret = 0;
+
+	for (i = 0; i < ncfgs; i++) {
+		for (j = 0; j < acvp_def_cfg_num; j++)
+			num += cfgs[i].num[j];
+	}
+	if (!num)
+		return 0;
+
+	parse.files = calloc(num, sizeof(*parse.files));
+	CKNULL(parse.files, -ENOMEM);
+
+	for (i = 0; i < ncfgs; i++) {
+		for (j = 0; j < acvp_def_cfg_num; j++) {
+			for (k = 0; k < cfgs[i].num[j]; k++)
+				parse.files[parse.num++] = &cfgs[i].files[j][k];
+		}
+	}
+
+#ifdef ACVP_USE_PTHREAD
+	{
+		/*
+		 * The definitions are loaded before the thread pool is
+		 * initialized. Thus, a few short lived threads parse the files
+		 * together with the caller.
+		 */
+		pthread_t threads[ACVP_DEF_CFG_PARSE_THREADS - 1];
+		bool started[ACVP_DEF_CFG_PARSE_THREADS - 1];
+		unsigned int nthreads = parse.num - 1;
+
+		if (nthreads > ACVP_DEF_CFG_PARSE_THREADS - 1)
+			nthreads = ACVP_DEF_CFG_PARSE_THREADS - 1;
+
+		for (i = 0; i < nthreads; i++) {
+			started[i] = !pthread_create(&threads[i], NULL,
+						     acvp_def_cfg_parse_worker,
+						     &parse);
+		}
+
+		acvp_def_cfg_parse_worker(&parse);
+
+		for (i = 0; i < nthreads; i++) {
+			if (started[i])
+				pthread_join(threads[i], NULL);
+		}
+	}
+#else
+	acvp_def_cfg_parse_worker(&parse);
+#endif
+
+out:
+	free(parse.files);
+	return ret;
+}
+
+/* Instantiate all permutations of the configuration files of a directory */
+static int acvp_def_cfg_load(const struct acvp_def_cfg *cfg)
+{
+	const struct acvp_def_cfg_file *oe, *vendor, *info, *impl;
+	unsigned int i, j, k, l;
+	int ret = 0;
+
+	/* Process all permutations of configuration files. */
+	for (i = 0; i < cfg->num[acvp_def_cfg_vendor]; i++) {
+		vendor = &cfg->files[acvp_def_cfg_vendor][i];
+
+		for (j = 0; j < cfg->num[acvp_def_cfg_info]; j++) {
+			info = &cfg->files[acvp_def_cfg_info][j];
 
-				if (!impl_found) {
-					CKINT(acvp_def_load_config(directory,
-								   oe, vendor,
-								   info, NULL));
+			for (k = 0; k < cfg->num[acvp_def_cfg_oe]; k++) {
+				oe = &cfg->files[acvp_def_cfg_oe][k];
+
+				if (!cfg->num[acvp_def_cfg_impl]) {
+					CKINT(acvp_def_load_config(
+						cfg->directory, oe, vendor,
+						info, NULL));
+					continue;
 				}
 
-				rewinddir(impl_dir);
+				for (l = 0; l < cfg->num[acvp_def_cfg_impl];
+				     l++) {
+					impl = &cfg->files[acvp_def_cfg_impl][l];
+					CKINT(acvp_def_load_config(
+						cfg->directory, oe, vendor,
+						info, impl));
+				}
 			}
-			rewinddir(oe_dir);
 		}
-		rewinddir(info_dir);
 	}
 
 	/*
@@ -2745,24 +3484,37 @@ int acvp_def_config(const char *directory)
 	CKINT(acvp_def_wire_deps());
 
 out:
-	if (oe_dir)
-		closedir(oe_dir);
-	if (vendor_dir)
-		closedir(vendor_dir);
-	if (info_dir)
-		closedir(info_dir);
-	if (impl_dir)
-		closedir(impl_dir);
+	return ret;
+}
+
+DSO_PUBLIC
+int acvp_def_config(const char *directory)
+{
+	struct acvp_def_cfg cfg;
+	int ret;
+
+	CKNULL_LOG(directory, -EINVAL, "Configuration directory missing\n");
+
+	CKINT(acvp_def_cfg_scan(&cfg, directory));
+	CKINT(acvp_def_cfg_parse(&cfg, 1));
+	CKINT(acvp_def_cfg_load(&cfg));
+
+out:
+	if (directory)
+		acvp_def_cfg_free(&cfg);
 	return ret;
 }
 
 DSO_PUBLIC
 int acvp_def_default_config(const char *config_basedir)
 {
+	struct acvp_def_cfg *cfgs = NULL, *tmp;
 	struct dirent *dirent;
 	DIR *dir = NULL;
 	char configdir[255];
 	char pathname[FILENAME_MAX];
+	char **dirnames = NULL;
+	unsigned int i, ncfgs = 0, size = 0;
 	int ret = 0, errsv;
 
 	if (config_basedir) {
@@ -2785,6 +3537,11 @@ int acvp_def_default_config(const char *config_basedir)
 	CKNULL_LOG(dir, -errsv, "Failed to open directory %s\n",
 		   ACVP_DEF_DEFAULT_CONFIG_DIR);
 
+	/*
+	 * The configuration files of all module definition directories are
+	 * parsed concurrently. The definitions are instantiated in the order
+	 * of the directories afterwards to obtain a stable registration order.
+	 */
 	while ((dirent = readdir(dir)) != NULL) {
 		/* Check that entry is neither ".", "..", or a hidden file */
 		if (!strncmp(dirent->d_name, ".", 1))
@@ -2794,13 +3551,42 @@ int acvp_def_default_config(const char *config_basedir)
 		if (dirent->d_type != DT_DIR)
 			continue;
 
+		if (ncfgs >= size) {
+			char **newnames;
+
+			size = size ? size * 2 : 16;
+			tmp = realloc(cfgs, size * sizeof(*cfgs));
+			CKNULL(tmp, -ENOMEM);
+			cfgs = tmp;
+			newnames = realloc(dirnames, size * sizeof(*dirnames));
+			CKNULL(newnames, -ENOMEM);
+			dirnames = newnames;
+		}
+
 		snprintf(pathname, sizeof(pathname), "%s/%s", configdir,
 			 dirent->d_name);
+		dirnames[ncfgs] = NULL;
+		CKINT(acvp_duplicate(&dirnames[ncfgs], pathname));
 
-		CKINT(acvp_def_config(pathname));
+		ret = acvp_def_cfg_scan(&cfgs[ncfgs], dirnames[ncfgs]);
+		/* A partially scanned directory is released as well */
+		ncfgs++;
+		if (ret)
+			goto out;
 	}
 
+	CKINT(acvp_def_cfg_parse(cfgs, ncfgs));
+
+	for (i = 0; i < ncfgs; i++)
+		CKINT(acvp_def_cfg_load(&cfgs[i]));
+
 out:
+	for (i = 0; i < ncfgs; i++) {
+		acvp_def_cfg_free(&cfgs[i]);
+		free(dirnames[i]);
+	}
+	free(cfgs);
+	free(dirnames);
 	if (dir)
 		closedir(dir);
 	return ret;
@@ -357,6 +357,9 @@ struct def_deps {
  * @var es The entropy source definitions
  * @var uninstantiated_def Reference to uninstantiated algorithm definition
  * @var deps Dependencies - if NULL then no dependencies
+ * @var registry_pos Position in the definition registry starting with 1 -
+ *		     0 if not registered. This value is internal to the
+ *		     library and MUST NOT be used.
  * @var next This pointer is internal to the library and MUST NOT be used.
  */
 struct definition {
@@ -368,6 +371,7 @@ struct definition {
 	struct esvp_es_def *es;
 	struct def_algo_map *uninstantiated_def;
 	struct def_deps *deps;
+	unsigned int registry_pos;
 	struct definition *next;
 };
 
@@ -453,6 +457,14 @@ int acvp_def_get_module_id(struct def_info *def_info);
 int acvp_def_put_module_id(struct def_info *def_info);
 
 void acvp_def_release_all(void);
+
+/**
+ * @brief Invalidate the search index of the registered definitions. This
+ *	  function must be called after the module name, version, vendor name
+ *	  or OE dependency names of a registered definition changed.
+ */
+void acvp_def_index_invalidate(void);
+
 void acvp_def_free_info(struct def_info *info);
 void acvp_def_free_vendor(struct def_vendor *vendor);
 void acvp_def_free_oe(struct def_oe *oe);
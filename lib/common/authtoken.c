@@ -27,6 +27,8 @@
 #include "json_wrapper.h"
 #include "definition.h"
 #include "request_helper.h"
+#include "sleep.h"
+#include "threading_support.h"
 #include "totp.h"
 
 int acvp_init_acvp_auth_ctx(struct acvp_auth_ctx **auth)
@@ -396,6 +398,7 @@ static int acvp_login_submit(struct json_object *login, const char *url,
 	netinfo.net = net;
 	netinfo.url = url;
 	netinfo.server_auth = NULL;
+	netinfo.response_fd = -1;
 	ret = na->acvp_http_post(&netinfo, &login_buf, response_buf);
 
 	/* Dump the password in case of an error for debugging */
@@ -794,3 +797,374 @@ out:
 
 	return ret;
 }
+
+/*****************************************************************************
+ * Proactive renewal of JWT auth tokens
+ *****************************************************************************/
+
+/*
+ * The JWT auth tokens of all test sessions with an active communication are
+ * registered with a background job which renews them in one batched
+ * POST /login/refresh shortly before they expire. This way, the worker
+ * threads always find a valid JWT auth token and never have to wait for a
+ * new TOTP window to log in.
+ *
+ * The background job executes in its own special thread group. It is started
+ * with the first registered test session and terminates once no test session
+ * is registered any more.
+ */
+
+/* Maximum time in seconds the renewal job sleeps before rechecking the tokens */
+#define ACVP_JWT_RENEW_POLL 60
+/* Time in seconds to wait if all due auth tokens are in use */
+#define ACVP_JWT_RENEW_BACKOFF 5
+
+struct acvp_jwt_renew_entry {
+	const struct acvp_testid_ctx *testid_ctx;
+	time_t retry; /* renewal failed, earliest time to try again */
+	bool renewing; /* auth token is locked and part of the current renewal */
+	struct acvp_jwt_renew_entry *next;
+};
+
+static struct acvp_jwt_renew_entry *acvp_jwt_renew_list = NULL;
+/* Lock protecting the list and acvp_jwt_renew_active */
+static DEFINE_MUTEX_W_UNLOCKED(acvp_jwt_renew_lock);
+static bool acvp_jwt_renew_active = false;
+/* Wakeup of acvp_jwt_renew_dequeue waiting for a renewal to finish */
+static pthread_cond_t acvp_jwt_renew_done = PTHREAD_COND_INITIALIZER;
+/* Wakeup of the renewal job when the registered test sessions change */
+static atomic_bool_t acvp_jwt_renew_update = ATOMIC_BOOL_INIT(false);
+
+static bool acvp_jwt_renew_eligible(const struct acvp_jwt_renew_entry *entry)
+{
+	const struct acvp_testid_ctx *testid_ctx = entry->testid_ctx;
+
+	return (testid_ctx->testid && acvp_jwt_exist(testid_ctx->server_auth));
+}
+
+/*
+ * Find the point in time the next auth token must be renewed - caller must
+ * hold acvp_jwt_renew_lock. An auth token that is currently locked is in use
+ * or refreshed by its owner and is checked again later.
+ */
+static bool acvp_jwt_renew_next(time_t *due)
+{
+	struct acvp_jwt_renew_entry *entry;
+	bool found = false;
+
+	for (entry = acvp_jwt_renew_list; entry; entry = entry->next) {
+		struct acvp_auth_ctx *auth = entry->testid_ctx->server_auth;
+		time_t entry_due;
+
+		if (!mutex_trylock(&auth->mutex))
+			continue;
+
+		if (acvp_jwt_renew_eligible(entry)) {
+			entry_due = auth->jwt_token_generated +
+				    ACVP_JWT_TOKEN_LIFETIME -
+				    ACVP_JWT_TOKEN_RENEW_AHEAD;
+			if (entry_due < entry->retry)
+				entry_due = entry->retry;
+			if (!found || entry_due < *due)
+				*due = entry_due;
+			found = true;
+		}
+
+		mutex_unlock(&auth->mutex);
+	}
+
+	return found;
+}
+
+/*
+ * Select all auth tokens which passed half of their lifetime and are not
+ * waiting for a retry after a failed renewal to renew as many tokens as
+ * possible with one TOTP value - caller must hold
+ * acvp_jwt_renew_lock. The auth tokens of the selected entries are locked and
+ * the entries are pinned with the renewing flag: acvp_jwt_renew_dequeue waits
+ * for the renewal to finish before it releases the entry.
+ */
+static int acvp_jwt_renew_select(struct json_object *jauth,
+				 struct acvp_jwt_renew_entry **renew,
+				 unsigned int renew_max, unsigned int *counter)
+{
+	struct acvp_jwt_renew_entry *entry;
+	time_t now = time(NULL);
+	int ret = 0;
+
+	for (entry = acvp_jwt_renew_list; entry && *counter < renew_max;
+	     entry = entry->next) {
+		struct acvp_auth_ctx *auth = entry->testid_ctx->server_auth;
+
+		if (!mutex_trylock(&auth->mutex))
+			continue;
+
+		if (!acvp_jwt_renew_eligible(entry) || now < entry->retry ||
+		    now - auth->jwt_token_generated <
+			    ACVP_JWT_TOKEN_LIFETIME / 2) {
+			mutex_unlock(&auth->mutex);
+			continue;
+		}
+
+		entry->renewing = true;
+		renew[(*counter)++] = entry;
+		CKINT(json_object_array_add(
+			jauth, json_object_new_string(auth->jwt_token)));
+	}
+
+out:
+	return ret;
+}
+
+/*
+ * POST /login/refresh for all auth tokens that passed half of their lifetime.
+ * The number of renewed auth tokens is returned with renewed.
+ */
+static int acvp_jwt_renew_due(unsigned int *renewed)
+{
+	struct acvp_jwt_renew_entry *entry, **renew = NULL;
+	struct json_object *login = NULL, *req = NULL, *jauth = NULL,
+			   *entry_login, *resp, *jauth_array, *jtoken;
+	ACVP_BUFFER_INIT(response_buf);
+	unsigned int counter = 0, max_reg_msg_size = UINT_MAX, renew_max = 0,
+		     i;
+	int ret;
+	char url[ACVP_NET_URL_MAXLEN];
+	bool largeendpoint;
+
+	login = json_object_new_array();
+	CKNULL(login, -ENOMEM);
+
+	CKINT(acvp_req_add_version(login));
+
+	entry_login = json_object_new_object();
+	CKNULL(entry_login, -ENOMEM);
+	CKINT(json_object_array_add(login, entry_login));
+
+	jauth = json_object_new_array();
+	CKNULL(jauth, -ENOMEM);
+
+	/*
+	 * The list lock is only held while selecting the auth tokens - the
+	 * network operation is performed without it to not stall the
+	 * registration of other test sessions.
+	 */
+	mutex_w_lock(&acvp_jwt_renew_lock);
+	for (entry = acvp_jwt_renew_list; entry; entry = entry->next)
+		renew_max++;
+	if (renew_max)
+		renew = calloc(renew_max, sizeof(*renew));
+	if (renew)
+		ret = acvp_jwt_renew_select(jauth, renew, renew_max, &counter);
+	else
+		ret = renew_max ? -ENOMEM : 0;
+	mutex_w_unlock(&acvp_jwt_renew_lock);
+	if (ret || !counter)
+		goto out;
+
+	/*
+	 * A TOTP value is only consumed if auth tokens are renewed. Like
+	 * acvp_login, the selected auth tokens stay locked while waiting for
+	 * the TOTP value.
+	 */
+	CKINT(acvp_login_totp(entry_login, false));
+	CKINT(json_object_object_add(entry_login, "accessToken", jauth));
+	jauth = NULL;
+
+	logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+	       "Proactively refresh %u auth tokens\n", counter);
+
+	CKINT(acvp_create_url(NIST_VAL_OP_LOGIN_REFRESH, url, sizeof(url)));
+	CKINT(acvp_login_submit(login, url, &response_buf));
+
+	CKNULL_LOG(response_buf.buf, -EINVAL, "No response data found\n");
+	CKINT(acvp_req_strip_version(&response_buf, &req, &resp));
+
+	/* Get the size constraint information. */
+	ret = json_get_bool(resp, "largeEndpointRequired", &largeendpoint);
+	if (!ret && largeendpoint)
+		CKINT(json_get_uint(resp, "sizeConstraint", &max_reg_msg_size));
+
+	CKINT(json_find_key(resp, "accessToken", &jauth_array,
+			    json_type_array));
+
+	/* The pinned entries and their locked auth tokens are owned by us */
+	for (i = 0; i < counter; i++) {
+		entry = renew[i];
+
+		jtoken = json_object_array_get_idx(jauth_array, i);
+		CKNULL_LOG(jtoken, -EINVAL,
+			   "Missing refreshed auth token in server response\n");
+		if (!json_object_is_type(jtoken, json_type_string)) {
+			logger(LOGGER_ERR, LOGGER_C_ANY,
+			       "JSON data type %s does not match expected type %s\n",
+			       json_type_to_name(json_object_get_type(jtoken)),
+			       json_type_to_name(json_type_string));
+			ret = -EINVAL;
+			goto out;
+		}
+
+		if (max_reg_msg_size != UINT_MAX) {
+			entry->testid_ctx->server_auth->max_reg_msg_size =
+				max_reg_msg_size;
+		}
+
+		CKINT(acvp_set_authtoken(entry->testid_ctx,
+					 json_object_get_string(jtoken)));
+	}
+
+	logger_status(LOGGER_C_ANY,
+		      "Proactive refresh of %u auth tokens completed\n",
+		      counter);
+	*renewed = counter;
+
+out:
+	if (counter) {
+		time_t retry = time(NULL) + ACVP_JWT_RENEW_POLL;
+
+		mutex_w_lock(&acvp_jwt_renew_lock);
+		for (i = 0; i < counter; i++) {
+			entry = renew[i];
+
+			/*
+			 * Try failed auth tokens again with the next cycle,
+			 * in the meantime the regular login applies.
+			 */
+			entry->retry = ret ? retry : 0;
+			entry->renewing = false;
+			mutex_unlock(&entry->testid_ctx->server_auth->mutex);
+		}
+		pthread_cond_broadcast(&acvp_jwt_renew_done);
+		mutex_w_unlock(&acvp_jwt_renew_lock);
+	}
+
+	free(renew);
+	ACVP_JSON_PUT_NULL(jauth);
+	ACVP_JSON_PUT_NULL(login);
+	ACVP_JSON_PUT_NULL(req);
+	acvp_free_buf(&response_buf);
+
+	return ret;
+}
+
+static int acvp_jwt_renew_thread(void *arg)
+{
+	(void)arg;
+
+	thread_set_name(acvp_jwt, 0);
+
+	for (;;) {
+		time_t due = 0, now;
+		unsigned int sleep_time = ACVP_JWT_RENEW_POLL;
+		bool found;
+
+		mutex_w_lock(&acvp_jwt_renew_lock);
+		if (!acvp_jwt_renew_list ||
+		    atomic_bool_read(&acvp_op_interrupted)) {
+			acvp_jwt_renew_active = false;
+			mutex_w_unlock(&acvp_jwt_renew_lock);
+			return 0;
+		}
+		atomic_bool_set_false(&acvp_jwt_renew_update);
+		found = acvp_jwt_renew_next(&due);
+		mutex_w_unlock(&acvp_jwt_renew_lock);
+
+		now = time(NULL);
+		if (found && due <= now) {
+			unsigned int renewed = 0;
+			int ret = acvp_jwt_renew_due(&renewed);
+
+			if (ret) {
+				logger(LOGGER_WARN, LOGGER_C_ANY,
+				       "Proactive refresh of auth tokens failed (%d)\n",
+				       ret);
+			} else if (renewed) {
+				continue;
+			} else {
+				/* The due auth tokens are in use, back off */
+				sleep_time = ACVP_JWT_RENEW_BACKOFF;
+			}
+		} else if (found && due - now < ACVP_JWT_RENEW_POLL) {
+			sleep_time = (unsigned int)(due - now);
+		}
+
+		sleep_interruptible2(sleep_time, &acvp_op_interrupted,
+				     &acvp_jwt_renew_update);
+	}
+}
+
+void acvp_jwt_renew_enqueue(const struct acvp_testid_ctx *testid_ctx)
+{
+	const struct acvp_ctx *ctx;
+	struct acvp_jwt_renew_entry *entry;
+
+	if (!testid_ctx || !testid_ctx->server_auth)
+		return;
+
+	ctx = testid_ctx->ctx;
+	if (!ctx || ctx->req_details.dump_register ||
+	    ctx->options.threading_disabled)
+		return;
+
+	/* The renewal is best effort, acvp_login is the fallback */
+	entry = calloc(1, sizeof(*entry));
+	if (!entry)
+		return;
+	entry->testid_ctx = testid_ctx;
+
+	mutex_w_lock(&acvp_jwt_renew_lock);
+
+	entry->next = acvp_jwt_renew_list;
+	acvp_jwt_renew_list = entry;
+
+	if (!acvp_jwt_renew_active) {
+		if (thread_start(acvp_jwt_renew_thread, NULL,
+				 ACVP_THREAD_JWT_RENEW_GROUP, NULL)) {
+			logger(LOGGER_WARN, LOGGER_C_ANY,
+			       "Cannot start proactive refresh of auth tokens\n");
+		} else {
+			acvp_jwt_renew_active = true;
+		}
+	}
+
+	atomic_bool_set_true(&acvp_jwt_renew_update);
+
+	mutex_w_unlock(&acvp_jwt_renew_lock);
+}
+
+void acvp_jwt_renew_dequeue(const struct acvp_testid_ctx *testid_ctx)
+{
+	struct acvp_jwt_renew_entry *entry, *prev;
+
+	if (!testid_ctx)
+		return;
+
+	mutex_w_lock(&acvp_jwt_renew_lock);
+
+	for (;;) {
+		prev = NULL;
+		for (entry = acvp_jwt_renew_list; entry; entry = entry->next) {
+			if (entry->testid_ctx == testid_ctx)
+				break;
+			prev = entry;
+		}
+
+		/* The renewal job accesses the entry without the list lock */
+		if (!entry || !entry->renewing)
+			break;
+		pthread_cond_wait(&acvp_jwt_renew_done, &acvp_jwt_renew_lock);
+	}
+
+	/* ctx was not enqueued */
+	if (entry) {
+		if (prev)
+			prev->next = entry->next;
+		else
+			acvp_jwt_renew_list = entry->next;
+		free(entry);
+
+		atomic_bool_set_true(&acvp_jwt_renew_update);
+	}
+
+	mutex_w_unlock(&acvp_jwt_renew_lock);
+}
@@ -46,6 +46,7 @@ int acvp_alloc_buf(uint32_t size, struct acvp_buf *buf)
 		return -ENOMEM;
 
 	buf->len = size;
+	buf->size = size;
 
 	return 0;
 }
@@ -58,6 +59,71 @@ void acvp_free_buf(struct acvp_buf *buf)
 		free(buf->buf);
 	buf->buf = NULL;
 	buf->len = 0;
+	buf->size = 0;
+}
+
+/* Minimum allocation to avoid many small reallocations */
+#define ACVP_BUF_MIN_SIZE 4096
+
+int acvp_buf_reserve(struct acvp_buf *buf, uint32_t size)
+{
+	uint8_t *tmp;
+	uint32_t newsize;
+
+	/* The size of buffers not allocated by this code is unknown */
+	if (!buf->buf || buf->size < buf->len)
+		buf->size = buf->buf ? buf->len : 0;
+
+	if (size <= buf->size)
+		return 0;
+
+	newsize = buf->size ? buf->size : ACVP_BUF_MIN_SIZE;
+	while (newsize < size) {
+		/* Prevent an overflow by falling back to the requested size */
+		if (newsize > UINT32_MAX / 2) {
+			newsize = size;
+			break;
+		}
+		newsize <<= 1;
+	}
+
+	tmp = realloc(buf->buf, newsize);
+	if (!tmp)
+		return -ENOMEM;
+
+	buf->buf = tmp;
+	buf->size = newsize;
+
+	return 0;
+}
+
+int acvp_buf_append(struct acvp_buf *buf, const uint8_t *data, uint32_t len)
+{
+	int ret;
+
+	/* Add one for the NULL terminator */
+	if (len >= UINT32_MAX - buf->len)
+		return -EOVERFLOW;
+
+	ret = acvp_buf_reserve(buf, buf->len + len + 1);
+	if (ret)
+		return ret;
+
+	memcpy(buf->buf + buf->len, data, len);
+	buf->len += len;
+	buf->buf[buf->len] = '\0';
+
+	return 0;
+}
+
+uint32_t acvp_ext_buf_len(const struct acvp_ext_buf *buf)
+{
+	uint32_t len = 0;
+
+	for (; buf; buf = buf->next)
+		len += buf->len;
+
+	return len;
 }
 
 void acvp_free_ext_buf(struct acvp_ext_buf *buf)
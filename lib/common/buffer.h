@@ -29,24 +29,66 @@ extern "C" {
 struct acvp_buf {
 	uint32_t len;
 	uint8_t *buf;
+	uint32_t size; /* Allocated size of buf, 0 if unknown */
 };
 
+/*
+ * Submit buffer which may be chained with other submit buffers. For
+ * multipart form-data submissions, the data of one part may be read from the
+ * file descriptor file_fd instead of buf if file_len is not zero.
+ */
 struct acvp_ext_buf {
 	uint32_t len;
 	uint8_t *buf;
+	uint64_t file_len; /* Length of the data provided by file_fd */
+	int file_fd;
 	char *filename;
 	char *data_type;
 	struct acvp_ext_buf *next;
 };
 
-#define ACVP_BUFFER_INIT(buffer) struct acvp_buf buffer = { 0, NULL }
+#define ACVP_BUFFER_INIT(buffer) struct acvp_buf buffer = { 0, NULL, 0 }
 
 #define ACVP_EXT_BUFFER_INIT(buffer)                                           \
-	struct acvp_ext_buf buffer = { 0, NULL, NULL, NULL, NULL }
+	struct acvp_ext_buf buffer = { 0, NULL, 0, -1, NULL, NULL, NULL }
 
 void acvp_free_buf(struct acvp_buf *buf);
 int acvp_alloc_buf(uint32_t size, struct acvp_buf *buf);
 
+/**
+ * @brief Ensure that the buffer can hold at least size bytes without a
+ *	  reallocation. The buffer grows geometrically to allow appending
+ *	  data in amortized linear time. The buffer data is retained.
+ *
+ * @param buf [in/out] Buffer to grow
+ * @param size [in] Required size of the buffer
+ *
+ * @return 0 on success, < 0 on error
+ */
+int acvp_buf_reserve(struct acvp_buf *buf, uint32_t size);
+
+/**
+ * @brief Append data to the buffer. The buffer data is always
+ *	  NULL-terminated, the terminator is not part of buf->len.
+ *
+ * @param buf [in/out] Buffer to append to
+ * @param data [in] Data to append
+ * @param len [in] Length of the data
+ *
+ * @return 0 on success, < 0 on error
+ */
+int acvp_buf_append(struct acvp_buf *buf, const uint8_t *data, uint32_t len);
+
+/**
+ * @brief Return the length of the data of all chained buffers. A chain of
+ *	  submit buffers is sent as one concatenated HTTP body.
+ *
+ * @param buf [in] First buffer of the chain, may be NULL
+ *
+ * @return length of data
+ */
+uint32_t acvp_ext_buf_len(const struct acvp_ext_buf *buf);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,155 @@
+/* Compression of data kept in the data store
+ *
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <string.h>
+#include <zlib.h>
+
+#include "compression.h"
+#include "logger.h"
+
+/* Window bits of deflate selecting the gzip format */
+#define ACVP_COMPRESSION_GZIP (15 + 16)
+
+/* Size of the chunks of decompressed data handed to the caller */
+#define ACVP_COMPRESSION_CHUNK 65536
+
+int acvp_compress(const struct acvp_buf *data, struct acvp_buf *out)
+{
+	z_stream strm;
+	uLong bound;
+	int ret;
+
+	memset(&strm, 0, sizeof(strm));
+	memset(out, 0, sizeof(*out));
+
+	if (deflateInit2(&strm, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+			 ACVP_COMPRESSION_GZIP, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return -ENOMEM;
+
+	/* The entire compressed data fits into a buffer of the bound size */
+	bound = deflateBound(&strm, data->len);
+	if (bound > UINT32_MAX) {
+		ret = -EOVERFLOW;
+		goto out;
+	}
+
+	ret = acvp_alloc_buf((uint32_t)bound, out);
+	if (ret)
+		goto out;
+
+	strm.next_in = data->buf;
+	strm.avail_in = data->len;
+	strm.next_out = out->buf;
+	strm.avail_out = out->len;
+
+	if (deflate(&strm, Z_FINISH) != Z_STREAM_END) {
+		logger(LOGGER_WARN, LOGGER_C_ANY, "Compression of data failed\n");
+		acvp_free_buf(out);
+		ret = -EFAULT;
+		goto out;
+	}
+
+	out->len = (uint32_t)strm.total_out;
+
+out:
+	deflateEnd(&strm);
+	return ret;
+}
+
+int acvp_decompress_stream(const uint8_t *data, size_t len,
+			   int (*cb)(void *priv, const uint8_t *buf,
+				     size_t buflen),
+			   void *priv)
+{
+	z_stream strm;
+	uint8_t chunk[ACVP_COMPRESSION_CHUNK];
+	int ret = 0, zret = Z_OK;
+
+	if (len > UINT_MAX)
+		return -EOVERFLOW;
+
+	memset(&strm, 0, sizeof(strm));
+	if (inflateInit2(&strm, ACVP_COMPRESSION_GZIP) != Z_OK)
+		return -ENOMEM;
+
+	/* zlib does not modify the input data */
+	strm.next_in = (Bytef *)(uintptr_t)data;
+	strm.avail_in = (uInt)len;
+
+	while (zret != Z_STREAM_END) {
+		strm.next_out = chunk;
+		strm.avail_out = sizeof(chunk);
+
+		/* Truncated data causes Z_BUF_ERROR as no progress is made */
+		zret = inflate(&strm, Z_NO_FLUSH);
+		if (zret != Z_OK && zret != Z_STREAM_END) {
+			ret = (zret == Z_MEM_ERROR) ? -ENOMEM : -EINVAL;
+			goto out;
+		}
+
+		if (strm.avail_out < sizeof(chunk)) {
+			ret = cb(priv, chunk, sizeof(chunk) - strm.avail_out);
+			if (ret < 0)
+				goto out;
+			ret = 0;
+		}
+	}
+
+out:
+	if (ret == -EINVAL)
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "Compressed data is corrupted\n");
+	inflateEnd(&strm);
+	return ret;
+}
+
+struct acvp_decompress_buf {
+	struct acvp_buf *out;
+	uint32_t maxlen;
+};
+
+static int acvp_decompress_append(void *priv, const uint8_t *buf,
+				  size_t buflen)
+{
+	struct acvp_decompress_buf *dbuf = priv;
+	struct acvp_buf *out = dbuf->out;
+
+	if (buflen > dbuf->maxlen - out->len)
+		return -ERANGE;
+
+	return acvp_buf_append(out, buf, (uint32_t)buflen);
+}
+
+int acvp_decompress(const uint8_t *data, size_t len, struct acvp_buf *out,
+		    uint32_t maxlen)
+{
+	struct acvp_decompress_buf dbuf = { .out = out, .maxlen = maxlen };
+	int ret;
+
+	memset(out, 0, sizeof(*out));
+
+	ret = acvp_decompress_stream(data, len, acvp_decompress_append, &dbuf);
+	if (ret)
+		acvp_free_buf(out);
+
+	return ret;
+}
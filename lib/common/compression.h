@@ -0,0 +1,88 @@
+/* Compression of data kept in the data store
+ *
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef _COMPRESSION_H
+#define _COMPRESSION_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * The data is compressed in the gzip format which allows the inspection of
+ * the compressed files with the common tools.
+ */
+#define ACVP_COMPRESSION_EXT ".gz"
+
+/**
+ * @brief Compress data
+ *
+ * @param data [in] Data to compress
+ * @param out [out] Buffer receiving the compressed data - the caller must
+ *		    release it with acvp_free_buf
+ *
+ * @return 0 on success, < 0 on error
+ */
+int acvp_compress(const struct acvp_buf *data, struct acvp_buf *out);
+
+/**
+ * @brief Decompress data and hand the decompressed data to the callback
+ *	  chunk by chunk without holding the entire decompressed data in
+ *	  memory
+ *
+ * @param data [in] Compressed data
+ * @param len [in] Length of the compressed data
+ * @param cb [in] Callback invoked for each chunk of decompressed data. If it
+ *		  returns a negative value, the decompression is aborted with
+ *		  that error.
+ * @param priv [in] Pointer handed to the callback without inspection
+ *
+ * @return 0 on success, < 0 on error (-EINVAL for corrupted data)
+ */
+int acvp_decompress_stream(const uint8_t *data, size_t len,
+			   int (*cb)(void *priv, const uint8_t *buf,
+				     size_t buflen),
+			   void *priv);
+
+/**
+ * @brief Decompress data into a buffer
+ *
+ * @param data [in] Compressed data
+ * @param len [in] Length of the compressed data
+ * @param out [out] Buffer receiving the NULL-terminated decompressed data -
+ *		    the caller must release it with acvp_free_buf
+ * @param maxlen [in] Maximum length of the decompressed data
+ *
+ * @return 0 on success, < 0 on error (-EINVAL for corrupted data, -ERANGE
+ *	   if the decompressed data exceeds maxlen)
+ */
+int acvp_decompress(const uint8_t *data, size_t len, struct acvp_buf *out,
+		    uint32_t maxlen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _COMPRESSION_H */
@@ -18,6 +18,7 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
 #include <ctype.h>
 #include <sys/types.h>
 #include <dirent.h>
@@ -35,6 +36,8 @@
 
 #include "acvp_error_handler.h"
 #include "acvpproxy.h"
+#include "compression.h"
+#include "datastore_io.h"
 #include "internal.h"
 #include "json_wrapper.h"
 #include "logger.h"
@@ -43,16 +46,156 @@
 
 static DEFINE_MUTEX_UNLOCKED(acvp_datastore_create);
 
+/* Storage layer holding the data store bases */
+static const struct acvp_datastore_io *io = &acvp_datastore_io_file;
+
 struct acvp_datastore_thread_ctx {
 	struct acvp_vsid_ctx *vsid_ctx;
 	const char *datastore_base;
 	const char *secure_base;
+	unsigned int state;
 	int (*cb)(const struct acvp_vsid_ctx *vsid_ctx,
 		  const struct acvp_buf *buf);
 };
 
-static int acvp_datastore_write_data(const struct acvp_buf *data,
-				     const char *filename)
+/************************************************************************
+ * Storage layer accessing directories and regular files
+ ************************************************************************/
+
+static int acvp_datastore_io_file_base(char *basedir, bool createdir,
+				       bool secure)
+{
+	(void)secure;
+
+	return acvp_datastore_file_dir(basedir, createdir);
+}
+
+static int acvp_datastore_io_file_stat(const char *pathname,
+				       struct acvp_datastore_stat *st)
+{
+	struct stat statbuf;
+
+	if (stat(pathname, &statbuf))
+		return -errno;
+
+	st->size = (uint64_t)statbuf.st_size;
+#ifdef __APPLE__
+	st->mtime = statbuf.st_mtimespec.tv_sec;
+#else
+	st->mtime = statbuf.st_mtim.tv_sec;
+#endif
+	st->dir = S_ISDIR(statbuf.st_mode);
+	st->regular = S_ISREG(statbuf.st_mode);
+
+	return 0;
+}
+
+static int acvp_datastore_io_file_read(const char *pathname, uint8_t **buf,
+				       size_t *buflen)
+{
+	FILE *file;
+	struct stat statbuf;
+	uint8_t *l_buf = NULL, *ptr;
+	size_t read, l_buflen, len;
+	int ret = 0;
+
+	file = fopen(pathname, "r");
+	CKNULL_C_LOG(file, -errno, LOGGER_C_DS_FILE, "Cannot open file\n");
+
+	if (fstat(fileno(file), &statbuf)) {
+		ret = -errno;
+		goto out;
+	}
+
+	l_buflen = (size_t)statbuf.st_size;
+	l_buf = calloc(1, l_buflen + 1);
+	CKNULL(l_buf, -ENOMEM);
+
+	ptr = l_buf;
+	len = l_buflen;
+	while (len) {
+		read = fread(ptr, 1, len, file);
+		if (!read) {
+			if (ferror(file) && errno == EINTR) {
+				clearerr(file);
+				continue;
+			}
+			break;
+		}
+		len -= read;
+		ptr += read;
+	}
+
+	*buf = l_buf;
+	*buflen = l_buflen - len;
+
+out:
+	if (file)
+		fclose(file);
+	if (ret && l_buf)
+		free(l_buf);
+	return ret;
+}
+
+static int acvp_datastore_io_file_map(const char *pathname,
+				      struct acvp_datastore_map *map)
+{
+	struct stat statbuf;
+	int ret = 0, fd;
+
+	memset(map, 0, sizeof(*map));
+
+	fd = open(pathname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = -errno;
+
+		if (ret != -ENOENT)
+			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+			       "Cannot open file %s (%d)\n", pathname, ret);
+		return ret;
+	}
+
+	if (fstat(fd, &statbuf)) {
+		ret = -errno;
+		goto out;
+	}
+
+	if (!statbuf.st_size)
+		goto out;
+
+	if ((uint64_t)statbuf.st_size > UINT32_MAX) {
+		ret = -EFBIG;
+		goto out;
+	}
+
+	map->addr = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED,
+			 fd, 0);
+	if (map->addr == MAP_FAILED) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE, "Cannot mmap file %s\n",
+		       pathname);
+		map->addr = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	map->len = (size_t)statbuf.st_size;
+	map->buf.buf = map->addr;
+	map->buf.len = (uint32_t)statbuf.st_size;
+
+out:
+	close(fd);
+	return ret;
+}
+
+static void acvp_datastore_io_file_unmap(struct acvp_datastore_map *map)
+{
+	if (map->addr)
+		munmap(map->addr, map->len);
+	memset(map, 0, sizeof(*map));
+}
+
+static int acvp_datastore_io_file_write(const char *pathname,
+					const struct acvp_buf *data)
 {
 	FILE *file;
 	size_t written;
@@ -61,7 +204,7 @@ static int acvp_datastore_write_data(const struct acvp_buf *data,
 	if (!data || !data->buf)
 		return 0;
 
-	file = fopen(filename, "w");
+	file = fopen(pathname, "w");
 	CKNULL(file, -errno);
 
 	written = fwrite(data->buf, 1, data->len, file);
@@ -75,336 +218,1862 @@ out:
 	return ret;
 }
 
-static int acvp_datastore_read_data(uint8_t **buf, size_t *buflen,
-				    const char *filename)
+static int acvp_datastore_io_file_stream(
+	const char *pathname, bool secure,
+	int (*stream)(const struct acvp_vsid_ctx *vsid_ctx, int fd, void *data),
+	const struct acvp_vsid_ctx *vsid_ctx, void *data)
 {
-	FILE *file;
-	struct stat statbuf;
-	uint8_t *l_buf = NULL, *ptr;
-	size_t read, l_buflen, len;
+	const char *filename = strrchr(pathname, '/');
+	char tmpname[FILENAME_MAX];
+	int ret, fd = -1;
+	bool tmp_created = false;
+
+	/*
+	 * The data is written to a hidden temporary file in the target
+	 * directory which is renamed once complete. The rename is atomic as
+	 * both files reside on the same file system.
+	 */
+	if (filename) {
+		snprintf(tmpname, sizeof(tmpname), "%.*s",
+			 (int)(filename - pathname), pathname);
+		filename++;
+	} else {
+		snprintf(tmpname, sizeof(tmpname), ".");
+		filename = pathname;
+	}
+	CKINT(acvp_extend_string(tmpname, sizeof(tmpname), "/.%s.XXXXXX",
+				 filename));
+
+	fd = mkstemp(tmpname);
+	if (fd < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Cannot create temporary file for %s (%d)\n", pathname,
+		       ret);
+		goto out;
+	}
+	tmp_created = true;
+
+	/* mkstemp only grants access to the owner */
+	if (!secure && fchmod(fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	CKINT(stream(vsid_ctx, fd, data));
+
+	ret = close(fd);
+	fd = -1;
+	if (ret < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	if (rename(tmpname, pathname) < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Cannot rename %s to %s (%d)\n", tmpname, pathname, ret);
+		goto out;
+	}
+	tmp_created = false;
+
+out:
+	if (fd >= 0)
+		close(fd);
+	if (tmp_created)
+		unlink(tmpname);
+	return ret;
+}
+
+void acvp_datastore_list_free(char **names, unsigned int num)
+{
+	unsigned int i;
+
+	if (!names)
+		return;
+
+	for (i = 0; i < num; i++)
+		free(names[i]);
+	free(names);
+}
+
+static int acvp_datastore_io_file_list(const char *dirname, char ***names,
+				       unsigned int *num)
+{
+	struct dirent *dirent;
+	DIR *dir;
+	char **l_names = NULL, **tmp;
+	unsigned int l_num = 0, size = 0;
 	int ret = 0;
 
-	/* Prevent memleak */
-	if (buf && *buf)
-		return -EINVAL;
+	dir = opendir(dirname);
+	CKNULL(dir, -errno);
+
+	while ((dirent = readdir(dir)) != NULL) {
+		if (!strncmp(dirent->d_name, ".", 1))
+			continue;
+
+		if (l_num >= size) {
+			size = size ? size * 2 : 16;
+			tmp = realloc(l_names, size * sizeof(*l_names));
+			CKNULL(tmp, -ENOMEM);
+			l_names = tmp;
+		}
 
-	ret = stat(filename, &statbuf);
+		l_names[l_num] = NULL;
+		CKINT(acvp_duplicate(&l_names[l_num], dirent->d_name));
+		l_num++;
+	}
+
+	*names = l_names;
+	*num = l_num;
+
+out:
 	if (ret)
+		acvp_datastore_list_free(l_names, l_num);
+	if (dir)
+		closedir(dir);
+	return ret;
+}
+
+static int acvp_datastore_io_file_rename(const char *oldpath,
+					 const char *newpath)
+{
+	if (rename(oldpath, newpath))
+		return -errno;
+	return 0;
+}
+
+static int acvp_datastore_io_file_unlink(const char *pathname)
+{
+	if (unlink(pathname))
+		return -errno;
+	return 0;
+}
+
+static int acvp_datastore_io_file_chmod(const char *pathname,
+					unsigned int mode)
+{
+	if (chmod(pathname, (mode_t)mode))
 		return -errno;
+	return 0;
+}
+
+const struct acvp_datastore_io acvp_datastore_io_file = {
+	.base = acvp_datastore_io_file_base,
+	.dir = acvp_datastore_file_dir,
+	.stat = acvp_datastore_io_file_stat,
+	.read = acvp_datastore_io_file_read,
+	.map = acvp_datastore_io_file_map,
+	.unmap = acvp_datastore_io_file_unmap,
+	.write = acvp_datastore_io_file_write,
+	.stream = acvp_datastore_io_file_stream,
+	.batch = NULL,
+	.add_file = NULL,
+	.list = acvp_datastore_io_file_list,
+	.rename = acvp_datastore_io_file_rename,
+	.unlink = acvp_datastore_io_file_unlink,
+	.chmod = acvp_datastore_io_file_chmod,
+};
+
+/************************************************************************
+ * Data store backend
+ ************************************************************************/
+
+/*
+ * The test vectors, the test responses and the expected results are exchanged
+ * with the IUT. They are always kept as regular files in the vsID directories
+ * independent of the storage layer holding all other files.
+ */
+static bool acvp_datastore_iut_file(const struct acvp_datastore_ctx *datastore,
+				    const char *filename)
+{
+	return (!strcmp(filename, datastore->vectorfile) ||
+		!strcmp(filename, datastore->resultsfile) ||
+		!strcmp(filename, datastore->expectedfile));
+}
+
+/* Create the directories of a regular file exchanged with the IUT */
+static int acvp_datastore_iut_dir(const char *pathname)
+{
+	char dir[FILENAME_MAX];
+	char *ptr;
+	int ret = 0;
+
+	snprintf(dir, sizeof(dir), "%s", pathname);
+	for (ptr = strchr(dir + 1, '/'); ptr; ptr = strchr(ptr + 1, '/')) {
+		*ptr = '\0';
+		CKINT(acvp_datastore_file_dir(dir, true));
+		*ptr = '/';
+	}
+
+out:
+	return ret;
+}
+
+/*
+ * The debug copies of the data exchanged with the ACVP server and the copies
+ * kept in the secure location of a vsID are only kept for the record. They
+ * are stored compressed under their name with the ACVP_COMPRESSION_EXT
+ * extension. Files are read from their compressed form if no uncompressed
+ * file exists which allows reading data stores holding uncompressed copies.
+ *
+ * The files exchanged with the IUT are only compressed if requested with
+ * ACVP_DATASTORE_COMPRESS_ENV.
+ */
+static const char *acvp_datastore_compressed_ext[] = { ".debug" };
+static bool acvp_datastore_compress_iut = false;
+
+static bool acvp_datastore_compressed_file(const char *filename)
+{
+	size_t len = strlen(filename), extlen;
+	unsigned int i;
+
+	for (i = 0; i < ARRAY_SIZE(acvp_datastore_compressed_ext); i++) {
+		extlen = strlen(acvp_datastore_compressed_ext[i]);
+		if (len >= extlen &&
+		    !strcmp(filename + len - extlen,
+			    acvp_datastore_compressed_ext[i]))
+			return true;
+	}
+
+	return false;
+}
+
+/* Obtain the name of the compressed form of a file, fails if it is absent */
+static int acvp_datastore_compressed_name(const char *filename, char *gzname,
+					  const size_t gznamelen)
+{
+	struct acvp_datastore_stat st;
+
+	snprintf(gzname, gznamelen, "%s%s", filename, ACVP_COMPRESSION_EXT);
+	return io->stat(gzname, &st);
+}
+
+static int acvp_datastore_write_data(const struct acvp_buf *data,
+				     const char *filename)
+{
+	ACVP_BUFFER_INIT(compressed);
+	char gzname[FILENAME_MAX];
+	int ret;
+
+	if (!acvp_datastore_compressed_file(filename))
+		return io->write(filename, data);
+
+	CKINT(acvp_compress(data, &compressed));
+	snprintf(gzname, sizeof(gzname), "%s%s", filename,
+		 ACVP_COMPRESSION_EXT);
+	CKINT(io->write(gzname, &compressed));
+
+out:
+	acvp_free_buf(&compressed);
+	return ret;
+}
+
+/* Store the vsID file compressed */
+static bool
+acvp_datastore_compressed_vsid(const struct acvp_datastore_ctx *datastore,
+			       const char *filename, const bool secure_location)
+{
+	if (secure_location)
+		return !!strcmp(filename, datastore->processedfile);
+
+	return acvp_datastore_compress_iut &&
+	       acvp_datastore_iut_file(datastore, filename);
+}
+
+/* Check whether the file exchanged with the IUT exists in any form */
+static bool acvp_datastore_iut_present(const char *pathname)
+{
+	struct acvp_datastore_stat st;
+	char gzname[FILENAME_MAX];
+
+	return !io->stat(pathname, &st) ||
+	       !acvp_datastore_compressed_name(pathname, gzname,
+					       sizeof(gzname));
+}
+
+/*
+ * Read the compressed form of a file exchanged with the IUT - it is a regular
+ * file independent of the storage layer.
+ */
+static int acvp_datastore_iut_read_compressed(const char *gzname,
+					      struct acvp_buf *data)
+{
+	struct acvp_datastore_map map;
+	int ret;
+
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE, "Reading compressed file %s\n",
+	       gzname);
+
+	CKINT(acvp_datastore_io_file_map(gzname, &map));
+	ret = acvp_decompress(map.buf.buf, map.buf.len, data, UINT32_MAX - 1);
+	acvp_datastore_io_file_unmap(&map);
+
+out:
+	return ret;
+}
+
+/*
+ * Replace the file exchanged with the IUT with its compressed form, the name
+ * of the compressed file is returned in pathname.
+ */
+static int acvp_datastore_iut_compress(char *pathname, const size_t len)
+{
+	struct acvp_datastore_map map;
+	ACVP_BUFFER_INIT(compressed);
+	char plain[FILENAME_MAX];
+	int ret;
+
+	snprintf(plain, sizeof(plain), "%s", pathname);
+
+	CKINT(acvp_datastore_io_file_map(plain, &map));
+	ret = acvp_compress(&map.buf, &compressed);
+	acvp_datastore_io_file_unmap(&map);
+	if (ret)
+		goto out;
+
+	CKINT(acvp_extend_string(pathname, len, "%s", ACVP_COMPRESSION_EXT));
+	CKINT(acvp_datastore_io_file_write(pathname, &compressed));
+	CKINT(acvp_datastore_io_file_unlink(plain));
+
+out:
+	acvp_free_buf(&compressed);
+	return ret;
+}
+
+static int acvp_datastore_read_compressed(uint8_t **buf, size_t *buflen,
+					  const char *gzname)
+{
+	struct acvp_datastore_map map;
+	ACVP_BUFFER_INIT(data);
+	int ret;
 
-	if (!statbuf.st_size || statbuf.st_size > ACVP_JWT_TOKEN_MAX) {
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE, "Reading compressed file %s\n",
+	       gzname);
+
+	CKINT(io->map(gzname, &map));
+	ret = acvp_decompress(map.buf.buf, map.buf.len, &data,
+			      ACVP_JWT_TOKEN_MAX);
+	io->unmap(&map);
+	if (ret)
+		goto out;
+
+	if (!data.len) {
 		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-		       "File %s is too large for reading (%" PRIu64 "bytes)",
-		       filename, statbuf.st_size);
-		return -ERANGE;
+		       "Compressed file %s is empty\n", gzname);
+		ret = -ERANGE;
+		goto out;
 	}
 
-	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE, "Reading file %s\n", filename);
-	l_buflen = (size_t)statbuf.st_size;
-	l_buf = calloc(1, l_buflen + 1);
-	CKNULL(l_buf, -ENOMEM);
+	*buf = data.buf;
+	*buflen = data.len;
+
+out:
+	return ret;
+}
+
+static int acvp_datastore_read_data(uint8_t **buf, size_t *buflen,
+				    const char *filename)
+{
+	struct acvp_datastore_stat st;
+	char gzname[FILENAME_MAX];
+	int ret;
+
+	/* Prevent memleak */
+	if (buf && *buf)
+		return -EINVAL;
+
+	ret = io->stat(filename, &st);
+	if (ret == -ENOENT &&
+	    !acvp_datastore_compressed_name(filename, gzname, sizeof(gzname)))
+		return acvp_datastore_read_compressed(buf, buflen, gzname);
+	if (ret)
+		return ret;
+
+	if (!st.size || st.size > ACVP_JWT_TOKEN_MAX) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "File %s is too large for reading (%" PRIu64 "bytes)",
+		       filename, st.size);
+		return -ERANGE;
+	}
+
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE, "Reading file %s\n", filename);
+
+	return io->read(filename, buf, buflen);
+}
+
+struct acvp_datastore_read_json_ctx {
+	struct json_tokener *tok;
+	struct json_object *obj;
+};
+
+/* Feed the decompressed data to the JSON parser */
+static int acvp_datastore_read_json_cb(void *priv, const uint8_t *buf,
+				       size_t buflen)
+{
+	struct acvp_datastore_read_json_ctx *ctx = priv;
+
+	/* Data following the JSON object is ignored */
+	if (ctx->obj)
+		return 0;
+
+	if (buflen > INT_MAX)
+		return -EOVERFLOW;
+
+	ctx->obj = json_tokener_parse_ex(ctx->tok, (const char *)buf,
+					 (int)buflen);
+	if (!ctx->obj &&
+	    json_tokener_get_error(ctx->tok) != json_tokener_continue)
+		return -EINVAL;
+
+	return 0;
+}
+
+/* Parse a compressed JSON file while it is decompressed */
+static struct json_object *
+acvp_datastore_read_json_compressed(const char *gzname)
+{
+	struct acvp_datastore_read_json_ctx ctx = { NULL, NULL };
+	struct acvp_datastore_map map;
+
+	if (io->map(gzname, &map))
+		return NULL;
+
+	ctx.tok = json_tokener_new();
+	if (ctx.tok) {
+		if (acvp_decompress_stream(map.buf.buf, map.buf.len,
+					   acvp_datastore_read_json_cb, &ctx))
+			ACVP_JSON_PUT_NULL(ctx.obj);
+		json_tokener_free(ctx.tok);
+	}
+
+	io->unmap(&map);
+
+	return ctx.obj;
+}
+
+/* Parse a JSON file, NULL is returned if it cannot be read or parsed */
+static struct json_object *acvp_datastore_read_json(const char *filename)
+{
+	struct acvp_datastore_map map;
+	struct json_tokener *tok;
+	struct json_object *obj = NULL;
+	char gzname[FILENAME_MAX];
+
+	if (io->map(filename, &map)) {
+		if (acvp_datastore_compressed_name(filename, gzname,
+						   sizeof(gzname)))
+			return NULL;
+		return acvp_datastore_read_json_compressed(gzname);
+	}
+
+	if (map.buf.len) {
+		tok = json_tokener_new();
+		if (tok) {
+			obj = json_tokener_parse_ex(tok, (char *)map.buf.buf,
+						    (int)map.buf.len);
+			if (json_tokener_get_error(tok) != json_tokener_success)
+				ACVP_JSON_PUT_NULL(obj);
+			json_tokener_free(tok);
+		}
+	}
+
+	io->unmap(&map);
+
+	return obj;
+}
+
+static int acvp_datastore_check_version(char *basedir, const bool createdir,
+					const bool secure)
+{
+	struct acvp_datastore_stat st;
+	size_t readbuflen;
+	unsigned long readversion;
+	int ret = 0;
+	char verfile[5100];
+	uint8_t *readbuf = NULL;
+
+	CKINT(io->base(basedir, createdir, secure));
+
+	snprintf(verfile, sizeof(verfile), "%s/%s", basedir,
+		 ACVP_DS_VERSIONFILE);
+
+	mutex_lock(&acvp_datastore_create);
+	ret = io->stat(verfile, &st);
+	if (ret) {
+		ACVP_BUFFER_INIT(writebuf);
+		char version[3];
+
+		if (ret != -ENOENT) {
+			mutex_unlock(&acvp_datastore_create);
+			return ret;
+		}
+
+		snprintf(version, sizeof(version), "%d", ACVP_DS_VERSION);
+		writebuf.buf = (uint8_t *)version;
+		writebuf.len = (uint32_t)strlen(version);
+		ret = acvp_datastore_write_data(&writebuf, verfile);
+
+		mutex_unlock(&acvp_datastore_create);
+
+		/* Handle the possible race condition */
+		if (ret != -EEXIST)
+			return ret;
+
+		return 0;
+	}
+	mutex_unlock(&acvp_datastore_create);
+
+	CKINT(acvp_datastore_read_data(&readbuf, &readbuflen, verfile));
+	CKNULL(readbuf, -ENOMEM);
+
+	readversion = strtoul((char *)readbuf, NULL, 10);
+	if (readversion >= ULONG_MAX) {
+		ret = -ERANGE;
+		goto out;
+	}
+
+	if (readversion != ACVP_DS_VERSION) {
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Datastore at %s is old!\n", basedir);
+		return -ETIME;
+	}
+
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
+	       "Version of datastore %s is appropriate\n", basedir);
+
+out:
+	if (readbuf)
+		free(readbuf);
+	return ret;
+}
+
+/*
+ * Select the storage layer when the data store is accessed the first time:
+ * the log storage layer is used if a data store base already holds a log file
+ * or if the user requested it for new data store bases. The io_uring storage
+ * layer is used if the user requested it and the kernel supports it.
+ */
+static void
+acvp_datastore_select_io(const struct acvp_datastore_ctx *datastore)
+{
+	static atomic_t io_selected = ATOMIC_INIT(0);
+	const char *env;
+
+	if (atomic_read(&io_selected))
+		return;
+
+	mutex_lock(&acvp_datastore_create);
+	if (atomic_read(&io_selected))
+		goto out;
+
+#ifdef HAVE_SECURE_GETENV
+	acvp_datastore_compress_iut =
+		(env = secure_getenv(ACVP_DATASTORE_COMPRESS_ENV)) &&
+		!strcmp(env, "1");
+	env = secure_getenv(ACVP_DATASTORE_ENV);
+#else
+	acvp_datastore_compress_iut =
+		(env = getenv(ACVP_DATASTORE_COMPRESS_ENV)) &&
+		!strcmp(env, "1");
+	env = getenv(ACVP_DATASTORE_ENV);
+#endif
+	if (acvp_datastore_compress_iut)
+		logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+		       "Files exchanged with the IUT are stored compressed\n");
+
+	if ((env && !strcmp(env, "log")) ||
+	    acvp_datastore_log_present(datastore->basedir) ||
+	    acvp_datastore_log_present(datastore->secure_basedir)) {
+		io = &acvp_datastore_io_log;
+		logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+		       "Data store files are held in log files %s\n",
+		       ACVP_DS_LOGFILE);
+	} else if (env && !strcmp(env, "uring")) {
+		if (acvp_datastore_uring_available()) {
+			io = &acvp_datastore_io_uring;
+			logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+			       "Data store files are accessed with io_uring\n");
+		} else {
+			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+			       "io_uring not available, data store files are accessed with regular file operations\n");
+		}
+	}
+
+	atomic_inc(&io_selected);
+
+out:
+	mutex_unlock(&acvp_datastore_create);
+}
+
+static int
+acvp_datastore_file_target_dir(const struct acvp_testid_ctx *testid_ctx,
+			       char *pathname, const size_t pathnamelen,
+			       const bool createdir, const bool secure_location)
+{
+	const struct acvp_ctx *ctx = testid_ctx->ctx;
+	const struct acvp_datastore_ctx *datastore = &ctx->datastore;
+	int ret;
+	static atomic_t ds_ver_checked = ATOMIC_INIT(0);
+	static atomic_t ds_secure_ver_checked = ATOMIC_INIT(0);
+
+	if (!datastore || !datastore->secure_basedir || !datastore->basedir)
+		return 0;
+
+	acvp_datastore_select_io(datastore);
+
+	if (secure_location) {
+		snprintf(pathname, pathnamelen, "%s/",
+			 datastore->secure_basedir);
+
+		if (!atomic_read(&ds_secure_ver_checked)) {
+			CKINT(acvp_datastore_check_version(pathname, createdir,
+							   true));
+			atomic_inc(&ds_secure_ver_checked);
+			chmod(pathname, 0700);
+		}
+	} else {
+		snprintf(pathname, pathnamelen, "%s", datastore->basedir);
+
+		if (!atomic_read(&ds_ver_checked)) {
+			CKINT(acvp_datastore_check_version(pathname, createdir,
+							   false));
+			atomic_inc(&ds_ver_checked);
+		}
+	}
+
+	CKINT(io->base(pathname, createdir, secure_location));
+
+out:
+	return ret;
+}
+
+static int
+acvp_datastore_file_testsessiondir(const struct acvp_testid_ctx *testid_ctx,
+				   char *pathname, const size_t pathnamelen,
+				   const bool createdir,
+				   const bool secure_location)
+{
+	const struct acvp_ctx *ctx = testid_ctx->ctx;
+	const struct acvp_modinfo_ctx *modinfo = &ctx->modinfo;
+	const struct definition *def = testid_ctx->def;
+	const struct def_vendor *vendor = def->vendor;
+	const struct def_info *info = def->info;
+	const char *specificver = modinfo->specificver_filesafe;
+	int ret;
+
+	CKINT(acvp_datastore_file_target_dir(testid_ctx, pathname, pathnamelen,
+					     createdir, secure_location));
+
+	if (vendor->vendor_name_filesafe) {
+		CKINT(acvp_extend_string(pathname, pathnamelen, "/%s",
+					 vendor->vendor_name_filesafe));
+		CKINT(io->dir(pathname, createdir));
+	}
+
+	if (info->module_name_filesafe) {
+		CKINT(acvp_extend_string(pathname, pathnamelen, "/%s",
+					 info->module_name_filesafe));
+		CKINT(io->dir(pathname, createdir));
+	}
+
+	if (info->module_version_filesafe) {
+		CKINT(acvp_extend_string(
+			pathname, pathnamelen, "/%s",
+			specificver ? specificver :
+					    info->module_version_filesafe));
+		CKINT(io->dir(pathname, createdir));
+	}
+
+out:
+	return ret;
+}
+
+static int
+acvp_datastore_file_vectordir(const struct acvp_testid_ctx *testid_ctx,
+			      char *pathname, const size_t pathnamelen,
+			      const bool createdir, const bool secure_location)
+{
+	int ret;
+
+	CKINT(acvp_datastore_file_testsessiondir(
+		testid_ctx, pathname, pathnamelen, createdir, secure_location));
+
+	CKINT(acvp_extend_string(pathname, pathnamelen, "/%u",
+				 testid_ctx->testid));
+	CKINT(io->dir(pathname, createdir));
+
+out:
+	return ret;
+}
+
+/* Move a directory including the files exchanged with the IUT */
+static int acvp_datastore_rename_dir(const char *oldpath, const char *newpath)
+{
+	struct acvp_datastore_stat st;
+	int ret;
+
+	CKINT(io->rename(oldpath, newpath));
+
+	/* The storage layer moves the regular files itself */
+	if (!io->add_file)
+		goto out;
+
+	/* The regular files exchanged with the IUT are moved separately */
+	if (acvp_datastore_io_file_stat(oldpath, &st))
+		goto out;
+
+	CKINT(acvp_datastore_iut_dir(newpath));
+	CKINT(acvp_datastore_io_file_rename(oldpath, newpath));
+
+out:
+	return ret;
+}
+
+static int
+acvp_datastore_file_rename_version(const struct acvp_testid_ctx *testid_ctx,
+				   char *newversion)
+{
+	const struct definition *def = testid_ctx->def;
+	struct def_info *info = def->info;
+	char *currver = info->module_version_filesafe;
+	char pathname[FILENAME_MAX];
+	char newpathname[FILENAME_MAX];
+	int ret;
+
+	if (acvp_op_get_interrupted())
+		return 0;
+
+	if (!info->module_version_filesafe)
+		return -EINVAL;
+
+	/* rename secure location */
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
+					    sizeof(pathname), false, true));
+	info->module_version_filesafe = newversion;
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
+					    sizeof(pathname), true, true));
+	info->module_version_filesafe = currver;
+	CKINT(acvp_datastore_rename_dir(pathname, newpathname));
+
+	/* rename regular location */
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
+					    sizeof(pathname), false, false));
+	info->module_version_filesafe = newversion;
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
+					    sizeof(pathname), true, false));
+	info->module_version_filesafe = currver;
+	CKINT(acvp_datastore_rename_dir(pathname, newpathname));
+
+out:
+	info->module_version_filesafe = currver;
+	return ret;
+}
+
+static int
+acvp_datastore_file_rename_name(const struct acvp_testid_ctx *testid_ctx,
+				char *newname)
+{
+	const struct definition *def = testid_ctx->def;
+	struct def_info *info = def->info;
+	char *currname = info->module_name_filesafe;
+	char pathname[FILENAME_MAX];
+	char newpathname[FILENAME_MAX];
+	int ret;
+
+	if (acvp_op_get_interrupted())
+		return 0;
+
+	if (!info->module_name_filesafe)
+		return -EINVAL;
+
+	/* rename secure location */
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
+					    sizeof(pathname), false, true));
+	info->module_name_filesafe = newname;
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
+					    sizeof(pathname), true, true));
+	info->module_name_filesafe = currname;
+	CKINT(acvp_datastore_rename_dir(pathname, newpathname));
+
+	/* rename regular location */
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
+					    sizeof(pathname), false, false));
+	info->module_name_filesafe = newname;
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
+					    sizeof(pathname), true, false));
+	info->module_name_filesafe = currname;
+	CKINT(acvp_datastore_rename_dir(pathname, newpathname));
+
+out:
+	info->module_name_filesafe = currname;
+	return ret;
+}
+
+static int
+acvp_datastore_file_vectordir_vsid(const struct acvp_vsid_ctx *vsid_ctx,
+				   char *pathname, const size_t pathnamelen,
+				   const bool createdir,
+				   const bool secure_location)
+{
+	int ret;
+
+	CKINT(acvp_datastore_file_vectordir(vsid_ctx->testid_ctx, pathname,
+					    pathnamelen, createdir,
+					    secure_location));
+
+	CKINT(acvp_extend_string(pathname, pathnamelen, "/%u", vsid_ctx->vsid));
+	CKINT(io->dir(pathname, createdir));
+
+out:
+	return ret;
+}
+
+static int
+acvp_datastore_find_verdict(const struct acvp_datastore_ctx *datastore,
+			    struct acvp_test_verdict_status *verdict,
+			    char *verdict_dir, const size_t verdict_dir_len)
+{
+	struct acvp_datastore_stat st;
+	struct acvp_datastore_map map;
+	int ret;
+
+	CKINT(acvp_extend_string(verdict_dir, verdict_dir_len, "/%s",
+				 datastore->verdictfile));
+
+	/* Verdict file exists, return information to  */
+	if (!io->stat(verdict_dir, &st)) {
+		/* Positive return code as this is no error */
+		if (!verdict)
+			return EEXIST;
+
+		CKINT(io->map(verdict_dir, &map));
+		ret = map.buf.len ? acvp_get_verdict_json(&map.buf,
+							   &verdict->verdict) :
+				   -EINVAL;
+		io->unmap(&map);
+
+		if (ret) {
+			logger(LOGGER_WARN, LOGGER_C_ANY,
+			       "File %s does not contain valid verdict\n",
+			       verdict_dir);
+			/*
+			 * We are not stopping here and will not goto out,
+			 * since we will report that the ID is unverified.
+			 */
+		}
+
+		return 0;
+	}
+
+	/*
+	 * If we have a verdict to fill and we reach here, we have no verdict
+	 * file.
+	 */
+	if (verdict)
+		verdict->verdict = acvp_verdict_unknown;
+
+out:
+	return ret;
+}
+
+static int
+acvp_datastore_find_modinfo(const struct acvp_datastore_ctx *datastore,
+			    struct acvp_test_verdict_status *verdict, char *dir,
+			    const size_t dir_len)
+{
+	struct acvp_datastore_stat st;
+	struct acvp_datastore_map map;
+	ACVP_BUFFER_INIT(data);
+	char gzname[FILENAME_MAX];
+	int ret;
+
+	CKINT(acvp_extend_string(dir, dir_len, "/%s", datastore->vectorfile));
+
+	/* Verdict file exists, return information to  */
+	if (!io->stat(dir, &st)) {
+		/* Positive return code as this is no error */
+		if (!verdict)
+			return EEXIST;
+
+		/* The test vectors are a regular file exchanged with the IUT */
+		CKINT(acvp_datastore_io_file_map(dir, &map));
+		ret = map.buf.len ? acvp_get_algoinfo_json(&map.buf, verdict) :
+				   -EINVAL;
+		acvp_datastore_io_file_unmap(&map);
+	} else if (!acvp_datastore_compressed_name(dir, gzname,
+						   sizeof(gzname))) {
+		if (!verdict)
+			return EEXIST;
+
+		ret = acvp_datastore_iut_read_compressed(gzname, &data);
+		if (!ret)
+			ret = data.len ? acvp_get_algoinfo_json(&data, verdict) :
+					 -EINVAL;
+		acvp_free_buf(&data);
+	} else {
+		return 0;
+	}
+
+	if (ret) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "File %s does not contain valid cipher information\n",
+		       dir);
+		/*
+		 * We are not stopping here and will not goto out, since we
+		 * will report that the ID is unverified.
+		 */
+	}
+
+	return 0;
+
+out:
+	return ret;
+}
+
+/************************************************************************
+ * Test session catalog
+ ************************************************************************/
+
+/*
+ * The catalog of a test session records the state of all vsIDs of the test
+ * session. It allows the selection of the vsIDs to be processed without
+ * searching the vsID directories. The writes of the files it tracks are
+ * recorded in a copy of the catalog held in memory which is written once
+ * the test session is released or the catalog is read again. The catalog
+ * is replaced atomically. As long as the copy in memory holds changes, the
+ * catalog is removed from the data store to prevent a terminated process
+ * from leaving an outdated catalog behind.
+ *
+ * The state of the vsIDs is only a hint as the user may remove files: the
+ * decisions about processing a vsID are based on the state obtained from
+ * the files of the vsID which also corrects the catalog.
+ *
+ * In addition, the catalog holds a summary of the test vectors (algorithm
+ * and mode) and of the verdict of each vsID. The summary is obtained when the
+ * file is written or - for data stores created before - when the test
+ * session is processed the next time. Listing operations use the summary
+ * instead of parsing the test vectors and verdicts of all vsIDs.
+ *
+ * The catalog is only used as is as long as the test session directory was
+ * not modified since the catalog was written. Otherwise, the vsID
+ * directories are listed again and only vsIDs not yet cataloged are
+ * examined. A catalog written within the same second as the last
+ * modification of the directory is not trusted as a subsequent
+ * modification may not change the time stamp.
+ */
+#define ACVP_DS_CATALOG_VERSION 1
+
+#define ACVP_DS_CATALOG_VECTOR (1 << 0)
+#define ACVP_DS_CATALOG_EXPECTED (1 << 1)
+#define ACVP_DS_CATALOG_PROCESSED (1 << 2)
+#define ACVP_DS_CATALOG_VERDICT (1 << 3)
+
+/* Files of a vsID whose summary is recorded in the catalog */
+#define ACVP_DS_CATALOG_SUMMARY                                                \
+	(ACVP_DS_CATALOG_VECTOR | ACVP_DS_CATALOG_VERDICT)
+
+static const struct {
+	const char *name;
+	unsigned int state;
+} acvp_datastore_catalog_flags[] = {
+	{ "vector", ACVP_DS_CATALOG_VECTOR },
+	{ "expected", ACVP_DS_CATALOG_EXPECTED },
+	{ "processed", ACVP_DS_CATALOG_PROCESSED },
+	{ "verdict", ACVP_DS_CATALOG_VERDICT },
+};
+
+static const struct {
+	const char *name;
+	enum acvp_test_verdict verdict;
+} acvp_datastore_catalog_verdicts[] = {
+	{ "unknown", acvp_verdict_unknown },
+	{ "failed", acvp_verdict_fail },
+	{ "passed", acvp_verdict_pass },
+	{ "unverified", acvp_verdict_unverified },
+	{ "unreceived", acvp_verdict_unreceived },
+	{ "pending", acvp_verdict_downloadpending },
+};
+
+/*
+ * The summary field holds the ACVP_DS_CATALOG_VECTOR and
+ * ACVP_DS_CATALOG_VERDICT flags of the files whose summary is recorded.
+ */
+struct acvp_datastore_catalog_vsid {
+	uint32_t vsid;
+	unsigned int state;
+	unsigned int summary;
+	enum acvp_test_verdict verdict;
+	char *cipher_name;
+	char *cipher_mode;
+};
+
+struct acvp_datastore_catalog {
+	struct acvp_datastore_catalog_vsid *vsids; /* sorted by vsID */
+	unsigned int num;
+	unsigned int size;
+	time_t dirtime;
+	time_t updated;
+};
+
+/* Catalog of a test session with changes not yet written */
+struct acvp_datastore_catalog_cache {
+	struct acvp_datastore_catalog_cache *next;
+	struct acvp_datastore_catalog catalog;
+	mutex_w_t lock;
+	bool dirty;
+	char path[FILENAME_MAX];
+};
+
+/*
+ * The lock protects the list of cached catalogs and serializes the reading
+ * and writing of the catalogs in the data store.
+ */
+static struct acvp_datastore_catalog_cache *acvp_datastore_catalogs = NULL;
+static DEFINE_MUTEX_UNLOCKED(acvp_datastore_catalog_lock);
+
+static void
+acvp_datastore_catalog_summary_free(struct acvp_datastore_catalog_vsid *entry)
+{
+	ACVP_PTR_FREE_NULL(entry->cipher_name);
+	ACVP_PTR_FREE_NULL(entry->cipher_mode);
+	entry->summary &= ~(unsigned int)ACVP_DS_CATALOG_VECTOR;
+}
+
+static void acvp_datastore_catalog_free(struct acvp_datastore_catalog *catalog)
+{
+	unsigned int i;
+
+	for (i = 0; i < catalog->num; i++)
+		acvp_datastore_catalog_summary_free(&catalog->vsids[i]);
+	free(catalog->vsids);
+	memset(catalog, 0, sizeof(*catalog));
+}
+
+static struct acvp_datastore_catalog_vsid *
+acvp_datastore_catalog_find(const struct acvp_datastore_catalog *catalog,
+			    uint32_t vsid, unsigned int *pos)
+{
+	unsigned int lo = 0, hi = catalog->num, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (catalog->vsids[mid].vsid == vsid) {
+			if (pos)
+				*pos = mid;
+			return &catalog->vsids[mid];
+		}
+
+		if (catalog->vsids[mid].vsid < vsid)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (pos)
+		*pos = lo;
+	return NULL;
+}
+
+static int acvp_datastore_catalog_add(struct acvp_datastore_catalog *catalog,
+				      uint32_t vsid, unsigned int state,
+				      struct acvp_datastore_catalog_vsid **added)
+{
+	struct acvp_datastore_catalog_vsid *entry, *tmp;
+	unsigned int pos, size;
+
+	entry = acvp_datastore_catalog_find(catalog, vsid, &pos);
+	if (entry) {
+		entry->state |= state;
+		if (added)
+			*added = entry;
+		return 0;
+	}
+
+	if (catalog->num >= catalog->size) {
+		size = catalog->size ? catalog->size * 2 : 16;
+		tmp = realloc(catalog->vsids, size * sizeof(*tmp));
+		if (!tmp)
+			return -ENOMEM;
+		catalog->vsids = tmp;
+		catalog->size = size;
+	}
+
+	memmove(&catalog->vsids[pos + 1], &catalog->vsids[pos],
+		(catalog->num - pos) * sizeof(*catalog->vsids));
+	entry = &catalog->vsids[pos];
+	memset(entry, 0, sizeof(*entry));
+	entry->vsid = vsid;
+	entry->state = state;
+	catalog->num++;
+
+	if (added)
+		*added = entry;
+
+	return 0;
+}
+
+/* Convert the name of a vsID directory, false if it is no vsID */
+static bool acvp_datastore_vsid_name(const char *name, uint32_t *vsid)
+{
+	unsigned long val;
+	unsigned int i;
+
+	for (i = 0; name[i]; i++) {
+		if (!isdigit(name[i]))
+			return false;
+	}
+
+	val = strtoul(name, NULL, 10);
+	if (!i || val > UINT32_MAX)
+		return false;
+
+	*vsid = (uint32_t)val;
+	return true;
+}
+
+/* State of the vsID tracked with the file written to the data store */
+static unsigned int
+acvp_datastore_catalog_state(const struct acvp_datastore_ctx *datastore,
+			     const char *filename, const bool secure_location)
+{
+	if (secure_location)
+		return strcmp(filename, datastore->processedfile) ?
+				     0 :
+				     ACVP_DS_CATALOG_PROCESSED;
+
+	if (!strcmp(filename, datastore->vectorfile))
+		return ACVP_DS_CATALOG_VECTOR;
+	if (!strcmp(filename, datastore->expectedfile))
+		return ACVP_DS_CATALOG_EXPECTED;
+	if (!strcmp(filename, datastore->verdictfile))
+		return ACVP_DS_CATALOG_VERDICT;
+
+	return 0;
+}
+
+/* Determine the state of a vsID from the files in its directories */
+static int acvp_datastore_vsid_state(const struct acvp_vsid_ctx *vsid_ctx,
+				     unsigned int *state)
+{
+	const struct acvp_datastore_ctx *datastore =
+		&vsid_ctx->testid_ctx->ctx->datastore;
+	const char *files[] = { datastore->vectorfile, datastore->expectedfile,
+				datastore->verdictfile };
+	const unsigned int states[] = { ACVP_DS_CATALOG_VECTOR,
+					ACVP_DS_CATALOG_EXPECTED,
+					ACVP_DS_CATALOG_VERDICT };
+	struct acvp_datastore_stat st;
+	char pathname[FILENAME_MAX];
+	size_t len;
+	unsigned int i;
+	int ret;
+
+	*state = 0;
+
+	CKINT(acvp_datastore_file_vectordir_vsid(
+		vsid_ctx, pathname, sizeof(pathname), false, false));
+	len = strlen(pathname);
+
+	for (i = 0; i < ARRAY_SIZE(files); i++) {
+		pathname[len] = '\0';
+		CKINT(acvp_extend_string(pathname, sizeof(pathname), "/%s",
+					 files[i]));
+		if (acvp_datastore_iut_present(pathname))
+			*state |= states[i];
+	}
+
+	ret = acvp_datastore_file_vectordir_vsid(
+		vsid_ctx, pathname, sizeof(pathname), false, true);
+	if (ret) {
+		/* The vsID may not have a secure directory */
+		if (ret == -ENOENT)
+			ret = 0;
+		goto out;
+	}
+
+	CKINT(acvp_extend_string(pathname, sizeof(pathname), "/%s",
+				 datastore->processedfile));
+	if (!io->stat(pathname, &st))
+		*state |= ACVP_DS_CATALOG_PROCESSED;
+
+out:
+	return ret;
+}
+
+/* Record the summary of the test vectors and / or the verdict of a vsID */
+static int
+acvp_datastore_catalog_summary(const struct acvp_vsid_ctx *vsid_ctx,
+			       struct acvp_datastore_catalog_vsid *entry,
+			       const unsigned int files)
+{
+	const struct acvp_datastore_ctx *datastore =
+		&vsid_ctx->testid_ctx->ctx->datastore;
+	struct acvp_test_verdict_status verdict;
+	char pathname[FILENAME_MAX];
+	size_t len;
+	int ret;
+
+	if (!files)
+		return 0;
+
+	memset(&verdict, 0, sizeof(verdict));
+
+	CKINT(acvp_datastore_file_vectordir_vsid(
+		vsid_ctx, pathname, sizeof(pathname), false, false));
+	len = strlen(pathname);
+
+	if (files & ACVP_DS_CATALOG_VECTOR) {
+		CKINT(acvp_datastore_find_modinfo(datastore, &verdict, pathname,
+						  sizeof(pathname)));
+		pathname[len] = '\0';
+
+		acvp_datastore_catalog_summary_free(entry);
+		entry->cipher_name = verdict.cipher_name;
+		entry->cipher_mode = verdict.cipher_mode;
+		verdict.cipher_name = NULL;
+		verdict.cipher_mode = NULL;
+		entry->summary |= ACVP_DS_CATALOG_VECTOR;
+	}
+
+	if (files & ACVP_DS_CATALOG_VERDICT) {
+		CKINT(acvp_datastore_find_verdict(datastore, &verdict, pathname,
+						  sizeof(pathname)));
+		entry->verdict = verdict.verdict;
+		entry->summary |= ACVP_DS_CATALOG_VERDICT;
+	}
+
+out:
+	ACVP_PTR_FREE_NULL(verdict.cipher_name);
+	ACVP_PTR_FREE_NULL(verdict.cipher_mode);
+	return ret;
+}
+
+/* Copy the summary of the given files from one catalog entry to another */
+static int
+acvp_datastore_catalog_summary_copy(struct acvp_datastore_catalog_vsid *dst,
+				    const struct acvp_datastore_catalog_vsid *src,
+				    const unsigned int files)
+{
+	int ret = 0;
+
+	if (files & ACVP_DS_CATALOG_VECTOR) {
+		acvp_datastore_catalog_summary_free(dst);
+		if (src->cipher_name)
+			CKINT(acvp_duplicate(&dst->cipher_name,
+					     src->cipher_name));
+		if (src->cipher_mode)
+			CKINT(acvp_duplicate(&dst->cipher_mode,
+					     src->cipher_mode));
+		dst->summary |= ACVP_DS_CATALOG_VECTOR;
+	}
+
+	if (files & ACVP_DS_CATALOG_VERDICT) {
+		dst->verdict = src->verdict;
+		dst->summary |= ACVP_DS_CATALOG_VERDICT;
+	}
+
+out:
+	return ret;
+}
+
+/* The summary is optional, it is obtained again if it is missing */
+static int
+acvp_datastore_catalog_load_summary(struct json_object *entry_obj,
+				    struct acvp_datastore_catalog_vsid *entry)
+{
+	struct json_object *val;
+	const char *str;
+	unsigned int i;
+	int ret = 0;
+
+	if (json_object_object_get_ex(entry_obj, "algorithm", &val)) {
+		if (val) {
+			CKINT(json_get_string(entry_obj, "algorithm", &str));
+			CKINT(acvp_duplicate(&entry->cipher_name, str));
+		}
+		if (!json_get_string(entry_obj, "mode", &str))
+			CKINT(acvp_duplicate(&entry->cipher_mode, str));
+		entry->summary |= ACVP_DS_CATALOG_VECTOR;
+	}
+
+	if (!json_get_string(entry_obj, "disposition", &str)) {
+		for (i = 0; i < ARRAY_SIZE(acvp_datastore_catalog_verdicts);
+		     i++) {
+			if (strcmp(str, acvp_datastore_catalog_verdicts[i].name))
+				continue;
+
+			entry->verdict =
+				acvp_datastore_catalog_verdicts[i].verdict;
+			entry->summary |= ACVP_DS_CATALOG_VERDICT;
+			break;
+		}
+	}
+
+out:
+	return ret;
+}
+
+static int acvp_datastore_catalog_load(const char *pathname,
+				       struct acvp_datastore_catalog *catalog)
+{
+	struct json_object *catalog_obj, *vsids, *entry_obj;
+	struct acvp_datastore_catalog_vsid *entry;
+	uint64_t val;
+	uint32_t version, vsid;
+	size_t i;
+	unsigned int j, state;
+	int ret;
+	bool flag;
+
+	memset(catalog, 0, sizeof(*catalog));
+
+	catalog_obj = acvp_datastore_read_json(pathname);
+	if (!catalog_obj)
+		return -ENOENT;
+
+	CKINT(json_get_uint(catalog_obj, "version", &version));
+	if (version != ACVP_DS_CATALOG_VERSION) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	CKINT(json_get_uint64(catalog_obj, "directoryTime", &val));
+	catalog->dirtime = (time_t)val;
+	CKINT(json_get_uint64(catalog_obj, "updated", &val));
+	catalog->updated = (time_t)val;
+
+	CKINT(json_find_key(catalog_obj, "vsIds", &vsids, json_type_array));
+	for (i = 0; i < json_object_array_length(vsids); i++) {
+		entry_obj = json_object_array_get_idx(vsids, i);
+		CKINT(json_get_uint(entry_obj, "vsId", &vsid));
+
+		state = 0;
+		for (j = 0; j < ARRAY_SIZE(acvp_datastore_catalog_flags); j++) {
+			CKINT(json_get_bool(entry_obj,
+					    acvp_datastore_catalog_flags[j].name,
+					    &flag));
+			if (flag)
+				state |= acvp_datastore_catalog_flags[j].state;
+		}
+
+		CKINT(acvp_datastore_catalog_add(catalog, vsid, state, &entry));
+		CKINT(acvp_datastore_catalog_load_summary(entry_obj, entry));
+	}
+
+out:
+	if (ret)
+		acvp_datastore_catalog_free(catalog);
+	ACVP_JSON_PUT_NULL(catalog_obj);
+	return ret;
+}
+
+static int acvp_datastore_catalog_stream(const struct acvp_vsid_ctx *vsid_ctx,
+					 int fd, void *data)
+{
+	(void)vsid_ctx;
+
+	if (json_object_to_fd(fd, data,
+			      JSON_C_TO_STRING_PLAIN |
+				      JSON_C_TO_STRING_NOSLASHESCAPE))
+		return -EIO;
+
+	return 0;
+}
+
+static int
+acvp_datastore_catalog_store_summary(struct json_object *entry_obj,
+				     const struct acvp_datastore_catalog_vsid *entry)
+{
+	unsigned int i;
+	int ret = 0;
+
+	if (entry->summary & ACVP_DS_CATALOG_VECTOR) {
+		CKINT(json_object_object_add(
+			entry_obj, "algorithm",
+			entry->cipher_name ?
+				json_object_new_string(entry->cipher_name) :
+				NULL));
+		if (entry->cipher_mode) {
+			CKINT(json_object_object_add(
+				entry_obj, "mode",
+				json_object_new_string(entry->cipher_mode)));
+		}
+	}
+
+	if (!(entry->summary & ACVP_DS_CATALOG_VERDICT))
+		return 0;
+
+	for (i = 0; i < ARRAY_SIZE(acvp_datastore_catalog_verdicts); i++) {
+		if (acvp_datastore_catalog_verdicts[i].verdict != entry->verdict)
+			continue;
+
+		CKINT(json_object_object_add(
+			entry_obj, "disposition",
+			json_object_new_string(
+				acvp_datastore_catalog_verdicts[i].name)));
+		break;
+	}
+
+out:
+	return ret;
+}
+
+static int acvp_datastore_catalog_store(const char *pathname,
+					struct acvp_datastore_catalog *catalog)
+{
+	struct json_object *catalog_obj, *vsids, *entry;
+	unsigned int i, j;
+	int ret;
+
+	catalog->updated = time(NULL);
+
+	catalog_obj = json_object_new_object();
+	CKNULL(catalog_obj, -ENOMEM);
+	CKINT(json_object_object_add(
+		catalog_obj, "version",
+		json_object_new_int(ACVP_DS_CATALOG_VERSION)));
+	CKINT(json_object_object_add(
+		catalog_obj, "directoryTime",
+		json_object_new_int64((int64_t)catalog->dirtime)));
+	CKINT(json_object_object_add(
+		catalog_obj, "updated",
+		json_object_new_int64((int64_t)catalog->updated)));
+	vsids = json_object_new_array();
+	CKNULL(vsids, -ENOMEM);
+	CKINT(json_object_object_add(catalog_obj, "vsIds", vsids));
+
+	for (i = 0; i < catalog->num; i++) {
+		entry = json_object_new_object();
+		CKNULL(entry, -ENOMEM);
+		CKINT(json_object_array_add(vsids, entry));
+		CKINT(json_object_object_add(
+			entry, "vsId",
+			json_object_new_int64((int64_t)catalog->vsids[i].vsid)));
+
+		for (j = 0; j < ARRAY_SIZE(acvp_datastore_catalog_flags); j++) {
+			CKINT(json_object_object_add(
+				entry, acvp_datastore_catalog_flags[j].name,
+				json_object_new_boolean(
+					!!(catalog->vsids[i].state &
+					   acvp_datastore_catalog_flags[j]
+						   .state))));
+		}
+
+		CKINT(acvp_datastore_catalog_store_summary(
+			entry, &catalog->vsids[i]));
+	}
+
+	/* The stream replaces the catalog atomically */
+	CKINT(io->stream(pathname, true, acvp_datastore_catalog_stream, NULL,
+			 catalog_obj));
+
+out:
+	ACVP_JSON_PUT_NULL(catalog_obj);
+	return ret;
+}
+
+/*
+ * Bring the catalog in line with the vsID directories of the test session:
+ * vsIDs which are not yet cataloged are examined, vsIDs whose directories
+ * vanished are dropped.
+ */
+static int acvp_datastore_catalog_scan(const struct acvp_testid_ctx *testid_ctx,
+				       const char *dir,
+				       struct acvp_datastore_catalog *catalog)
+{
+	struct acvp_datastore_catalog scanned;
+	struct acvp_datastore_catalog_vsid *entry, *added;
+	struct acvp_vsid_ctx vsid_ctx;
+	char **names = NULL;
+	unsigned int n, num = 0, state;
+	uint32_t vsid;
+	int ret;
+
+	memset(&scanned, 0, sizeof(scanned));
+	memset(&vsid_ctx, 0, sizeof(vsid_ctx));
+	vsid_ctx.testid_ctx = testid_ctx;
+
+	CKINT(io->list(dir, &names, &num));
 
-	file = fopen(filename, "r");
-	CKNULL_C_LOG(file, -EINVAL, LOGGER_C_DS_FILE, "Cannot open file\n");
+	for (n = 0; n < num; n++) {
+		if (!acvp_datastore_vsid_name(names[n], &vsid))
+			continue;
 
-	ptr = l_buf;
-	len = l_buflen;
-	do {
-		read = fread(ptr, 1, len, file);
-		if (read > 0) {
-			len -= read;
-			ptr += read;
+		entry = acvp_datastore_catalog_find(catalog, vsid, NULL);
+		if (entry) {
+			state = entry->state;
+		} else {
+			vsid_ctx.vsid = vsid;
+			CKINT(acvp_datastore_vsid_state(&vsid_ctx, &state));
 		}
-	} while ((ret > 0 || EINTR == errno) && len);
 
-	fclose(file);
+		CKINT(acvp_datastore_catalog_add(&scanned, vsid, state, &added));
 
-	if (buf)
-		*buf = l_buf;
-	if (buflen)
-		*buflen = l_buflen;
+		/* Hand over the summary of the known vsID */
+		if (entry) {
+			added->summary = entry->summary;
+			added->verdict = entry->verdict;
+			added->cipher_name = entry->cipher_name;
+			added->cipher_mode = entry->cipher_mode;
+			entry->cipher_name = NULL;
+			entry->cipher_mode = NULL;
+		}
+	}
 
-	ret = 0;
+	acvp_datastore_catalog_free(catalog);
+	*catalog = scanned;
+	memset(&scanned, 0, sizeof(scanned));
 
 out:
-	if (ret && l_buf)
-		free(l_buf);
+	acvp_datastore_catalog_free(&scanned);
+	acvp_datastore_list_free(names, num);
 	return ret;
 }
 
-static int acvp_datastore_check_version(char *basedir, const bool createdir)
+/* Path name of the catalog of a test session */
+static int acvp_datastore_catalog_path(const struct acvp_testid_ctx *testid_ctx,
+				       char *catalogpath,
+				       const size_t catalogpathlen,
+				       const bool createdir)
 {
-	struct stat statbuf;
-	size_t readbuflen;
-	unsigned long readversion;
-	int ret = 0;
-	char verfile[5100];
-	uint8_t *readbuf = NULL;
-
-	CKINT(acvp_datastore_file_dir(basedir, createdir));
+	int ret;
 
-	snprintf(verfile, sizeof(verfile), "%s/%s", basedir,
-		 ACVP_DS_VERSIONFILE);
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, catalogpath,
+					    catalogpathlen, createdir, true));
+	CKINT(acvp_extend_string(catalogpath, catalogpathlen, "/%s",
+				 ACVP_DS_CATALOG));
 
-	mutex_lock(&acvp_datastore_create);
-	if (stat(verfile, &statbuf)) {
-		ACVP_BUFFER_INIT(writebuf);
-		char version[3];
-		int errsv = errno;
+out:
+	return ret;
+}
 
-		if (errsv != ENOENT) {
-			mutex_unlock(&acvp_datastore_create);
-			return -errsv;
-		}
+/*
+ * Obtain the catalog of a test session, the caller holds the catalog lock.
+ * If the catalog had to be updated from the vsID directories, it is stored
+ * again.
+ */
+static int acvp_datastore_catalog_get(const struct acvp_testid_ctx *testid_ctx,
+				      struct acvp_datastore_catalog *catalog,
+				      char *catalogpath,
+				      const size_t catalogpathlen)
+{
+	struct acvp_datastore_stat st;
+	char dir[FILENAME_MAX];
+	int ret;
 
-		snprintf(version, sizeof(version), "%d", ACVP_DS_VERSION);
-		writebuf.buf = (uint8_t *)version;
-		writebuf.len = (uint32_t)strlen(version);
-		ret = acvp_datastore_write_data(&writebuf, verfile);
+	memset(catalog, 0, sizeof(*catalog));
 
-		mutex_unlock(&acvp_datastore_create);
+	CKINT(acvp_datastore_file_vectordir(testid_ctx, dir, sizeof(dir),
+					    false, false));
+	CKINT(io->stat(dir, &st));
 
-		/* Handle the possible race condition */
-		if (ret != -EEXIST)
-			return ret;
+	CKINT(acvp_datastore_catalog_path(testid_ctx, catalogpath,
+					  catalogpathlen, true));
 
+	if (!acvp_datastore_catalog_load(catalogpath, catalog) &&
+	    catalog->dirtime == st.mtime && catalog->dirtime < catalog->updated)
 		return 0;
-	}
-	mutex_unlock(&acvp_datastore_create);
-
-	CKINT(acvp_datastore_read_data(&readbuf, &readbuflen, verfile));
-	CKNULL(readbuf, -ENOMEM);
-
-	readversion = strtoul((char *)readbuf, NULL, 10);
-	if (readversion >= ULONG_MAX) {
-		ret = -ERANGE;
-		goto out;
-	}
 
-	if (readversion != ACVP_DS_VERSION) {
-		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
-		       "Datastore at %s is old!\n", basedir);
-		return -ETIME;
-	}
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE, "Updating catalog %s\n",
+	       catalogpath);
 
-	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
-	       "Version of datastore %s is appropriate\n", basedir);
+	CKINT(acvp_datastore_catalog_scan(testid_ctx, dir, catalog));
+	catalog->dirtime = st.mtime;
+	CKINT(acvp_datastore_catalog_store(catalogpath, catalog));
 
 out:
-	if (readbuf)
-		free(readbuf);
+	if (ret)
+		acvp_datastore_catalog_free(catalog);
 	return ret;
 }
 
+/*
+ * Obtain the cached catalog of a test session with its lock held, the
+ * catalog is read from the data store when it is not cached yet.
+ */
 static int
-acvp_datastore_file_target_dir(const struct acvp_testid_ctx *testid_ctx,
-			       char *pathname, const size_t pathnamelen,
-			       const bool createdir, const bool secure_location)
+acvp_datastore_catalog_cache_get(const struct acvp_testid_ctx *testid_ctx,
+				 struct acvp_datastore_catalog_cache **result)
 {
-	const struct acvp_ctx *ctx = testid_ctx->ctx;
-	const struct acvp_datastore_ctx *datastore = &ctx->datastore;
+	struct acvp_datastore_catalog_cache *cache;
+	char catalogpath[FILENAME_MAX];
 	int ret;
-	static atomic_t ds_ver_checked = ATOMIC_INIT(0);
-	static atomic_t ds_secure_ver_checked = ATOMIC_INIT(0);
 
-	if (!datastore || !datastore->secure_basedir || !datastore->basedir)
-		return 0;
+	CKINT(acvp_datastore_catalog_path(testid_ctx, catalogpath,
+					  sizeof(catalogpath), true));
 
-	if (secure_location) {
-		snprintf(pathname, pathnamelen, "%s/",
-			 datastore->secure_basedir);
+	mutex_lock(&acvp_datastore_catalog_lock);
 
-		if (!atomic_read(&ds_secure_ver_checked)) {
-			CKINT(acvp_datastore_check_version(pathname,
-							   createdir));
-			atomic_inc(&ds_secure_ver_checked);
-			chmod(pathname, 0700);
+	for (cache = acvp_datastore_catalogs; cache; cache = cache->next) {
+		if (!strcmp(cache->path, catalogpath))
+			break;
+	}
+
+	if (!cache) {
+		cache = calloc(1, sizeof(*cache));
+		if (!cache) {
+			ret = -ENOMEM;
+			goto unlock;
 		}
-	} else {
-		snprintf(pathname, pathnamelen, "%s", datastore->basedir);
 
-		if (!atomic_read(&ds_ver_checked)) {
-			CKINT(acvp_datastore_check_version(pathname,
-							   createdir));
-			atomic_inc(&ds_ver_checked);
+		ret = acvp_datastore_catalog_get(testid_ctx, &cache->catalog,
+						 cache->path,
+						 sizeof(cache->path));
+		if (ret) {
+			free(cache);
+			goto unlock;
 		}
+
+		mutex_w_init(&cache->lock, 0);
+		cache->next = acvp_datastore_catalogs;
+		acvp_datastore_catalogs = cache;
 	}
 
-	CKINT(acvp_datastore_file_dir(pathname, createdir));
+	mutex_w_lock(&cache->lock);
+	*result = cache;
 
+unlock:
+	mutex_unlock(&acvp_datastore_catalog_lock);
 out:
 	return ret;
 }
 
-static int
-acvp_datastore_file_testsessiondir(const struct acvp_testid_ctx *testid_ctx,
-				   char *pathname, const size_t pathnamelen,
-				   const bool createdir,
-				   const bool secure_location)
+/*
+ * Write the cached catalog to the data store and release it, the caller
+ * holds the catalog lock.
+ */
+static int acvp_datastore_catalog_flush(const char *catalogpath)
 {
-	const struct acvp_ctx *ctx = testid_ctx->ctx;
-	const struct acvp_modinfo_ctx *modinfo = &ctx->modinfo;
-	const struct definition *def = testid_ctx->def;
-	const struct def_vendor *vendor = def->vendor;
-	const struct def_info *info = def->info;
-	const char *specificver = modinfo->specificver_filesafe;
-	int ret;
-
-	CKINT(acvp_datastore_file_target_dir(testid_ctx, pathname, pathnamelen,
-					     createdir, secure_location));
+	struct acvp_datastore_catalog_cache *cache, **prev;
+	int ret = 0;
 
-	if (vendor->vendor_name_filesafe) {
-		CKINT(acvp_extend_string(pathname, pathnamelen, "/%s",
-					 vendor->vendor_name_filesafe));
-		CKINT(acvp_datastore_file_dir(pathname, createdir));
+	for (prev = &acvp_datastore_catalogs; *prev; prev = &(*prev)->next) {
+		if (!strcmp((*prev)->path, catalogpath))
+			break;
 	}
 
-	if (info->module_name_filesafe) {
-		CKINT(acvp_extend_string(pathname, pathnamelen, "/%s",
-					 info->module_name_filesafe));
-		CKINT(acvp_datastore_file_dir(pathname, createdir));
-	}
+	cache = *prev;
+	if (!cache)
+		return 0;
+	*prev = cache->next;
 
-	if (info->module_version_filesafe) {
-		CKINT(acvp_extend_string(
-			pathname, pathnamelen, "/%s",
-			specificver ? specificver :
-					    info->module_version_filesafe));
-		CKINT(acvp_datastore_file_dir(pathname, createdir));
+	/* Wait for the updates in flight */
+	mutex_w_lock(&cache->lock);
+	mutex_w_unlock(&cache->lock);
+
+	if (cache->dirty) {
+		logger(LOGGER_DEBUG, LOGGER_C_DS_FILE, "Writing catalog %s\n",
+		       catalogpath);
+		ret = acvp_datastore_catalog_store(catalogpath,
+						   &cache->catalog);
 	}
 
-out:
+	acvp_datastore_catalog_free(&cache->catalog);
+	mutex_w_destroy(&cache->lock);
+	free(cache);
+
 	return ret;
 }
 
+static void
+acvp_datastore_file_release_testid(const struct acvp_testid_ctx *testid_ctx)
+{
+	char catalogpath[FILENAME_MAX];
+	int ret;
+
+	if (!testid_ctx || !testid_ctx->ctx || !testid_ctx->def)
+		return;
+
+	/* Without a secure directory there is no catalog */
+	if (acvp_datastore_catalog_path(testid_ctx, catalogpath,
+					sizeof(catalogpath), false))
+		return;
+
+	mutex_lock(&acvp_datastore_catalog_lock);
+	ret = acvp_datastore_catalog_flush(catalogpath);
+	mutex_unlock(&acvp_datastore_catalog_lock);
+
+	if (ret) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot write catalog %s: %d\n", catalogpath, ret);
+	}
+}
+
+/* Mark the cached catalog as changed, the caller holds its lock */
 static int
-acvp_datastore_file_vectordir(const struct acvp_testid_ctx *testid_ctx,
-			      char *pathname, const size_t pathnamelen,
-			      const bool createdir, const bool secure_location)
+acvp_datastore_catalog_cache_dirty(struct acvp_datastore_catalog_cache *cache)
 {
 	int ret;
 
-	CKINT(acvp_datastore_file_testsessiondir(
-		testid_ctx, pathname, pathnamelen, createdir, secure_location));
+	if (cache->dirty)
+		return 0;
 
-	CKINT(acvp_extend_string(pathname, pathnamelen, "/%u",
-				 testid_ctx->testid));
-	CKINT(acvp_datastore_file_dir(pathname, createdir));
+	/* The catalog in the data store is outdated from now on */
+	ret = io->unlink(cache->path);
+	if (ret == -ENOENT)
+		ret = 0;
+	cache->dirty = true;
 
-out:
 	return ret;
 }
 
-static int
-acvp_datastore_file_rename_version(const struct acvp_testid_ctx *testid_ctx,
-				   char *newversion)
+/*
+ * Record the state change of a vsID in the catalog of its test session: the
+ * state flags of set are added, the flags of clear are removed.
+ */
+static int acvp_datastore_catalog_update(const struct acvp_vsid_ctx *vsid_ctx,
+					 const unsigned int set,
+					 const unsigned int clear)
 {
-	const struct definition *def = testid_ctx->def;
-	struct def_info *info = def->info;
-	char *currver = info->module_version_filesafe;
-	char pathname[FILENAME_MAX];
-	char newpathname[FILENAME_MAX];
+	struct acvp_datastore_catalog_cache *cache;
+	struct acvp_datastore_catalog_vsid *entry, summary;
 	int ret;
 
-	if (acvp_op_get_interrupted())
+	if (!set && !clear)
 		return 0;
 
-	if (!info->module_version_filesafe)
-		return -EINVAL;
+	/*
+	 * The summary of the test vectors and the verdict is obtained again
+	 * whenever these files are written. Parsing the files does not hold
+	 * up the updates of the other vsIDs.
+	 */
+	memset(&summary, 0, sizeof(summary));
+	CKINT(acvp_datastore_catalog_summary(vsid_ctx, &summary,
+					     set & ACVP_DS_CATALOG_SUMMARY));
 
-	/* rename secure location */
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
-					    sizeof(pathname), false, true));
-	info->module_version_filesafe = newversion;
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
-					    sizeof(pathname), true, true));
-	info->module_version_filesafe = currver;
-	ret = rename(pathname, newpathname);
-	if (ret) {
-		ret = -errno;
-		goto out;
-	}
+	CKINT(acvp_datastore_catalog_cache_get(vsid_ctx->testid_ctx, &cache));
 
-	/* rename regular location */
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
-					    sizeof(pathname), false, false));
-	info->module_version_filesafe = newversion;
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
-					    sizeof(pathname), true, false));
-	info->module_version_filesafe = currver;
-	ret = rename(pathname, newpathname);
-	if (ret) {
-		ret = -errno;
-		goto out;
+	entry = acvp_datastore_catalog_find(&cache->catalog, vsid_ctx->vsid,
+					    NULL);
+	if (entry && (entry->state & set) == set && !(entry->state & clear) &&
+	    !(set & ACVP_DS_CATALOG_SUMMARY))
+		goto unlock;
+
+	ret = acvp_datastore_catalog_add(&cache->catalog, vsid_ctx->vsid, set,
+					 &entry);
+	if (ret)
+		goto unlock;
+
+	entry->state &= ~clear;
+	if (clear & ACVP_DS_CATALOG_VECTOR)
+		acvp_datastore_catalog_summary_free(entry);
+	if (clear & ACVP_DS_CATALOG_VERDICT) {
+		entry->summary &= ~(unsigned int)ACVP_DS_CATALOG_VERDICT;
+		entry->verdict = acvp_verdict_unknown;
 	}
 
+	ret = acvp_datastore_catalog_summary_copy(
+		entry, &summary, set & ACVP_DS_CATALOG_SUMMARY);
+	if (ret)
+		goto unlock;
+
+	ret = acvp_datastore_catalog_cache_dirty(cache);
+
+unlock:
+	mutex_w_unlock(&cache->lock);
 out:
-	info->module_version_filesafe = currver;
+	acvp_datastore_catalog_summary_free(&summary);
 	return ret;
 }
 
+/*
+ * Obtain the state of a vsID from its files and correct the catalog entry
+ * if the files changed without the catalog being updated.
+ */
 static int
-acvp_datastore_file_rename_name(const struct acvp_testid_ctx *testid_ctx,
-				char *newname)
+acvp_datastore_catalog_revalidate(const struct acvp_vsid_ctx *vsid_ctx,
+				  struct acvp_datastore_catalog_vsid *entry,
+				  unsigned int *state)
 {
-	const struct definition *def = testid_ctx->def;
-	struct def_info *info = def->info;
-	char *currname = info->module_name_filesafe;
-	char pathname[FILENAME_MAX];
-	char newpathname[FILENAME_MAX];
 	int ret;
 
-	if (acvp_op_get_interrupted())
-		return 0;
-
-	if (!info->module_name_filesafe)
-		return -EINVAL;
-
-	/* rename secure location */
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
-					    sizeof(pathname), false, true));
-	info->module_name_filesafe = newname;
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
-					    sizeof(pathname), true, true));
-	info->module_name_filesafe = currname;
-	ret = rename(pathname, newpathname);
-	if (ret) {
-		ret = -errno;
+	CKINT(acvp_datastore_vsid_state(vsid_ctx, state));
+	if (*state == entry->state)
 		goto out;
-	}
 
-	/* rename regular location */
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, pathname,
-					    sizeof(pathname), false, false));
-	info->module_name_filesafe = newname;
-	CKINT(acvp_datastore_file_vectordir(testid_ctx, newpathname,
-					    sizeof(pathname), true, false));
-	info->module_name_filesafe = currname;
-	ret = rename(pathname, newpathname);
-	if (ret) {
-		ret = -errno;
-		goto out;
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
+	       "Catalog state of vsID %u outdated (%u instead of %u)\n",
+	       vsid_ctx->vsid, entry->state, *state);
+
+	CKINT(acvp_datastore_catalog_update(vsid_ctx, *state & ~entry->state,
+					    entry->state & ~*state));
+
+	/* The summary of removed files is void */
+	if (!(*state & ACVP_DS_CATALOG_VECTOR))
+		acvp_datastore_catalog_summary_free(entry);
+	if (!(*state & ACVP_DS_CATALOG_VERDICT)) {
+		entry->summary &= ~(unsigned int)ACVP_DS_CATALOG_VERDICT;
+		entry->verdict = acvp_verdict_unknown;
 	}
+	entry->state = *state;
 
 out:
-	info->module_name_filesafe = currname;
 	return ret;
 }
 
+/*
+ * Record the missing summaries of the vsIDs in the catalog. This covers vsIDs
+ * whose files were written before the catalog recorded summaries. The
+ * summaries are obtained without holding a catalog lock.
+ */
 static int
-acvp_datastore_file_vectordir_vsid(const struct acvp_vsid_ctx *vsid_ctx,
-				   char *pathname, const size_t pathnamelen,
-				   const bool createdir,
-				   const bool secure_location)
+acvp_datastore_catalog_backfill(const struct acvp_testid_ctx *testid_ctx,
+				struct acvp_datastore_catalog *catalog)
 {
-	int ret;
+	struct acvp_datastore_catalog_cache *cache;
+	struct acvp_datastore_catalog_vsid *entry, *cached;
+	struct acvp_vsid_ctx vsid_ctx;
+	unsigned int i, missing;
+	bool updated = false;
+	int ret = 0;
 
-	CKINT(acvp_datastore_file_vectordir(vsid_ctx->testid_ctx, pathname,
-					    pathnamelen, createdir,
-					    secure_location));
+	memset(&vsid_ctx, 0, sizeof(vsid_ctx));
+	vsid_ctx.testid_ctx = testid_ctx;
 
-	CKINT(acvp_extend_string(pathname, pathnamelen, "/%u", vsid_ctx->vsid));
-	CKINT(acvp_datastore_file_dir(pathname, createdir));
+	for (i = 0; i < catalog->num; i++) {
+		entry = &catalog->vsids[i];
+		missing = entry->state & ACVP_DS_CATALOG_SUMMARY &
+			  ~entry->summary;
+		if (!missing)
+			continue;
+
+		vsid_ctx.vsid = entry->vsid;
+		CKINT(acvp_datastore_catalog_summary(&vsid_ctx, entry,
+						     missing));
+		updated = true;
+	}
+
+	if (!updated)
+		return 0;
+
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
+	       "Recording vsID summaries in catalog of testID %u\n",
+	       testid_ctx->testid);
+
+	CKINT(acvp_datastore_catalog_cache_get(testid_ctx, &cache));
+
+	for (i = 0; i < catalog->num; i++) {
+		entry = &catalog->vsids[i];
+		cached = acvp_datastore_catalog_find(&cache->catalog,
+						     entry->vsid, NULL);
+		if (!cached)
+			continue;
+
+		missing = entry->summary & ~cached->summary;
+		if (!missing)
+			continue;
+
+		ret = acvp_datastore_catalog_summary_copy(cached, entry,
+							  missing);
+		if (!ret)
+			ret = acvp_datastore_catalog_cache_dirty(cache);
+		if (ret)
+			break;
+	}
+
+	mutex_w_unlock(&cache->lock);
 
 out:
 	return ret;
@@ -456,7 +2125,7 @@ acvp_datastore_file_write_authtoken(const struct acvp_testid_ctx *testid_ctx)
 		 * We do not care about the error code as we cannot do
 		 * anything else here.
 		 */
-		unlink(file);
+		io->unlink(file);
 	} else {
 		/*
 		 * Ensure that nobody except the ACVP Proxy can access the
@@ -476,7 +2145,7 @@ acvp_datastore_file_write_authtoken(const struct acvp_testid_ctx *testid_ctx)
 		 * anything else here. The likelihood of an error is very
 		 * slim, as we just created and wrote the file.
 		 */
-		chmod(file, S_IRUSR | S_IWUSR);
+		io->chmod(file, S_IRUSR | S_IWUSR);
 	}
 
 	logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
@@ -513,14 +2182,14 @@ out:
 static int acvp_datastore_file_uint(const char *pathname, const char *filename,
 				    uint32_t *id)
 {
-	struct stat statbuf;
+	struct acvp_datastore_stat st;
 	int ret = 0;
 	char file[FILENAME_MAX];
 
 	/* Get message size */
 	snprintf(file, sizeof(file), "%s/%s", pathname, filename);
 
-	if (!stat(file, &statbuf) && statbuf.st_size) {
+	if (!io->stat(file, &st) && st.size) {
 		size_t msgsize_len;
 		unsigned long msgsize_int;
 		char *msgsize = NULL;
@@ -547,17 +2216,25 @@ out:
 static int acvp_datastore_process_certinfo(const char *pathname,
 					   const char *filename, char **cert_no)
 {
-	struct stat statbuf;
+	struct acvp_datastore_stat st;
 	struct json_object *certinfo = NULL;
 	int ret = 0;
 	char file[FILENAME_MAX];
 
 	snprintf(file, sizeof(file), "%s/%s", pathname, filename);
-	if (!stat(file, &statbuf) && statbuf.st_size) {
+	if (!io->stat(file, &st) && st.size) {
 		struct json_object *certdata, *certversion;
 		const char *valId;
 
-		CKINT(json_read_data(file, &certinfo));
+		certinfo = acvp_datastore_read_json(file);
+		CKNULL_LOG(certinfo, -EFAULT, "Cannot parse input file %s\n",
+			   file);
+		if (!json_object_is_type(certinfo, json_type_array)) {
+			logger(LOGGER_ERR, LOGGER_C_ANY,
+			       "JSON input data is not expected ACVP array\n");
+			ret = -EINVAL;
+			goto out;
+		}
 		CKINT(json_split_version(certinfo, &certdata, &certversion));
 		CKINT(json_get_string(certdata, "validationId", &valId));
 		CKINT(acvp_duplicate(cert_no, valId));
@@ -572,7 +2249,7 @@ static int acvp_datastore_parse_status(const char *pathname,
 				       const char *filename,
 				       const struct acvp_testid_ctx *testid_ctx)
 {
-	struct stat statbuf;
+	struct acvp_datastore_stat st;
 	struct json_object *status = NULL;
 	int ret = 0;
 	char file[FILENAME_MAX];
@@ -581,10 +2258,10 @@ static int acvp_datastore_parse_status(const char *pathname,
 		return 0;
 
 	snprintf(file, sizeof(file), "%s/%s", pathname, filename);
-	if (!stat(file, &statbuf) && statbuf.st_size) {
+	if (!io->stat(file, &st) && st.size) {
 		logger(LOGGER_DEBUG, LOGGER_C_ANY, "Loading status file %s\n",
 		       file);
-		status = json_object_from_file(file);
+		status = acvp_datastore_read_json(file);
 		CKNULL_LOG(status, -EFAULT, "Cannot parse input file %s\n",
 			   file);
 		CKINT(testid_ctx->status_parse(testid_ctx, status));
@@ -602,7 +2279,7 @@ acvp_datastore_file_read_authtoken(const struct acvp_testid_ctx *testid_ctx)
 	const struct acvp_ctx *ctx;
 	const struct acvp_datastore_ctx *datastore;
 	const struct definition *def;
-	struct stat statbuf;
+	struct acvp_datastore_stat st;
 	int ret = 0;
 	char pathname[FILENAME_MAX / 2];
 	char file[FILENAME_MAX];
@@ -635,7 +2312,7 @@ acvp_datastore_file_read_authtoken(const struct acvp_testid_ctx *testid_ctx)
 	/* Get JWT token file */
 	snprintf(file, sizeof(file), "%s/%s", pathname,
 		 datastore->jwttokenfile);
-	if (!stat(file, &statbuf) && statbuf.st_size) {
+	if (!io->stat(file, &st) && st.size) {
 		logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
 		       "Try to read auth token from file %s\n", file);
 
@@ -648,11 +2325,7 @@ acvp_datastore_file_read_authtoken(const struct acvp_testid_ctx *testid_ctx)
 		CKINT(acvp_datastore_read_data((uint8_t **)&auth->jwt_token,
 					       &auth->jwt_token_len, file));
 
-#ifdef __APPLE__
-		auth->jwt_token_generated = statbuf.st_mtimespec.tv_sec;
-#else
-		auth->jwt_token_generated = statbuf.st_mtim.tv_sec;
-#endif
+		auth->jwt_token_generated = st.mtime;
 
 		logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
 		       "Got authorization token %s\n", auth->jwt_token);
@@ -697,6 +2370,7 @@ static int acvp_datastore_file_write_vsid(const struct acvp_vsid_ctx *vsid_ctx,
 	const struct acvp_ctx *ctx;
 	const struct acvp_datastore_ctx *datastore;
 	const struct definition *def;
+	ACVP_BUFFER_INIT(compressed);
 	char pathname[FILENAME_MAX];
 	int ret;
 
@@ -723,12 +2397,104 @@ static int acvp_datastore_file_write_vsid(const struct acvp_vsid_ctx *vsid_ctx,
 		vsid_ctx, pathname, sizeof(pathname), true, secure_location));
 	CKINT(acvp_extend_string(pathname, sizeof(pathname), "/%s", filename));
 
-	CKINT(acvp_datastore_write_data(data, pathname));
+	if (acvp_datastore_compressed_vsid(datastore, filename,
+					   secure_location)) {
+		CKINT(acvp_compress(data, &compressed));
+		data = &compressed;
+		CKINT(acvp_extend_string(pathname, sizeof(pathname), "%s",
+					 ACVP_COMPRESSION_EXT));
+	}
+
+	if (io->add_file && !secure_location &&
+	    acvp_datastore_iut_file(datastore, filename)) {
+		CKINT(acvp_datastore_iut_dir(pathname));
+		CKINT(acvp_datastore_io_file_write(pathname, data));
+		CKINT(io->add_file(pathname));
+	} else {
+		CKINT(acvp_datastore_write_data(data, pathname));
+	}
+
+	CKINT(acvp_datastore_catalog_update(
+		vsid_ctx,
+		acvp_datastore_catalog_state(datastore, filename,
+					     secure_location),
+		0));
 
 	logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
 	       "data written for testID %u / vsID %u to file %s\n",
 	       testid_ctx->testid, vsid_ctx->vsid, filename);
 
+out:
+	acvp_free_buf(&compressed);
+	return ret;
+}
+
+static int acvp_datastore_file_stream_vsid(
+	const struct acvp_vsid_ctx *vsid_ctx, const char *filename,
+	const bool secure_location,
+	int (*stream)(const struct acvp_vsid_ctx *vsid_ctx, int fd, void *data),
+	void *data)
+{
+	const struct acvp_testid_ctx *testid_ctx;
+	const struct acvp_ctx *ctx;
+	const struct acvp_datastore_ctx *datastore;
+	const struct definition *def;
+	char pathname[FILENAME_MAX];
+	int ret;
+
+	CKNULL_C_LOG(vsid_ctx, -EINVAL, LOGGER_C_DS_FILE,
+		     "Data store backend exchange info missing\n");
+
+	if (acvp_op_get_interrupted())
+		return 0;
+
+	testid_ctx = vsid_ctx->testid_ctx;
+	ctx = testid_ctx->ctx;
+	datastore = &ctx->datastore;
+	def = testid_ctx->def;
+
+	CKNULL_C_LOG(datastore, -EINVAL, LOGGER_C_DS_FILE,
+		     "Datastore context missing\n");
+	CKNULL_C_LOG(def, -EINVAL, LOGGER_C_DS_FILE,
+		     "Module definition context missing\n");
+	CKNULL_C_LOG(filename, -EINVAL, LOGGER_C_DS_FILE, "Filename missing\n");
+	CKNULL_C_LOG(stream, -EINVAL, LOGGER_C_DS_FILE,
+		     "Stream callback missing\n");
+
+	CKINT(acvp_datastore_file_vectordir_vsid(
+		vsid_ctx, pathname, sizeof(pathname), true, secure_location));
+	CKINT(acvp_extend_string(pathname, sizeof(pathname), "/%s", filename));
+
+	if (io->add_file && !secure_location &&
+	    acvp_datastore_iut_file(datastore, filename)) {
+		CKINT(acvp_datastore_iut_dir(pathname));
+		CKINT(acvp_datastore_io_file_stream(pathname, secure_location,
+						    stream, vsid_ctx, data));
+		/* The data is only compressed once it is complete */
+		if (acvp_datastore_compressed_vsid(datastore, filename,
+						   secure_location))
+			CKINT(acvp_datastore_iut_compress(pathname,
+							  sizeof(pathname)));
+		CKINT(io->add_file(pathname));
+	} else {
+		CKINT(io->stream(pathname, secure_location, stream, vsid_ctx,
+				 data));
+		if (acvp_datastore_compressed_vsid(datastore, filename,
+						   secure_location))
+			CKINT(acvp_datastore_iut_compress(pathname,
+							  sizeof(pathname)));
+	}
+
+	CKINT(acvp_datastore_catalog_update(
+		vsid_ctx,
+		acvp_datastore_catalog_state(datastore, filename,
+					     secure_location),
+		0));
+
+	logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+	       "data streamed for testID %u / vsID %u to file %s\n",
+	       testid_ctx->testid, vsid_ctx->vsid, filename);
+
 out:
 	return ret;
 }
@@ -847,110 +2613,23 @@ out:
 	return ret;
 }
 
-static int
-acvp_datastore_find_verdict(const struct acvp_datastore_ctx *datastore,
-			    struct acvp_test_verdict_status *verdict,
-			    char *verdict_dir, const size_t verdict_dir_len)
-{
-	struct stat statbuf;
-	int ret;
-
-	CKINT(acvp_extend_string(verdict_dir, verdict_dir_len, "/%s",
-				 datastore->verdictfile));
-
-	/* Verdict file exists, return information to  */
-	if (!stat(verdict_dir, &statbuf)) {
-		ACVP_BUFFER_INIT(verdict_buf);
-		int fd;
-
-		/* Positive return code as this is no error */
-		if (!verdict)
-			return EEXIST;
-
-		fd = open(verdict_dir, O_RDONLY | O_CLOEXEC);
-		if (fd < 0) {
-			ret = -errno;
-
-			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-			       "Cannot open file %s (%d)\n", verdict_dir, ret);
-			goto out;
-		}
-
-		verdict_buf.buf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ,
-				       MAP_SHARED, fd, 0);
-		if (verdict_buf.buf == MAP_FAILED) {
-			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-			       "Cannot mmap file %s\n", verdict_dir);
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		verdict_buf.len = (uint32_t)statbuf.st_size;
-		ret = acvp_get_verdict_json(&verdict_buf, &verdict->verdict);
-
-		munmap(verdict_buf.buf, (size_t)statbuf.st_size);
-		close(fd);
-
-		if (ret) {
-			logger(LOGGER_WARN, LOGGER_C_ANY,
-			       "File %s does not contain valid verdict\n",
-			       verdict_dir);
-			/*
-			 * We are not stopping here and will not goto out,
-			 * since we will report that the ID is unverified.
-			 */
-		}
-
-		return 0;
-	}
-
-	/*
-	 * If we have a verdict to fill and we reach here, we have no verdict
-	 * file.
-	 */
-	if (verdict)
-		verdict->verdict = acvp_verdict_unknown;
-
-out:
-	return ret;
-}
-
 static int acvp_datastore_find_metadata(struct acvp_testid_ctx *testid_ctx,
 					char *dir, const size_t dir_len)
 {
-	struct stat statbuf;
-	ACVP_BUFFER_INIT(buf);
-	int ret, fd;
+	struct acvp_datastore_stat st;
+	struct acvp_datastore_map map;
+	int ret;
 
 	CKINT(acvp_extend_string(dir, dir_len, "/%s", ACVP_DS_TESTIDMETA));
 
-	if (stat(dir, &statbuf))
+	if (io->stat(dir, &st))
 		return 0;
 
-	fd = open(dir, O_RDONLY | O_CLOEXEC);
-	if (fd < 0) {
-		ret = -errno;
-
-		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-		       "Cannot open file %s (%d)\n", dir, ret);
-		goto out;
-	}
-
-	buf.buf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED, fd,
-		       0);
-	if (buf.buf == MAP_FAILED) {
-		logger(LOGGER_WARN, LOGGER_C_DS_FILE, "Cannot mmap file %s\n",
-		       dir);
-		ret = -ENOMEM;
-		goto out;
-	}
-
-	buf.len = (uint32_t)statbuf.st_size;
-
-	ret = acvp_get_testsession_expiry_epoch(&buf, &testid_ctx->expiry);
-
-	munmap(buf.buf, (size_t)statbuf.st_size);
-	close(fd);
+	CKINT(io->map(dir, &map));
+	ret = map.buf.len ? acvp_get_testsession_expiry_epoch(
+				   &map.buf, &testid_ctx->expiry) :
+			   -EINVAL;
+	io->unmap(&map);
 
 	if (ret) {
 		logger(LOGGER_WARN, LOGGER_C_ANY,
@@ -968,66 +2647,6 @@ out:
 	return ret;
 }
 
-static int
-acvp_datastore_find_modinfo(const struct acvp_datastore_ctx *datastore,
-			    struct acvp_test_verdict_status *verdict, char *dir,
-			    const size_t dir_len)
-{
-	struct stat statbuf;
-	int ret;
-
-	CKINT(acvp_extend_string(dir, dir_len, "/%s", datastore->vectorfile));
-
-	/* Verdict file exists, return information to  */
-	if (!stat(dir, &statbuf)) {
-		ACVP_BUFFER_INIT(buf);
-		int fd;
-
-		/* Positive return code as this is no error */
-		if (!verdict)
-			return EEXIST;
-
-		fd = open(dir, O_RDONLY | O_CLOEXEC);
-		if (fd < 0) {
-			ret = -errno;
-
-			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-			       "Cannot open file %s (%d)\n", dir, ret);
-			goto out;
-		}
-
-		buf.buf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ,
-			       MAP_SHARED, fd, 0);
-		if (buf.buf == MAP_FAILED) {
-			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-			       "Cannot mmap file %s\n", dir);
-			ret = -ENOMEM;
-			goto out;
-		}
-
-		buf.len = (uint32_t)statbuf.st_size;
-		ret = acvp_get_algoinfo_json(&buf, verdict);
-
-		munmap(buf.buf, (size_t)statbuf.st_size);
-		close(fd);
-
-		if (ret) {
-			logger(LOGGER_WARN, LOGGER_C_ANY,
-			       "File %s does not contain valid cipher information\n",
-			       dir);
-			/*
-			 * We are not stopping here and will not goto out,
-			 * since we will report that the ID is unverified.
-			 */
-		}
-
-		return 0;
-	}
-
-out:
-	return ret;
-}
-
 static int
 acvp_datastore_find_testid_verdict(const struct acvp_testid_ctx *testid_ctx)
 {
@@ -1096,39 +2715,28 @@ out:
 	return ret;
 }
 
-static int acvp_datastore_find_vsid_verdict(struct acvp_vsid_ctx *vsid_ctx)
+/* Obtain the cipher information and the verdict from the catalog */
+static int acvp_datastore_find_vsid_verdict(
+	struct acvp_vsid_ctx *vsid_ctx,
+	const struct acvp_datastore_catalog_vsid *entry)
 {
-	const struct acvp_testid_ctx *testid_ctx;
-	const struct acvp_ctx *ctx;
-	const struct acvp_datastore_ctx *datastore;
-	char vector_dir[FILENAME_MAX];
-	int ret;
+	int ret = 0;
 
 	CKNULL_C_LOG(vsid_ctx, -EINVAL, LOGGER_C_DS_FILE,
 		     "Data store backend exchange info missing\n");
-	testid_ctx = vsid_ctx->testid_ctx;
-
-	CKNULL_C_LOG(testid_ctx, -EINVAL, LOGGER_C_DS_FILE,
-		     "Data store backend exchange info missing\n");
-
-	ctx = testid_ctx->ctx;
-	datastore = &ctx->datastore;
-
-	ret = acvp_datastore_file_vectordir_vsid(
-		vsid_ctx, vector_dir, sizeof(vector_dir), false, false);
-	if (ret) {
-		/* If pathname does not exist, we ignore it. */
-		return 0;
-	} else {
-		CKINT(acvp_datastore_find_verdict(datastore, NULL, vector_dir,
-						  sizeof(vector_dir)));
 
-		CKINT(acvp_datastore_file_vectordir_vsid(vsid_ctx, vector_dir,
-							 sizeof(vector_dir),
-							 false, false));
-		CKINT(acvp_datastore_find_modinfo(datastore, &vsid_ctx->verdict,
-						  vector_dir,
-						  sizeof(vector_dir)));
+	if (entry->cipher_name)
+		CKINT(acvp_duplicate(&vsid_ctx->verdict.cipher_name,
+				     entry->cipher_name));
+	if (entry->cipher_mode)
+		CKINT(acvp_duplicate(&vsid_ctx->verdict.cipher_mode,
+				     entry->cipher_mode));
+
+	/* Without a verdict file, the verdict is unknown */
+	if (!(entry->state & ACVP_DS_CATALOG_VERDICT) ||
+	    (entry->summary & ACVP_DS_CATALOG_VERDICT)) {
+		vsid_ctx->verdict.verdict = entry->verdict;
+		vsid_ctx->verdict_cached = true;
 	}
 
 out:
@@ -1153,6 +2761,10 @@ static int acvp_datastore_get_vsid_verdict(struct acvp_vsid_ctx *vsid_ctx)
 	if (acvp_op_get_interrupted())
 		return 0;
 
+	/* The verdict was obtained from the catalog already */
+	if (vsid_ctx->verdict_cached)
+		return 0;
+
 	ctx = testid_ctx->ctx;
 	datastore = &ctx->datastore;
 
@@ -1174,6 +2786,7 @@ out:
 static int
 acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 			    const char *datastore_base, const char *secure_base,
+			    const unsigned int state,
 			    int (*cb)(const struct acvp_vsid_ctx *vsid_ctx,
 				      const struct acvp_buf *buf))
 {
@@ -1182,15 +2795,16 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 	const struct acvp_datastore_ctx *datastore = &ctx->datastore;
 	const struct acvp_opts_ctx *ctx_opts = &ctx->options;
 	const struct acvp_auth_ctx *auth = testid_ctx->server_auth;
-	FILE *file;
-	struct stat statbuf;
-	struct acvp_buf buf;
+	struct acvp_datastore_stat st;
+	struct acvp_datastore_map map;
+	ACVP_BUFFER_INIT(processed);
+	ACVP_BUFFER_INIT(resp);
 	time_t now;
 	struct tm now_detail;
-	uint8_t *resp_buf;
-	int fd = -1, ret = 0;
-	char resppath[FILENAME_MAX], processedpath[FILENAME_MAX],
-		vectorfile[FILENAME_MAX], expected[FILENAME_MAX], now_buf[30];
+	int ret = 0;
+	bool resp_compressed = false;
+	char vsiddir[FILENAME_MAX], resppath[FILENAME_MAX],
+		gzpath[FILENAME_MAX], processedpath[FILENAME_MAX], now_buf[30];
 
 	CKNULL_C_LOG(datastore_base, -EINVAL, LOGGER_C_DS_FILE,
 		     "Data store base missing\n");
@@ -1217,7 +2831,8 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 
 	/* Create path names */
 	CKINT(acvp_datastore_file_vectordir_vsid(
-		vsid_ctx, resppath, sizeof(resppath), false, false));
+		vsid_ctx, vsiddir, sizeof(vsiddir), false, false));
+	snprintf(resppath, sizeof(resppath), "%s", vsiddir);
 	CKINT(acvp_extend_string(resppath, sizeof(resppath), "/%s",
 				 datastore->resultsfile));
 
@@ -1232,16 +2847,6 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 	CKINT(acvp_extend_string(processedpath, sizeof(processedpath), "/%s",
 				 datastore->processedfile));
 
-	CKINT(acvp_datastore_file_vectordir_vsid(
-		vsid_ctx, vectorfile, sizeof(vectorfile), false, false));
-	CKINT(acvp_extend_string(vectorfile, sizeof(vectorfile), "/%s",
-				 datastore->vectorfile));
-
-	CKINT(acvp_datastore_file_vectordir_vsid(
-		vsid_ctx, expected, sizeof(expected), false, false));
-	CKINT(acvp_extend_string(expected, sizeof(expected), "/%s",
-				 datastore->expectedfile));
-
 	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
 	       "Read response from %s and processed file from %s\n", resppath,
 	       processedpath);
@@ -1250,34 +2855,26 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 	 * If we have an expected result on file, we cannot submit real results
 	 * any more - the ACVP server will reject it.
 	 */
-	if (!stat(expected, &statbuf)) {
+	if (state & ACVP_DS_CATALOG_EXPECTED) {
 		logger_status(
 			LOGGER_C_DS_FILE,
-			"Skipping submission for vsID %u since expected results are present (%s exists)\n",
-			vsid_ctx->vsid, expected);
+			"Skipping submission for vsID %u since expected results are present (%s/%s exists)\n",
+			vsid_ctx->vsid, vsiddir, datastore->expectedfile);
 		logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
-		       "Skipping submission for vsID %u since expected results are present (%s exists)\n",
-		       vsid_ctx->vsid, expected);
+		       "Skipping submission for vsID %u since expected results are present (%s/%s exists)\n",
+		       vsid_ctx->vsid, vsiddir, datastore->expectedfile);
 		vsid_ctx->sample_file_present = true;
 
 		return 0;
 	}
 
 	/* If there is already a processed file, do a resubmit */
-	if (!stat(processedpath, &statbuf)) {
+	if (state & ACVP_DS_CATALOG_PROCESSED) {
 		if (ctx_opts->delete_vsid) {
 			return cb(vsid_ctx, NULL);
 		}
 		if (!ctx_opts->resubmit_result) {
-			char verdict_file[FILENAME_MAX];
-
-			CKINT(acvp_datastore_file_vectordir_vsid(
-				vsid_ctx, verdict_file, sizeof(verdict_file),
-				false, false));
-			CKINT(acvp_extend_string(verdict_file,
-						 sizeof(verdict_file), "/%s",
-						 datastore->verdictfile));
-			if (stat(verdict_file, &statbuf)) {
+			if (!(state & ACVP_DS_CATALOG_VERDICT)) {
 				logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
 				       "Skipping submission for vsID %u since it was submitted already, but fetching verdict\n",
 				       vsid_ctx->vsid);
@@ -1313,14 +2910,26 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 		}
 	}
 
-	/* Get response file */
-	if (stat(resppath, &statbuf)) {
-		int errsv = errno;
-
-		if (errsv != ENOENT) {
-			ret = -errsv;
-			goto out;
+	/*
+	 * Get response file - it is a regular file provided by the IUT
+	 * independent of the storage layer.
+	 */
+	memset(&st, 0, sizeof(st));
+	ret = acvp_datastore_io_file_stat(resppath, &st);
+	/* The IUT may provide its response compressed */
+	if (ret == -ENOENT) {
+		snprintf(gzpath, sizeof(gzpath), "%s", resppath);
+		CKINT(acvp_extend_string(gzpath, sizeof(gzpath), "%s",
+					 ACVP_COMPRESSION_EXT));
+		if (!acvp_datastore_io_file_stat(gzpath, &st)) {
+			snprintf(resppath, sizeof(resppath), "%s", gzpath);
+			resp_compressed = true;
+			ret = 0;
 		}
+	}
+	if (ret) {
+		if (ret != -ENOENT)
+			goto out;
 
 		logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
 		       "No response file for vsID %u found (%s not found)\n",
@@ -1330,7 +2939,7 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 		 * Download pending vsID requests (do not try to submit
 		 * responses).
 		 */
-		if (stat(vectorfile, &statbuf)) {
+		if (!(state & ACVP_DS_CATALOG_VECTOR)) {
 			logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
 			       "No request file for vsID %u found\n",
 			       vsid_ctx->vsid);
@@ -1346,14 +2955,14 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 		ret = 0;
 		goto out;
 	} else {
-		if (!statbuf.st_size) {
+		if (!st.size) {
 			logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
 			       "Skipping submission for vsID %u since response file not found (%s empty)\n",
 			       vsid_ctx->vsid, resppath);
 			ret = 0;
 			goto out;
 		}
-		if ((statbuf.st_mode & S_IFMT) != S_IFREG) {
+		if (!st.regular) {
 			logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
 			       "Skipping directory entry %s which is no regular file\n",
 			       resppath);
@@ -1361,33 +2970,26 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 			goto out;
 		}
 
-		fd = open(resppath, O_RDONLY | O_CLOEXEC);
-		if (fd < 0) {
-			ret = -errno;
+		if (resp_compressed) {
+			CKINT(acvp_datastore_iut_read_compressed(resppath,
+								 &resp));
+			ret = resp.len ? cb(vsid_ctx, &resp) : 0;
+			acvp_free_buf(&resp);
+		} else {
+			CKINT(acvp_datastore_io_file_map(resppath, &map));
 
-			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-			       "Cannot open file %s (%d)\n", resppath, ret);
-			goto out;
-		}
+			/*
+			 * The response is uploaded straight from the mapping,
+			 * it is read exactly once from beginning to end.
+			 */
+			if (map.addr)
+				madvise(map.addr, map.len, MADV_SEQUENTIAL);
 
-		resp_buf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ,
-				MAP_SHARED, fd, 0);
-		if (resp_buf == MAP_FAILED) {
-			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-			       "Cannot mmap file %s\n", resppath);
-			close(fd);
-			ret = -ENOMEM;
-			goto out;
+			/* Process response file */
+			ret = cb(vsid_ctx, &map.buf);
+			acvp_datastore_io_file_unmap(&map);
 		}
 
-		buf.buf = resp_buf;
-		buf.len = (uint32_t)statbuf.st_size;
-
-		/* Process response file */
-		ret = cb(vsid_ctx, &buf);
-		munmap(resp_buf, (size_t)statbuf.st_size);
-		close(fd);
-
 		if (ret < 0) {
 			/*
 			 * If the upload was rejected, we do not create the
@@ -1414,10 +3016,11 @@ acvp_datastore_process_vsid(struct acvp_vsid_ctx *vsid_ctx,
 			 now_detail.tm_mday, now_detail.tm_hour,
 			 now_detail.tm_min, now_detail.tm_sec);
 
-		file = fopen(processedpath, "w");
-		CKNULL(file, -errno);
-		fwrite(now_buf, 1, strlen(now_buf), file);
-		fclose(file);
+		processed.buf = (uint8_t *)now_buf;
+		processed.len = (uint32_t)strlen(now_buf);
+		CKINT(acvp_datastore_write_data(&processed, processedpath));
+		CKINT(acvp_datastore_catalog_update(
+			vsid_ctx, ACVP_DS_CATALOG_PROCESSED, 0));
 	}
 
 out:
@@ -1432,6 +3035,7 @@ static int acvp_datastore_file_find_responses_thread(void *arg)
 	struct acvp_vsid_ctx *vsid_ctx = tdata->vsid_ctx;
 	const char *datastore_base = tdata->datastore_base;
 	const char *secure_base = tdata->secure_base;
+	const unsigned int state = tdata->state;
 	int (*cb)(const struct acvp_vsid_ctx *vsid_ctx,
 		  const struct acvp_buf *buf) = tdata->cb;
 	int ret;
@@ -1441,7 +3045,7 @@ static int acvp_datastore_file_find_responses_thread(void *arg)
 	thread_set_name(acvp_vsid, vsid_ctx->vsid);
 
 	ret = acvp_datastore_process_vsid(vsid_ctx, datastore_base, secure_base,
-					  cb);
+					  state, cb);
 
 	acvp_release_vsid_ctx(vsid_ctx);
 
@@ -1471,7 +3075,7 @@ static int acvp_def_check(const struct acvp_testid_ctx *testid_ctx,
 	snprintf(defpath, sizeof(defpath), "%s/%s", dir, ACVP_DS_DEF_REFERENCE);
 
 	/* Do not do anyting if we did not find a definition search file */
-	def_config = json_object_from_file(defpath);
+	def_config = acvp_datastore_read_json(defpath);
 	if (!def_config)
 		return 0;
 
@@ -1491,13 +3095,16 @@ static int acvp_datastore_file_find_responses(
 	const struct acvp_datastore_ctx *datastore;
 	const struct acvp_opts_ctx *opts;
 	const struct definition *def;
-	struct dirent *dirent;
-	DIR *dir = NULL;
+	struct acvp_datastore_catalog catalog;
+	char catalogpath[FILENAME_MAX];
 	char datastore_base[FILENAME_MAX - 100];
 	char base[FILENAME_MAX - 100];
 	char secure_base[FILENAME_MAX - 100];
+	unsigned int n;
 	int ret;
 
+	memset(&catalog, 0, sizeof(catalog));
+
 	CKNULL_C_LOG(testid_ctx, -EINVAL, LOGGER_C_DS_FILE,
 		     "Data store backend exchange info missing\n");
 
@@ -1554,35 +3161,32 @@ static int acvp_datastore_file_find_responses(
 	if (acvp_def_check(testid_ctx, base))
 		return 0;
 
-	dir = opendir(datastore_base);
-	CKNULL(dir, -errno);
+	/* The vsIDs, their state and summary are obtained from the catalog */
+	CKINT(acvp_datastore_catalog_path(testid_ctx, catalogpath,
+					  sizeof(catalogpath), true));
+	mutex_lock(&acvp_datastore_catalog_lock);
+	ret = acvp_datastore_catalog_flush(catalogpath);
+	if (!ret) {
+		ret = acvp_datastore_catalog_get(testid_ctx, &catalog,
+						 catalogpath,
+						 sizeof(catalogpath));
+	}
+	mutex_unlock(&acvp_datastore_catalog_lock);
+	if (!ret)
+		ret = acvp_datastore_catalog_backfill(testid_ctx, &catalog);
+	if (ret) {
+		acvp_datastore_catalog_free(&catalog);
+		return ret;
+	}
 
-	while ((dirent = readdir(dir)) != NULL) {
+	for (n = 0; n < catalog.num; n++) {
 		const struct acvp_search_ctx *search = &datastore->search;
 		struct acvp_vsid_ctx *vsid_ctx = NULL;
-		unsigned long vsid_val;
-		unsigned int i, skip = 0;
-
-		if (!strncmp(dirent->d_name, ".", 1))
-			continue;
-
-		for (i = 0; i < strlen(dirent->d_name); i++) {
-			if (!isdigit(dirent->d_name[i])) {
-				skip = 1;
-				break;
-			}
-		}
-		if (skip)
-			continue;
+		const uint32_t vsid_val = catalog.vsids[n].vsid;
+		unsigned int state;
 
 		logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
-		       "Process results directory %s\n", dirent->d_name);
-
-		vsid_val = strtoul(dirent->d_name, NULL, 10);
-		if (vsid_val == ULONG_MAX) {
-			ret = -errno;
-			goto out;
-		}
+		       "Process results directory %u\n", vsid_val);
 
 		/*
 		 * If specific vsID is requested, only return requested vsID.
@@ -1600,7 +3204,7 @@ static int acvp_datastore_file_find_responses(
 
 			if (!found) {
 				logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
-				       "Skipping test results dir %lu\n",
+				       "Skipping test results dir %u\n",
 				       vsid_val);
 				continue;
 			}
@@ -1609,7 +3213,7 @@ static int acvp_datastore_file_find_responses(
 		vsid_ctx = calloc(1, sizeof(*vsid_ctx));
 		CKNULL(vsid_ctx, -ENOMEM);
 
-		vsid_ctx->vsid = (uint32_t)vsid_val;
+		vsid_ctx->vsid = vsid_val;
 		vsid_ctx->testid_ctx = testid_ctx;
 		if (clock_gettime(CLOCK_REALTIME, &vsid_ctx->start)) {
 			ret = -errno;
@@ -1617,13 +3221,16 @@ static int acvp_datastore_file_find_responses(
 			goto out;
 		}
 
-		ret = acvp_datastore_find_vsid_verdict(vsid_ctx);
+		ret = acvp_datastore_catalog_revalidate(
+			vsid_ctx, &catalog.vsids[n], &state);
+		if (!ret) {
+			ret = acvp_datastore_find_vsid_verdict(
+				vsid_ctx, &catalog.vsids[n]);
+		}
 		if (ret < 0) {
 			acvp_release_vsid_ctx(vsid_ctx);
 			goto out;
 		}
-		if (ret == EEXIST)
-			vsid_ctx->verdict_file_present = true;
 
 		/*
 		 * If the testid_ctx contains a test verdict retrieval,
@@ -1645,14 +3252,15 @@ static int acvp_datastore_file_find_responses(
 		if (opts->threading_disabled) {
 			logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
 			       "Disable threading support\n");
-			ret = acvp_datastore_process_vsid(
-				vsid_ctx, datastore_base, secure_base, cb);
+			ret = acvp_datastore_process_vsid(vsid_ctx,
+							  datastore_base,
+							  secure_base, state,
+							  cb);
 			acvp_release_vsid_ctx(vsid_ctx);
 			if (ret)
 				goto out;
 		} else {
 			struct acvp_datastore_thread_ctx *tdata;
-			int ret_ancestor;
 
 			tdata = calloc(1, sizeof(*tdata));
 			if (!tdata) {
@@ -1663,15 +3271,15 @@ static int acvp_datastore_file_find_responses(
 			tdata->vsid_ctx = vsid_ctx;
 			tdata->datastore_base = datastore_base;
 			tdata->secure_base = secure_base;
+			tdata->state = state;
 			tdata->cb = cb;
 			CKINT(thread_start(
 				acvp_datastore_file_find_responses_thread,
-				tdata, 1, &ret_ancestor));
-			ret |= ret_ancestor;
+				tdata, 1, NULL));
 		}
 #else
 		ret = acvp_datastore_process_vsid(vsid_ctx, datastore_base,
-						  secure_base, cb);
+						  secure_base, state, cb);
 		acvp_release_vsid_ctx(vsid_ctx);
 		if (ret)
 			goto out;
@@ -1689,8 +3297,7 @@ out:
 	ret |= thread_wait();
 #endif
 
-	if (dir)
-		closedir(dir);
+	acvp_datastore_catalog_free(&catalog);
 
 	return ret;
 }
@@ -1702,11 +3309,10 @@ static int acvp_datastore_file_find_testsession(const struct definition *def,
 {
 	const struct acvp_datastore_ctx *datastore;
 	struct acvp_testid_ctx testid_ctx;
-	struct dirent *dirent;
-	DIR *dir = NULL;
+	char **names = NULL;
 	char pathname[FILENAME_MAX - 100];
 	char base[FILENAME_MAX - 100];
-	unsigned int tcount = 0;
+	unsigned int n, num = 0, tcount = 0;
 	int ret;
 
 	CKNULL_C_LOG(ctx, -EINVAL, LOGGER_C_DS_FILE,
@@ -1741,13 +3347,12 @@ static int acvp_datastore_file_find_testsession(const struct definition *def,
 	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
 	       "Read test session directory %s\n", pathname);
 
-	dir = opendir(pathname);
-	CKNULL(dir, -errno);
+	CKINT(io->list(pathname, &names, &num));
 
 	/* Iterate through test session directory and process files */
-	while ((tcount < *testid_count) && (dirent = readdir(dir)) != NULL) {
+	for (n = 0; (tcount < *testid_count) && n < num; n++) {
 		const struct acvp_search_ctx *search = &datastore->search;
-		unsigned long testid = strtoul(dirent->d_name, NULL, 10);
+		unsigned long testid = strtoul(names[n], NULL, 10);
 
 		if (testid >= UINT_MAX) {
 			ret = -errno;
@@ -1785,27 +3390,37 @@ static int acvp_datastore_file_find_testsession(const struct definition *def,
 			}
 		}
 
-		/* Search for vsIDs */
+		/* Search for vsIDs in the catalog of the test session */
 		if (search->nr_submit_vsid) {
-			struct acvp_vsid_ctx vsid_ctx;
+			struct acvp_datastore_catalog catalog;
 			unsigned int i, found = 0;
-			char pathname2[FILENAME_MAX];
-
-			/* Fudge the vsid_ctx */
-			memset(&vsid_ctx, 0, sizeof(vsid_ctx));
-			vsid_ctx.testid_ctx = &testid_ctx;
-
-			for (i = 0; i < search->nr_submit_vsid; i++) {
-				vsid_ctx.vsid = search->submit_vsid[i];
+			char catalogpath[FILENAME_MAX];
+
+			memset(&catalog, 0, sizeof(catalog));
+			ret = acvp_datastore_catalog_path(&testid_ctx,
+							  catalogpath,
+							  sizeof(catalogpath),
+							  true);
+			mutex_lock(&acvp_datastore_catalog_lock);
+			if (!ret)
+				ret = acvp_datastore_catalog_flush(catalogpath);
+			if (!ret) {
+				ret = acvp_datastore_catalog_get(
+					&testid_ctx, &catalog, catalogpath,
+					sizeof(catalogpath));
+			}
+			mutex_unlock(&acvp_datastore_catalog_lock);
 
-				/* If vsID dir exists, function returns 0 */
-				if (!acvp_datastore_file_vectordir_vsid(
-					    &vsid_ctx, pathname2,
-					    sizeof(pathname2), false, false)) {
+			for (i = 0; !ret && i < search->nr_submit_vsid; i++) {
+				if (acvp_datastore_catalog_find(
+					    &catalog, search->submit_vsid[i],
+					    NULL)) {
 					found = 1;
 					break;
 				}
 			}
+			acvp_datastore_catalog_free(&catalog);
+			ret = 0;
 
 			if (!found) {
 				logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
@@ -1841,15 +3456,21 @@ static int acvp_datastore_file_find_testsession(const struct definition *def,
 	*testid_count = tcount;
 
 out:
-	if (dir)
-		closedir(dir);
+	acvp_datastore_list_free(names, num);
 	return ret;
 }
 
+static void acvp_datastore_file_batch(bool begin)
+{
+	if (io->batch)
+		io->batch(begin);
+}
+
 static struct acvp_datastore_be acvp_datastore_file = {
 	&acvp_datastore_file_find_testsession,
 	&acvp_datastore_file_find_responses,
 	&acvp_datastore_file_write_vsid,
+	&acvp_datastore_file_stream_vsid,
 	&acvp_datastore_file_write_testid,
 	&acvp_datastore_file_compare,
 	&acvp_datastore_file_write_authtoken,
@@ -1858,6 +3479,8 @@ static struct acvp_datastore_be acvp_datastore_file = {
 	&acvp_datastore_get_vsid_verdict,
 	&acvp_datastore_file_rename_version,
 	&acvp_datastore_file_rename_name,
+	&acvp_datastore_file_release_testid,
+	&acvp_datastore_file_batch,
 };
 
 ACVP_DEFINE_CONSTRUCTOR(acvp_datastore_init)
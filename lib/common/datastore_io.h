@@ -0,0 +1,173 @@
+/* Datastore backend storing files - storage layer
+ *
+ * Copyright (C) 2018 - 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef DATASTORE_IO_H
+#define DATASTORE_IO_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include "bool.h"
+#include "buffer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Environment variable selecting the storage layer of data store bases which
+ * do not exist yet: the value "log" selects the log storage layer, the value
+ * "uring" selects the io_uring storage layer. A data store base holding a log
+ * file is always accessed with the log storage layer.
+ */
+#define ACVP_DATASTORE_ENV "ACVPPROXY_DATASTORE"
+
+/*
+ * Environment variable requesting the test vectors and expected results
+ * exchanged with the IUT to be stored compressed if it is set to 1. The IUT
+ * must read the compressed files and may provide its responses compressed.
+ */
+#define ACVP_DATASTORE_COMPRESS_ENV "ACVPPROXY_COMPRESS_IUT"
+
+/* Log file holding all files of one data store base */
+#define ACVP_DS_LOGFILE "datastore.log"
+
+struct acvp_vsid_ctx;
+
+/**
+ * @brief File status information of the storage layer
+ *
+ * @var size Size of the file
+ * @var mtime Last modification time of the file
+ * @var dir Entry is a directory
+ * @var regular Entry is a regular file
+ */
+struct acvp_datastore_stat {
+	uint64_t size;
+	time_t mtime;
+	bool dir;
+	bool regular;
+};
+
+/**
+ * @brief Read-only mapping of a file
+ *
+ * @var buf Data of the file
+ * @var addr Start of the mapping which may precede the data
+ * @var len Length of the mapping
+ */
+struct acvp_datastore_map {
+	struct acvp_buf buf;
+	void *addr;
+	size_t len;
+};
+
+/**
+ * @brief Storage layer of the data store backend
+ *
+ * The data store backend defines the directory hierarchy holding the files of
+ * the test sessions and vsIDs. The storage layer implements the access to the
+ * directories and files referenced with path names below a data store base.
+ * All functions return 0 on success or a negative errno value on error.
+ *
+ * @base: Open the data store base directory, create it if createdir is set.
+ *	  A secure base is only accessible by the owner.
+ * @dir: Check that the directory exists, create it if createdir is set.
+ * @stat: Obtain the status information of the file or directory.
+ * @read: Read the file into an allocated NULL-terminated buffer.
+ * @map: Map the file read-only.
+ * @unmap: Release the mapping obtained with map.
+ * @write: Create or replace the file with the data.
+ * @stream: Create or replace the file with the data the stream callback
+ *	    writes to the provided file descriptor. The file only appears under
+ *	    its name once the callback returned successfully.
+ * @batch: Start (begin is set) or end the batch scope of the calling thread:
+ *	   the writes of the thread within the scope may be deferred until the
+ *	   scope ends or the written files are accessed (NULL if the storage
+ *	   layer does not batch writes).
+ * @add_file: Record a regular file which was created outside of the storage
+ *	      layer at the given path name (NULL if the storage layer accesses
+ *	      the regular files directly).
+ * @list: Obtain the names of all entries of a directory except for hidden
+ *	  entries. The array and the names must be released with
+ *	  acvp_datastore_list_free.
+ * @rename: Move a directory or file to the new path name.
+ * @unlink: Remove a file.
+ * @chmod: Change the permissions of a file.
+ */
+struct acvp_datastore_io {
+	int (*base)(char *basedir, bool createdir, bool secure);
+	int (*dir)(char *dirname, bool createdir);
+	int (*stat)(const char *pathname, struct acvp_datastore_stat *st);
+	int (*read)(const char *pathname, uint8_t **buf, size_t *buflen);
+	int (*map)(const char *pathname, struct acvp_datastore_map *map);
+	void (*unmap)(struct acvp_datastore_map *map);
+	int (*write)(const char *pathname, const struct acvp_buf *data);
+	int (*stream)(const char *pathname, bool secure,
+		      int (*stream)(const struct acvp_vsid_ctx *vsid_ctx, int fd,
+				    void *data),
+		      const struct acvp_vsid_ctx *vsid_ctx, void *data);
+	void (*batch)(bool begin);
+	int (*add_file)(const char *pathname);
+	int (*list)(const char *dirname, char ***names, unsigned int *num);
+	int (*rename)(const char *oldpath, const char *newpath);
+	int (*unlink)(const char *pathname);
+	int (*chmod)(const char *pathname, unsigned int mode);
+};
+
+/* Storage layer accessing directories and regular files */
+extern const struct acvp_datastore_io acvp_datastore_io_file;
+
+/*
+ * Storage layer holding all files of a data store base in one append-only
+ * log file together with an in-memory index of the directory hierarchy.
+ */
+extern const struct acvp_datastore_io acvp_datastore_io_log;
+
+/*
+ * Storage layer accessing directories and regular files which submits the
+ * open, the read or write and the close of a file with one io_uring
+ * submission (Linux only). The writes of a batch scope are submitted
+ * together. Writes complete asynchronously, the completion is awaited when
+ * the file is accessed again.
+ */
+extern const struct acvp_datastore_io acvp_datastore_io_uring;
+
+/**
+ * @brief Check whether the data store base is maintained with the log storage
+ *	  layer
+ */
+bool acvp_datastore_log_present(const char *basedir);
+
+/**
+ * @brief Check whether the kernel supports the io_uring storage layer
+ */
+bool acvp_datastore_uring_available(void);
+
+/**
+ * @brief Release the directory listing obtained with the list callback
+ */
+void acvp_datastore_list_free(char **names, unsigned int num);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DATASTORE_IO_H */
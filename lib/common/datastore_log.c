@@ -0,0 +1,1813 @@
+/* Datastore backend storing files - log storage layer
+ *
+ * Copyright (C) 2018 - 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <sys/types.h>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#include "constructor.h"
+#include "datastore_io.h"
+#include "internal.h"
+#include "logger.h"
+#include "mutex.h"
+
+/*
+ * The log file starts with a header holding the magic and the format version
+ * followed by the records. A record consists of the record header, the path
+ * name of the entry relative to the data store base and the payload. The
+ * payload of a file is its content, the payload of a rename is the new path
+ * name. All integers are stored in little endian byte order.
+ *
+ * The record header holds a CRC32 over the record header, the path name and
+ * the payload which is calculated with the CRC field set to zero. The CRC is
+ * written after the payload and the log is synchronized to the storage before
+ * a write is reported as complete.
+ *
+ * The log is only appended to. A record which is only partially written, e.g.
+ * due to a crash, is removed the next time the log is accessed. As records
+ * are only appended after the previous record reached the storage, only the
+ * last record can be incomplete. A damaged record followed by an intact
+ * record is reported as a corrupted log which is left untouched.
+ *
+ * Records superseded by later records are removed by compacting the log into
+ * a new log file which atomically replaces the log file.
+ */
+#define ACVP_DS_LOG_MAGIC "ACVPLOG"
+#define ACVP_DS_LOG_VERSION 2
+#define ACVP_DS_LOG_HDRLEN 16
+#define ACVP_DS_LOG_RECMAGIC 0x52445341
+#define ACVP_DS_LOG_RECLEN 32
+
+enum acvp_ds_log_type {
+	acvp_ds_log_put = 1, /* File with its data in the log */
+	acvp_ds_log_mkdir, /* Directory */
+	acvp_ds_log_extern, /* Regular file outside of the log */
+	acvp_ds_log_delete, /* Removal of a file */
+	acvp_ds_log_rename, /* Move of a file or directory */
+};
+
+/* Entry of the in-memory index of the directory hierarchy */
+struct acvp_ds_log_node {
+	char *name;
+	struct acvp_ds_log_node **children; /* sorted by name */
+	unsigned int nchildren;
+	unsigned int size;
+	enum acvp_ds_log_type type;
+	uint64_t offset; /* Offset of the file data in the log */
+	uint64_t len;
+	uint64_t reclen; /* Length of the record creating the entry */
+	time_t mtime;
+};
+
+/* One data store base held in a log */
+struct acvp_ds_log {
+	struct acvp_ds_log *next;
+	char *basedir;
+	size_t basedirlen;
+	int fd;
+	dev_t dev; /* Identity of the log file */
+	ino_t ino;
+	int *retired; /* Descriptors of log files replaced by a compaction */
+	unsigned int nretired;
+	uint64_t end; /* End of the last record applied to the index */
+	uint64_t live; /* Length of the records the index refers to */
+	mutex_t lock; /* Protects the index and the appending of records */
+	struct acvp_ds_log_node root;
+};
+
+static struct acvp_ds_log *acvp_ds_logs = NULL;
+static DEFINE_MUTEX_UNLOCKED(acvp_ds_logs_lock);
+
+static void acvp_ds_log_put32(uint8_t *p, uint32_t val)
+{
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		p[i] = (uint8_t)(val >> (8 * i));
+}
+
+static void acvp_ds_log_put64(uint8_t *p, uint64_t val)
+{
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+		p[i] = (uint8_t)(val >> (8 * i));
+}
+
+static uint32_t acvp_ds_log_get32(const uint8_t *p)
+{
+	uint32_t val = 0;
+	unsigned int i;
+
+	for (i = 0; i < 4; i++)
+		val |= (uint32_t)p[i] << (8 * i);
+	return val;
+}
+
+static uint64_t acvp_ds_log_get64(const uint8_t *p)
+{
+	uint64_t val = 0;
+	unsigned int i;
+
+	for (i = 0; i < 8; i++)
+		val |= (uint64_t)p[i] << (8 * i);
+	return val;
+}
+
+static time_t acvp_ds_log_mtime(const struct stat *statbuf)
+{
+#ifdef __APPLE__
+	return statbuf->st_mtimespec.tv_sec;
+#else
+	return statbuf->st_mtim.tv_sec;
+#endif
+}
+
+/************************************************************************
+ * In-memory index
+ ************************************************************************/
+
+static void acvp_ds_log_node_clear(struct acvp_ds_log_node *node)
+{
+	unsigned int i;
+
+	for (i = 0; i < node->nchildren; i++) {
+		acvp_ds_log_node_clear(node->children[i]);
+		free(node->children[i]);
+	}
+	free(node->children);
+	free(node->name);
+	node->children = NULL;
+	node->nchildren = 0;
+	node->size = 0;
+	node->name = NULL;
+}
+
+static void acvp_ds_log_node_free(struct acvp_ds_log_node *node)
+{
+	acvp_ds_log_node_clear(node);
+	free(node);
+}
+
+static struct acvp_ds_log_node *
+acvp_ds_log_node_new(const char *name, size_t namelen,
+		     enum acvp_ds_log_type type)
+{
+	struct acvp_ds_log_node *node = calloc(1, sizeof(*node));
+
+	if (!node)
+		return NULL;
+
+	node->name = malloc(namelen + 1);
+	if (!node->name) {
+		free(node);
+		return NULL;
+	}
+	memcpy(node->name, name, namelen);
+	node->name[namelen] = '\0';
+	node->type = type;
+
+	return node;
+}
+
+/*
+ * Binary search for the child with the given name. If the child does not
+ * exist, pos receives the position where it is to be inserted.
+ */
+static struct acvp_ds_log_node *
+acvp_ds_log_child(const struct acvp_ds_log_node *node, const char *name,
+		  size_t namelen, unsigned int *pos)
+{
+	unsigned int lo = 0, hi = node->nchildren, mid;
+	int cmp;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		cmp = strncmp(node->children[mid]->name, name, namelen);
+		if (!cmp && node->children[mid]->name[namelen])
+			cmp = 1;
+
+		if (!cmp) {
+			if (pos)
+				*pos = mid;
+			return node->children[mid];
+		}
+
+		if (cmp < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	if (pos)
+		*pos = lo;
+	return NULL;
+}
+
+/* Ensure that one more child can be inserted without allocation */
+static int acvp_ds_log_reserve(struct acvp_ds_log_node *node)
+{
+	struct acvp_ds_log_node **tmp;
+	unsigned int size;
+
+	if (node->nchildren < node->size)
+		return 0;
+
+	size = node->size ? node->size * 2 : 8;
+	tmp = realloc(node->children, size * sizeof(*tmp));
+	if (!tmp)
+		return -ENOMEM;
+	node->children = tmp;
+	node->size = size;
+
+	return 0;
+}
+
+static void acvp_ds_log_insert(struct acvp_ds_log_node *node,
+			       struct acvp_ds_log_node *child, unsigned int pos)
+{
+	memmove(&node->children[pos + 1], &node->children[pos],
+		(node->nchildren - pos) * sizeof(*node->children));
+	node->children[pos] = child;
+	node->nchildren++;
+}
+
+static void acvp_ds_log_remove(struct acvp_ds_log_node *node, unsigned int pos)
+{
+	node->nchildren--;
+	memmove(&node->children[pos], &node->children[pos + 1],
+		(node->nchildren - pos) * sizeof(*node->children));
+}
+
+/*
+ * Walk to the parent directory of the entry referenced by the key and return
+ * the name of the entry. Missing directories are created if requested.
+ */
+static int acvp_ds_log_parent(struct acvp_ds_log_node *root, const char *key,
+			      bool create, struct acvp_ds_log_node **parent,
+			      const char **name, size_t *namelen)
+{
+	struct acvp_ds_log_node *node = root, *child;
+	const char *slash;
+	unsigned int pos;
+
+	while ((slash = strchr(key, '/')) != NULL) {
+		child = acvp_ds_log_child(node, key, (size_t)(slash - key),
+					  &pos);
+		if (!child) {
+			if (!create)
+				return -ENOENT;
+
+			if (acvp_ds_log_reserve(node))
+				return -ENOMEM;
+			child = acvp_ds_log_node_new(key, (size_t)(slash - key),
+						     acvp_ds_log_mkdir);
+			if (!child)
+				return -ENOMEM;
+			acvp_ds_log_insert(node, child, pos);
+		} else if (child->type != acvp_ds_log_mkdir) {
+			return -ENOTDIR;
+		}
+
+		node = child;
+		key = slash + 1;
+	}
+
+	*parent = node;
+	*name = key;
+	*namelen = strlen(key);
+
+	return 0;
+}
+
+static struct acvp_ds_log_node *acvp_ds_log_lookup(struct acvp_ds_log *log,
+						   const char *key)
+{
+	struct acvp_ds_log_node *parent;
+	const char *name;
+	size_t namelen;
+
+	if (!*key)
+		return &log->root;
+
+	if (acvp_ds_log_parent(&log->root, key, false, &parent, &name,
+			       &namelen))
+		return NULL;
+
+	return acvp_ds_log_child(parent, name, namelen, NULL);
+}
+
+static int acvp_ds_log_apply_rename(struct acvp_ds_log *log,
+				    struct acvp_ds_log_node *parent,
+				    const char *key, const char *newkey,
+				    time_t mtime)
+{
+	struct acvp_ds_log_node *node, *newparent, *target;
+	const char *name, *newname;
+	size_t keylen = strlen(key), namelen, newnamelen;
+	unsigned int pos, newpos;
+	char *tmp;
+	int ret;
+
+	name = strrchr(key, '/');
+	name = name ? name + 1 : key;
+	namelen = strlen(name);
+
+	node = acvp_ds_log_child(parent, name, namelen, NULL);
+	if (!node)
+		return -ENOENT;
+	if (!*newkey)
+		return -EINVAL;
+	if (!strcmp(key, newkey))
+		return 0;
+
+	/* A directory cannot be moved below itself */
+	if (!strncmp(newkey, key, keylen) && newkey[keylen] == '/')
+		return -EINVAL;
+
+	CKINT(acvp_ds_log_parent(&log->root, newkey, true, &newparent,
+				 &newname, &newnamelen));
+	CKINT(acvp_ds_log_reserve(newparent));
+
+	/* An existing target is replaced following the rename(2) semantics */
+	target = acvp_ds_log_child(newparent, newname, newnamelen, &newpos);
+	if (target) {
+		if (target->type == acvp_ds_log_mkdir) {
+			if (node->type != acvp_ds_log_mkdir)
+				return -EISDIR;
+			if (target->nchildren)
+				return -ENOTEMPTY;
+		} else if (node->type == acvp_ds_log_mkdir) {
+			return -ENOTDIR;
+		}
+	}
+
+	tmp = malloc(newnamelen + 1);
+	CKNULL(tmp, -ENOMEM);
+	memcpy(tmp, newname, newnamelen);
+	tmp[newnamelen] = '\0';
+
+	if (target) {
+		acvp_ds_log_remove(newparent, newpos);
+		log->live -= target->reclen;
+		acvp_ds_log_node_free(target);
+	}
+
+	/* Removing the target may have moved the entry */
+	acvp_ds_log_child(parent, name, namelen, &pos);
+	acvp_ds_log_remove(parent, pos);
+
+	free(node->name);
+	node->name = tmp;
+
+	acvp_ds_log_child(newparent, newname, newnamelen, &newpos);
+	acvp_ds_log_insert(newparent, node, newpos);
+
+	parent->mtime = mtime;
+	newparent->mtime = mtime;
+
+out:
+	return ret;
+}
+
+/*
+ * Apply a record to the index. The offset and the length refer to the data
+ * of the record, the record length covers the complete record.
+ */
+static int acvp_ds_log_apply(struct acvp_ds_log *log,
+			     enum acvp_ds_log_type type, const char *key,
+			     const char *newkey, uint64_t offset, uint64_t len,
+			     uint64_t reclen, time_t mtime)
+{
+	struct acvp_ds_log_node *parent, *node;
+	const char *name;
+	size_t namelen;
+	unsigned int pos;
+	bool create = (type != acvp_ds_log_delete &&
+		       type != acvp_ds_log_rename);
+	int ret;
+
+	/* The data store base itself is always present */
+	if (!*key)
+		return (type == acvp_ds_log_mkdir) ? 0 : -EINVAL;
+
+	CKINT(acvp_ds_log_parent(&log->root, key, create, &parent, &name,
+				 &namelen));
+
+	if (type == acvp_ds_log_rename)
+		return acvp_ds_log_apply_rename(log, parent, key, newkey,
+						mtime);
+
+	node = acvp_ds_log_child(parent, name, namelen, &pos);
+
+	if (type == acvp_ds_log_delete) {
+		if (!node)
+			return -ENOENT;
+		if (node->type == acvp_ds_log_mkdir)
+			return -EISDIR;
+
+		acvp_ds_log_remove(parent, pos);
+		log->live -= node->reclen;
+		acvp_ds_log_node_free(node);
+		parent->mtime = mtime;
+		return 0;
+	}
+
+	if (node) {
+		/*
+		 * A directory created before its entries carries the time
+		 * stamp of the record, e.g. when written by a compaction.
+		 */
+		if (type == acvp_ds_log_mkdir) {
+			if (node->type != acvp_ds_log_mkdir)
+				return -EEXIST;
+			log->live -= node->reclen;
+			log->live += reclen;
+			node->reclen = reclen;
+			node->mtime = mtime;
+			return 0;
+		}
+		if (node->type == acvp_ds_log_mkdir)
+			return -EISDIR;
+		log->live -= node->reclen;
+	} else {
+		CKINT(acvp_ds_log_reserve(parent));
+		node = acvp_ds_log_node_new(name, namelen, type);
+		CKNULL(node, -ENOMEM);
+		acvp_ds_log_insert(parent, node, pos);
+
+		/* Like a directory, the parent is modified by a new entry */
+		parent->mtime = mtime;
+	}
+
+	node->type = type;
+	node->offset = offset;
+	node->len = len;
+	node->reclen = reclen;
+	node->mtime = mtime;
+	log->live += reclen;
+
+out:
+	return ret;
+}
+
+/************************************************************************
+ * Log file
+ ************************************************************************/
+
+static int acvp_ds_log_pwrite(int fd, const uint8_t *buf, size_t len,
+			      uint64_t off)
+{
+	ssize_t written;
+
+	while (len) {
+		written = pwrite(fd, buf, len, (off_t)off);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+
+		buf += written;
+		len -= (size_t)written;
+		off += (uint64_t)written;
+	}
+
+	return 0;
+}
+
+static int acvp_ds_log_pread(int fd, uint8_t *buf, size_t len, uint64_t off)
+{
+	ssize_t rd;
+
+	while (len) {
+		rd = pread(fd, buf, len, (off_t)off);
+		if (rd < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		if (!rd)
+			return -EIO;
+
+		buf += rd;
+		len -= (size_t)rd;
+		off += (uint64_t)rd;
+	}
+
+	return 0;
+}
+
+static uint32_t acvp_ds_log_crc(uint32_t crc, const uint8_t *buf, uint64_t len)
+{
+	uInt todo;
+
+	while (len) {
+		todo = (len > (1U << 30)) ? (1U << 30) : (uInt)len;
+		crc = (uint32_t)crc32(crc, buf, todo);
+		buf += todo;
+		len -= todo;
+	}
+
+	return crc;
+}
+
+/* Copy the data of a file into the log and update the CRC of the record */
+static int acvp_ds_log_copy(int fd, uint64_t off, int srcfd, uint64_t len,
+			    uint32_t *crc)
+{
+	uint8_t buf[16384];
+	uint64_t srcoff = 0;
+	size_t todo;
+	int ret = 0;
+
+	while (len) {
+		todo = (len > sizeof(buf)) ? sizeof(buf) : (size_t)len;
+
+		CKINT(acvp_ds_log_pread(srcfd, buf, todo, srcoff));
+		CKINT(acvp_ds_log_pwrite(fd, buf, todo, off));
+		*crc = acvp_ds_log_crc(*crc, buf, todo);
+
+		srcoff += todo;
+		off += todo;
+		len -= todo;
+	}
+
+out:
+	return ret;
+}
+
+/* Serialize the access to the log file among all processes */
+static int acvp_ds_log_flock(int fd, short type)
+{
+	struct flock fl;
+
+	memset(&fl, 0, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+
+	while (fcntl(fd, F_SETLKW, &fl) < 0) {
+		if (errno != EINTR)
+			return -errno;
+	}
+
+	return 0;
+}
+
+/*
+ * Check the record at the start of the given log data. The length of the
+ * record is returned if it is complete and intact, 0 otherwise.
+ */
+static uint64_t acvp_ds_log_record(const uint8_t *rec, uint64_t avail)
+{
+	uint8_t hdr[ACVP_DS_LOG_RECLEN];
+	uint64_t datalen;
+	uint32_t type, keylen, crc;
+
+	if (avail < ACVP_DS_LOG_RECLEN)
+		return 0;
+
+	type = acvp_ds_log_get32(rec + 4);
+	keylen = acvp_ds_log_get32(rec + 8);
+	datalen = acvp_ds_log_get64(rec + 16);
+
+	if (acvp_ds_log_get32(rec) != ACVP_DS_LOG_RECMAGIC ||
+	    type < acvp_ds_log_put || type > acvp_ds_log_rename ||
+	    keylen >= FILENAME_MAX || keylen > avail - ACVP_DS_LOG_RECLEN ||
+	    datalen > avail - ACVP_DS_LOG_RECLEN - keylen)
+		return 0;
+	if (type == acvp_ds_log_rename && datalen >= FILENAME_MAX)
+		return 0;
+
+	memcpy(hdr, rec, sizeof(hdr));
+	acvp_ds_log_put32(hdr + 12, 0);
+	crc = acvp_ds_log_crc(0, hdr, sizeof(hdr));
+	crc = acvp_ds_log_crc(crc, rec + ACVP_DS_LOG_RECLEN, keylen + datalen);
+	if (crc != acvp_ds_log_get32(rec + 12))
+		return 0;
+
+	return ACVP_DS_LOG_RECLEN + keylen + datalen;
+}
+
+/* Check whether an intact record follows a damaged record */
+static bool acvp_ds_log_intact_follows(const uint8_t *rec, uint64_t avail)
+{
+	uint64_t i;
+
+	for (i = 1; i + ACVP_DS_LOG_RECLEN <= avail; i++) {
+		if (acvp_ds_log_get32(rec + i) == ACVP_DS_LOG_RECMAGIC &&
+		    acvp_ds_log_record(rec + i, avail - i))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Apply the records between the end of the processed log and the given size
+ * to the index. Parsing stops at an incomplete record at the end of the log.
+ */
+static int acvp_ds_log_replay(struct acvp_ds_log *log, uint64_t size)
+{
+	uint64_t pagemask = (uint64_t)sysconf(_SC_PAGESIZE) - 1;
+	uint64_t start = log->end & ~pagemask, off = log->end;
+	uint64_t datalen, reclen;
+	uint32_t type, keylen;
+	size_t maplen;
+	const uint8_t *rec;
+	uint8_t *addr;
+	char key[FILENAME_MAX], newkey[FILENAME_MAX];
+	int ret = 0;
+
+	if (size - start > SIZE_MAX)
+		return -EFBIG;
+	maplen = (size_t)(size - start);
+
+	addr = mmap(NULL, maplen, PROT_READ, MAP_SHARED, log->fd,
+		    (off_t)start);
+	if (addr == MAP_FAILED)
+		return -errno;
+
+	while (off < size) {
+		rec = addr + (off - start);
+		reclen = acvp_ds_log_record(rec, size - off);
+		if (!reclen) {
+			if (!acvp_ds_log_intact_follows(rec, size - off))
+				break;
+
+			logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+			       "Data store log %s/%s is corrupted at offset %llu\n",
+			       log->basedir, ACVP_DS_LOGFILE,
+			       (unsigned long long)off);
+			ret = -EIO;
+			goto out;
+		}
+
+		type = acvp_ds_log_get32(rec + 4);
+		keylen = acvp_ds_log_get32(rec + 8);
+		datalen = acvp_ds_log_get64(rec + 16);
+
+		memcpy(key, rec + ACVP_DS_LOG_RECLEN, keylen);
+		key[keylen] = '\0';
+
+		newkey[0] = '\0';
+		if (type == acvp_ds_log_rename) {
+			memcpy(newkey, rec + ACVP_DS_LOG_RECLEN + keylen,
+			       (size_t)datalen);
+			newkey[datalen] = '\0';
+		}
+
+		/* Records rejected by the index are never written */
+		ret = acvp_ds_log_apply(log, (enum acvp_ds_log_type)type, key,
+					newkey,
+					off + ACVP_DS_LOG_RECLEN + keylen,
+					datalen, reclen,
+					(time_t)acvp_ds_log_get64(rec + 24));
+		if (ret == -ENOMEM)
+			goto out;
+		ret = 0;
+
+		off += reclen;
+	}
+
+	log->end = off;
+
+out:
+	munmap(addr, maplen);
+	return ret;
+}
+
+/* Catch up with the records written by other processes, the locks are held */
+static int acvp_ds_log_sync(struct acvp_ds_log *log)
+{
+	struct stat statbuf;
+	uint64_t size;
+	int ret;
+
+	if (fstat(log->fd, &statbuf))
+		return -errno;
+
+	size = (uint64_t)statbuf.st_size;
+	if (size == log->end)
+		return 0;
+
+	if (size < log->end) {
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Data store log %s/%s was truncated\n", log->basedir,
+		       ACVP_DS_LOGFILE);
+		return -EIO;
+	}
+
+	CKINT(acvp_ds_log_replay(log, size));
+
+	if (log->end < size) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Removing incomplete record from data store log %s/%s\n",
+		       log->basedir, ACVP_DS_LOGFILE);
+		if (ftruncate(log->fd, (off_t)log->end))
+			return -errno;
+	}
+
+out:
+	return ret;
+}
+
+/* Reserve the space to retain the descriptor of a replaced log file */
+static int acvp_ds_log_reserve_retired(struct acvp_ds_log *log)
+{
+	int *tmp;
+
+	tmp = realloc(log->retired, (log->nretired + 1) * sizeof(*tmp));
+	if (!tmp)
+		return -ENOMEM;
+	log->retired = tmp;
+
+	return 0;
+}
+
+/*
+ * Switch to the log file which replaced the current log file, the log lock is
+ * held. The descriptor of the replaced log file remains open as reads may
+ * still access it. The index is built again from the new log file.
+ */
+static int acvp_ds_log_reopen(struct acvp_ds_log *log, const char *pathname)
+{
+	struct stat statbuf;
+	int ret, fd;
+
+	CKINT(acvp_ds_log_reserve_retired(log));
+
+	fd = open(pathname, O_RDWR | O_CLOEXEC);
+	if (fd < 0)
+		return -errno;
+	if (fstat(fd, &statbuf)) {
+		ret = -errno;
+		close(fd);
+		return ret;
+	}
+
+	logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
+	       "Data store log %s was replaced\n", pathname);
+
+	log->retired[log->nretired++] = log->fd;
+	log->fd = fd;
+	log->dev = statbuf.st_dev;
+	log->ino = statbuf.st_ino;
+	log->end = ACVP_DS_LOG_HDRLEN;
+	log->live = 0;
+	acvp_ds_log_node_clear(&log->root);
+
+out:
+	return ret;
+}
+
+/*
+ * Lock the log file against other processes, the log lock is held. If the log
+ * file was replaced by the compaction of another process, the new log file is
+ * used.
+ */
+static int acvp_ds_log_lock(struct acvp_ds_log *log)
+{
+	struct stat statbuf;
+	char pathname[FILENAME_MAX];
+	int ret;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", log->basedir,
+		 ACVP_DS_LOGFILE);
+
+	for (;;) {
+		CKINT(acvp_ds_log_flock(log->fd, F_WRLCK));
+
+		if (stat(pathname, &statbuf)) {
+			ret = -errno;
+			acvp_ds_log_flock(log->fd, F_UNLCK);
+			goto out;
+		}
+		if (statbuf.st_dev == log->dev && statbuf.st_ino == log->ino)
+			break;
+
+		acvp_ds_log_flock(log->fd, F_UNLCK);
+		CKINT(acvp_ds_log_reopen(log, pathname));
+	}
+
+out:
+	return ret;
+}
+
+/* Pick up records written by other processes */
+static int acvp_ds_log_refresh(struct acvp_ds_log *log)
+{
+	struct stat statbuf;
+	char pathname[FILENAME_MAX];
+	int ret;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", log->basedir,
+		 ACVP_DS_LOGFILE);
+	if (stat(pathname, &statbuf))
+		return -errno;
+
+	mutex_reader_lock(&log->lock);
+	ret = ((uint64_t)statbuf.st_size == log->end &&
+	       statbuf.st_dev == log->dev && statbuf.st_ino == log->ino);
+	mutex_reader_unlock(&log->lock);
+	if (ret)
+		return 0;
+
+	mutex_lock(&log->lock);
+	ret = acvp_ds_log_lock(log);
+	if (!ret) {
+		ret = acvp_ds_log_sync(log);
+		acvp_ds_log_flock(log->fd, F_UNLCK);
+	}
+	mutex_unlock(&log->lock);
+
+	return ret;
+}
+
+/*
+ * Append a record and apply it to the index, the locks are held. The data is
+ * either provided with a buffer or with a file descriptor. A durable record
+ * reached the storage when the function returns.
+ */
+static int acvp_ds_log_append_locked(struct acvp_ds_log *log,
+				     enum acvp_ds_log_type type,
+				     const char *key, const char *newkey,
+				     const uint8_t *data, uint64_t datalen,
+				     int srcfd, time_t mtime, bool durable)
+{
+	uint8_t hdr[ACVP_DS_LOG_RECLEN + FILENAME_MAX];
+	size_t keylen = strlen(key);
+	uint64_t off = log->end;
+	uint32_t crc;
+	int ret;
+
+	if (keylen >= FILENAME_MAX)
+		return -ENAMETOOLONG;
+
+	if (type == acvp_ds_log_rename) {
+		data = (const uint8_t *)newkey;
+		datalen = strlen(newkey);
+	}
+
+	memset(hdr, 0, ACVP_DS_LOG_RECLEN);
+	acvp_ds_log_put32(hdr, ACVP_DS_LOG_RECMAGIC);
+	acvp_ds_log_put32(hdr + 4, (uint32_t)type);
+	acvp_ds_log_put32(hdr + 8, (uint32_t)keylen);
+	acvp_ds_log_put64(hdr + 16, datalen);
+	acvp_ds_log_put64(hdr + 24, (uint64_t)mtime);
+	memcpy(hdr + ACVP_DS_LOG_RECLEN, key, keylen);
+	crc = acvp_ds_log_crc(0, hdr, ACVP_DS_LOG_RECLEN + keylen);
+
+	CKINT(acvp_ds_log_pwrite(log->fd, hdr, ACVP_DS_LOG_RECLEN + keylen,
+				 off));
+	off += ACVP_DS_LOG_RECLEN + keylen;
+
+	if (srcfd >= 0) {
+		CKINT(acvp_ds_log_copy(log->fd, off, srcfd, datalen, &crc));
+	} else if (datalen) {
+		CKINT(acvp_ds_log_pwrite(log->fd, data, (size_t)datalen, off));
+		crc = acvp_ds_log_crc(crc, data, datalen);
+	}
+
+	/* The record is only valid once the CRC is written */
+	acvp_ds_log_put32(hdr + 12, crc);
+	CKINT(acvp_ds_log_pwrite(log->fd, hdr + 12, 4, log->end + 12));
+
+	if (durable && fdatasync(log->fd)) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Cannot synchronize data store log %s/%s (%d)\n",
+		       log->basedir, ACVP_DS_LOGFILE, ret);
+		goto out;
+	}
+
+	CKINT(acvp_ds_log_apply(log, type, key, newkey ? newkey : "", off,
+				datalen, off + datalen - log->end, mtime));
+
+	log->end = off + datalen;
+
+out:
+	/* Drop the record if it could not be written or was rejected */
+	if (ret && ftruncate(log->fd, (off_t)log->end))
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot remove record from data store log %s/%s\n",
+		       log->basedir, ACVP_DS_LOGFILE);
+	return ret;
+}
+
+/************************************************************************
+ * Compaction
+ ************************************************************************/
+
+/*
+ * The log is compacted once the records which are no longer referenced by the
+ * index, e.g. overwritten or deleted files, exceed the referenced records and
+ * the given minimum.
+ */
+#define ACVP_DS_LOG_COMPACT_MIN (1 << 20)
+
+static bool acvp_ds_log_compact_due(const struct acvp_ds_log *log)
+{
+	uint64_t dead;
+
+	if (log->end - ACVP_DS_LOG_HDRLEN <= log->live)
+		return false;
+
+	dead = log->end - ACVP_DS_LOG_HDRLEN - log->live;
+	return (dead >= ACVP_DS_LOG_COMPACT_MIN && dead > log->live);
+}
+
+/*
+ * Write the entries below the directory to the compacted log. Directories are
+ * written after their entries to retain their time stamp.
+ */
+static int acvp_ds_log_compact_dir(struct acvp_ds_log *compacted,
+				   const struct acvp_ds_log_node *dir,
+				   char *key, size_t keylen,
+				   const uint8_t *addr)
+{
+	const struct acvp_ds_log_node *node;
+	size_t namelen, sublen = keylen ? keylen + 1 : 0;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < dir->nchildren; i++) {
+		node = dir->children[i];
+		namelen = strlen(node->name);
+		if (sublen + namelen >= FILENAME_MAX)
+			return -ENAMETOOLONG;
+
+		if (keylen)
+			key[keylen] = '/';
+		memcpy(key + sublen, node->name, namelen + 1);
+
+		if (node->type == acvp_ds_log_mkdir) {
+			CKINT(acvp_ds_log_compact_dir(compacted, node, key,
+						      sublen + namelen, addr));
+		}
+
+		CKINT(acvp_ds_log_append_locked(
+			compacted, node->type, key, NULL,
+			(node->type == acvp_ds_log_put) ? addr + node->offset :
+							  NULL,
+			(node->type == acvp_ds_log_put) ? node->len : 0, -1,
+			node->mtime, false));
+
+		key[keylen] = '\0';
+	}
+
+out:
+	return ret;
+}
+
+/*
+ * Replace the log file with a log file only holding the records referenced by
+ * the index, the locks are held. The new log file is locked when it replaces
+ * the log file. Other processes notice the replacement when locking the log
+ * file.
+ */
+static int acvp_ds_log_compact(struct acvp_ds_log *log)
+{
+	struct acvp_ds_log compacted;
+	struct stat statbuf;
+	uint64_t oldend = log->end;
+	uint8_t hdr[ACVP_DS_LOG_HDRLEN];
+	uint8_t *addr = MAP_FAILED;
+	char pathname[FILENAME_MAX], tmpname[FILENAME_MAX], key[FILENAME_MAX];
+	int ret, dirfd;
+
+	memset(&compacted, 0, sizeof(compacted));
+	compacted.basedir = log->basedir;
+	compacted.end = ACVP_DS_LOG_HDRLEN;
+	compacted.root.type = acvp_ds_log_mkdir;
+
+	if (oldend > SIZE_MAX)
+		return -EFBIG;
+	if (fstat(log->fd, &statbuf))
+		return -errno;
+	ret = acvp_ds_log_reserve_retired(log);
+	if (ret)
+		return ret;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", log->basedir,
+		 ACVP_DS_LOGFILE);
+	snprintf(tmpname, sizeof(tmpname), "%s/.%s.XXXXXX", log->basedir,
+		 ACVP_DS_LOGFILE);
+
+	compacted.fd = mkstemp(tmpname);
+	if (compacted.fd < 0) {
+		ret = -errno;
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot create temporary file for compacting %s (%d)\n",
+		       pathname, ret);
+		return ret;
+	}
+
+	if (fcntl(compacted.fd, F_SETFD, FD_CLOEXEC) ||
+	    fchmod(compacted.fd, statbuf.st_mode & 0777)) {
+		ret = -errno;
+		goto out;
+	}
+
+	addr = mmap(NULL, (size_t)oldend, PROT_READ, MAP_SHARED, log->fd, 0);
+	if (addr == MAP_FAILED) {
+		ret = -errno;
+		goto out;
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, ACVP_DS_LOG_MAGIC, sizeof(ACVP_DS_LOG_MAGIC));
+	acvp_ds_log_put32(hdr + 8, ACVP_DS_LOG_VERSION);
+	CKINT(acvp_ds_log_pwrite(compacted.fd, hdr, sizeof(hdr), 0));
+
+	key[0] = '\0';
+	CKINT(acvp_ds_log_compact_dir(&compacted, &log->root, key, 0, addr));
+
+	if (fdatasync(compacted.fd) || fstat(compacted.fd, &statbuf)) {
+		ret = -errno;
+		goto out;
+	}
+
+	CKINT(acvp_ds_log_flock(compacted.fd, F_WRLCK));
+	if (rename(tmpname, pathname)) {
+		ret = -errno;
+		goto out;
+	}
+	tmpname[0] = '\0';
+
+	/* The replacement must persist before records are appended to it */
+	dirfd = open(log->basedir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (dirfd < 0 || fsync(dirfd)) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot synchronize directory %s\n", log->basedir);
+	}
+	if (dirfd >= 0)
+		close(dirfd);
+
+	logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+	       "Data store log %s compacted from %llu to %llu bytes\n",
+	       pathname, (unsigned long long)oldend,
+	       (unsigned long long)compacted.end);
+
+	acvp_ds_log_flock(log->fd, F_UNLCK);
+	log->retired[log->nretired++] = log->fd;
+	acvp_ds_log_node_clear(&log->root);
+
+	log->fd = compacted.fd;
+	log->dev = statbuf.st_dev;
+	log->ino = statbuf.st_ino;
+	log->end = compacted.end;
+	log->live = compacted.live;
+	log->root = compacted.root;
+	compacted.fd = -1;
+	memset(&compacted.root, 0, sizeof(compacted.root));
+
+out:
+	if (addr != MAP_FAILED)
+		munmap(addr, (size_t)oldend);
+	if (tmpname[0])
+		unlink(tmpname);
+	if (compacted.fd >= 0)
+		close(compacted.fd);
+	acvp_ds_log_node_clear(&compacted.root);
+	return ret;
+}
+
+static int acvp_ds_log_append(struct acvp_ds_log *log,
+			      enum acvp_ds_log_type type, const char *key,
+			      const char *newkey, const uint8_t *data,
+			      uint64_t datalen, int srcfd)
+{
+	int ret;
+
+	mutex_lock(&log->lock);
+	ret = acvp_ds_log_lock(log);
+	if (!ret) {
+		ret = acvp_ds_log_sync(log);
+		if (!ret)
+			ret = acvp_ds_log_append_locked(log, type, key, newkey,
+							data, datalen, srcfd,
+							time(NULL), true);
+
+		/* A failed compaction leaves the log file as it is */
+		if (!ret && acvp_ds_log_compact_due(log) &&
+		    acvp_ds_log_compact(log)) {
+			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+			       "Cannot compact data store log %s/%s\n",
+			       log->basedir, ACVP_DS_LOGFILE);
+		}
+
+		acvp_ds_log_flock(log->fd, F_UNLCK);
+	}
+	mutex_unlock(&log->lock);
+
+	return ret;
+}
+
+/* Files exchanged with the IUT remain regular files */
+static bool acvp_ds_log_iut_file(const char *name)
+{
+	return (!strcmp(name, ACVP_DS_TESTREQUEST) ||
+		!strcmp(name, ACVP_DS_TESTRESPONSE) ||
+		!strcmp(name, ACVP_DS_EXPECTED));
+}
+
+/* Record the directories and files of an existing data store base */
+static int acvp_ds_log_import(struct acvp_ds_log *log, const char *dirname,
+			      const char *key)
+{
+	struct dirent *dirent;
+	struct stat statbuf;
+	DIR *dir;
+	char pathname[FILENAME_MAX], subkey[FILENAME_MAX];
+	int ret = 0, fd;
+
+	dir = opendir(dirname);
+	CKNULL_C_LOG(dir, -errno, LOGGER_C_DS_FILE,
+		     "Cannot open directory %s\n", dirname);
+
+	while ((dirent = readdir(dir)) != NULL) {
+		if (!strncmp(dirent->d_name, ".", 1))
+			continue;
+		if (!*key && !strcmp(dirent->d_name, ACVP_DS_LOGFILE))
+			continue;
+
+		snprintf(pathname, sizeof(pathname), "%s/%s", dirname,
+			 dirent->d_name);
+		snprintf(subkey, sizeof(subkey), "%s%s%s", key, *key ? "/" : "",
+			 dirent->d_name);
+
+		if (lstat(pathname, &statbuf)) {
+			ret = -errno;
+			goto out;
+		}
+
+		if (S_ISDIR(statbuf.st_mode)) {
+			CKINT(acvp_ds_log_append_locked(
+				log, acvp_ds_log_mkdir, subkey, NULL, NULL, 0,
+				-1, acvp_ds_log_mtime(&statbuf), false));
+			CKINT(acvp_ds_log_import(log, pathname, subkey));
+		} else if (!S_ISREG(statbuf.st_mode)) {
+			continue;
+		} else if (acvp_ds_log_iut_file(dirent->d_name)) {
+			CKINT(acvp_ds_log_append_locked(
+				log, acvp_ds_log_extern, subkey, NULL, NULL, 0,
+				-1, acvp_ds_log_mtime(&statbuf), false));
+		} else {
+			fd = open(pathname, O_RDONLY | O_CLOEXEC);
+			if (fd < 0) {
+				ret = -errno;
+				goto out;
+			}
+			ret = acvp_ds_log_append_locked(
+				log, acvp_ds_log_put, subkey, NULL, NULL,
+				(uint64_t)statbuf.st_size, fd,
+				acvp_ds_log_mtime(&statbuf), false);
+			close(fd);
+			if (ret)
+				goto out;
+		}
+	}
+
+out:
+	if (dir)
+		closedir(dir);
+	return ret;
+}
+
+/* Open the log of the data store base, the log is created if necessary */
+static int acvp_ds_log_open(struct acvp_ds_log *log, bool secure)
+{
+	struct stat statbuf;
+	uint8_t hdr[ACVP_DS_LOG_HDRLEN];
+	char pathname[FILENAME_MAX];
+	int ret;
+	bool locked = false;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", log->basedir,
+		 ACVP_DS_LOGFILE);
+
+	log->fd = open(pathname, O_RDWR | O_CREAT | O_CLOEXEC,
+		       secure ? S_IRUSR | S_IWUSR :
+				      S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP |
+					      S_IROTH | S_IWOTH);
+	if (log->fd < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Cannot open data store log %s (%d)\n", pathname, ret);
+		return ret;
+	}
+
+	if (fstat(log->fd, &statbuf))
+		return -errno;
+	log->dev = statbuf.st_dev;
+	log->ino = statbuf.st_ino;
+
+	CKINT(acvp_ds_log_lock(log));
+	locked = true;
+
+	if (fstat(log->fd, &statbuf)) {
+		ret = -errno;
+		goto out;
+	}
+
+	log->end = ACVP_DS_LOG_HDRLEN;
+
+	if (statbuf.st_size) {
+		if (statbuf.st_size < ACVP_DS_LOG_HDRLEN ||
+		    acvp_ds_log_pread(log->fd, hdr, sizeof(hdr), 0) ||
+		    memcmp(hdr, ACVP_DS_LOG_MAGIC, sizeof(ACVP_DS_LOG_MAGIC)) ||
+		    acvp_ds_log_get32(hdr + 8) != ACVP_DS_LOG_VERSION) {
+			logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+			       "File %s is no data store log of version %u\n",
+			       pathname, ACVP_DS_LOG_VERSION);
+			ret = -EINVAL;
+			goto out;
+		}
+
+		CKINT(acvp_ds_log_sync(log));
+		goto out;
+	}
+
+	memset(hdr, 0, sizeof(hdr));
+	memcpy(hdr, ACVP_DS_LOG_MAGIC, sizeof(ACVP_DS_LOG_MAGIC));
+	acvp_ds_log_put32(hdr + 8, ACVP_DS_LOG_VERSION);
+	CKINT(acvp_ds_log_pwrite(log->fd, hdr, sizeof(hdr), 0));
+
+	/* Files present in the data store base are taken over into the log */
+	logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+	       "Creating data store log %s\n", pathname);
+	ret = acvp_ds_log_import(log, log->basedir, "");
+	if (!ret && fdatasync(log->fd))
+		ret = -errno;
+	if (ret) {
+		/* Start over the next time */
+		if (ftruncate(log->fd, 0))
+			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+			       "Cannot reset data store log %s\n", pathname);
+		goto out;
+	}
+
+out:
+	if (locked)
+		acvp_ds_log_flock(log->fd, F_UNLCK);
+	return ret;
+}
+
+static void acvp_ds_log_free(struct acvp_ds_log *log)
+{
+	unsigned int i;
+
+	if (log->fd >= 0)
+		close(log->fd);
+	for (i = 0; i < log->nretired; i++)
+		close(log->retired[i]);
+	free(log->retired);
+	acvp_ds_log_node_clear(&log->root);
+	mutex_destroy(&log->lock);
+	free(log->basedir);
+	free(log);
+}
+
+/*
+ * Find the log holding the path name and convert the path name into the key
+ * of the entry relative to the data store base.
+ */
+static int acvp_ds_log_find(const char *pathname, struct acvp_ds_log **log,
+			    char *key, size_t keysize)
+{
+	struct acvp_ds_log *l, *found = NULL;
+	const char *ptr, *end;
+	size_t keylen = 0, complen;
+
+	mutex_reader_lock(&acvp_ds_logs_lock);
+	for (l = acvp_ds_logs; l; l = l->next) {
+		if (found && l->basedirlen <= found->basedirlen)
+			continue;
+		if (strncmp(pathname, l->basedir, l->basedirlen))
+			continue;
+		if (pathname[l->basedirlen] != '/' &&
+		    pathname[l->basedirlen] != '\0')
+			continue;
+		found = l;
+	}
+	mutex_reader_unlock(&acvp_ds_logs_lock);
+
+	if (!found) {
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Path %s is not located in a data store base\n",
+		       pathname);
+		return -EINVAL;
+	}
+
+	key[0] = '\0';
+	for (ptr = pathname + found->basedirlen; *ptr; ptr = end) {
+		while (*ptr == '/')
+			ptr++;
+		if (!*ptr)
+			break;
+
+		end = strchr(ptr, '/');
+		if (!end)
+			end = ptr + strlen(ptr);
+		complen = (size_t)(end - ptr);
+
+		if (complen == 1 && *ptr == '.')
+			continue;
+		if (complen == 2 && !strncmp(ptr, "..", 2))
+			return -EINVAL;
+
+		if (keylen + complen + 2 > keysize)
+			return -ENAMETOOLONG;
+		if (keylen)
+			key[keylen++] = '/';
+		memcpy(key + keylen, ptr, complen);
+		keylen += complen;
+		key[keylen] = '\0';
+	}
+
+	*log = found;
+
+	return 0;
+}
+
+/************************************************************************
+ * Storage layer
+ ************************************************************************/
+
+static int acvp_ds_log_io_base(char *basedir, bool createdir, bool secure)
+{
+	struct acvp_ds_log *log;
+	size_t len = strlen(basedir);
+	int ret = 0;
+
+	while (len > 1 && basedir[len - 1] == '/')
+		len--;
+
+	mutex_lock(&acvp_ds_logs_lock);
+
+	for (log = acvp_ds_logs; log; log = log->next) {
+		if (log->basedirlen == len &&
+		    !strncmp(log->basedir, basedir, len))
+			goto out;
+	}
+
+	CKINT(acvp_datastore_file_dir(basedir, createdir));
+
+	log = calloc(1, sizeof(*log));
+	CKNULL(log, -ENOMEM);
+	log->fd = -1;
+	log->root.type = acvp_ds_log_mkdir;
+	mutex_init(&log->lock, 0);
+
+	log->basedir = malloc(len + 1);
+	if (!log->basedir) {
+		acvp_ds_log_free(log);
+		ret = -ENOMEM;
+		goto out;
+	}
+	memcpy(log->basedir, basedir, len);
+	log->basedir[len] = '\0';
+	log->basedirlen = len;
+
+	ret = acvp_ds_log_open(log, secure);
+	if (ret) {
+		acvp_ds_log_free(log);
+		goto out;
+	}
+
+	log->next = acvp_ds_logs;
+	acvp_ds_logs = log;
+
+out:
+	mutex_unlock(&acvp_ds_logs_lock);
+	return ret;
+}
+
+static int acvp_ds_log_io_dir(char *dirname, bool createdir)
+{
+	struct acvp_ds_log *log;
+	struct acvp_ds_log_node *node;
+	char key[FILENAME_MAX];
+	int ret;
+
+	CKINT(acvp_req_check_string(dirname, strlen(dirname)));
+	CKINT(acvp_ds_log_find(dirname, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_refresh(log));
+
+	mutex_reader_lock(&log->lock);
+	node = acvp_ds_log_lookup(log, key);
+	if (node)
+		ret = (node->type == acvp_ds_log_mkdir) ? 0 : -ENOTDIR;
+	mutex_reader_unlock(&log->lock);
+
+	if (node)
+		goto out;
+
+	if (!createdir) {
+		logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
+		       "Directory %s not created\n", dirname);
+		return -ENOENT;
+	}
+
+	CKINT(acvp_ds_log_append(log, acvp_ds_log_mkdir, key, NULL, NULL, 0,
+				 -1));
+	logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE, "directory %s created\n",
+	       dirname);
+
+out:
+	return ret;
+}
+
+/*
+ * Obtain the location of a file in the log file referenced by the descriptor.
+ * The extern flag indicates a regular file outside of the log.
+ */
+static int acvp_ds_log_locate(const char *pathname, int *fd,
+			      struct acvp_ds_log_node *found, bool *ext)
+{
+	struct acvp_ds_log *log;
+	struct acvp_ds_log_node *node;
+	char key[FILENAME_MAX];
+	int ret;
+
+	*ext = false;
+
+	CKINT(acvp_ds_log_find(pathname, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_refresh(log));
+
+	mutex_reader_lock(&log->lock);
+	node = acvp_ds_log_lookup(log, key);
+	if (!node) {
+		ret = -ENOENT;
+	} else {
+		*found = *node;
+		*ext = (node->type == acvp_ds_log_extern);
+		*fd = log->fd;
+	}
+	mutex_reader_unlock(&log->lock);
+
+	/* Only the scalar members are valid outside of the lock */
+	found->name = NULL;
+	found->children = NULL;
+
+out:
+	return ret;
+}
+
+static int acvp_ds_log_io_stat(const char *pathname,
+			       struct acvp_datastore_stat *st)
+{
+	struct acvp_ds_log_node node;
+	int ret, fd;
+	bool ext;
+
+	CKINT(acvp_ds_log_locate(pathname, &fd, &node, &ext));
+	if (ext)
+		return acvp_datastore_io_file.stat(pathname, st);
+
+	st->dir = (node.type == acvp_ds_log_mkdir);
+	st->regular = (node.type == acvp_ds_log_put);
+	st->size = st->dir ? 0 : node.len;
+	st->mtime = node.mtime;
+
+out:
+	return ret;
+}
+
+static int acvp_ds_log_io_read(const char *pathname, uint8_t **buf,
+			       size_t *buflen)
+{
+	struct acvp_ds_log_node node;
+	uint8_t *l_buf = NULL;
+	int ret, fd;
+	bool ext;
+
+	CKINT(acvp_ds_log_locate(pathname, &fd, &node, &ext));
+	if (ext)
+		return acvp_datastore_io_file.read(pathname, buf, buflen);
+	if (node.type == acvp_ds_log_mkdir)
+		return -EISDIR;
+	if (node.len >= SIZE_MAX)
+		return -EFBIG;
+
+	l_buf = calloc(1, (size_t)node.len + 1);
+	CKNULL(l_buf, -ENOMEM);
+	CKINT(acvp_ds_log_pread(fd, l_buf, (size_t)node.len,
+				node.offset));
+
+	*buf = l_buf;
+	*buflen = (size_t)node.len;
+	l_buf = NULL;
+
+out:
+	free(l_buf);
+	return ret;
+}
+
+static int acvp_ds_log_io_map(const char *pathname,
+			      struct acvp_datastore_map *map)
+{
+	struct acvp_ds_log_node node;
+	uint64_t pagemask = (uint64_t)sysconf(_SC_PAGESIZE) - 1, start;
+	void *addr;
+	int ret, fd;
+	bool ext;
+
+	memset(map, 0, sizeof(*map));
+
+	CKINT(acvp_ds_log_locate(pathname, &fd, &node, &ext));
+	if (ext)
+		return acvp_datastore_io_file.map(pathname, map);
+	if (node.type == acvp_ds_log_mkdir)
+		return -EISDIR;
+	if (!node.len)
+		return 0;
+	if (node.len > UINT32_MAX)
+		return -EFBIG;
+
+	/* The mapping must start at a page boundary */
+	start = node.offset & ~pagemask;
+	addr = mmap(NULL, (size_t)(node.offset - start + node.len), PROT_READ,
+		    MAP_SHARED, fd, (off_t)start);
+	if (addr == MAP_FAILED) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE, "Cannot mmap file %s\n",
+		       pathname);
+		return -ENOMEM;
+	}
+
+	map->addr = addr;
+	map->len = (size_t)(node.offset - start + node.len);
+	map->buf.buf = (uint8_t *)addr + (node.offset - start);
+	map->buf.len = (uint32_t)node.len;
+
+out:
+	return ret;
+}
+
+static void acvp_ds_log_io_unmap(struct acvp_datastore_map *map)
+{
+	acvp_datastore_io_file.unmap(map);
+}
+
+static int acvp_ds_log_io_write(const char *pathname,
+				const struct acvp_buf *data)
+{
+	struct acvp_ds_log *log;
+	char key[FILENAME_MAX];
+	int ret;
+
+	if (!data || !data->buf)
+		return 0;
+
+	CKINT(acvp_ds_log_find(pathname, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_append(log, acvp_ds_log_put, key, NULL, data->buf,
+				 data->len, -1));
+
+out:
+	return ret;
+}
+
+static int acvp_ds_log_io_stream(
+	const char *pathname, bool secure,
+	int (*stream)(const struct acvp_vsid_ctx *vsid_ctx, int fd, void *data),
+	const struct acvp_vsid_ctx *vsid_ctx, void *data)
+{
+	struct acvp_ds_log *log;
+	struct stat statbuf;
+	char key[FILENAME_MAX], tmpname[FILENAME_MAX];
+	int ret, fd = -1;
+
+	(void)secure;
+
+	CKINT(acvp_ds_log_find(pathname, &log, key, sizeof(key)));
+
+	/*
+	 * The data is collected in an anonymous temporary file and copied
+	 * into the log once complete.
+	 */
+	snprintf(tmpname, sizeof(tmpname), "%s/.%s.XXXXXX", log->basedir,
+		 ACVP_DS_LOGFILE);
+	fd = mkstemp(tmpname);
+	if (fd < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+		       "Cannot create temporary file for %s (%d)\n", pathname,
+		       ret);
+		goto out;
+	}
+	unlink(tmpname);
+
+	CKINT(stream(vsid_ctx, fd, data));
+
+	if (fstat(fd, &statbuf)) {
+		ret = -errno;
+		goto out;
+	}
+
+	CKINT(acvp_ds_log_append(log, acvp_ds_log_put, key, NULL, NULL,
+				 (uint64_t)statbuf.st_size, fd));
+
+out:
+	if (fd >= 0)
+		close(fd);
+	return ret;
+}
+
+static int acvp_ds_log_io_add_file(const char *pathname)
+{
+	struct acvp_ds_log *log;
+	struct acvp_ds_log_node *node;
+	char key[FILENAME_MAX];
+	int ret;
+	bool present;
+
+	CKINT(acvp_ds_log_find(pathname, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_refresh(log));
+
+	mutex_reader_lock(&log->lock);
+	node = acvp_ds_log_lookup(log, key);
+	present = (node && node->type == acvp_ds_log_extern);
+	mutex_reader_unlock(&log->lock);
+
+	if (present)
+		goto out;
+
+	CKINT(acvp_ds_log_append(log, acvp_ds_log_extern, key, NULL, NULL, 0,
+				 -1));
+
+out:
+	return ret;
+}
+
+static int acvp_ds_log_io_list(const char *dirname, char ***names,
+			       unsigned int *num)
+{
+	struct acvp_ds_log *log;
+	struct acvp_ds_log_node *node;
+	char key[FILENAME_MAX];
+	char **l_names = NULL;
+	unsigned int i, l_num = 0;
+	int ret;
+
+	CKINT(acvp_ds_log_find(dirname, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_refresh(log));
+
+	mutex_reader_lock(&log->lock);
+
+	node = acvp_ds_log_lookup(log, key);
+	if (!node) {
+		ret = -ENOENT;
+		goto unlock;
+	}
+	if (node->type != acvp_ds_log_mkdir) {
+		ret = -ENOTDIR;
+		goto unlock;
+	}
+	if (!node->nchildren)
+		goto unlock;
+
+	l_names = calloc(node->nchildren, sizeof(*l_names));
+	if (!l_names) {
+		ret = -ENOMEM;
+		goto unlock;
+	}
+
+	for (i = 0; i < node->nchildren; i++) {
+		if (!strncmp(node->children[i]->name, ".", 1))
+			continue;
+
+		ret = acvp_duplicate(&l_names[l_num], node->children[i]->name);
+		if (ret)
+			goto unlock;
+		l_num++;
+	}
+
+unlock:
+	mutex_reader_unlock(&log->lock);
+
+	if (ret) {
+		acvp_datastore_list_free(l_names, l_num);
+		goto out;
+	}
+
+	*names = l_names;
+	*num = l_num;
+
+out:
+	return ret;
+}
+
+static int acvp_ds_log_io_rename(const char *oldpath, const char *newpath)
+{
+	struct acvp_ds_log *log, *newlog;
+	char key[FILENAME_MAX], newkey[FILENAME_MAX];
+	int ret;
+
+	CKINT(acvp_ds_log_find(oldpath, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_find(newpath, &newlog, newkey, sizeof(newkey)));
+	if (log != newlog)
+		return -EXDEV;
+
+	CKINT(acvp_ds_log_append(log, acvp_ds_log_rename, key, newkey, NULL, 0,
+				 -1));
+
+out:
+	return ret;
+}
+
+static int acvp_ds_log_io_unlink(const char *pathname)
+{
+	struct acvp_ds_log *log;
+	char key[FILENAME_MAX];
+	int ret;
+
+	CKINT(acvp_ds_log_find(pathname, &log, key, sizeof(key)));
+	CKINT(acvp_ds_log_append(log, acvp_ds_log_delete, key, NULL, NULL, 0,
+				 -1));
+
+out:
+	return ret;
+}
+
+/* The permissions of the log file apply to all files it holds */
+static int acvp_ds_log_io_chmod(const char *pathname, unsigned int mode)
+{
+	(void)pathname;
+	(void)mode;
+
+	return 0;
+}
+
+const struct acvp_datastore_io acvp_datastore_io_log = {
+	.base = acvp_ds_log_io_base,
+	.dir = acvp_ds_log_io_dir,
+	.stat = acvp_ds_log_io_stat,
+	.read = acvp_ds_log_io_read,
+	.map = acvp_ds_log_io_map,
+	.unmap = acvp_ds_log_io_unmap,
+	.write = acvp_ds_log_io_write,
+	.stream = acvp_ds_log_io_stream,
+	.batch = NULL,
+	.add_file = acvp_ds_log_io_add_file,
+	.list = acvp_ds_log_io_list,
+	.rename = acvp_ds_log_io_rename,
+	.unlink = acvp_ds_log_io_unlink,
+	.chmod = acvp_ds_log_io_chmod,
+};
+
+bool acvp_datastore_log_present(const char *basedir)
+{
+	struct stat statbuf;
+	char pathname[FILENAME_MAX];
+
+	if (!basedir)
+		return false;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", basedir,
+		 ACVP_DS_LOGFILE);
+	if (stat(pathname, &statbuf))
+		return false;
+
+	return S_ISREG(statbuf.st_mode);
+}
+
+ACVP_DEFINE_DESTRUCTOR(acvp_datastore_log_release)
+static void acvp_datastore_log_release(void)
+{
+	struct acvp_ds_log *log;
+
+	mutex_lock(&acvp_ds_logs_lock);
+	while (acvp_ds_logs) {
+		log = acvp_ds_logs;
+		acvp_ds_logs = log->next;
+		acvp_ds_log_free(log);
+	}
+	mutex_unlock(&acvp_ds_logs_lock);
+}
@@ -0,0 +1,1007 @@
+/* Datastore backend storing files - io_uring storage layer
+ *
+ * Copyright (C) 2018 - 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "aux_helper.h"
+#include "constructor.h"
+#include "datastore_io.h"
+#include "logger.h"
+#include "mutex.h"
+#include "mutex_w.h"
+#include "ret_checkers.h"
+
+/*
+ * Opening files into a registered file slot requires the kernel headers of
+ * Linux 5.15 or later. With older headers only the regular file operations are
+ * available.
+ */
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#ifdef IORING_FILE_INDEX_ALLOC
+#define ACVP_DS_URING
+#endif
+#endif
+#endif
+
+#ifdef ACVP_DS_URING
+
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*
+ * The open, the data transfer and the close of a file are submitted together
+ * as one chain of linked requests. The file is opened into a registered file
+ * slot of the ring which is used by the subsequent requests of the chain. The
+ * close is hard-linked to the data transfer to release the slot even if the
+ * transfer fails.
+ *
+ * Idle rings are kept in a pool. A thread takes a ring for the duration of
+ * one operation which implies that threads never wait for the file system
+ * operations of other threads.
+ *
+ * Writes are collected in batches. Each write of a batch uses its own file
+ * slot, so the chains of all writes of a batch are submitted with one system
+ * call. Outside of a batch scope (see the batch callback), a batch holds one
+ * write which is submitted immediately. Within a batch scope, the writes of
+ * the thread are submitted together when the scope ends, when the batch is
+ * full or when one of the files is accessed.
+ *
+ * A write returns once its chain is prepared, the ring stays with the batch
+ * until all chains completed. The completion is collected when a file of the
+ * batch is accessed again, when a later write finds the batch completed, when
+ * too many writes are in flight, when the submitting thread terminates or at
+ * exit. The kernel cancels the requests of a terminating thread which implies
+ * that a thread must not terminate before its writes completed. Errors of a
+ * write are logged when its completion is collected.
+ */
+#define ACVP_DS_URING_ENTRIES 32
+/* Maximum number of writes of a batch, each uses 3 entries and one slot */
+#define ACVP_DS_URING_BATCH 8
+/* File slot of reads */
+#define ACVP_DS_URING_SLOT 0
+
+/* Maximum number of writes in flight */
+#define ACVP_DS_URING_WRITES 64
+
+/* Size of the buffer a file is read into together with its status */
+#define ACVP_DS_URING_READ_LEN 65536
+
+struct acvp_ds_uring {
+	struct acvp_ds_uring *next;
+	int fd;
+	void *sq_ring;
+	size_t sq_ring_len;
+	void *cq_ring;
+	size_t cq_ring_len;
+	struct io_uring_sqe *sqes;
+	size_t sqes_len;
+	unsigned int *sq_head;
+	unsigned int *sq_tail;
+	unsigned int *sq_mask;
+	unsigned int *sq_array;
+	unsigned int *cq_head;
+	unsigned int *cq_tail;
+	unsigned int *cq_mask;
+	struct io_uring_cqe *cqes;
+	unsigned int queued; /* Requests prepared but not yet submitted */
+};
+
+/**
+ * @brief Write of a batch
+ *
+ * @var pathname File to be written
+ * @var buf Copy of the data to be written
+ * @var len Length of the data
+ * @var res_open Result of the open request
+ * @var res_write Result of the write request
+ * @var res_close Result of the close request
+ */
+struct acvp_ds_uring_write {
+	struct acvp_ds_uring_write *next;
+	char *pathname;
+	uint8_t *buf;
+	uint32_t len;
+	int res_open, res_write, res_close;
+};
+
+/**
+ * @brief Batch of writes in flight
+ *
+ * @var ring Ring the chains of the writes are prepared in
+ * @var owner Thread which prepared the chains
+ * @var writes Writes of the batch in the order of their preparation
+ * @var num Number of writes of the batch
+ * @var submitted The chains are handed to the kernel
+ * @var completing A thread collects the completion of the batch
+ */
+struct acvp_ds_uring_batch {
+	struct acvp_ds_uring_batch *next;
+	struct acvp_ds_uring *ring;
+	pthread_t owner;
+	struct acvp_ds_uring_write *writes;
+	unsigned int num;
+	bool submitted;
+	bool completing;
+};
+
+static struct acvp_ds_uring *acvp_ds_urings = NULL;
+static DEFINE_MUTEX_UNLOCKED(acvp_ds_urings_lock);
+
+/* Batches in flight in the order of their creation */
+static struct acvp_ds_uring_batch *acvp_ds_uring_batches = NULL;
+static unsigned int acvp_ds_uring_writes_num = 0;
+static DEFINE_MUTEX_W_UNLOCKED(acvp_ds_uring_writes_lock);
+static pthread_cond_t acvp_ds_uring_writes_done = PTHREAD_COND_INITIALIZER;
+
+/* Nesting level of the batch scope of the thread */
+static __thread unsigned int acvp_ds_uring_batching = 0;
+
+/* Thread-specific marker of threads with writes in flight */
+static pthread_key_t acvp_ds_uring_thread;
+static pthread_once_t acvp_ds_uring_thread_once = PTHREAD_ONCE_INIT;
+static bool acvp_ds_uring_thread_registered = false;
+
+static void acvp_ds_uring_free(struct acvp_ds_uring *ring)
+{
+	if (ring->sqes)
+		munmap(ring->sqes, ring->sqes_len);
+	if (ring->cq_ring && ring->cq_ring != ring->sq_ring)
+		munmap(ring->cq_ring, ring->cq_ring_len);
+	if (ring->sq_ring)
+		munmap(ring->sq_ring, ring->sq_ring_len);
+	if (ring->fd >= 0)
+		close(ring->fd);
+	free(ring);
+}
+
+static int acvp_ds_uring_setup(struct acvp_ds_uring **ring_out)
+{
+	struct io_uring_params p;
+	struct acvp_ds_uring *ring;
+	int slots[ACVP_DS_URING_BATCH], ret = 0;
+	unsigned int i;
+	uint8_t *sq, *cq;
+
+	ring = calloc(1, sizeof(*ring));
+	if (!ring)
+		return -ENOMEM;
+
+	memset(&p, 0, sizeof(p));
+	ring->fd = (int)syscall(__NR_io_uring_setup, ACVP_DS_URING_ENTRIES, &p);
+	if (ring->fd < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	ring->sq_ring_len = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	ring->cq_ring_len =
+		p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (ring->cq_ring_len > ring->sq_ring_len)
+			ring->sq_ring_len = ring->cq_ring_len;
+		ring->cq_ring_len = ring->sq_ring_len;
+	}
+
+	ring->sq_ring = mmap(NULL, ring->sq_ring_len, PROT_READ | PROT_WRITE,
+			     MAP_SHARED | MAP_POPULATE, ring->fd,
+			     IORING_OFF_SQ_RING);
+	if (ring->sq_ring == MAP_FAILED) {
+		ring->sq_ring = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		ring->cq_ring = ring->sq_ring;
+	} else {
+		ring->cq_ring = mmap(NULL, ring->cq_ring_len,
+				     PROT_READ | PROT_WRITE,
+				     MAP_SHARED | MAP_POPULATE, ring->fd,
+				     IORING_OFF_CQ_RING);
+		if (ring->cq_ring == MAP_FAILED) {
+			ring->cq_ring = NULL;
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	ring->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+	ring->sqes = mmap(NULL, ring->sqes_len, PROT_READ | PROT_WRITE,
+			  MAP_SHARED | MAP_POPULATE, ring->fd,
+			  IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED) {
+		ring->sqes = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	sq = ring->sq_ring;
+	ring->sq_head = (unsigned int *)(sq + p.sq_off.head);
+	ring->sq_tail = (unsigned int *)(sq + p.sq_off.tail);
+	ring->sq_mask = (unsigned int *)(sq + p.sq_off.ring_mask);
+	ring->sq_array = (unsigned int *)(sq + p.sq_off.array);
+
+	cq = ring->cq_ring;
+	ring->cq_head = (unsigned int *)(cq + p.cq_off.head);
+	ring->cq_tail = (unsigned int *)(cq + p.cq_off.tail);
+	ring->cq_mask = (unsigned int *)(cq + p.cq_off.ring_mask);
+	ring->cqes = (struct io_uring_cqe *)(cq + p.cq_off.cqes);
+
+	/* Register the empty file slots the files are opened into */
+	for (i = 0; i < ARRAY_SIZE(slots); i++)
+		slots[i] = -1;
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_FILES,
+		    slots, ARRAY_SIZE(slots)) < 0) {
+		ret = -errno;
+		goto out;
+	}
+
+	*ring_out = ring;
+
+out:
+	if (ret)
+		acvp_ds_uring_free(ring);
+	return ret;
+}
+
+/* Take an idle ring from the pool or set up a new one */
+static int acvp_ds_uring_get(struct acvp_ds_uring **ring)
+{
+	mutex_lock(&acvp_ds_urings_lock);
+	*ring = acvp_ds_urings;
+	if (*ring)
+		acvp_ds_urings = (*ring)->next;
+	mutex_unlock(&acvp_ds_urings_lock);
+
+	if (*ring)
+		return 0;
+
+	return acvp_ds_uring_setup(ring);
+}
+
+static void acvp_ds_uring_put(struct acvp_ds_uring *ring)
+{
+	mutex_lock(&acvp_ds_urings_lock);
+	ring->next = acvp_ds_urings;
+	acvp_ds_urings = ring;
+	mutex_unlock(&acvp_ds_urings_lock);
+}
+
+/*
+ * Prepare the next request of the submission - the result of the request is
+ * stored in res once it completed.
+ */
+static struct io_uring_sqe *acvp_ds_uring_sqe(struct acvp_ds_uring *ring,
+					      uint8_t opcode, int *res)
+{
+	unsigned int tail = *ring->sq_tail + ring->queued;
+	unsigned int idx = tail & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[idx];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	sqe->user_data = (uint64_t)(uintptr_t)res;
+	ring->sq_array[idx] = idx;
+	ring->queued++;
+
+	*res = -ECANCELED;
+
+	return sqe;
+}
+
+/* Hand all prepared requests to the kernel, return their number */
+static unsigned int acvp_ds_uring_start(struct acvp_ds_uring *ring)
+{
+	unsigned int nr = ring->queued;
+
+	__atomic_store_n(ring->sq_tail, *ring->sq_tail + ring->queued,
+			 __ATOMIC_RELEASE);
+	ring->queued = 0;
+
+	return nr;
+}
+
+/* Collect the results of all completed requests */
+static unsigned int acvp_ds_uring_reap(struct acvp_ds_uring *ring)
+{
+	struct io_uring_cqe *cqe;
+	unsigned int head = *ring->cq_head, completed = 0;
+	unsigned int tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+	int *res;
+
+	while (head != tail) {
+		cqe = &ring->cqes[head & *ring->cq_mask];
+		res = (int *)(uintptr_t)cqe->user_data;
+		*res = cqe->res;
+		head++;
+		completed++;
+	}
+	__atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+
+	return completed;
+}
+
+/* Check whether nr requests completed without collecting them */
+static bool acvp_ds_uring_done(struct acvp_ds_uring *ring, unsigned int nr)
+{
+	return (__atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE) -
+		*ring->cq_head) >= nr;
+}
+
+/* Submit the started requests and wait for nr completions */
+static int acvp_ds_uring_wait(struct acvp_ds_uring *ring, unsigned int nr)
+{
+	unsigned int submit, completed = 0;
+
+	for (;;) {
+		completed += acvp_ds_uring_reap(ring);
+		if (completed >= nr)
+			return 0;
+
+		submit = *ring->sq_tail -
+			 __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+
+		if (syscall(__NR_io_uring_enter, ring->fd, submit,
+			    nr - completed, IORING_ENTER_GETEVENTS, NULL,
+			    0) < 0 &&
+		    errno != EINTR)
+			return -errno;
+	}
+}
+
+/*
+ * Submit all prepared requests and wait for their completion. The ring is
+ * returned to the pool or released if the submission failed as the state of
+ * the ring is unknown in this case.
+ */
+static int acvp_ds_uring_run(struct acvp_ds_uring *ring, unsigned int nr)
+{
+	int ret = acvp_ds_uring_wait(ring, nr);
+
+	if (ret) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Submission to io_uring failed (%d)\n", ret);
+		acvp_ds_uring_free(ring);
+	} else {
+		acvp_ds_uring_put(ring);
+	}
+
+	return ret;
+}
+
+static void acvp_ds_uring_openat(struct acvp_ds_uring *ring,
+				 unsigned int slot, const char *pathname,
+				 int flags, int *res)
+{
+	struct io_uring_sqe *sqe =
+		acvp_ds_uring_sqe(ring, IORING_OP_OPENAT, res);
+
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uint64_t)(uintptr_t)pathname;
+	sqe->len = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+	/* The file slot is no file descriptor, O_CLOEXEC is rejected */
+	sqe->open_flags = (uint32_t)flags;
+	sqe->file_index = slot + 1;
+	sqe->flags = IOSQE_IO_LINK;
+}
+
+static void acvp_ds_uring_rw(struct acvp_ds_uring *ring, unsigned int slot,
+			     uint8_t opcode, void *buf, uint32_t len,
+			     uint64_t off, int *res)
+{
+	struct io_uring_sqe *sqe = acvp_ds_uring_sqe(ring, opcode, res);
+
+	sqe->fd = (int)slot;
+	sqe->addr = (uint64_t)(uintptr_t)buf;
+	sqe->len = len;
+	sqe->off = off;
+	sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+}
+
+static void acvp_ds_uring_close(struct acvp_ds_uring *ring, unsigned int slot,
+				int *res)
+{
+	struct io_uring_sqe *sqe = acvp_ds_uring_sqe(ring, IORING_OP_CLOSE, res);
+
+	sqe->file_index = slot + 1;
+}
+
+static void acvp_ds_uring_statx(struct acvp_ds_uring *ring,
+				const char *pathname, struct statx *stx,
+				int *res)
+{
+	struct io_uring_sqe *sqe = acvp_ds_uring_sqe(ring, IORING_OP_STATX, res);
+
+	sqe->fd = AT_FDCWD;
+	sqe->addr = (uint64_t)(uintptr_t)pathname;
+	sqe->len = STATX_TYPE | STATX_SIZE | STATX_MTIME;
+	sqe->off = (uint64_t)(uintptr_t)stx;
+}
+
+/* Hand the chains of the batch to the kernel - caller holds the lock */
+static void acvp_ds_uring_batch_submit(struct acvp_ds_uring_batch *b)
+{
+	b->submitted = true;
+
+	/*
+	 * A failed submission is repeated when the completion is collected,
+	 * its error is reported then.
+	 */
+	if (syscall(__NR_io_uring_enter, b->ring->fd,
+		    acvp_ds_uring_start(b->ring), 0, 0, NULL, 0) < 0 &&
+	    errno != EINTR) {
+		logger(LOGGER_DEBUG, LOGGER_C_DS_FILE,
+		       "Submission to io_uring deferred (%d)\n", -errno);
+	}
+}
+
+static void acvp_ds_uring_write_free(struct acvp_ds_uring_write *w)
+{
+	if (w->pathname)
+		free(w->pathname);
+	if (w->buf)
+		free(w->buf);
+	free(w);
+}
+
+/*
+ * Wait for the completion of the batch and release it - the caller holds the
+ * lock of the writes in flight and marked the batch as completing. The lock is
+ * dropped while waiting.
+ */
+static void acvp_ds_uring_batch_complete(struct acvp_ds_uring_batch *b)
+{
+	struct acvp_ds_uring_batch **prev;
+	struct acvp_ds_uring_write *w;
+	int ret;
+
+	if (!b->submitted)
+		acvp_ds_uring_batch_submit(b);
+
+	mutex_w_unlock(&acvp_ds_uring_writes_lock);
+
+	ret = acvp_ds_uring_run(b->ring, 3 * b->num);
+	for (w = b->writes; w; w = w->next) {
+		if (ret || w->res_open < 0) {
+			logger(LOGGER_ERR, LOGGER_C_DS_FILE,
+			       "Cannot write file %s (%d)\n", w->pathname,
+			       ret ? ret : w->res_open);
+		} else if (w->res_write < 0 ||
+			   (uint32_t)w->res_write != w->len) {
+			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+			       "data written to %s (%d) mismatch with data available (%u)\n",
+			       w->pathname, w->res_write, w->len);
+		}
+	}
+
+	mutex_w_lock(&acvp_ds_uring_writes_lock);
+
+	for (prev = &acvp_ds_uring_batches; *prev; prev = &(*prev)->next) {
+		if (*prev == b) {
+			*prev = b->next;
+			break;
+		}
+	}
+	acvp_ds_uring_writes_num -= b->num;
+	pthread_cond_broadcast(&acvp_ds_uring_writes_done);
+
+	while (b->writes) {
+		w = b->writes;
+		b->writes = w->next;
+		acvp_ds_uring_write_free(w);
+	}
+	free(b);
+}
+
+static bool acvp_ds_uring_batch_has(const struct acvp_ds_uring_batch *b,
+				    const char *pathname)
+{
+	const struct acvp_ds_uring_write *w;
+
+	for (w = b->writes; w; w = w->next) {
+		if (!strcmp(w->pathname, pathname))
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Wait for all writes in flight to the file if pathname is set and submitted
+ * by the thread if owner is set. Batches which are not submitted yet are
+ * submitted.
+ */
+static void acvp_ds_uring_flush_writes(const char *pathname,
+				       const pthread_t *owner)
+{
+	struct acvp_ds_uring_batch *b;
+
+	mutex_w_lock(&acvp_ds_uring_writes_lock);
+	for (;;) {
+		for (b = acvp_ds_uring_batches; b; b = b->next) {
+			if ((!pathname ||
+			     acvp_ds_uring_batch_has(b, pathname)) &&
+			    (!owner || pthread_equal(b->owner, *owner)))
+				break;
+		}
+		if (!b)
+			break;
+
+		/* Another thread collects the completion */
+		if (b->completing) {
+			pthread_cond_wait(&acvp_ds_uring_writes_done,
+					  &acvp_ds_uring_writes_lock);
+			continue;
+		}
+
+		b->completing = true;
+		acvp_ds_uring_batch_complete(b);
+	}
+	mutex_w_unlock(&acvp_ds_uring_writes_lock);
+}
+
+/* Wait for all writes in flight to the file or all writes if pathname is NULL */
+static void acvp_ds_uring_flush(const char *pathname)
+{
+	acvp_ds_uring_flush_writes(pathname, NULL);
+}
+
+static void acvp_ds_uring_thread_exit(void *marker)
+{
+	pthread_t self = pthread_self();
+
+	(void)marker;
+	acvp_ds_uring_flush_writes(NULL, &self);
+}
+
+static void acvp_ds_uring_thread_init(void)
+{
+	if (pthread_key_create(&acvp_ds_uring_thread,
+			       acvp_ds_uring_thread_exit)) {
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot register thread termination handler, data store files are written synchronously\n");
+		return;
+	}
+
+	acvp_ds_uring_thread_registered = true;
+}
+
+/*
+ * Collect the batches which completed and the oldest batches beyond the
+ * maximum number of writes in flight.
+ */
+static void acvp_ds_uring_collect(void)
+{
+	struct acvp_ds_uring_batch *b;
+
+	mutex_w_lock(&acvp_ds_uring_writes_lock);
+	for (;;) {
+		for (b = acvp_ds_uring_batches; b; b = b->next) {
+			if (b->completing || !b->submitted)
+				continue;
+			if (acvp_ds_uring_writes_num > ACVP_DS_URING_WRITES ||
+			    acvp_ds_uring_done(b->ring, 3 * b->num))
+				break;
+		}
+		if (!b)
+			break;
+
+		b->completing = true;
+		acvp_ds_uring_batch_complete(b);
+	}
+	mutex_w_unlock(&acvp_ds_uring_writes_lock);
+}
+
+/* Find the batch of the thread collecting writes - caller holds the lock */
+static struct acvp_ds_uring_batch *acvp_ds_uring_batch_open(void)
+{
+	struct acvp_ds_uring_batch *b;
+	pthread_t self = pthread_self();
+
+	for (b = acvp_ds_uring_batches; b; b = b->next) {
+		if (!b->submitted && pthread_equal(b->owner, self))
+			return b;
+	}
+
+	return NULL;
+}
+
+static int acvp_ds_uring_io_read(const char *pathname, uint8_t **buf,
+				 size_t *buflen)
+{
+	struct acvp_ds_uring *ring;
+	struct statx stx;
+	uint8_t *l_buf = NULL, *tmp;
+	size_t len;
+	int ret, res_stat, res_open, res_read, res_close;
+
+	acvp_ds_uring_flush(pathname);
+
+	l_buf = malloc(ACVP_DS_URING_READ_LEN + 1);
+	CKNULL(l_buf, -ENOMEM);
+
+	/*
+	 * The status is obtained together with the data - only a file larger
+	 * than the buffer requires a second submission.
+	 */
+	CKINT(acvp_ds_uring_get(&ring));
+	acvp_ds_uring_statx(ring, pathname, &stx, &res_stat);
+	acvp_ds_uring_openat(ring, ACVP_DS_URING_SLOT, pathname, O_RDONLY,
+			     &res_open);
+	acvp_ds_uring_rw(ring, ACVP_DS_URING_SLOT, IORING_OP_READ, l_buf,
+			 ACVP_DS_URING_READ_LEN, 0, &res_read);
+	acvp_ds_uring_close(ring, ACVP_DS_URING_SLOT, &res_close);
+	CKINT(acvp_ds_uring_run(ring, acvp_ds_uring_start(ring)));
+
+	if (res_open < 0) {
+		ret = res_open;
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot open file %s (%d)\n", pathname, ret);
+		goto out;
+	}
+	if (res_read < 0) {
+		ret = res_read;
+		goto out;
+	}
+	len = (size_t)res_read;
+
+	if (len == ACVP_DS_URING_READ_LEN && !res_stat &&
+	    stx.stx_size > ACVP_DS_URING_READ_LEN) {
+		if (stx.stx_size > INT_MAX) {
+			ret = -EFBIG;
+			goto out;
+		}
+
+		tmp = realloc(l_buf, (size_t)stx.stx_size + 1);
+		CKNULL(tmp, -ENOMEM);
+		l_buf = tmp;
+
+		CKINT(acvp_ds_uring_get(&ring));
+		acvp_ds_uring_openat(ring, ACVP_DS_URING_SLOT, pathname,
+				     O_RDONLY, &res_open);
+		acvp_ds_uring_rw(ring, ACVP_DS_URING_SLOT, IORING_OP_READ,
+				 l_buf + len, (uint32_t)(stx.stx_size - len),
+				 len, &res_read);
+		acvp_ds_uring_close(ring, ACVP_DS_URING_SLOT, &res_close);
+		CKINT(acvp_ds_uring_run(ring, acvp_ds_uring_start(ring)));
+
+		if (res_open < 0 || res_read < 0) {
+			ret = res_open < 0 ? res_open : res_read;
+			goto out;
+		}
+		len += (size_t)res_read;
+	}
+
+	/* A file shrinking while it is read is read up to its new end */
+	l_buf[len] = '\0';
+	*buf = l_buf;
+	*buflen = len;
+
+out:
+	if (ret && l_buf)
+		free(l_buf);
+	return ret;
+}
+
+static int acvp_ds_uring_io_write(const char *pathname,
+				  const struct acvp_buf *data)
+{
+	struct acvp_ds_uring_write *w, **tail;
+	struct acvp_ds_uring_batch *b, *new = NULL, **btail;
+	int ret = 0;
+
+	if (!data || !data->buf)
+		return 0;
+
+	/* Asynchronous writes require the termination handler */
+	if (pthread_once(&acvp_ds_uring_thread_once,
+			 acvp_ds_uring_thread_init) ||
+	    !acvp_ds_uring_thread_registered ||
+	    pthread_setspecific(acvp_ds_uring_thread, &acvp_ds_uring_thread))
+		return acvp_datastore_io_file.write(pathname, data);
+
+	/* Writes to one file complete in the order of their submission */
+	acvp_ds_uring_flush(pathname);
+
+	w = calloc(1, sizeof(*w));
+	CKNULL(w, -ENOMEM);
+	w->pathname = strdup(pathname);
+	CKNULL(w->pathname, -ENOMEM);
+	/* The caller may release the data once the write returned */
+	w->buf = malloc(data->len ? data->len : 1);
+	CKNULL(w->buf, -ENOMEM);
+	memcpy(w->buf, data->buf, data->len);
+	w->len = data->len;
+
+	mutex_w_lock(&acvp_ds_uring_writes_lock);
+	b = acvp_ds_uring_batch_open();
+	if (b && b->num >= ACVP_DS_URING_BATCH) {
+		acvp_ds_uring_batch_submit(b);
+		b = NULL;
+	}
+
+	/*
+	 * Only the thread itself adds batches it owns, thus no other batch of
+	 * the thread appears while the lock is dropped.
+	 */
+	if (!b) {
+		mutex_w_unlock(&acvp_ds_uring_writes_lock);
+
+		new = calloc(1, sizeof(*new));
+		CKNULL(new, -ENOMEM);
+		CKINT(acvp_ds_uring_get(&new->ring));
+		new->owner = pthread_self();
+
+		mutex_w_lock(&acvp_ds_uring_writes_lock);
+		for (btail = &acvp_ds_uring_batches; *btail;
+		     btail = &(*btail)->next)
+			;
+		*btail = new;
+		b = new;
+		new = NULL;
+	}
+
+	acvp_ds_uring_openat(b->ring, b->num, w->pathname,
+			     O_WRONLY | O_CREAT | O_TRUNC, &w->res_open);
+	acvp_ds_uring_rw(b->ring, b->num, IORING_OP_WRITE, w->buf, w->len, 0,
+			 &w->res_write);
+	acvp_ds_uring_close(b->ring, b->num, &w->res_close);
+
+	for (tail = &b->writes; *tail; tail = &(*tail)->next)
+		;
+	*tail = w;
+	b->num++;
+	acvp_ds_uring_writes_num++;
+	w = NULL;
+
+	/* Outside of a batch scope the write is submitted immediately */
+	if (!acvp_ds_uring_batching)
+		acvp_ds_uring_batch_submit(b);
+	mutex_w_unlock(&acvp_ds_uring_writes_lock);
+
+	acvp_ds_uring_collect();
+
+out:
+	if (new) {
+		if (new->ring)
+			acvp_ds_uring_put(new->ring);
+		free(new);
+	}
+	if (w)
+		acvp_ds_uring_write_free(w);
+	return ret;
+}
+
+static void acvp_ds_uring_io_batch(bool begin)
+{
+	struct acvp_ds_uring_batch *b;
+
+	if (begin) {
+		acvp_ds_uring_batching++;
+		return;
+	}
+
+	if (!acvp_ds_uring_batching || --acvp_ds_uring_batching)
+		return;
+
+	/* Submit the writes collected in the batch scope together */
+	mutex_w_lock(&acvp_ds_uring_writes_lock);
+	b = acvp_ds_uring_batch_open();
+	if (b)
+		acvp_ds_uring_batch_submit(b);
+	mutex_w_unlock(&acvp_ds_uring_writes_lock);
+
+	acvp_ds_uring_collect();
+}
+
+/*
+ * Check that the kernel supports all requests and opening files into the
+ * registered file slot (Linux 5.15 and later). The ring is kept in the pool.
+ */
+bool acvp_datastore_uring_available(void)
+{
+	static const uint8_t ops[] = { IORING_OP_OPENAT, IORING_OP_READ,
+				       IORING_OP_WRITE, IORING_OP_CLOSE,
+				       IORING_OP_STATX };
+	struct io_uring_probe *probe = NULL;
+	struct acvp_ds_uring *ring;
+	unsigned int i;
+	int ret, res_open, res_close;
+
+	CKINT(acvp_ds_uring_get(&ring));
+
+	probe = calloc(1, sizeof(*probe) +
+				  IORING_OP_LAST * sizeof(struct io_uring_probe_op));
+	CKNULL(probe, -ENOMEM);
+	if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE,
+		    probe, IORING_OP_LAST) < 0) {
+		ret = -errno;
+		acvp_ds_uring_free(ring);
+		goto out;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(ops); i++) {
+		if (ops[i] > probe->last_op ||
+		    !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED)) {
+			ret = -EOPNOTSUPP;
+			acvp_ds_uring_free(ring);
+			goto out;
+		}
+	}
+
+	acvp_ds_uring_openat(ring, ACVP_DS_URING_SLOT, "/",
+			     O_RDONLY | O_DIRECTORY, &res_open);
+	acvp_ds_uring_close(ring, ACVP_DS_URING_SLOT, &res_close);
+	CKINT(acvp_ds_uring_run(ring, acvp_ds_uring_start(ring)));
+	CKINT(res_open);
+	CKINT(res_close);
+
+out:
+	if (probe)
+		free(probe);
+	if (ret)
+		logger(LOGGER_VERBOSE, LOGGER_C_DS_FILE,
+		       "io_uring not usable for the data store (%d)\n", ret);
+	return !ret;
+}
+
+ACVP_DEFINE_DESTRUCTOR(acvp_datastore_uring_release)
+static void acvp_datastore_uring_release(void)
+{
+	struct acvp_ds_uring *ring;
+
+	/* Writes in flight must reach the file system before the exit */
+	acvp_ds_uring_flush(NULL);
+
+	mutex_lock(&acvp_ds_urings_lock);
+	while (acvp_ds_urings) {
+		ring = acvp_ds_urings;
+		acvp_ds_urings = ring->next;
+		acvp_ds_uring_free(ring);
+	}
+	mutex_unlock(&acvp_ds_urings_lock);
+}
+
+#else /* ACVP_DS_URING */
+
+static void acvp_ds_uring_flush(const char *pathname)
+{
+	(void)pathname;
+}
+
+static int acvp_ds_uring_io_read(const char *pathname, uint8_t **buf,
+				 size_t *buflen)
+{
+	return acvp_datastore_io_file.read(pathname, buf, buflen);
+}
+
+static int acvp_ds_uring_io_write(const char *pathname,
+				  const struct acvp_buf *data)
+{
+	return acvp_datastore_io_file.write(pathname, data);
+}
+
+static void acvp_ds_uring_io_batch(bool begin)
+{
+	(void)begin;
+}
+
+bool acvp_datastore_uring_available(void)
+{
+	return false;
+}
+
+#endif /* ACVP_DS_URING */
+
+/*
+ * All other operations are performed with the regular file storage layer once
+ * the writes in flight to the accessed files completed.
+ */
+static int acvp_ds_uring_io_base(char *basedir, bool createdir, bool secure)
+{
+	return acvp_datastore_io_file.base(basedir, createdir, secure);
+}
+
+static int acvp_ds_uring_io_dir(char *dirname, bool createdir)
+{
+	return acvp_datastore_io_file.dir(dirname, createdir);
+}
+
+static int acvp_ds_uring_io_stat(const char *pathname,
+				 struct acvp_datastore_stat *st)
+{
+	acvp_ds_uring_flush(pathname);
+	return acvp_datastore_io_file.stat(pathname, st);
+}
+
+static int acvp_ds_uring_io_map(const char *pathname,
+				struct acvp_datastore_map *map)
+{
+	acvp_ds_uring_flush(pathname);
+	return acvp_datastore_io_file.map(pathname, map);
+}
+
+static void acvp_ds_uring_io_unmap(struct acvp_datastore_map *map)
+{
+	acvp_datastore_io_file.unmap(map);
+}
+
+static int acvp_ds_uring_io_stream(
+	const char *pathname, bool secure,
+	int (*stream)(const struct acvp_vsid_ctx *vsid_ctx, int fd, void *data),
+	const struct acvp_vsid_ctx *vsid_ctx, void *data)
+{
+	acvp_ds_uring_flush(pathname);
+	return acvp_datastore_io_file.stream(pathname, secure, stream, vsid_ctx,
+					     data);
+}
+
+/* Listing or moving a directory covers all files below it */
+static int acvp_ds_uring_io_list(const char *dirname, char ***names,
+				 unsigned int *num)
+{
+	acvp_ds_uring_flush(NULL);
+	return acvp_datastore_io_file.list(dirname, names, num);
+}
+
+static int acvp_ds_uring_io_rename(const char *oldpath, const char *newpath)
+{
+	acvp_ds_uring_flush(NULL);
+	return acvp_datastore_io_file.rename(oldpath, newpath);
+}
+
+static int acvp_ds_uring_io_unlink(const char *pathname)
+{
+	acvp_ds_uring_flush(pathname);
+	return acvp_datastore_io_file.unlink(pathname);
+}
+
+static int acvp_ds_uring_io_chmod(const char *pathname, unsigned int mode)
+{
+	acvp_ds_uring_flush(pathname);
+	return acvp_datastore_io_file.chmod(pathname, mode);
+}
+
+const struct acvp_datastore_io acvp_datastore_io_uring = {
+	.base = acvp_ds_uring_io_base,
+	.dir = acvp_ds_uring_io_dir,
+	.stat = acvp_ds_uring_io_stat,
+	.read = acvp_ds_uring_io_read,
+	.map = acvp_ds_uring_io_map,
+	.unmap = acvp_ds_uring_io_unmap,
+	.write = acvp_ds_uring_io_write,
+	.stream = acvp_ds_uring_io_stream,
+	.batch = acvp_ds_uring_io_batch,
+	.add_file = NULL,
+	.list = acvp_ds_uring_io_list,
+	.rename = acvp_ds_uring_io_rename,
+	.unlink = acvp_ds_uring_io_unlink,
+	.chmod = acvp_ds_uring_io_chmod,
+};
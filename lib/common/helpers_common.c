@@ -19,8 +19,9 @@
 
 #include <ctype.h>
 #include <fcntl.h>
+#include <inttypes.h>
+#include <stdlib.h>
 #include <string.h>
-#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
@@ -86,62 +87,180 @@ void acvp_print_expiry(FILE *stream, time_t expiry)
 		fprintf_green(stream, "in %lu days", (expiry - now) / 86400);
 }
 
+/*
+ * Size of the chunks a file is read and hashed in. The chunk buffer is page
+ * aligned so that the kernel can copy whole pages into it.
+ */
+#define ACVP_HASH_FILE_CHUNK (4UL << 20)
+
+/* Files of at least this size have the hashing progress logged */
+#define ACVP_HASH_FILE_PROGRESS (256ULL << 20)
+
 int acvp_hash_file(const char *pathname, const struct hash *hash,
 		   struct acvp_buf *md)
 {
 	struct stat statbuf;
 	HASH_CTX_ON_STACK(ctx);
-	ACVP_EXT_BUFFER_INIT(data);
+	uint64_t size, processed = 0;
+	uint8_t *chunk = NULL;
+	long pagesize;
+	unsigned int reported = 0;
 	int ret, fd;
 
-	if (stat(pathname, &statbuf)) {
+	fd = open(pathname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
 		ret = -errno;
 		logger(LOGGER_ERR, LOGGER_C_ANY,
 		       "File name %s does not exist\n", pathname);
 		return ret;
 	}
 
+	if (fstat(fd, &statbuf)) {
+		ret = -errno;
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot stat file %s (%d)\n", pathname, ret);
+		goto out;
+	}
+
 	if (!S_ISREG(statbuf.st_mode)) {
 		logger(LOGGER_ERR, LOGGER_C_ANY, "%s is not a regular file\n",
 		       pathname);
-		return -EINVAL;
+		ret = -EINVAL;
+		goto out;
 	}
 
-	CKINT(acvp_alloc_buf(hash->digestsize, md));
+	size = (uint64_t)statbuf.st_size;
 
-	fd = open(pathname, O_RDONLY | O_CLOEXEC);
-	if (fd < 0) {
-		ret = -errno;
+#ifdef POSIX_FADV_SEQUENTIAL
+	/* Allow the kernel to read ahead aggressively */
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
 
-		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-		       "Cannot open file %s (%d)\n", pathname, ret);
+	pagesize = sysconf(_SC_PAGESIZE);
+	if (pagesize <= 0)
+		pagesize = 4096;
+	ret = -posix_memalign((void **)&chunk, (size_t)pagesize,
+			      ACVP_HASH_FILE_CHUNK);
+	if (ret)
 		goto out;
-	}
 
-	data.buf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED,
-			fd, 0);
-	if (data.buf == MAP_FAILED) {
-		logger(LOGGER_WARN, LOGGER_C_DS_FILE, "Cannot mmap file %s\n",
-		       pathname);
-		ret = -ENOMEM;
-		goto out;
+	CKINT(acvp_alloc_buf(hash->digestsize, md));
+
+	hash->init(ctx);
+
+	while (1) {
+		ssize_t rc = read(fd, chunk, ACVP_HASH_FILE_CHUNK);
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+
+			ret = -errno;
+			logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+			       "Cannot read file %s (%d)\n", pathname, ret);
+			goto out;
+		}
+		if (!rc)
+			break;
+
+		hash->update(ctx, chunk, (size_t)rc);
+		processed += (uint64_t)rc;
+
+		/* Report every 10 percent of large files */
+		if (size >= ACVP_HASH_FILE_PROGRESS && processed < size &&
+		    (processed * 10 / size) > reported) {
+			reported = (unsigned int)(processed * 10 / size);
+			logger(LOGGER_VERBOSE, LOGGER_C_ANY,
+			       "Hashing of file %s: %u%% completed\n",
+			       pathname, reported * 10);
+		}
 	}
 
-	data.len = (uint32_t)statbuf.st_size;
+	if (processed != size) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "File %s changed size while hashing (expected %" PRIu64
+		       " bytes, hashed %" PRIu64 " bytes)\n",
+		       pathname, size, processed);
+	}
 
-	hash->init(ctx);
-	hash->update(ctx, data.buf, data.len);
 	hash->final(ctx, md->buf);
 
-	munmap(data.buf, (size_t)statbuf.st_size);
-	close(fd);
-
 	logger(LOGGER_DEBUG, LOGGER_C_ANY, "Hashing of file %s completed\n",
 	       pathname);
 	logger_binary(LOGGER_DEBUG, LOGGER_C_ANY, md->buf, md->len,
 		      "Message digest of file");
 
 out:
+	free(chunk);
+	close(fd);
+	return ret;
+}
+
+#ifdef ACVP_USE_PTHREAD
+static void *acvp_hash_files_thread(void *arg)
+{
+	struct acvp_hash_file_req *req = arg;
+
+	req->ret = acvp_hash_file(req->pathname, req->hash, req->md);
+	return NULL;
+}
+#endif
+
+int acvp_hash_files(struct acvp_hash_file_req *reqs, unsigned int num)
+{
+	unsigned int i;
+	int ret = 0;
+
+#ifdef ACVP_USE_PTHREAD
+	pthread_t *threads = NULL;
+	bool *started = NULL;
+
+	/*
+	 * The files are hashed while the definitions are loaded which happens
+	 * before the thread pool is initialized. Thus, each file gets a short
+	 * lived thread of its own while the caller hashes the first file.
+	 */
+	if (num > 1) {
+		threads = calloc(num, sizeof(*threads));
+		started = calloc(num, sizeof(*started));
+	}
+
+	if (threads && started) {
+		for (i = 1; i < num; i++) {
+			started[i] = !pthread_create(&threads[i], NULL,
+						     acvp_hash_files_thread,
+						     &reqs[i]);
+		}
+
+		acvp_hash_files_thread(&reqs[0]);
+
+		for (i = 1; i < num; i++) {
+			if (started[i])
+				pthread_join(threads[i], NULL);
+			else
+				acvp_hash_files_thread(&reqs[i]);
+		}
+	} else
+#endif
+	{
+		for (i = 0; i < num; i++) {
+			reqs[i].ret = acvp_hash_file(reqs[i].pathname,
+						     reqs[i].hash, reqs[i].md);
+		}
+	}
+
+#ifdef ACVP_USE_PTHREAD
+	free(threads);
+	free(started);
+#endif
+
+	for (i = 0; i < num; i++) {
+		if (reqs[i].ret) {
+			ret = reqs[i].ret;
+			break;
+		}
+	}
+
 	return ret;
 }
 
@@ -343,6 +343,7 @@ struct acvp_na_ex {
 	const struct acvp_net_ctx *net;
 	const char *url;
 	const struct acvp_auth_ctx *server_auth;
+	int response_fd; /* File receiving large responses or -1 */
 };
 
 /**
@@ -359,13 +360,21 @@ struct acvp_na_ex {
  *		    no data is either sent or requested. Even when the
  *		    submit_buf is NULL, the POST operation must be performed
  *		    with an empty HTTP body.
+ *		    The data of submit buffers chained with the next pointer
+ *		    is sent as one HTTP body. This also applies to
+ *		    acvp_http_put.
  * @acvp_http_post_multi: Multipart form-data submimssion of the submit buffer.
  * @acvp_http_get: Obtain data from the CAVP server using the provided URL.
  *		   The CAVP response shall be stored in the provided buffer.
  *		   This callback implements the HTTP GET of the data.
  *		   The data buffer must be allocated by the callback.
  *		   The caller may set the buffer to NULL when no data is
- *		   requested.
+ *		   requested. If netinfo->response_fd is a valid file
+ *		   descriptor and the response is larger than
+ *		   ACVP_NET_STREAM_HEADLEN, the entire response is written to
+ *		   the file while the buffer only receives its beginning.
+ *		   The file is truncated before the data is received. A
+ *		   backend not supporting this may always fill the buffer.
  * @acvp_http_put: Submit data with the HTTP PUT operation to the CAVP server.
  * @acvp_http_delete: Perform a HTTP DELETE operation on the given URL.
  * @acvp_http_interrupt: Signal handler interrupted network operation, shut down
@@ -475,6 +484,9 @@ struct acvp_vsid_ctx {
 	/* vsID response handler shall only attempt to download the verdict. */
 	bool fetch_verdict;
 
+	/* The verdict was obtained from the summary kept by the data store */
+	bool verdict_cached;
+
 	struct timespec start;
 };
 
@@ -505,6 +517,13 @@ struct acvp_vsid_ctx {
  * @acvp_datastore_write_vsid: Store generic information given with the data
  *			       buffer to the location pointed to by filename at
  *			       the vsID level.
+ * @acvp_datastore_stream_vsid: Store the data the stream callback writes to
+ *				the provided file descriptor to the location
+ *				pointed to by filename at the vsID level. The
+ *				file only appears under its name once the
+ *				callback returned successfully, i.e. a reader
+ *				never sees a partially written file. The
+ *				return code of the callback is returned.
  * @acvp_datastore_write_testid: Store generic information given with the data
  *			       	 buffer to the location pointed to by filename
  *				 at the testID level.
@@ -520,6 +539,10 @@ struct acvp_vsid_ctx {
  * @acvp_datastore_get_vsid_verdict Get verdict information for vsID
  * @acvp_datastore_file_rename_version Rename module: change version number
  * @acvp_datastore_file_rename_name Rename module: change module name
+ * @acvp_datastore_release_testid Write the cached state of the testID
+ * @acvp_datastore_batch Start (begin is true) or end a batch of writes of the
+ *			 calling thread which may be deferred until the batch
+ *			 ends
  */
 struct acvp_datastore_be {
 	int (*acvp_datastore_find_testsession)(const struct definition *def,
@@ -535,6 +558,12 @@ struct acvp_datastore_be {
 					 const char *filename,
 					 bool secure_location,
 					 const struct acvp_buf *data);
+	int (*acvp_datastore_stream_vsid)(
+		const struct acvp_vsid_ctx *vsid_ctx, const char *filename,
+		bool secure_location,
+		int (*stream)(const struct acvp_vsid_ctx *vsid_ctx, int fd,
+			      void *data),
+		void *data);
 	int (*acvp_datastore_write_testid)(
 		const struct acvp_testid_ctx *testid_ctx, const char *filename,
 		bool secure_location, const struct acvp_buf *data);
@@ -554,6 +583,9 @@ struct acvp_datastore_be {
 		const struct acvp_testid_ctx *testid_ctx, char *newversion);
 	int (*acvp_datastore_rename_name)(
 		const struct acvp_testid_ctx *testid_ctx, char *newname);
+	void (*acvp_datastore_release_testid)(
+		const struct acvp_testid_ctx *testid_ctx);
+	void (*acvp_datastore_batch)(bool begin);
 };
 
 /**
@@ -706,8 +738,16 @@ int acvp_process_retry_testid(const struct acvp_testid_ctx *testid_ctx,
  *		  by this function.
  * @param cb Callback function to invoke for each found data entry
  *
+ * The remaining pages are fetched in parallel while the callbacks process
+ * the preceding page. The callbacks are still invoked in order of the
+ * entries and from the calling thread. The number of entries requested per
+ * page is ACVP_PAGING_LIMIT unless the environment variable
+ * ACVP_PAGING_LIMIT_ENV specifies a different value.
+ *
  * @return 0 on success (no match), < 0 on error, EINTR (match found)
  */
+#define ACVP_PAGING_LIMIT 1000
+#define ACVP_PAGING_LIMIT_ENV "ACVPPROXY_PAGING_LIMIT"
 int acvp_paging_get(const struct acvp_testid_ctx *testid_ctx, const char *url,
 		    const unsigned int show_type, void *private,
 		    int (*cb)(void *private, struct json_object *dataentry));
@@ -859,6 +899,33 @@ int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
 		const struct acvp_ext_buf *submit, struct acvp_buf *response,
 		enum acvp_http_type nettype);
 
+/*
+ * Responses up to this size are held in memory, larger responses are
+ * streamed to the file provided with acvp_net_op_stream.
+ */
+#define ACVP_NET_STREAM_HEADLEN (1 << 16)
+
+/**
+ * @brief Helper to perform HTTP GET operation streaming large responses to
+ *	  a file
+ *
+ * @param testid_ctx [in] TestID context with set credentials
+ * @param url [in] URL to access
+ * @param response [out] Buffer to hold the response - if the response is
+ *			 streamed, the buffer only holds its beginning
+ * @param fd [in] File descriptor of the file receiving the entire response -
+ *		  the file is truncated first
+ * @param streamed [out] Does the response exceed ACVP_NET_STREAM_HEADLEN
+ *			 bytes and was therefore only written to the file
+ *			 (true) or is it held in the response buffer as well
+ *			 (false)
+ *
+ * @return: see acvp_net_op
+ */
+int acvp_net_op_stream(const struct acvp_testid_ctx *testid_ctx,
+		       const char *url, struct acvp_buf *response, int fd,
+		       bool *streamed);
+
 /************************************************************************
  * ACVP meta data handling
  ************************************************************************/
@@ -957,6 +1024,25 @@ int acvp_login(const struct acvp_testid_ctx *testid_ctx);
  */
 int acvp_login_refresh(const struct acvp_testid_ctx *testid_ctx_head);
 
+/**
+ * @brief Register the JWT auth token of the test session for the proactive
+ * renewal. The auth token is refreshed in the background together with the
+ * auth tokens of all other registered test sessions shortly before it
+ * expires. This way, the network operations of the test session do not need
+ * to wait for a TOTP value to log in again.
+ *
+ * The test session must be unregistered with acvp_jwt_renew_dequeue before
+ * its authentication context is released.
+ */
+void acvp_jwt_renew_enqueue(const struct acvp_testid_ctx *testid_ctx);
+
+/**
+ * @brief Unregister the JWT auth token of the test session from the proactive
+ * renewal. Once the function returns, the auth token is not accessed by the
+ * renewal any more.
+ */
+void acvp_jwt_renew_dequeue(const struct acvp_testid_ctx *testid_ctx);
+
 /**
  * @brief Check whether auth token needs a refresh by the ACVP server
  *
@@ -1075,6 +1161,31 @@ int acvp_req_check_filename(char *string, const size_t slen);
 void acvp_print_expiry(FILE *stream, time_t expiry);
 int acvp_hash_file(const char *pathname, const struct hash *hash,
 		   struct acvp_buf *md);
+
+/**
+ * @brief Request to hash one file with acvp_hash_files
+ *
+ * @param pathname File to be hashed
+ * @param hash Hash implementation to be used
+ * @param md Buffer receiving the message digest
+ * @param ret Return code of the hash operation of this file
+ */
+struct acvp_hash_file_req {
+	char pathname[FILENAME_MAX];
+	const struct hash *hash;
+	struct acvp_buf *md;
+	int ret;
+};
+
+/**
+ * @brief Hash independent files concurrently
+ *
+ * @param reqs [in/out] Array of hash requests
+ * @param num [in] Number of entries in reqs
+ *
+ * @return 0 on success, the first error of the requests otherwise
+ */
+int acvp_hash_files(struct acvp_hash_file_req *reqs, unsigned int num);
 int acvp_cert_ref(struct acvp_buf *buf);
 
 bool acvp_req_is_production(void);
@@ -1157,6 +1268,8 @@ int acvp_req_kas_r3_kc_method(const struct def_algo_kas_r3_kc *kcm,
 #define ACVP_DS_DEF_REFERENCE "definition_reference.json"
 /* File holding the ACVP request */
 #define ACVP_DS_DEF_REQUEST "request"
+/* File holding the state of all vsIDs of a test session */
+#define ACVP_DS_CATALOG "testid_catalog.json"
 
 /* Directories pointing to definition information */
 #define ACVP_DEF_DEFAULT_CONFIG_DIR "module_definitions"
@@ -1170,8 +1283,8 @@ int acvp_req_kas_r3_kc_method(const struct def_algo_kas_r3_kc *kcm,
  * Auxiliary information
  ************************************************************************/
 
-/* Max 128 MB */
-#define ACVP_RESPONSE_MAXLEN (1 << 27)
+/* Max 1 GB */
+#define ACVP_RESPONSE_MAXLEN (1 << 30)
 
 #ifdef __cplusplus
 }
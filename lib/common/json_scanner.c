@@ -0,0 +1,553 @@
+/* Scanner for JSON data without creating JSON objects
+ *
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#include <json-c/json_tokener.h>
+
+#include "json_scanner.h"
+
+/*
+ * JSON scanner
+ * ============
+ *
+ * The JSON-C tokener creates a JSON object for every value of the parsed
+ * data. For large vector sets, this costs a multiple of the size of the data
+ * in memory and the majority of the processing time. Callers only
+ * interested in a few keys of the data use the scanner instead which only
+ * reports the location of the values in the scanned buffer.
+ */
+
+enum json_scan_state {
+	/* A value is expected */
+	json_scan_value,
+	/* A value or the end of the array is expected */
+	json_scan_value_or_end,
+	/* A key is expected */
+	json_scan_key,
+	/* A key or the end of the object is expected */
+	json_scan_key_or_end,
+	/* A comma or the end of the object / array is expected */
+	json_scan_next,
+};
+
+static inline bool json_scan_is_ws(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\n' || c == '\r');
+}
+
+static inline bool json_scan_is_digit(char c)
+{
+	return (c >= '0' && c <= '9');
+}
+
+static inline bool json_scan_is_hex(char c)
+{
+	return (json_scan_is_digit(c) || (c >= 'a' && c <= 'f') ||
+		(c >= 'A' && c <= 'F'));
+}
+
+/* Find the end of a string starting after the opening quote */
+static int json_scan_string(const char *buf, size_t len, size_t *pos)
+{
+	size_t i = *pos;
+
+	while (i < len) {
+		unsigned char c = (unsigned char)buf[i];
+
+		if (c == '"') {
+			*pos = i;
+			return 0;
+		}
+
+		/* Control characters must be escaped */
+		if (c < 0x20)
+			return -EINVAL;
+
+		if (c == '\\') {
+			if (++i >= len)
+				return -EINVAL;
+
+			switch (buf[i]) {
+			case '"':
+			case '\\':
+			case '/':
+			case 'b':
+			case 'f':
+			case 'n':
+			case 'r':
+			case 't':
+				break;
+			case 'u':
+				if (i + 4 >= len ||
+				    !json_scan_is_hex(buf[i + 1]) ||
+				    !json_scan_is_hex(buf[i + 2]) ||
+				    !json_scan_is_hex(buf[i + 3]) ||
+				    !json_scan_is_hex(buf[i + 4]))
+					return -EINVAL;
+				i += 4;
+				break;
+			default:
+				return -EINVAL;
+			}
+		}
+
+		i++;
+	}
+
+	return -EINVAL;
+}
+
+/* Find the end of a number and determine whether it is an integer */
+static int json_scan_number(const char *buf, size_t len, size_t *pos,
+			    enum json_type *type)
+{
+	size_t i = *pos;
+
+	*type = json_type_int;
+
+	if (buf[i] == '-')
+		i++;
+
+	if (i >= len || !json_scan_is_digit(buf[i]))
+		return -EINVAL;
+
+	/* No leading zeros */
+	if (buf[i] == '0') {
+		i++;
+	} else {
+		while (i < len && json_scan_is_digit(buf[i]))
+			i++;
+	}
+
+	if (i < len && buf[i] == '.') {
+		*type = json_type_double;
+		i++;
+		if (i >= len || !json_scan_is_digit(buf[i]))
+			return -EINVAL;
+		while (i < len && json_scan_is_digit(buf[i]))
+			i++;
+	}
+
+	if (i < len && (buf[i] == 'e' || buf[i] == 'E')) {
+		*type = json_type_double;
+		i++;
+		if (i < len && (buf[i] == '+' || buf[i] == '-'))
+			i++;
+		if (i >= len || !json_scan_is_digit(buf[i]))
+			return -EINVAL;
+		while (i < len && json_scan_is_digit(buf[i]))
+			i++;
+	}
+
+	*pos = i;
+	return 0;
+}
+
+static int json_scan_literal(const char *buf, size_t len, size_t *pos,
+			     const char *literal)
+{
+	size_t litlen = strlen(literal);
+
+	if (len - *pos < litlen || memcmp(buf + *pos, literal, litlen))
+		return -EINVAL;
+
+	*pos += litlen;
+	return 0;
+}
+
+int json_scan(const char *buf, size_t len,
+	      int (*cb)(void *priv, const struct json_scan_event *ev),
+	      void *priv)
+{
+	struct json_scan_event ev;
+	enum json_scan_state state = json_scan_value;
+	/* Type of the enclosing objects and arrays: true for an object */
+	bool is_object[JSON_TOKENER_DEFAULT_DEPTH];
+	unsigned int depth = 0;
+	size_t pos = 0, start;
+	int ret;
+
+	if (!buf || !cb)
+		return -EINVAL;
+
+	memset(&ev, 0, sizeof(ev));
+
+	while (1) {
+		while (pos < len && json_scan_is_ws(buf[pos]))
+			pos++;
+
+		if (pos >= len)
+			return -EINVAL;
+
+		switch (state) {
+		case json_scan_key_or_end:
+		case json_scan_key:
+			if (buf[pos] == '}' && state == json_scan_key_or_end)
+				goto end;
+
+			if (buf[pos] != '"')
+				return -EINVAL;
+
+			start = ++pos;
+			ret = json_scan_string(buf, len, &pos);
+			if (ret)
+				return ret;
+			ev.key = buf + start;
+			ev.keylen = pos - start;
+			pos++;
+
+			while (pos < len && json_scan_is_ws(buf[pos]))
+				pos++;
+			if (pos >= len || buf[pos] != ':')
+				return -EINVAL;
+			pos++;
+
+			state = json_scan_value;
+			continue;
+
+		case json_scan_next:
+			if (!depth)
+				return 0;
+
+			if (buf[pos] == ',') {
+				pos++;
+				state = is_object[depth - 1] ? json_scan_key :
+							       json_scan_value;
+				continue;
+			}
+
+			if (buf[pos] == '}' || buf[pos] == ']')
+				goto end;
+
+			return -EINVAL;
+
+		case json_scan_value_or_end:
+			if (buf[pos] == ']')
+				goto end;
+			break;
+
+		case json_scan_value:
+		default:
+			break;
+		}
+
+		/* Parse one value */
+		ev.depth = depth;
+		ev.value = NULL;
+		ev.len = 0;
+		ev.end = false;
+
+		switch (buf[pos]) {
+		case '{':
+		case '[':
+			if (depth >= JSON_TOKENER_DEFAULT_DEPTH)
+				return -EINVAL;
+
+			ev.type = (buf[pos] == '{') ? json_type_object :
+						      json_type_array;
+			is_object[depth++] = (buf[pos] == '{');
+			pos++;
+
+			ret = cb(priv, &ev);
+			if (ret)
+				return (ret < 0) ? ret : 0;
+
+			ev.key = NULL;
+			ev.keylen = 0;
+			state = is_object[depth - 1] ? json_scan_key_or_end :
+						       json_scan_value_or_end;
+			continue;
+
+		case '"':
+			start = ++pos;
+			ret = json_scan_string(buf, len, &pos);
+			if (ret)
+				return ret;
+			ev.type = json_type_string;
+			ev.value = buf + start;
+			ev.len = pos - start;
+			pos++;
+			break;
+
+		case 't':
+			ev.type = json_type_boolean;
+			ev.value = buf + pos;
+			ret = json_scan_literal(buf, len, &pos, "true");
+			if (ret)
+				return ret;
+			ev.len = 4;
+			break;
+
+		case 'f':
+			ev.type = json_type_boolean;
+			ev.value = buf + pos;
+			ret = json_scan_literal(buf, len, &pos, "false");
+			if (ret)
+				return ret;
+			ev.len = 5;
+			break;
+
+		case 'n':
+			ev.type = json_type_null;
+			ev.value = buf + pos;
+			ret = json_scan_literal(buf, len, &pos, "null");
+			if (ret)
+				return ret;
+			ev.len = 4;
+			break;
+
+		default:
+			start = pos;
+			ret = json_scan_number(buf, len, &pos, &ev.type);
+			if (ret)
+				return ret;
+			ev.value = buf + start;
+			ev.len = pos - start;
+			break;
+		}
+
+		ret = cb(priv, &ev);
+		if (ret)
+			return (ret < 0) ? ret : 0;
+
+		ev.key = NULL;
+		ev.keylen = 0;
+		state = json_scan_next;
+
+		/* The top-level value is complete */
+		if (!depth)
+			return 0;
+
+		continue;
+
+end:
+		/* End of the object or array */
+		if ((buf[pos] == '}') != is_object[depth - 1])
+			return -EINVAL;
+		pos++;
+		depth--;
+
+		ev.depth = depth;
+		ev.key = NULL;
+		ev.keylen = 0;
+		ev.type = is_object[depth] ? json_type_object :
+					     json_type_array;
+		ev.value = NULL;
+		ev.len = 0;
+		ev.end = true;
+
+		ret = cb(priv, &ev);
+		if (ret)
+			return (ret < 0) ? ret : 0;
+
+		state = json_scan_next;
+
+		if (!depth)
+			return 0;
+	}
+}
+
+bool json_scan_match_key(const struct json_scan_event *ev,
+			 struct json_scan_key *keys, unsigned int nkeys)
+{
+	unsigned int i;
+
+	if (!ev->key || ev->end)
+		return false;
+
+	for (i = 0; i < nkeys; i++) {
+		struct json_scan_key *key = keys + i;
+
+		if (strlen(key->name) != ev->keylen ||
+		    memcmp(key->name, ev->key, ev->keylen))
+			continue;
+
+		key->type = ev->type;
+		key->value = ev->value;
+		key->len = ev->len;
+		key->found = true;
+		return true;
+	}
+
+	return false;
+}
+
+int json_scan_get_uint(const struct json_scan_key *key, uint32_t *integer)
+{
+	char tmp[24];
+	char *end;
+	long long val;
+
+	if (!key->found)
+		return -ENOENT;
+
+	if (key->type != json_type_int || key->len >= sizeof(tmp))
+		return -EINVAL;
+
+	memcpy(tmp, key->value, key->len);
+	tmp[key->len] = '\0';
+
+	errno = 0;
+	val = strtoll(tmp, &end, 10);
+	if (errno || *end || val < 0 || val >= INT_MAX)
+		return -EINVAL;
+
+	*integer = (uint32_t)val;
+
+	return 0;
+}
+
+int json_scan_get_bool(const struct json_scan_key *key, bool *val)
+{
+	if (!key->found)
+		return -ENOENT;
+
+	if (key->type != json_type_boolean)
+		return -EINVAL;
+
+	*val = (key->len == 4);
+
+	return 0;
+}
+
+static unsigned int json_scan_hex4(const char *in)
+{
+	unsigned int i, val = 0;
+
+	for (i = 0; i < 4; i++) {
+		char c = in[i];
+
+		val <<= 4;
+		if (c >= '0' && c <= '9')
+			val |= (unsigned int)(c - '0');
+		else if (c >= 'a' && c <= 'f')
+			val |= (unsigned int)(c - 'a' + 10);
+		else
+			val |= (unsigned int)(c - 'A' + 10);
+	}
+
+	return val;
+}
+
+/* Write the UTF-8 representation of the code point */
+static size_t json_scan_utf8(unsigned int cp, char *out)
+{
+	if (cp < 0x80) {
+		out[0] = (char)cp;
+		return 1;
+	}
+	if (cp < 0x800) {
+		out[0] = (char)(0xc0 | (cp >> 6));
+		out[1] = (char)(0x80 | (cp & 0x3f));
+		return 2;
+	}
+	if (cp < 0x10000) {
+		out[0] = (char)(0xe0 | (cp >> 12));
+		out[1] = (char)(0x80 | ((cp >> 6) & 0x3f));
+		out[2] = (char)(0x80 | (cp & 0x3f));
+		return 3;
+	}
+	out[0] = (char)(0xf0 | (cp >> 18));
+	out[1] = (char)(0x80 | ((cp >> 12) & 0x3f));
+	out[2] = (char)(0x80 | ((cp >> 6) & 0x3f));
+	out[3] = (char)(0x80 | (cp & 0x3f));
+	return 4;
+}
+
+int json_scan_get_string(const struct json_scan_key *key, char **outbuf)
+{
+	const char *in;
+	char *out;
+	size_t i, o = 0;
+
+	if (!key->found)
+		return -ENOENT;
+
+	if (key->type != json_type_string)
+		return -EINVAL;
+
+	/* A decoded string is never longer than its escaped representation */
+	out = malloc(key->len + 1);
+	if (!out)
+		return -ENOMEM;
+
+	in = key->value;
+	for (i = 0; i < key->len; i++) {
+		unsigned int cp;
+
+		if (in[i] != '\\') {
+			out[o++] = in[i];
+			continue;
+		}
+
+		/* The scanner validated the escape sequences */
+		switch (in[++i]) {
+		case 'b':
+			out[o++] = '\b';
+			break;
+		case 'f':
+			out[o++] = '\f';
+			break;
+		case 'n':
+			out[o++] = '\n';
+			break;
+		case 'r':
+			out[o++] = '\r';
+			break;
+		case 't':
+			out[o++] = '\t';
+			break;
+		case 'u':
+			cp = json_scan_hex4(in + i + 1);
+			i += 4;
+
+			/* Combine a surrogate pair */
+			if (cp >= 0xd800 && cp < 0xdc00 && i + 6 < key->len &&
+			    in[i + 1] == '\\' && in[i + 2] == 'u') {
+				unsigned int low = json_scan_hex4(in + i + 3);
+
+				if (low >= 0xdc00 && low < 0xe000) {
+					cp = 0x10000 + ((cp - 0xd800) << 10) +
+					     (low - 0xdc00);
+					i += 6;
+				}
+			}
+
+			/* Replace unpaired surrogates as JSON-C does */
+			if (cp >= 0xd800 && cp < 0xe000)
+				cp = 0xfffd;
+
+			o += json_scan_utf8(cp, out + o);
+			break;
+		default:
+			/* quote, backslash and slash */
+			out[o++] = in[i];
+			break;
+		}
+	}
+	out[o] = '\0';
+
+	*outbuf = out;
+
+	return 0;
+}
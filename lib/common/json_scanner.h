@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef _JSON_SCANNER_H
+#define _JSON_SCANNER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <json-c/json_object.h>
+
+#include "bool.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Event reported by json_scan for each JSON value and for the end of each
+ * object and array.
+ *
+ * @depth: Number of objects and arrays enclosing the value - the top-level
+ *	   value has the depth 0.
+ * @key: Key of the value if it is a member of an object, NULL otherwise.
+ *	 The key is not NUL-terminated and its escapes are not decoded.
+ * @keylen: Length of the key.
+ * @type: Type of the value.
+ * @value: Text of a string, number or literal in the scanned buffer. For
+ *	   strings the quotes are not included and escapes are not decoded.
+ *	   NULL for objects and arrays.
+ * @len: Length of the value text.
+ * @end: The event marks the end of an object or array.
+ */
+struct json_scan_event {
+	unsigned int depth;
+	const char *key;
+	size_t keylen;
+	enum json_type type;
+	const char *value;
+	size_t len;
+	bool end;
+};
+
+/**
+ * @brief Scan JSON data without creating JSON objects
+ *
+ * The function validates the syntax of the JSON data and reports every
+ * value to the callback in the order of the data. The values are not
+ * copied, the events only point into the scanned buffer. The maximum
+ * nesting depth is the one of the JSON-C tokener.
+ *
+ * @param buf [in] JSON data
+ * @param len [in] Length of JSON data
+ * @param cb [in] Callback invoked for each event. If it returns a negative
+ *		  value, the scan is aborted with that error. If it returns a
+ *		  positive value, the scan terminates successfully.
+ * @param priv [in] Pointer handed to the callback without inspection
+ *
+ * @return 0 on success, < 0 on error (-EINVAL for invalid JSON data)
+ */
+int json_scan(const char *buf, size_t len,
+	      int (*cb)(void *priv, const struct json_scan_event *ev),
+	      void *priv);
+
+/*
+ * Value of a key searched for by the caller of json_scan, e.g. with
+ * acvp_req_scan_keys.
+ */
+struct json_scan_key {
+	const char *name;
+	enum json_type type;
+	const char *value;
+	size_t len;
+	bool found;
+};
+
+/**
+ * @brief Match the key of a scan event against a list of searched keys
+ *
+ * @param ev [in] Scan event
+ * @param keys [in/out] Keys to search for - the value of a matching key is
+ *			set from the event
+ * @param nkeys [in] Number of keys
+ *
+ * @return true if a key matched, false otherwise
+ */
+bool json_scan_match_key(const struct json_scan_event *ev,
+			 struct json_scan_key *keys, unsigned int nkeys);
+
+/*
+ * Get the uint32_t representation of an integer found for the key.
+ */
+int json_scan_get_uint(const struct json_scan_key *key, uint32_t *integer);
+
+/*
+ * Get the boolean value found for the key.
+ */
+int json_scan_get_bool(const struct json_scan_key *key, bool *val);
+
+/*
+ * Get a copy of the decoded string found for the key - caller must free the
+ * string.
+ */
+int json_scan_get_string(const struct json_scan_key *key, char **outbuf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _JSON_SCANNER_H */
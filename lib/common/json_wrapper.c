@@ -20,6 +20,7 @@
 
 #include <limits.h>
 #include <errno.h>
+#include <string.h>
 
 #include "binhexbin.h"
 #include "json_wrapper.h"
@@ -273,6 +274,7 @@ int acvp_req_strip_version(const struct acvp_buf *buf,
 {
 	struct json_object *resp, *version;
 	struct json_tokener *tok;
+	struct json_arena *arena, *prev;
 	int ret = 0;
 
 	if (!buf || !buf->buf || !buf->len)
@@ -284,10 +286,27 @@ int acvp_req_strip_version(const struct acvp_buf *buf,
 	tok = json_tokener_new();
 	CKNULL(tok, -ENOMEM);
 
+	/*
+	 * The response tree is allocated from an arena which is released in
+	 * one step when the caller puts the full JSON object.
+	 */
+	arena = json_arena_new();
+	if (!arena) {
+		json_tokener_free(tok);
+		return -ENOMEM;
+	}
+
+	prev = json_arena_set(arena);
 	resp = json_tokener_parse_ex(tok, (const char *)buf->buf,
 				     (int)buf->len);
+	json_arena_set(prev);
 	json_tokener_free(tok);
 
+	if (!resp || json_arena_set_owner(resp)) {
+		json_arena_free(arena);
+		resp = NULL;
+	}
+
 	CKNULL_LOG(resp, -EINVAL, "JSON tokener cannot parse ASCII data\n");
 	json_logger(LOGGER_DEBUG2, LOGGER_C_ANY, resp,
 		    "Parsed ACVP response\n");
@@ -301,6 +320,160 @@ out:
 	return ret;
 }
 
+#define ACVP_REQ_SCAN_MAX_KEYS 16
+
+struct acvp_req_scan {
+	struct json_scan_key *keys;
+	/* Keys found in the current array entry */
+	struct json_scan_key entry_keys[ACVP_REQ_SCAN_MAX_KEYS];
+	unsigned int nkeys;
+	const char *version_keyword;
+	bool is_array;
+	bool entry_is_version;
+	bool version_found;
+	bool data_found;
+	bool early;
+};
+
+static bool acvp_req_scan_complete(const struct json_scan_key *keys,
+				   unsigned int nkeys)
+{
+	unsigned int i;
+
+	for (i = 0; i < nkeys; i++) {
+		if (!keys[i].found)
+			return false;
+	}
+
+	return true;
+}
+
+static int acvp_req_scan_cb(void *priv, const struct json_scan_event *ev)
+{
+	struct acvp_req_scan *scan = priv;
+	unsigned int i;
+
+	/* The response itself */
+	if (!ev->depth) {
+		if (ev->end)
+			return 0;
+
+		if (ev->type == json_type_array) {
+			scan->is_array = true;
+			return 0;
+		}
+		if (ev->type == json_type_object)
+			return 0;
+
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "JSON data is not an expected ACVP object\n");
+		return -EINVAL;
+	}
+
+	/* The response is the real data */
+	if (!scan->is_array) {
+		if (ev->depth == 1 &&
+		    json_scan_match_key(ev, scan->keys, scan->nkeys) &&
+		    scan->early &&
+		    acvp_req_scan_complete(scan->keys, scan->nkeys))
+			return 1;
+
+		return 0;
+	}
+
+	/* Array entry containing either the version or the real data */
+	if (ev->depth == 1) {
+		if (ev->type != json_type_object) {
+			logger(LOGGER_ERR, LOGGER_C_ANY,
+			       "JSON data are not expected ACVP objects\n");
+			return -EINVAL;
+		}
+
+		if (!ev->end) {
+			for (i = 0; i < scan->nkeys; i++)
+				scan->entry_keys[i].found = false;
+			scan->entry_is_version = false;
+			return 0;
+		}
+
+		if (scan->entry_is_version) {
+			scan->version_found = true;
+		} else {
+			/* As json_split_version, use the last data entry */
+			memcpy(scan->keys, scan->entry_keys,
+			       scan->nkeys * sizeof(*scan->keys));
+			scan->data_found = true;
+		}
+
+		return 0;
+	}
+
+	if (ev->depth != 2 || !ev->key)
+		return 0;
+
+	if (ev->keylen == strlen(scan->version_keyword) &&
+	    !memcmp(ev->key, scan->version_keyword, ev->keylen)) {
+		scan->entry_is_version = true;
+		return 0;
+	}
+
+	if (json_scan_match_key(ev, scan->entry_keys, scan->nkeys) &&
+	    scan->early && scan->version_found && !scan->entry_is_version &&
+	    acvp_req_scan_complete(scan->entry_keys, scan->nkeys)) {
+		memcpy(scan->keys, scan->entry_keys,
+		       scan->nkeys * sizeof(*scan->keys));
+		scan->data_found = true;
+		return 1;
+	}
+
+	return 0;
+}
+
+int acvp_req_scan_keys(const struct acvp_buf *buf, struct json_scan_key *keys,
+		       unsigned int nkeys, bool early)
+{
+	const struct acvp_net_proto *proto;
+	struct acvp_req_scan scan;
+	unsigned int i;
+	int ret;
+
+	CKNULL(keys, -EINVAL);
+	if (nkeys > ACVP_REQ_SCAN_MAX_KEYS)
+		return -EINVAL;
+
+	for (i = 0; i < nkeys; i++)
+		keys[i].found = false;
+
+	if (!buf || !buf->buf || !buf->len)
+		return 0;
+
+	CKINT(acvp_get_proto(&proto));
+
+	memset(&scan, 0, sizeof(scan));
+	scan.keys = keys;
+	scan.nkeys = nkeys;
+	scan.version_keyword = proto->proto_version_keyword;
+	scan.early = early;
+	memcpy(scan.entry_keys, keys, nkeys * sizeof(*keys));
+
+	ret = json_scan((const char *)buf->buf, buf->len, acvp_req_scan_cb,
+			&scan);
+	if (ret) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "JSON scanner cannot parse ASCII data\n");
+		goto out;
+	}
+
+	if (scan.is_array && (!scan.data_found || !scan.version_found)) {
+		logger(LOGGER_WARN, LOGGER_C_ANY,
+		       "No data found in ACVP server response\n");
+		ret = -EINVAL;
+	}
+
+out:
+	return ret;
+}
+
 int json_read_data(const char *filename, struct json_object **inobj)
 {
 	struct json_object *o = json_object_from_file(filename);
@@ -328,6 +501,63 @@ out:
 	return ret;
 }
 
+int json_to_buf(struct json_object *jobj, int flags, struct acvp_buf *buf)
+{
+	struct printbuf *pb = printbuf_new();
+	size_t len;
+	int ret = 0;
+
+	CKNULL(pb, -ENOMEM);
+
+	if (json_object_to_printbuf(jobj, pb, flags, &len) < 0) {
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "JSON object conversion into string failed\n");
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	if (len > UINT32_MAX) {
+		ret = -EOVERFLOW;
+		goto out;
+	}
+
+	acvp_free_buf(buf);
+	buf->buf = (uint8_t *)printbuf_steal(pb, NULL);
+	buf->len = (uint32_t)len;
+	buf->size = buf->len + 1;
+	pb = NULL;
+
+out:
+	if (pb)
+		printbuf_free(pb);
+	return ret;
+}
+
+int json_print(FILE *stream, struct json_object *jobj, int flags)
+{
+	struct printbuf *pb;
+	int ret = 0;
+
+	/* Data buffered by the stream must precede the JSON data */
+	if (fflush(stream))
+		return -errno;
+
+	pb = printbuf_new_fd(fileno(stream));
+	CKNULL(pb, -errno);
+
+	if (json_object_to_printbuf(jobj, pb, flags, NULL) < 0 ||
+	    printbuf_strappend(pb, "\n") < 0 || printbuf_flush(pb) < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "Cannot write JSON data (%d)\n", ret);
+	}
+
+	printbuf_free(pb);
+
+out:
+	return ret;
+}
+
 int json_add_bin2hex(struct json_object *dst, const char *key,
 		     const struct acvp_buf *buf)
 {
@@ -21,10 +21,12 @@
 #define _JSON_WRAPPER_H
 
 #include <stdint.h>
+#include <stdio.h>
 #include <json-c/json.h>
 
 #include "bool.h"
 #include "buffer.h"
+#include "json_scanner.h"
 #include "logger.h"
 
 #ifdef __cplusplus
@@ -102,6 +104,26 @@ int acvp_req_strip_version(const struct acvp_buf *buf,
 			   struct json_object **full_json,
 			   struct json_object **parsed);
 
+/**
+ * Scan ACVP server response for the given keys of the real data without
+ * parsing the response into JSON objects
+ *
+ * The response is interpreted like with acvp_req_strip_version: the keys are
+ * searched for in the array entry that does not contain the version or in
+ * the response itself if it is an object. Keys of nested objects are not
+ * matched. The JSON data is validated completely unless early is set.
+ *
+ * @buf: [in] buffer containing JSON data from ACVP server
+ * @keys: [in/out] keys to search for - found keys point into buf
+ * @nkeys: [in] number of keys
+ * @early: [in] terminate the scan as soon as all keys are found in the real
+ *		data following the version entry
+ *
+ * Note: An empty buffer is no error, no keys are found in this case.
+ */
+int acvp_req_scan_keys(const struct acvp_buf *buf, struct json_scan_key *keys,
+		       unsigned int nkeys, bool early);
+
 /**
  * Read JSON file
  *
@@ -110,6 +132,31 @@ int acvp_req_strip_version(const struct acvp_buf *buf,
  */
 int json_read_data(const char *filename, struct json_object **inobj);
 
+/**
+ * Serialize JSON object into a newly allocated buffer
+ *
+ * Contrary to json_object_to_json_string_ext, the string is not kept with the
+ * JSON object and its length is known without inspecting it.
+ *
+ * @param jobj [in] JSON object to serialize
+ * @param flags [in] JSON_C_TO_STRING_* flags
+ * @param buf [out] Buffer holding the NUL-terminated string - the caller must
+ *		    release it with acvp_free_buf.
+ */
+int json_to_buf(struct json_object *jobj, int flags, struct acvp_buf *buf);
+
+/**
+ * Write serialized JSON object followed by a newline to the stream
+ *
+ * The data is written in chunks to the file descriptor of the stream without
+ * creating the complete string first.
+ *
+ * @param stream [in] Stream to write to
+ * @param jobj [in] JSON object to serialize
+ * @param flags [in] JSON_C_TO_STRING_* flags
+ */
+int json_print(FILE *stream, struct json_object *jobj, int flags);
+
 /*
  * Add a JSON string entry with the given key by converting the binary data
  * given with buf
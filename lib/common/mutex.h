@@ -22,6 +22,7 @@
 
 #include <pthread.h>
 
+#include "bool.h"
 #include "logger.h"
 
 /**
@@ -71,6 +72,20 @@ static inline void mutex_init(mutex_t *mutex, int locked)
 		mutex_lock(mutex);
 }
 
+/**
+ * Mutual exclusion lock: Attempt to take the lock. The function will never
+ * block but return whether the lock was successfully taken or not.
+ *
+ * @param mutex [in] lock variable to lock
+ * @return true if lock was taken, false if lock was not taken
+ */
+static inline bool mutex_trylock(mutex_t *mutex)
+{
+	if (pthread_rwlock_trywrlock(mutex))
+		return false;
+	return true;
+}
+
 static inline void mutex_destroy(mutex_t *mutex)
 {
 	pthread_rwlock_destroy(mutex);
@@ -136,7 +136,7 @@ static int acvp_nsurl_http_common(const struct acvp_na_ex *netinfo,
 	const struct acvp_auth_ctx *auth = netinfo->server_auth;
 	NSURL *url;
 	NSMutableURLRequest *urlRequest;
-	NSString *submit;
+	NSMutableData *submit = nil;
 	ACVPHTTPRequest *http;
 	const char *http_type_str;
 	char useragent[30];
@@ -170,14 +170,19 @@ static int acvp_nsurl_http_common(const struct acvp_na_ex *netinfo,
 	CKINT(acvp_versionstring_short(useragent, sizeof(useragent)));
 
 	if (submit_buf) {
+		const struct acvp_ext_buf *s_buf;
+
 		[urlRequest setValue:@"application/json"
 		  forHTTPHeaderField:@"Content-Type"];
 		[urlRequest setValue:[NSString stringWithFormat:@"%u",
-				      submit_buf->len]
+				      acvp_ext_buf_len(submit_buf)]
 		  forHTTPHeaderField:@"Content-Length"];
-		
-		submit = [NSString stringWithFormat:@"%s",
-			  submit_buf->buf];
+
+		/* The chained buffers form one HTTP body */
+		submit = [NSMutableData
+			  dataWithCapacity:acvp_ext_buf_len(submit_buf)];
+		for (s_buf = submit_buf; s_buf; s_buf = s_buf->next)
+			[submit appendBytes:s_buf->buf length:s_buf->len];
 	}
         
 	if (auth && auth->jwt_token && auth->jwt_token_len) {
@@ -204,36 +209,35 @@ static int acvp_nsurl_http_common(const struct acvp_na_ex *netinfo,
 		http_type_str = "POST";
 		logger(LOGGER_DEBUG, LOGGER_C_CURL,
 		       "Performing an HTTP POST operation\n");
-		if (!submit_buf || !submit_buf->buf || !submit_buf->len) {
+		if (!acvp_ext_buf_len(submit_buf)) {
 			logger(LOGGER_WARN, LOGGER_C_CURL, "Nothing to POST\n");
 			ret = -EINVAL;
 			goto out;
 		}
 
 		[urlRequest setHTTPMethod:@"POST"];
-		[urlRequest setHTTPBody:
-		 [submit dataUsingEncoding:NSUTF8StringEncoding]];
+		[urlRequest setHTTPBody:submit];
 			
 		logger(LOGGER_DEBUG, LOGGER_C_CURL,
-		       "About to HTTP POST the following data:\n%s\n",
-		       submit_buf->buf);
+		       "About to HTTP POST the following data:\n%.*s\n",
+		       (int)[submit length], (const char *)[submit bytes]);
 		break;
 	case acvp_http_put:
 		http_type_str = "PUT";
 		logger(LOGGER_DEBUG, LOGGER_C_CURL,
 		       "Performing an HTTP PUT operation\n");
-		if (!submit_buf || !submit_buf->buf || !submit_buf->len) {
+		if (!acvp_ext_buf_len(submit_buf)) {
 			logger(LOGGER_WARN, LOGGER_C_CURL, "Nothing to PUT\n");
 			ret = -EINVAL;
 			goto out;
 		}
 
 		[urlRequest setHTTPMethod:@"PUT"];
-		[urlRequest setHTTPBody:[submit dataUsingEncoding:NSUTF8StringEncoding]];
+		[urlRequest setHTTPBody:submit];
 
 		logger(LOGGER_DEBUG, LOGGER_C_CURL,
-		       "About to HTTP PUT the following data:\n%s\n",
-		       submit_buf->buf);
+		       "About to HTTP PUT the following data:\n%.*s\n",
+		       (int)[submit length], (const char *)[submit bytes]);
 		break;
 	case acvp_http_delete:
 		http_type_str = "DELETE";
@@ -425,7 +429,26 @@ static int acvp_nsurl_http_post_multi(const struct acvp_na_ex *netinfo,
 					  dataUsingEncoding:NSUTF8StringEncoding]];
 		}
 
-		if (s_buf->buf) {
+		if (s_buf->file_len) {
+			NSFileHandle *file = [[NSFileHandle alloc]
+				initWithFileDescriptor:s_buf->file_fd
+					closeOnDealloc:NO];
+			NSData *file_data;
+
+			logger(LOGGER_DEBUG, LOGGER_C_CURL,
+			       "Adding file data of length %llu\n",
+			       (unsigned long long)s_buf->file_len);
+			[file seekToFileOffset:0];
+			file_data = [file readDataOfLength:
+				(NSUInteger)s_buf->file_len];
+			if ([file_data length] != s_buf->file_len) {
+				logger(LOGGER_ERR, LOGGER_C_CURL,
+				       "Reading of upload data failed\n");
+				ret = -EIO;
+				goto out;
+			}
+			[body appendData:file_data];
+		} else if (s_buf->buf) {
 			logger(LOGGER_DEBUG, LOGGER_C_CURL,
 			       "Adding binary data of length %u\n",
 			       s_buf->len);
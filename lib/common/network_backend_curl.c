@@ -18,9 +18,15 @@
  * DAMAGE.
  */
 
+#define _GNU_SOURCE
+#include <inttypes.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <strings.h>
+#include <time.h>
 #include <unistd.h>
 
 #include <curl/curl.h>
@@ -29,11 +35,28 @@
 #include "logger.h"
 #include "acvpproxy.h"
 #include "internal.h"
+#include "mutex_w.h"
+#include "network_backend_curl_multi.h"
 #include "sleep.h"
 
 #define HTTP_OK 200
 #define ACVP_CURL_MAX_RETRIES 3
 
+/*
+ * Backoff in seconds after a failed transfer: the backoff starts at
+ * ACVP_CURL_BACKOFF_BASE and doubles with every failure up to
+ * ACVP_CURL_BACKOFF_MAX. A random jitter of up to half the backoff is added
+ * to prevent concurrent transfers from retrying in lock step.
+ */
+#define ACVP_CURL_BACKOFF_BASE 2
+#define ACVP_CURL_BACKOFF_MAX 30
+
+/*
+ * Maximum number of idle CURL handles kept for reuse. Each idle handle may
+ * hold a live connection to the ACVP server.
+ */
+#define ACVP_CURL_POOL_SIZE 32
+
 #define CURL_CKINT(x)                                                          \
 	{                                                                      \
 		cret = x;                                                      \
@@ -48,11 +71,215 @@
  */
 static atomic_bool_t acvp_curl_interrupted = ATOMIC_BOOL_INIT(false);
 
+/*
+ * Is the multi interface event loop used for the HTTP transfers? The choice is
+ * made with the first HTTP transfer.
+ */
+static atomic_bool_t acvp_curl_multi_selected = ATOMIC_BOOL_INIT(false);
+static DEFINE_MUTEX_W_UNLOCKED(acvp_curl_multi_select_lock);
+static bool acvp_curl_multi_enabled = false;
+
+/*
+ * Enable the multi interface event loop if requested by the user. The event
+ * loop is started with the first HTTP transfer and therefore only in processes
+ * performing network operations.
+ */
+static void acvp_curl_multi_select(void)
+{
+	const char *env;
+	unsigned long max_inflight;
+
+	if (atomic_bool_read(&acvp_curl_multi_selected))
+		return;
+
+	mutex_w_lock(&acvp_curl_multi_select_lock);
+	if (atomic_bool_read(&acvp_curl_multi_selected))
+		goto out;
+
+#ifdef HAVE_SECURE_GETENV
+	env = secure_getenv(ACVP_CURL_MULTI_ENV);
+#else
+	env = getenv(ACVP_CURL_MULTI_ENV);
+#endif
+	if (env) {
+		max_inflight = strtoul(env, NULL, 10);
+		if (max_inflight > UINT_MAX)
+			max_inflight = 0;
+
+		if (!acvp_curl_multi_init((unsigned int)max_inflight))
+			acvp_curl_multi_enabled = true;
+	}
+
+	atomic_bool_set_true(&acvp_curl_multi_selected);
+
+out:
+	mutex_w_unlock(&acvp_curl_multi_select_lock);
+}
+
+/*
+ * Perform the HTTP transfer - either with the blocking easy interface or with
+ * the multi interface event loop.
+ */
+static CURLcode acvp_curl_perform(CURL *curl)
+{
+	acvp_curl_multi_select();
+
+	if (acvp_curl_multi_enabled)
+		return acvp_curl_multi_perform(curl);
+	return curl_easy_perform(curl);
+}
+
 static void acvp_curl_interrupt(void)
 {
 	atomic_bool_set_true(&acvp_curl_interrupted);
 }
 
+/*
+ * Connection pool
+ * ===============
+ *
+ * Setting up a TCP connection with mutual TLS authentication to the ACVP
+ * server is the most expensive part of an HTTP request. To avoid paying this
+ * price for every request, the CURL handles are not destroyed after an
+ * HTTP operation but returned to a pool of idle handles. A handle obtained
+ * from the pool retains its live connections.
+ *
+ * In addition, all handles are attached to one share object which provides
+ * a common DNS cache and TLS session cache. This allows a thread to resume
+ * the TLS session established by another thread. The connection cache is not
+ * shared as libcurl does not support sharing it between concurrently used
+ * handles - each handle keeps its own connections.
+ */
+static CURLSH *acvp_curl_share = NULL;
+static mutex_w_t acvp_curl_share_lock[CURL_LOCK_DATA_LAST];
+
+static CURL *acvp_curl_pool[ACVP_CURL_POOL_SIZE];
+static unsigned int acvp_curl_pool_avail = 0;
+static DEFINE_MUTEX_W_UNLOCKED(acvp_curl_pool_lock);
+
+static void acvp_curl_share_lock_cb(CURL *handle, curl_lock_data data,
+				    curl_lock_access access, void *userptr)
+{
+	(void)handle;
+	(void)access;
+	(void)userptr;
+
+	if (data < CURL_LOCK_DATA_LAST)
+		mutex_w_lock(&acvp_curl_share_lock[data]);
+}
+
+static void acvp_curl_share_unlock_cb(CURL *handle, curl_lock_data data,
+				      void *userptr)
+{
+	(void)handle;
+	(void)userptr;
+
+	if (data < CURL_LOCK_DATA_LAST)
+		mutex_w_unlock(&acvp_curl_share_lock[data]);
+}
+
+static void acvp_curl_share_init(void)
+{
+	CURLSH *share;
+	unsigned int i;
+
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		mutex_w_init(&acvp_curl_share_lock[i], 0);
+
+	share = curl_share_init();
+	if (!share)
+		return;
+
+	if (curl_share_setopt(share, CURLSHOPT_LOCKFUNC,
+			      acvp_curl_share_lock_cb) ||
+	    curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC,
+			      acvp_curl_share_unlock_cb) ||
+	    curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS) ||
+	    curl_share_setopt(share, CURLSHOPT_SHARE,
+			      CURL_LOCK_DATA_SSL_SESSION)) {
+		curl_share_cleanup(share);
+		return;
+	}
+
+	acvp_curl_share = share;
+}
+
+static void acvp_curl_share_release(void)
+{
+	unsigned int i;
+
+	if (acvp_curl_share) {
+		curl_share_cleanup(acvp_curl_share);
+		acvp_curl_share = NULL;
+	}
+
+	for (i = 0; i < CURL_LOCK_DATA_LAST; i++)
+		mutex_w_destroy(&acvp_curl_share_lock[i]);
+}
+
+/*
+ * Obtain a CURL handle - an idle handle from the pool is preferred, a new
+ * handle is only allocated if the pool is empty. The handle is returned
+ * with all options reset.
+ */
+static CURL *acvp_curl_handle_get(void)
+{
+	CURL *curl = NULL;
+
+	mutex_w_lock(&acvp_curl_pool_lock);
+	if (acvp_curl_pool_avail) {
+		acvp_curl_pool_avail--;
+		curl = acvp_curl_pool[acvp_curl_pool_avail];
+		acvp_curl_pool[acvp_curl_pool_avail] = NULL;
+	}
+	mutex_w_unlock(&acvp_curl_pool_lock);
+
+	if (curl) {
+		/* Live connections and caches are left untouched */
+		curl_easy_reset(curl);
+		logger(LOGGER_DEBUG, LOGGER_C_CURL,
+		       "Reusing CURL handle from connection pool\n");
+	} else {
+		curl = curl_easy_init();
+	}
+
+	return curl;
+}
+
+/*
+ * Return a CURL handle to the pool. If the pool is full or the network
+ * operation was interrupted, the handle is released.
+ */
+static void acvp_curl_handle_put(CURL *curl)
+{
+	if (!curl)
+		return;
+
+	if (!atomic_bool_read(&acvp_curl_interrupted)) {
+		mutex_w_lock(&acvp_curl_pool_lock);
+		if (acvp_curl_pool_avail < ACVP_CURL_POOL_SIZE) {
+			acvp_curl_pool[acvp_curl_pool_avail] = curl;
+			acvp_curl_pool_avail++;
+			curl = NULL;
+		}
+		mutex_w_unlock(&acvp_curl_pool_lock);
+	}
+
+	if (curl)
+		curl_easy_cleanup(curl);
+}
+
+static void acvp_curl_pool_release(void)
+{
+	mutex_w_lock(&acvp_curl_pool_lock);
+	while (acvp_curl_pool_avail) {
+		acvp_curl_pool_avail--;
+		curl_easy_cleanup(acvp_curl_pool[acvp_curl_pool_avail]);
+		acvp_curl_pool[acvp_curl_pool_avail] = NULL;
+	}
+	mutex_w_unlock(&acvp_curl_pool_lock);
+}
+
 static int acvp_curl_progress_callback(void *clientp, curl_off_t dltotal,
 				       curl_off_t dlnow, curl_off_t ultotal,
 				       curl_off_t ulnow)
@@ -66,24 +293,59 @@ static int acvp_curl_progress_callback(void *clientp, curl_off_t dltotal,
 	return atomic_bool_read(&acvp_curl_interrupted);
 }
 
+/*
+ * Upload of the submit buffer chain: the data of all chained buffers is sent
+ * as one HTTP body. The data is read directly from the buffers, the
+ * upload can be rewound as curl may need to send the data again.
+ */
+struct acvp_curl_upload {
+	const struct acvp_ext_buf *head;
+	const struct acvp_ext_buf *curr;
+	uint32_t offset;
+};
+
+static void acvp_curl_upload_log(const struct acvp_ext_buf *submit_buf,
+				 const char *http_type_str)
+{
+	if (logger_get_verbosity(LOGGER_C_CURL) < LOGGER_DEBUG)
+		return;
+
+	logger(LOGGER_DEBUG, LOGGER_C_CURL,
+	       "Performing an HTTP %s operation of following data:\n",
+	       http_type_str);
+
+	/* The data is not necessarily NULL-terminated */
+	for (; submit_buf; submit_buf = submit_buf->next) {
+		logger(LOGGER_DEBUG, LOGGER_C_CURL, "%.*s\n",
+		       (int)submit_buf->len, (const char *)submit_buf->buf);
+	}
+}
+
 static size_t acvp_curl_read_cb(char *buffer, size_t size, size_t nitems,
 				void *userdata)
 {
-	struct acvp_buf *send_buf = (struct acvp_buf *)userdata;
-	size_t sendsize = (size * nitems);
+	struct acvp_curl_upload *upload = (struct acvp_curl_upload *)userdata;
+	size_t bufsize = (size * nitems), sendsize = 0, len;
 
-	if (!send_buf)
+	if (!upload)
 		return 0;
 
-	if (sendsize > send_buf->len)
-		sendsize = send_buf->len;
+	while (upload->curr && sendsize < bufsize) {
+		const struct acvp_ext_buf *curr = upload->curr;
 
-	if (!sendsize)
-		return 0;
+		len = curr->len - upload->offset;
+		if (len > bufsize - sendsize)
+			len = bufsize - sendsize;
 
-	memcpy(buffer, send_buf->buf, sendsize);
-	send_buf->buf += sendsize;
-	send_buf->len -= (uint32_t)sendsize;
+		memcpy(buffer + sendsize, curr->buf + upload->offset, len);
+		sendsize += len;
+		upload->offset += (uint32_t)len;
+
+		if (upload->offset >= curr->len) {
+			upload->curr = curr->next;
+			upload->offset = 0;
+		}
+	}
 
 	logger(LOGGER_DEBUG2, LOGGER_C_CURL, "Number of bytes uploaded: %zu\n",
 	       sendsize);
@@ -91,13 +353,68 @@ static size_t acvp_curl_read_cb(char *buffer, size_t size, size_t nitems,
 	return sendsize;
 }
 
+static int acvp_curl_seek_cb(void *userdata, curl_off_t offset, int origin)
+{
+	struct acvp_curl_upload *upload = (struct acvp_curl_upload *)userdata;
+	const struct acvp_ext_buf *curr;
+
+	if (!upload || origin != SEEK_SET || offset < 0)
+		return CURL_SEEKFUNC_CANTSEEK;
+
+	for (curr = upload->head; curr; curr = curr->next) {
+		if (offset < curr->len)
+			break;
+		offset -= curr->len;
+	}
+
+	/* Seeking to the end of the data is allowed */
+	if (!curr && offset)
+		return CURL_SEEKFUNC_FAIL;
+
+	upload->curr = curr;
+	upload->offset = (uint32_t)offset;
+
+	return CURL_SEEKFUNC_OK;
+}
+
+/*
+ * Destination of the response data: the buffer receives the response unless
+ * a file is given and the response exceeds ACVP_NET_STREAM_HEADLEN. In this
+ * case, the entire response is written to the file while the buffer keeps
+ * the data received so far for inspection by the caller.
+ */
+struct acvp_curl_response {
+	struct acvp_buf *buf;
+	int fd;
+	bool streaming;
+};
+
+static int acvp_curl_write_fd(int fd, const uint8_t *data, size_t len)
+{
+	ssize_t written;
+
+	while (len) {
+		written = write(fd, data, len);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += written;
+		len -= (size_t)written;
+	}
+
+	return 0;
+}
+
 static size_t acvp_curl_write_cb(void *ptr, size_t size, size_t nmemb,
 				 void *userdata)
 {
-	struct acvp_buf *response_buf = (struct acvp_buf *)userdata;
+	struct acvp_curl_response *response = userdata;
+	struct acvp_buf *response_buf = response->buf;
 	size_t bufsize = (size * nmemb);
 	size_t totalsize;
-	uint8_t *resp_p;
+	int ret;
 
 	if (!response_buf) {
 		logger(LOGGER_DEBUG, LOGGER_C_CURL,
@@ -110,6 +427,28 @@ static size_t acvp_curl_write_cb(void *ptr, size_t size, size_t nmemb,
 	if (!bufsize)
 		return 0;
 
+	if (response->fd >= 0 &&
+	    (response->streaming ||
+	     bufsize + response_buf->len >= ACVP_NET_STREAM_HEADLEN)) {
+		if (!response->streaming && response_buf->len) {
+			ret = acvp_curl_write_fd(response->fd,
+						 response_buf->buf,
+						 response_buf->len);
+			if (ret)
+				goto err;
+		}
+		response->streaming = true;
+
+		ret = acvp_curl_write_fd(response->fd, ptr, bufsize);
+		if (ret)
+			goto err;
+
+		logger(LOGGER_DEBUG2, LOGGER_C_CURL,
+		       "Streamed data chunk (len %zu) to file\n", bufsize);
+
+		return bufsize;
+	}
+
 	totalsize = bufsize + response_buf->len;
 	if (totalsize > ACVP_RESPONSE_MAXLEN || totalsize < response_buf->len) {
 		logger(LOGGER_WARN, LOGGER_C_CURL,
@@ -117,29 +456,80 @@ static size_t acvp_curl_write_cb(void *ptr, size_t size, size_t nmemb,
 		return 0;
 	}
 
-	if (!response_buf->buf)
-		response_buf->buf = malloc(bufsize + 1); /* add one for \0 */
-	else
-		response_buf->buf = realloc(response_buf->buf, totalsize + 1);
-
-	if (!response_buf->buf) {
-		response_buf->len = 0;
+	if (acvp_buf_append(response_buf, ptr, (uint32_t)bufsize))
 		return 0;
+
+	logger(LOGGER_DEBUG2, LOGGER_C_CURL,
+	       "Retrieved data chunk (len %zu, total %u): %.*s\n", bufsize,
+	       response_buf->len, (int)bufsize,
+	       response_buf->buf + response_buf->len - bufsize);
+
+	return bufsize;
+
+err:
+	logger(LOGGER_WARN, LOGGER_C_CURL,
+	       "Writing received data to file failed: %d\n", ret);
+	return 0;
+}
+
+/* Size the response buffer according to the announced Content-Length */
+static size_t acvp_curl_header_cb(char *buffer, size_t size, size_t nitems,
+				  void *userdata)
+{
+	struct acvp_curl_response *response = userdata;
+	struct acvp_buf *response_buf = response->buf;
+	static const char content_length[] = "Content-Length:";
+	size_t hdrsize = size * nitems;
+	unsigned long long len;
+	char value[24];
+
+	if (!response_buf || hdrsize <= sizeof(content_length) - 1 ||
+	    strncasecmp(buffer, content_length, sizeof(content_length) - 1))
+		return hdrsize;
+
+	/* The header line is not NULL-terminated */
+	hdrsize -= sizeof(content_length) - 1;
+	snprintf(value, sizeof(value), "%.*s",
+		 (int)(hdrsize < sizeof(value) ? hdrsize : sizeof(value) - 1),
+		 buffer + sizeof(content_length) - 1);
+	len = strtoull(value, NULL, 10);
+
+	/* A streamed response does not need to fit into the buffer */
+	if (response->fd >= 0 && len >= ACVP_NET_STREAM_HEADLEN)
+		return size * nitems;
+
+	/*
+	 * The size is only a hint - if the allocation fails, the buffer
+	 * grows while receiving the data.
+	 */
+	if (len && len < ACVP_RESPONSE_MAXLEN) {
+		logger(LOGGER_DEBUG2, LOGGER_C_CURL,
+		       "Reserve %llu bytes for response data\n", len);
+		acvp_buf_reserve(response_buf,
+				 response_buf->len + (uint32_t)len + 1);
 	}
 
-	resp_p = response_buf->buf + response_buf->len;
-	response_buf->len = (uint32_t)totalsize;
+	return size * nitems;
+}
 
-	memcpy(resp_p, ptr, bufsize);
+/* Drop the data a previous transfer attempt streamed to the file */
+static int acvp_curl_response_truncate(struct acvp_curl_response *response)
+{
+	int ret;
 
-	/* NULL-terminate string */
-	response_buf->buf[response_buf->len] = '\0';
+	response->streaming = false;
+	if (response->fd < 0)
+		return 0;
 
-	logger(LOGGER_DEBUG2, LOGGER_C_CURL,
-	       "Current complete retrieved data (len %u): %s\n",
-	       response_buf->len, response_buf->buf);
+	if (ftruncate(response->fd, 0) < 0 ||
+	    lseek(response->fd, 0, SEEK_SET) < 0) {
+		ret = -errno;
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Truncating response file failed: %d\n", ret);
+		return ret;
+	}
 
-	return bufsize;
+	return 0;
 }
 
 static int acvp_curl_add_auth_hdr(const struct acvp_auth_ctx *auth,
@@ -273,7 +663,7 @@ static int acvp_curl_debug_cb(CURL *handle, curl_infotype type, char *data,
 }
 
 static int acvp_curl_common_init(const struct acvp_na_ex *netinfo,
-				 struct acvp_buf *response_buf,
+				 struct acvp_curl_response *response,
 				 struct curl_slist **slist, CURL **curl_ret)
 {
 	const struct acvp_net_ctx *net = netinfo->net;
@@ -291,8 +681,11 @@ static int acvp_curl_common_init(const struct acvp_na_ex *netinfo,
 
 	CKINT(acvp_curl_add_auth_hdr(auth, slist));
 
-	curl = curl_easy_init();
+	curl = acvp_curl_handle_get();
 	CKNULL(curl, -ENOMEM);
+	if (acvp_curl_share)
+		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_SHARE,
+					    acvp_curl_share));
 	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_URL, url));
 	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_NOPROGRESS, 1L));
 	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_USERAGENT, useragent));
@@ -367,37 +760,58 @@ static int acvp_curl_common_init(const struct acvp_na_ex *netinfo,
 	 * If the caller wants the HTTP data from the server
 	 * set the callback function
 	 */
-	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_WRITEDATA, response_buf));
+	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_WRITEDATA, response));
 	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION,
 				    acvp_curl_write_cb));
+	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_HEADERDATA, response));
+	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION,
+				    acvp_curl_header_cb));
 
 	*curl_ret = curl;
 
 out:
 	if (ret && curl)
-		curl_easy_cleanup(curl);
+		acvp_curl_handle_put(curl);
 	return ret;
 }
 
+static unsigned int acvp_curl_backoff(unsigned int retries)
+{
+	unsigned int backoff = ACVP_CURL_BACKOFF_BASE, seed;
+
+	while (--retries && backoff < ACVP_CURL_BACKOFF_MAX)
+		backoff <<= 1;
+	if (backoff > ACVP_CURL_BACKOFF_MAX)
+		backoff = ACVP_CURL_BACKOFF_MAX;
+
+	/* The stack address differs between the threads */
+	seed = (unsigned int)time(NULL) ^ (unsigned int)(uintptr_t)&seed;
+
+	return backoff + (unsigned int)rand_r(&seed) % (backoff / 2 + 1);
+}
+
 static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 				 const struct acvp_ext_buf *submit_buf,
 				 struct acvp_buf *response_buf,
 				 enum acvp_http_type http_type)
 {
+	struct acvp_curl_response response = { response_buf,
+					       netinfo->response_fd, false };
 	struct curl_slist *slist = NULL;
 	CURL *curl = NULL;
 	CURLcode cret;
-	ACVP_BUFFER_INIT(submit_tmp);
+	struct acvp_curl_upload upload = { submit_buf, submit_buf, 0 };
 	const char *url = netinfo->url, *http_type_str;
 	int ret;
 	unsigned int retries = 0;
+	uint32_t response_len;
 	long http_response_code = 0;
 
 	if (submit_buf)
 		slist = curl_slist_append(slist,
 					  "Content-Type: application/json");
 
-	CKINT(acvp_curl_common_init(netinfo, response_buf, &slist, &curl));
+	CKINT(acvp_curl_common_init(netinfo, &response, &slist, &curl));
 
 	switch (http_type) {
 	case acvp_http_get:
@@ -408,47 +822,29 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 		break;
 	case acvp_http_post:
 		http_type_str = "POST";
-		if (!submit_buf || !submit_buf->buf || !submit_buf->len) {
+		if (!acvp_ext_buf_len(submit_buf)) {
 			logger(LOGGER_WARN, LOGGER_C_CURL, "Nothing to POST\n");
 			ret = -EINVAL;
 			goto out;
 		}
-		logger(LOGGER_DEBUG, LOGGER_C_CURL,
-		       "Performing an HTTP POST operation of following data:\n%s\n",
-		       submit_buf->buf);
+		acvp_curl_upload_log(submit_buf, http_type_str);
 		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_POST, 1L));
-		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE_LARGE,
-					    (curl_off_t)submit_buf->len));
-		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_POSTFIELDS,
-					    submit_buf->buf));
+		CURL_CKINT(curl_easy_setopt(
+			curl, CURLOPT_POSTFIELDSIZE_LARGE,
+			(curl_off_t)acvp_ext_buf_len(submit_buf)));
 		break;
 	case acvp_http_put:
 		http_type_str = "PUT";
-		if (!submit_buf || !submit_buf->buf || !submit_buf->len) {
+		if (!acvp_ext_buf_len(submit_buf)) {
 			logger(LOGGER_WARN, LOGGER_C_CURL, "Nothing to PUT\n");
 			ret = -EINVAL;
 			goto out;
 		}
-		logger(LOGGER_DEBUG, LOGGER_C_CURL,
-		       "Performing an HTTP PUT operation of following data:\n%s\n",
-		       submit_buf->buf);
-
-		/*
-		 * We need a temporary buffer as we need to read parts of the
-		 * buffer and thus adjust the pointer and length field.
-		 */
-		submit_tmp.buf = submit_buf->buf;
-		submit_tmp.len = submit_buf->len;
-		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_READFUNCTION,
-					    acvp_curl_read_cb));
+		acvp_curl_upload_log(submit_buf, http_type_str);
 		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_UPLOAD, 1L));
-		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_INFILESIZE_LARGE,
-					    (curl_off_t)submit_buf->len));
-		CURL_CKINT(
-			curl_easy_setopt(curl, CURLOPT_READDATA, &submit_tmp));
-		logger(LOGGER_DEBUG, LOGGER_C_CURL,
-		       "About to HTTP PUT the following data:\n%s\n",
-		       submit_buf->buf);
+		CURL_CKINT(curl_easy_setopt(
+			curl, CURLOPT_INFILESIZE_LARGE,
+			(curl_off_t)acvp_ext_buf_len(submit_buf)));
 		break;
 	case acvp_http_delete:
 		http_type_str = "DELETE";
@@ -466,6 +862,19 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 		goto out;
 	}
 
+	/*
+	 * The data to be sent is read directly from the submit buffers
+	 * without copying it into one request body.
+	 */
+	if (submit_buf) {
+		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_READFUNCTION,
+					    acvp_curl_read_cb));
+		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_READDATA, &upload));
+		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION,
+					    acvp_curl_seek_cb));
+		CURL_CKINT(curl_easy_setopt(curl, CURLOPT_SEEKDATA, &upload));
+	}
+
 #if 0
 	/* Set a specific cipher */
 	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_SSL_CIPHER_LIST,
@@ -473,8 +882,10 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 #endif
 
 	/* Perform the HTTP request */
+	response_len = response_buf ? response_buf->len : 0;
+	CKINT(acvp_curl_response_truncate(&response));
 	while (retries < ACVP_CURL_MAX_RETRIES) {
-		cret = curl_easy_perform(curl);
+		cret = acvp_curl_perform(curl);
 		if (cret == CURLE_OK)
 			break;
 
@@ -487,6 +898,17 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 			goto out;
 		}
 
+		/* Drop the partial data of the failed transfer */
+		if (response_buf && response_buf->buf) {
+			response_buf->len = response_len;
+			response_buf->buf[response_len] = '\0';
+		}
+		CKINT(acvp_curl_response_truncate(&response));
+
+		/* Send the data again from its beginning */
+		upload.curr = submit_buf;
+		upload.offset = 0;
+
 		retries++;
 		if (retries < ACVP_CURL_MAX_RETRIES) {
 			int ret2;
@@ -496,7 +918,8 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 			 * untouched in case it contains the error from the
 			 * HTTP operation.
 			 */
-			ret2 = sleep_interruptible(10, &acvp_curl_interrupted);
+			ret2 = sleep_interruptible(acvp_curl_backoff(retries),
+						   &acvp_curl_interrupted);
 			if (ret2 < 0) {
 				ret = ret2;
 				goto out;
@@ -518,8 +941,7 @@ static int acvp_curl_http_common(const struct acvp_na_ex *netinfo,
 	}
 
 out:
-	if (curl)
-		curl_easy_cleanup(curl);
+	acvp_curl_handle_put(curl);
 	if (slist)
 		curl_slist_free_all(slist);
 	return atomic_bool_read(&acvp_curl_interrupted) ? -EINTR : ret;
@@ -555,6 +977,89 @@ static int acvp_curl_http_delete(const struct acvp_na_ex *netinfo,
 				     acvp_http_delete);
 }
 
+/* Part of a multipart form-data submission read from a file */
+struct acvp_curl_mime_file {
+	int fd;
+	uint64_t len;
+	uint64_t offset;
+};
+
+static size_t acvp_curl_mime_read_cb(char *buffer, size_t size, size_t nitems,
+				     void *arg)
+{
+	struct acvp_curl_mime_file *file = arg;
+	size_t todo = size * nitems;
+	ssize_t rc;
+
+	if (file->offset >= file->len)
+		return 0;
+
+	if (todo > file->len - file->offset)
+		todo = (size_t)(file->len - file->offset);
+
+	do {
+		rc = pread(file->fd, buffer, todo, (off_t)file->offset);
+	} while (rc < 0 && errno == EINTR);
+
+	/* The file must not shrink during the upload */
+	if (rc <= 0) {
+		logger(LOGGER_ERR, LOGGER_C_CURL,
+		       "Reading of upload data at offset %" PRIu64
+		       " failed (%d)\n",
+		       file->offset, rc ? -errno : -EIO);
+		return CURL_READFUNC_ABORT;
+	}
+
+	file->offset += (uint64_t)rc;
+
+	return (size_t)rc;
+}
+
+static int acvp_curl_mime_seek_cb(void *arg, curl_off_t offset, int origin)
+{
+	struct acvp_curl_mime_file *file = arg;
+
+	if (origin != SEEK_SET || offset < 0 || (uint64_t)offset > file->len)
+		return CURL_SEEKFUNC_CANTSEEK;
+
+	file->offset = (uint64_t)offset;
+
+	return CURL_SEEKFUNC_OK;
+}
+
+/*
+ * The file data is read in chunks by CURL during the transfer instead of
+ * copying the entire file into the MIME part.
+ */
+static int acvp_curl_mime_file(curl_mimepart *field,
+			       const struct acvp_ext_buf *s_buf)
+{
+	struct acvp_curl_mime_file *file;
+	CURLcode cret;
+	int ret = 0;
+
+	file = calloc(1, sizeof(*file));
+	CKNULL(file, -ENOMEM);
+	file->fd = s_buf->file_fd;
+	file->len = s_buf->file_len;
+
+	/* CURL releases the file state together with the MIME part */
+	cret = curl_mime_data_cb(field, (curl_off_t)file->len,
+				 acvp_curl_mime_read_cb, acvp_curl_mime_seek_cb,
+				 free, file);
+	if (cret) {
+		free(file);
+		ret = -EFAULT;
+		goto out;
+	}
+
+	logger(LOGGER_DEBUG, LOGGER_C_CURL,
+	       "Add mime data of length %" PRIu64 " from file\n", file->len);
+
+out:
+	return ret;
+}
+
 static int acvp_curl_http_post_multi(const struct acvp_na_ex *netinfo,
 				     const struct acvp_ext_buf *submit_buf,
 				     struct acvp_buf *response_buf)
@@ -562,17 +1067,14 @@ static int acvp_curl_http_post_multi(const struct acvp_na_ex *netinfo,
 	const struct acvp_ext_buf *s_buf;
 	struct curl_slist *slist = NULL;
 	CURL *curl = NULL;
-	CURLM *multi_handle = NULL;
-	CURLMcode mc;
 	CURLcode cret;
 	curl_mime *form = NULL;
 	curl_mimepart *field = NULL;
-	int ret = 0, still_running = 0;
-
-	CKINT(acvp_curl_common_init(netinfo, response_buf, &slist, &curl));
+	struct acvp_curl_response response = { response_buf, -1, false };
+	long http_response_code = 0;
+	int ret = 0;
 
-	multi_handle = curl_multi_init();
-	CKNULL(multi_handle, -ENOMEM);
+	CKINT(acvp_curl_common_init(netinfo, &response, &slist, &curl));
 
 	form = curl_mime_init(curl);
 	CKNULL(form, -ENOMEM);
@@ -583,7 +1085,9 @@ static int acvp_curl_http_post_multi(const struct acvp_na_ex *netinfo,
 		CURL_CKINT(curl_mime_name(field, s_buf->data_type));
 		logger(LOGGER_DEBUG, LOGGER_C_CURL, "Set mime type %s\n",
 		       s_buf->data_type);
-		if (s_buf->buf) {
+		if (s_buf->file_len) {
+			CKINT(acvp_curl_mime_file(field, s_buf));
+		} else if (s_buf->buf) {
 			CURL_CKINT(curl_mime_data(
 				field, (const char *)s_buf->buf, s_buf->len));
 			logger(LOGGER_DEBUG, LOGGER_C_CURL,
@@ -598,94 +1102,35 @@ static int acvp_curl_http_post_multi(const struct acvp_na_ex *netinfo,
 
 	CURL_CKINT(curl_easy_setopt(curl, CURLOPT_MIMEPOST, form));
 
-	mc = curl_multi_add_handle(multi_handle, curl);
-	if (mc != CURLM_OK) {
-		logger(LOGGER_WARN, LOGGER_C_CURL,
-		       "Addition of CURL easy-handle failed with code %d (%s)\n",
-		       mc, curl_multi_strerror(mc));
-	}
+	logger(LOGGER_DEBUG, LOGGER_C_CURL,
+	       "Performing a multi-form HTTP POST operation\n");
 
-	mc = curl_multi_perform(multi_handle, &still_running);
-	if (mc != CURLM_OK) {
+	cret = acvp_curl_perform(curl);
+	if (cret != CURLE_OK) {
 		logger(LOGGER_WARN, LOGGER_C_CURL,
-		       "Curl multi-HTTP operation failed with code %d (%s)\n",
-		       mc, curl_multi_strerror(mc));
+		       "Curl multi-form HTTP operation failed with code %d (%s)\n",
+		       cret, curl_easy_strerror(cret));
+		ret = -EFAULT;
+		goto out;
 	}
 
-	while (still_running) {
-		struct timeval timeout;
-
-		fd_set fdread;
-		fd_set fdwrite;
-		fd_set fdexcep;
-		int maxfd = -1;
-
-		long curl_timeo;
-
-		curl_multi_timeout(multi_handle, &curl_timeo);
-		if (curl_timeo < 0)
-			curl_timeo = 1000;
-
-		timeout.tv_sec = curl_timeo / 1000;
-		timeout.tv_usec = (curl_timeo % 1000) * 1000;
-
-		logger(LOGGER_DEBUG2, LOGGER_C_CURL,
-		       "Setting the multi-form post timeout to %lu seconds, %lu microseconds\n",
-		       timeout.tv_sec, timeout.tv_usec);
-
-		FD_ZERO(&fdread);
-		FD_ZERO(&fdwrite);
-		FD_ZERO(&fdexcep);
-
-		/* get file descriptors from the transfers */
-		mc = curl_multi_fdset(multi_handle, &fdread, &fdwrite, &fdexcep,
-				      &maxfd);
-		if (mc != CURLM_OK) {
-			logger(LOGGER_ERR, LOGGER_C_ANY,
-			       "curl_multi_fdset() failed, code %d.\n", mc);
-			break;
-		}
-
-		if (maxfd == -1) {
-			struct timeval wait = { 0, 100 * 1000 }; /* 100ms */
-
-			logger(LOGGER_DEBUG2, LOGGER_C_CURL,
-			       "Sleeping a bit\n");
-			ret = select(0, NULL, NULL, NULL, &wait);
-		} else {
-			ret = select(maxfd + 1, &fdread, &fdwrite, &fdexcep,
-				     &timeout);
-		}
+	acvp_curl_log_peer_cert(curl);
 
-		switch (ret) {
-		case -1:
-			/* select error */
-			ret = -errno;
-			break;
-		case 0:
-		default:
-			ret = 0;
-			/* timeout or readable/writable sockets */
-			mc = curl_multi_perform(multi_handle, &still_running);
-			if (mc != CURLM_OK) {
-				logger(LOGGER_WARN, LOGGER_C_CURL,
-				       "Curl multi-HTTP operation failed with code %d (%s)\n",
-				       mc, curl_multi_strerror(mc));
-			}
-			break;
-		}
+	curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_response_code);
+	if (http_response_code != HTTP_OK) {
+		logger(LOGGER_WARN, LOGGER_C_CURL,
+		       "Unable to HTTP POST multi-form data for URL %s: %ld\n",
+		       netinfo->url, http_response_code);
+		ret = -(int)http_response_code;
 	}
 
 out:
-	if (multi_handle)
-		curl_multi_cleanup(multi_handle);
-	if (curl)
-		curl_easy_cleanup(curl);
+	acvp_curl_handle_put(curl);
 	if (form)
 		curl_mime_free(form);
 	if (slist)
 		curl_slist_free_all(slist);
-	return ret;
+	return atomic_bool_read(&acvp_curl_interrupted) ? -EINTR : ret;
 }
 
 extern int acvp_openssl_thread_setup(void);
@@ -694,11 +1139,18 @@ static int acvp_curl_library_init(void)
 	if (curl_global_init(CURL_GLOBAL_ALL))
 		return -EFAULT;
 
+	acvp_curl_share_init();
+
 	return acvp_openssl_thread_setup();
 }
 
 static void acvp_curl_library_exit(void)
 {
+	acvp_curl_multi_release();
+
+	/* All handles must be gone before the share object is released */
+	acvp_curl_pool_release();
+	acvp_curl_share_release();
 	curl_global_cleanup();
 }
 
@@ -0,0 +1,439 @@
+/* Network access backend using libcurl - multi interface event loop
+ *
+ * Copyright (C) 2018 - 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "atomic_bool.h"
+#include "bool.h"
+#include "logger.h"
+#include "mutex_w.h"
+#include "network_backend_curl_multi.h"
+
+/*
+ * Multi interface event loop
+ * ==========================
+ *
+ * Instead of having each caller perform its HTTP transfer with
+ * curl_easy_perform, the transfers are handed to one event loop thread
+ * which drives all of them concurrently with one CURLM handle. The caller
+ * prepares the easy handle as usual, enqueues it and sleeps on the condition
+ * variable of its transfer until the event loop reports the completion of
+ * the transfer. Only the caller of the completed transfer is woken up.
+ *
+ * At most max_inflight transfers are active at any time, all other transfers
+ * remain queued in the order of their submission.
+ *
+ * The caller intentionally stays blocked for the duration of its transfer:
+ * the network access backend interface (struct acvp_netaccess_be) which is
+ * shared with the other backends returns the response to the caller, and
+ * the callers keep their request state on the stack of their job. The event
+ * loop therefore shares the connections and bounds the number of concurrent
+ * transfers, but it does not release the threads of the callers. The long
+ * waits for a server-requested retry do not occupy a thread as the vsID
+ * jobs are deferred with thread_defer instead.
+ *
+ * The event loop sleeps in curl_multi_poll and is woken up with
+ * curl_multi_wakeup when a new transfer is queued. Older libcurl versions
+ * lack both functions: the event loop then sleeps in curl_multi_wait with a
+ * pipe as additional file descriptor which is written to for the wakeup.
+ */
+
+/* Timeout in milliseconds the event loop waits for socket activity */
+#define ACVP_CURL_MULTI_POLL_TIMEOUT 1000
+
+/* curl_multi_poll and curl_multi_wakeup are available since 7.68.0 */
+#if LIBCURL_VERSION_NUM >= 0x074400
+#define ACVP_CURL_MULTI_WAKEUP
+#endif
+
+struct acvp_curl_multi_xfer {
+	CURL *curl;
+	CURLcode result;
+	bool done;
+	pthread_cond_t completion; /* Wakeup of the caller */
+	struct acvp_curl_multi_xfer *next;
+};
+
+static CURLM *acvp_curl_multi = NULL;
+static pthread_t acvp_curl_multi_thread;
+static unsigned int acvp_curl_multi_max_inflight = 0;
+
+/* Lock protecting the transfer lists */
+static DEFINE_MUTEX_W_UNLOCKED(acvp_curl_multi_lock);
+
+#ifndef ACVP_CURL_MULTI_WAKEUP
+/* Pipe waking up the event loop */
+static int acvp_curl_multi_pipe[2] = { -1, -1 };
+#endif
+
+/* Transfers waiting to be added to the multi handle */
+static struct acvp_curl_multi_xfer *acvp_curl_multi_pending = NULL;
+static struct acvp_curl_multi_xfer *acvp_curl_multi_pending_tail = NULL;
+/* Transfers added to the multi handle */
+static struct acvp_curl_multi_xfer *acvp_curl_multi_active = NULL;
+static unsigned int acvp_curl_multi_inflight = 0;
+
+static atomic_bool_t acvp_curl_multi_shutdown = ATOMIC_BOOL_INIT(false);
+
+/* Caller must hold acvp_curl_multi_lock */
+static void acvp_curl_multi_complete(struct acvp_curl_multi_xfer *xfer,
+				     CURLcode result)
+{
+	xfer->result = result;
+	xfer->done = true;
+	pthread_cond_signal(&xfer->completion);
+}
+
+#ifdef ACVP_CURL_MULTI_WAKEUP
+
+static CURLMcode acvp_curl_multi_wait(void)
+{
+	return curl_multi_poll(acvp_curl_multi, NULL, 0,
+			       ACVP_CURL_MULTI_POLL_TIMEOUT, NULL);
+}
+
+static void acvp_curl_multi_wake(void)
+{
+	curl_multi_wakeup(acvp_curl_multi);
+}
+
+static int acvp_curl_multi_wake_init(void)
+{
+	return 0;
+}
+
+static void acvp_curl_multi_wake_release(void)
+{
+}
+
+#else /* ACVP_CURL_MULTI_WAKEUP */
+
+static CURLMcode acvp_curl_multi_wait(void)
+{
+	struct curl_waitfd waitfd = { .fd = acvp_curl_multi_pipe[0],
+				      .events = CURL_WAIT_POLLIN,
+				      .revents = 0 };
+	CURLMcode mc;
+	char buf[64];
+
+	mc = curl_multi_wait(acvp_curl_multi, &waitfd, 1,
+			     ACVP_CURL_MULTI_POLL_TIMEOUT, NULL);
+
+	/* Consume all wakeups */
+	if (waitfd.revents) {
+		while (read(acvp_curl_multi_pipe[0], buf, sizeof(buf)) > 0)
+			;
+	}
+
+	return mc;
+}
+
+static void acvp_curl_multi_wake(void)
+{
+	char c = 0;
+
+	/* A full pipe already holds a pending wakeup */
+	if (write(acvp_curl_multi_pipe[1], &c, 1) < 0)
+		return;
+}
+
+static int acvp_curl_multi_wake_init(void)
+{
+	unsigned int i;
+
+	if (pipe(acvp_curl_multi_pipe))
+		return -errno;
+
+	for (i = 0; i < 2; i++) {
+		if (fcntl(acvp_curl_multi_pipe[i], F_SETFL, O_NONBLOCK) ||
+		    fcntl(acvp_curl_multi_pipe[i], F_SETFD, FD_CLOEXEC)) {
+			int ret = -errno;
+
+			close(acvp_curl_multi_pipe[0]);
+			close(acvp_curl_multi_pipe[1]);
+			acvp_curl_multi_pipe[0] = -1;
+			acvp_curl_multi_pipe[1] = -1;
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static void acvp_curl_multi_wake_release(void)
+{
+	if (acvp_curl_multi_pipe[0] >= 0)
+		close(acvp_curl_multi_pipe[0]);
+	if (acvp_curl_multi_pipe[1] >= 0)
+		close(acvp_curl_multi_pipe[1]);
+	acvp_curl_multi_pipe[0] = -1;
+	acvp_curl_multi_pipe[1] = -1;
+}
+
+#endif /* ACVP_CURL_MULTI_WAKEUP */
+
+/* Move pending transfers to the multi handle - caller must hold the lock */
+static void acvp_curl_multi_add_pending(void)
+{
+	while (acvp_curl_multi_pending &&
+	       acvp_curl_multi_inflight < acvp_curl_multi_max_inflight) {
+		struct acvp_curl_multi_xfer *xfer = acvp_curl_multi_pending;
+		CURLMcode mc;
+
+		acvp_curl_multi_pending = xfer->next;
+		if (!acvp_curl_multi_pending)
+			acvp_curl_multi_pending_tail = NULL;
+
+		curl_easy_setopt(xfer->curl, CURLOPT_PRIVATE, xfer);
+		mc = curl_multi_add_handle(acvp_curl_multi, xfer->curl);
+		if (mc != CURLM_OK) {
+			logger(LOGGER_WARN, LOGGER_C_CURL,
+			       "Addition of CURL easy-handle failed with code %d (%s)\n",
+			       mc, curl_multi_strerror(mc));
+			acvp_curl_multi_complete(xfer, CURLE_FAILED_INIT);
+			continue;
+		}
+
+		xfer->next = acvp_curl_multi_active;
+		acvp_curl_multi_active = xfer;
+		acvp_curl_multi_inflight++;
+	}
+}
+
+/* Remove a transfer from the active list - caller must hold the lock */
+static void acvp_curl_multi_del_active(struct acvp_curl_multi_xfer *xfer)
+{
+	struct acvp_curl_multi_xfer **iter;
+
+	for (iter = &acvp_curl_multi_active; *iter; iter = &(*iter)->next) {
+		if (*iter == xfer) {
+			*iter = xfer->next;
+			xfer->next = NULL;
+			acvp_curl_multi_inflight--;
+			return;
+		}
+	}
+}
+
+/* Collect all completed transfers and wake up their callers */
+static void acvp_curl_multi_reap(void)
+{
+	CURLMsg *msg;
+	int msgs_left;
+
+	while ((msg = curl_multi_info_read(acvp_curl_multi, &msgs_left))) {
+		struct acvp_curl_multi_xfer *xfer = NULL;
+
+		if (msg->msg != CURLMSG_DONE)
+			continue;
+
+		curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, &xfer);
+		curl_multi_remove_handle(acvp_curl_multi, msg->easy_handle);
+		if (!xfer)
+			continue;
+
+		mutex_w_lock(&acvp_curl_multi_lock);
+		acvp_curl_multi_del_active(xfer);
+		acvp_curl_multi_complete(xfer, msg->data.result);
+		mutex_w_unlock(&acvp_curl_multi_lock);
+	}
+}
+
+/* Abort all queued and active transfers - caller must hold the lock */
+static void acvp_curl_multi_abort_all(void)
+{
+	struct acvp_curl_multi_xfer *xfer;
+
+	while (acvp_curl_multi_active) {
+		xfer = acvp_curl_multi_active;
+		acvp_curl_multi_del_active(xfer);
+		curl_multi_remove_handle(acvp_curl_multi, xfer->curl);
+		acvp_curl_multi_complete(xfer, CURLE_ABORTED_BY_CALLBACK);
+	}
+
+	while (acvp_curl_multi_pending) {
+		xfer = acvp_curl_multi_pending;
+		acvp_curl_multi_pending = xfer->next;
+		xfer->next = NULL;
+		acvp_curl_multi_complete(xfer, CURLE_ABORTED_BY_CALLBACK);
+	}
+	acvp_curl_multi_pending_tail = NULL;
+}
+
+static void *acvp_curl_multi_worker(void *arg)
+{
+	sigset_t block;
+	int running;
+
+	(void)arg;
+
+	/* Signals are processed by the signal handler thread */
+	sigfillset(&block);
+	pthread_sigmask(SIG_BLOCK, &block, NULL);
+
+	logger(LOGGER_VERBOSE, LOGGER_C_CURL,
+	       "CURL event loop started with at most %u concurrent transfers\n",
+	       acvp_curl_multi_max_inflight);
+
+	while (!atomic_bool_read(&acvp_curl_multi_shutdown)) {
+		CURLMcode mc;
+
+		mutex_w_lock(&acvp_curl_multi_lock);
+		acvp_curl_multi_add_pending();
+		mutex_w_unlock(&acvp_curl_multi_lock);
+
+		mc = curl_multi_perform(acvp_curl_multi, &running);
+		if (mc != CURLM_OK) {
+			logger(LOGGER_WARN, LOGGER_C_CURL,
+			       "Curl multi-HTTP operation failed with code %d (%s)\n",
+			       mc, curl_multi_strerror(mc));
+		}
+
+		acvp_curl_multi_reap();
+
+		/*
+		 * Admit queued transfers for the slots of the completed ones
+		 * before sleeping - newly added transfers let the wait return
+		 * immediately.
+		 */
+		mutex_w_lock(&acvp_curl_multi_lock);
+		acvp_curl_multi_add_pending();
+		mutex_w_unlock(&acvp_curl_multi_lock);
+
+		/* Sleep until socket activity, timeout or new transfer */
+		mc = acvp_curl_multi_wait();
+		if (mc != CURLM_OK) {
+			logger(LOGGER_WARN, LOGGER_C_CURL,
+			       "Curl multi-HTTP poll failed with code %d (%s)\n",
+			       mc, curl_multi_strerror(mc));
+		}
+	}
+
+	mutex_w_lock(&acvp_curl_multi_lock);
+	acvp_curl_multi_abort_all();
+	mutex_w_unlock(&acvp_curl_multi_lock);
+
+	logger(LOGGER_VERBOSE, LOGGER_C_CURL, "CURL event loop terminated\n");
+
+	return NULL;
+}
+
+CURLcode acvp_curl_multi_perform(CURL *curl)
+{
+	struct acvp_curl_multi_xfer xfer;
+	int cancelstate;
+
+	if (!acvp_curl_multi)
+		return CURLE_FAILED_INIT;
+
+	xfer.curl = curl;
+	xfer.result = CURLE_OK;
+	xfer.done = false;
+	xfer.next = NULL;
+	if (pthread_cond_init(&xfer.completion, NULL))
+		return CURLE_OUT_OF_MEMORY;
+
+	/*
+	 * The transfer lives on our stack and is referenced by the event loop,
+	 * so the caller must not be canceled before the transfer completes.
+	 * An interrupted transfer is aborted by the progress callback.
+	 */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelstate);
+	mutex_w_lock(&acvp_curl_multi_lock);
+
+	if (atomic_bool_read(&acvp_curl_multi_shutdown)) {
+		xfer.result = CURLE_ABORTED_BY_CALLBACK;
+		goto out;
+	}
+
+	if (acvp_curl_multi_pending_tail)
+		acvp_curl_multi_pending_tail->next = &xfer;
+	else
+		acvp_curl_multi_pending = &xfer;
+	acvp_curl_multi_pending_tail = &xfer;
+
+	/* Interrupt the wait of the event loop */
+	acvp_curl_multi_wake();
+
+	while (!xfer.done)
+		pthread_cond_wait(&xfer.completion, &acvp_curl_multi_lock);
+
+out:
+	mutex_w_unlock(&acvp_curl_multi_lock);
+	pthread_setcancelstate(cancelstate, NULL);
+	pthread_cond_destroy(&xfer.completion);
+
+	return xfer.result;
+}
+
+int acvp_curl_multi_init(unsigned int max_inflight)
+{
+	int ret;
+
+	if (acvp_curl_multi)
+		return 0;
+
+	acvp_curl_multi_max_inflight =
+		max_inflight ? max_inflight : ACVP_CURL_MULTI_MAX_INFLIGHT;
+
+	acvp_curl_multi = curl_multi_init();
+	if (!acvp_curl_multi)
+		return -ENOMEM;
+
+	ret = acvp_curl_multi_wake_init();
+	if (ret) {
+		curl_multi_cleanup(acvp_curl_multi);
+		acvp_curl_multi = NULL;
+		return ret;
+	}
+
+	/* Keep one connection per possible transfer for reuse */
+	curl_multi_setopt(acvp_curl_multi, CURLMOPT_MAXCONNECTS,
+			  (long)acvp_curl_multi_max_inflight);
+
+	ret = -pthread_create(&acvp_curl_multi_thread, NULL,
+			      acvp_curl_multi_worker, NULL);
+	if (ret) {
+		acvp_curl_multi_wake_release();
+		curl_multi_cleanup(acvp_curl_multi);
+		acvp_curl_multi = NULL;
+	}
+
+	return ret;
+}
+
+void acvp_curl_multi_release(void)
+{
+	if (!acvp_curl_multi)
+		return;
+
+	atomic_bool_set_true(&acvp_curl_multi_shutdown);
+	acvp_curl_multi_wake();
+	pthread_join(acvp_curl_multi_thread, NULL);
+
+	acvp_curl_multi_wake_release();
+	curl_multi_cleanup(acvp_curl_multi);
+	acvp_curl_multi = NULL;
+}
@@ -0,0 +1,70 @@
+/* Network access backend using libcurl - multi interface event loop
+ *
+ * Copyright (C) 2018 - 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#ifndef NETWORK_BACKEND_CURL_MULTI_H
+#define NETWORK_BACKEND_CURL_MULTI_H
+
+#include <curl/curl.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Environment variable enabling the multi interface event loop. Its value
+ * specifies the maximum number of concurrent HTTP transfers. If the value is
+ * not a number, ACVP_CURL_MULTI_MAX_INFLIGHT transfers are allowed.
+ */
+#define ACVP_CURL_MULTI_ENV "ACVPPROXY_CURL_MULTI"
+#define ACVP_CURL_MULTI_MAX_INFLIGHT 64
+
+/**
+ * @brief Initialize the event loop driving all HTTP transfers.
+ *
+ * @param max_inflight [in] Maximum number of concurrent transfers - if zero,
+ *			    ACVP_CURL_MULTI_MAX_INFLIGHT is used.
+ *
+ * @return 0 on success, < 0 on error
+ */
+int acvp_curl_multi_init(unsigned int max_inflight);
+
+/**
+ * @brief Perform the HTTP transfer prepared with the given easy handle.
+ *
+ * The transfer is handed to the event loop and the caller is blocked until
+ * the transfer completes. The function is a drop-in replacement for
+ * curl_easy_perform as the network access backend interface is synchronous.
+ *
+ * @param curl [in] Fully set up easy handle
+ *
+ * @return CURL result code of the transfer
+ */
+CURLcode acvp_curl_multi_perform(CURL *curl);
+
+/**
+ * @brief Terminate the event loop. All pending transfers are aborted.
+ */
+void acvp_curl_multi_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* NETWORK_BACKEND_CURL_MULTI_H */
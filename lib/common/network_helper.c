@@ -17,11 +17,15 @@
  * DAMAGE.
  */
 
+#include <errno.h>
+#include <unistd.h>
+
 #include "internal.h"
 
 static int _acvp_net_op(const struct acvp_testid_ctx *testid_ctx,
 			const char *url, const struct acvp_ext_buf *submit,
-			struct acvp_buf *response, enum acvp_http_type nettype)
+			struct acvp_buf *response, enum acvp_http_type nettype,
+			int response_fd)
 {
 	const struct acvp_net_ctx *net;
 	struct acvp_auth_ctx *auth = testid_ctx->server_auth;
@@ -35,6 +39,7 @@ static int _acvp_net_op(const struct acvp_testid_ctx *testid_ctx,
 	netinfo.net = net;
 	netinfo.url = url;
 	netinfo.server_auth = auth;
+	netinfo.response_fd = response_fd;
 
 	mutex_reader_lock(&auth->mutex);
 	switch (nettype) {
@@ -89,9 +94,11 @@ out:
 	return ret;
 }
 
-int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
-		const struct acvp_ext_buf *submit, struct acvp_buf *response,
-		enum acvp_http_type nettype)
+static int acvp_net_op_common(const struct acvp_testid_ctx *testid_ctx,
+			      const char *url,
+			      const struct acvp_ext_buf *submit,
+			      struct acvp_buf *response,
+			      enum acvp_http_type nettype, int response_fd)
 {
 	struct acvp_auth_ctx *auth = testid_ctx->server_auth;
 	enum acvp_error_code code = ACVP_ERR_NO_ERR;
@@ -100,7 +107,8 @@ int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
 	CKNULL_LOG(na, -EFAULT, "No network backend registered\n");
 	CKNULL_LOG(auth, -EINVAL, "Authentication context missing\n");
 
-	ret = _acvp_net_op(testid_ctx, url, submit, response, nettype);
+	ret = _acvp_net_op(testid_ctx, url, submit, response, nettype,
+			   response_fd);
 	CKINT(acvp_error_convert(response, ret, &code));
 
 	/*
@@ -112,7 +120,8 @@ int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
 		logger(LOGGER_WARN, LOGGER_C_ANY,
 		       "Authentication error received - force refresh of auth token and retry network operation\n");
 		CKINT(acvp_jwt_invalidate(testid_ctx));
-		CKINT(_acvp_net_op(testid_ctx, url, submit, response, nettype));
+		CKINT(_acvp_net_op(testid_ctx, url, submit, response, nettype,
+				   response_fd));
 		CKINT(acvp_error_convert(response, ret, &code));
 	}
 
@@ -127,3 +136,80 @@ int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
 out:
 	return ret;
 }
+
+int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
+		const struct acvp_ext_buf *submit, struct acvp_buf *response,
+		enum acvp_http_type nettype)
+{
+	return acvp_net_op_common(testid_ctx, url, submit, response, nettype,
+				  -1);
+}
+
+static int acvp_net_write_fd(int fd, const uint8_t *data, uint32_t len)
+{
+	ssize_t written;
+
+	while (len) {
+		written = write(fd, data, len);
+		if (written < 0) {
+			if (errno == EINTR)
+				continue;
+			return -errno;
+		}
+		data += written;
+		len -= (uint32_t)written;
+	}
+
+	return 0;
+}
+
+int acvp_net_op_stream(const struct acvp_testid_ctx *testid_ctx,
+		       const char *url, struct acvp_buf *response, int fd,
+		       bool *streamed)
+{
+	off_t written;
+	int ret, ret2;
+
+	CKNULL_LOG(streamed, -EINVAL, "Stream indicator missing\n");
+	*streamed = false;
+
+	if (fd < 0) {
+		logger(LOGGER_ERR, LOGGER_C_ANY, "Stream file missing\n");
+		return -EINVAL;
+	}
+
+	/* Drop the data of a previous invocation */
+	if (ftruncate(fd, 0) < 0 || lseek(fd, 0, SEEK_SET) < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "Cannot truncate stream file (%d)\n", ret);
+		goto out;
+	}
+
+	ret = acvp_net_op_common(testid_ctx, url, NULL, response,
+				 acvp_http_get, fd);
+
+	/* The backend only writes to the file if the response is large */
+	written = lseek(fd, 0, SEEK_CUR);
+	if (written < 0) {
+		ret = -errno;
+		logger(LOGGER_ERR, LOGGER_C_ANY,
+		       "Cannot obtain size of streamed data (%d)\n", ret);
+		goto out;
+	}
+	*streamed = !!written;
+
+	/* The file shall contain the response in any case */
+	if (!written && ret >= 0 && response->buf && response->len) {
+		ret2 = acvp_net_write_fd(fd, response->buf, response->len);
+		if (ret2) {
+			logger(LOGGER_ERR, LOGGER_C_ANY,
+			       "Cannot write response to stream file (%d)\n",
+			       ret2);
+			ret = ret2;
+		}
+	}
+
+out:
+	return ret;
+}
@@ -26,6 +26,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <time.h>
 #include <unistd.h>
 
 #include "atomic_bool.h"
@@ -43,32 +44,110 @@
  * Threading Support
  * =================
  *
- * Threading support is provided by maintaining a pool of threads which
- * are spawned when they are needed. Once the thread completes its first job
- * it remains idle but alive and waits for the next job. The code first
- * tries to reuse existing idle threads before spawning new threads.
+ * Threading support is provided by maintaining a pool of worker threads for
+ * each thread group. A job submitted with thread_start is appended to the
+ * job queue of its thread group and picked up by the next idle worker of
+ * that group. Idle workers sleep on the condition variable of their thread
+ * group and are woken up as soon as a job is queued. A new worker is only
+ * spawned if the queued jobs outnumber the idle workers and the thread group
+ * has unused thread slots left.
+ *
+ * The job queue of a regular thread group holds at most
+ * THREADING_QUEUE_PER_THREAD jobs per thread slot of the group. If the queue
+ * is full, thread_start blocks the caller until a worker picks up a job. This
+ * limits the memory held by queued jobs when a caller spawns a large number
+ * of jobs. A job of the same or of a higher thread group is never blocked as
+ * the workers it would wait for may be the ones waiting for it to complete.
  *
  * It is permissible to spawn new threads from different mother threads. When
- * calling thread_wait, only the threads from the caller are waited for.
+ * calling thread_wait, only the jobs from the caller are waited for. For this,
+ * each mother thread owns a completion record which counts its outstanding
+ * jobs and collects their return codes.
+ *
+ * Work Stealing
+ * -------------
+ *
+ * When all slots of a thread group are busy, its jobs may be executed by idle
+ * workers of a thread group with a lower number: a worker whose own job queue
+ * is empty steals queued jobs from the thread groups with a higher number.
+ * Stealing never happens in the other direction and never involves special
+ * thread groups. As the "child" threads are allocated in a higher thread
+ * group than their "mother" threads, a "mother" job is never executed by a
+ * worker reserved for "child" jobs. Thus, the anti-deadlock guarantee of the
+ * thread groups is retained - stolen "child" jobs never wait for other jobs
+ * and therefore only delay the "mother" jobs.
+ *
+ * In addition, a mother thread waiting in thread_wait executes its own queued
+ * jobs of the last thread group instead of sleeping. Jobs of the last thread
+ * group therefore must not spawn jobs of regular thread groups themselves.
+ *
+ * Deferred Jobs
+ * -------------
+ *
+ * A job which has to wait for some time, e.g. because the ACVP server asked
+ * to retry a request later, invokes thread_defer and returns. Instead of
+ * completing the job, it is parked in the list of deferred jobs of its thread
+ * group which is ordered by the due time of the jobs. The job therefore does
+ * not occupy a thread while waiting. An idle worker of the thread group sleeps
+ * until the earliest due time and moves all due jobs back to the job queue.
+ * The mother thread keeps waiting for the deferred job.
  */
 
+/* Number of queued jobs per thread slot of a regular thread group */
+#define THREADING_QUEUE_PER_THREAD 2
+
 /*
- * Structure for one thread
+ * Completion record of one mother thread
  */
-struct thread_ctx {
-	pthread_t thread_id; /* Thread ID from pthread_create */
-	pthread_t parent; /* Parent thread ID */
-	unsigned int thread_num; /* Current slot number */
-	int ret_ancestor; /* Return code of ancestor code */
+struct thread_parent {
+	pthread_t parent; /* Mother thread ID */
+	unsigned int outstanding; /* Number of unfinished jobs */
+	int ret; /* Return codes of finished jobs ORed together */
+	struct thread_parent *next;
+};
 
+/*
+ * One queued job
+ */
+struct thread_job {
 	int (*start_routine)(void *); /* Thread code to be executed */
 	void *data; /* Parameters used by the thread code */
+	struct thread_parent *parent; /* Mother thread, NULL for special groups */
+	struct thread_group *group; /* Thread group the job is queued with */
+	time_t due; /* Point in time a deferred job shall be executed again */
+	bool requeue; /* Did the job request to be executed again? */
+	struct thread_job *next;
+};
 
-	atomic_bool_t thread_pending; /* Is thread associated with structure? */
-	mutex_w_t inuse; /* Is thread data structure used? */
-	atomic_bool_t shutdown; /* Shall the thread be shut down? */
-	bool scheduled; /* Is/was a job executed and return code
-					 * is ready for pickup? */
+/*
+ * Job queue and worker accounting of one thread group
+ */
+struct thread_group {
+	pthread_cond_t job_avail; /* Wakeup of idle workers */
+	pthread_cond_t space_avail; /* Wakeup of callers waiting for the queue */
+	struct thread_job *head, *tail; /* Queued jobs */
+	unsigned int queued; /* Number of queued jobs */
+	unsigned int max_queued; /* Queue limit, 0 for no limit */
+	struct thread_job *delayed; /* Deferred jobs ordered by due time */
+	unsigned int idle; /* Number of workers waiting for a job */
+	unsigned int workers; /* Number of running workers */
+	unsigned int lower, upper; /* Range of thread slots of the group */
+	int ret_ancestor; /* Return code of last job of a special group */
+	bool shutdown; /* Shall the workers terminate once queue is empty? */
+};
+
+/*
+ * Structure for one thread
+ */
+struct thread_ctx {
+	pthread_t thread_id; /* Thread ID from pthread_create */
+	unsigned int thread_num; /* Current slot number */
+	struct thread_group *group; /* Thread group the worker serves */
+	struct thread_job *job; /* Currently executed job */
+	bool alive; /* Is thread associated with structure? */
+	bool exited; /* Did the thread terminate and waits for being joined? */
+	bool joining; /* Is the thread being joined by the cleanup functions? */
+	bool idle; /* Is the thread waiting for a job? */
 };
 
 /*
@@ -84,8 +163,26 @@ static struct thread_ctx threads[THREADING_REALLY_ALL_THREADS];
 static uint32_t threads_groups = 0;
 static uint32_t threads_per_threadgroup = 1;
 
+/*
+ * Array holding the thread groups - the special thread groups are located
+ * after the THREADING_MAX_THREADS possible regular groups.
+ */
+static struct thread_group thread_groups[THREADING_REALLY_ALL_THREADS];
+
+/* Completion records of all mother threads with outstanding jobs */
+static struct thread_parent *thread_parents = NULL;
+
 static pthread_attr_t pthread_attr;
 
+/*
+ * Lock protecting the job queues, the completion records and the thread
+ * slots.
+ */
+static DEFINE_MUTEX_W_UNLOCKED(threads_lock);
+
+/* Wakeup of mother threads waiting in thread_wait */
+static pthread_cond_t threads_completion = PTHREAD_COND_INITIALIZER;
+
 /*
  * Indicator to prevent spawning of new threads while the cleanup / garbage
  * collector functions execute.
@@ -99,6 +196,9 @@ static atomic_bool_t threads_in_cancel = ATOMIC_BOOL_INIT(false);
  */
 static DEFINE_MUTEX_W_UNLOCKED(threads_cleanup);
 
+/* Job executed by the calling thread */
+static __thread struct thread_job *thread_current_job = NULL;
+
 static inline unsigned int thread_get_special_slot(unsigned int thread_group)
 {
 	if (thread_group <= THREADING_MAX_THREADS)
@@ -113,6 +213,22 @@ static inline bool thread_is_special(struct thread_ctx *tctx)
 	return (tctx->thread_num >= THREADING_MAX_THREADS) ? true : false;
 }
 
+static struct thread_group *thread_get_group(uint32_t thread_group)
+{
+	unsigned int special_slot = thread_get_special_slot(thread_group);
+
+	if (special_slot) {
+		if (special_slot >= THREADING_REALLY_ALL_THREADS)
+			return NULL;
+		return &thread_groups[special_slot];
+	}
+
+	if (thread_group >= threads_groups)
+		return NULL;
+
+	return &thread_groups[thread_group];
+}
+
 int thread_init(uint32_t groups)
 {
 	static uint32_t thread_initialized = 0;
@@ -135,15 +251,29 @@ int thread_init(uint32_t groups)
 
 	CKINT(pthread_attr_init(&pthread_attr));
 	memset(threads, 0, sizeof(threads));
-
-	for (i = 0; i < THREADING_REALLY_ALL_THREADS; i++) {
-		mutex_w_init(&threads[i].inuse, false);
-		atomic_bool_set_false(&threads[i].shutdown);
-	}
+	memset(thread_groups, 0, sizeof(thread_groups));
 
 	threads_groups = groups;
 	threads_per_threadgroup = THREADING_MAX_THREADS / threads_groups;
 
+	for (i = 0; i < THREADING_REALLY_ALL_THREADS; i++) {
+		struct thread_group *grp = &thread_groups[i];
+
+		pthread_cond_init(&grp->job_avail, NULL);
+		pthread_cond_init(&grp->space_avail, NULL);
+
+		if (i >= THREADING_MAX_THREADS) {
+			/* Special groups own exactly one slot */
+			grp->lower = i;
+			grp->upper = i + 1;
+		} else if (i < threads_groups) {
+			grp->lower = i * threads_per_threadgroup;
+			grp->upper = (i + 1) * threads_per_threadgroup;
+			grp->max_queued = threads_per_threadgroup *
+					  THREADING_QUEUE_PER_THREAD;
+		}
+	}
+
 	logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
 	       "Initialized threading support for %u threads\n",
 	       THREADING_MAX_THREADS);
@@ -158,38 +288,284 @@ out:
 	return 0;
 }
 
-static inline void thread_block(void)
+static void thread_unlock(void *lock)
+{
+	mutex_w_unlock((mutex_w_t *)lock);
+}
+
+/*
+ * Wait for the condition with threads_lock held - if due is not zero, the
+ * wait ends at the latest at the given point in time. The lock is released if
+ * the caller is canceled while waiting.
+ */
+static void thread_cond_wait(pthread_cond_t *cond, time_t due)
 {
-	const struct timespec sleeptime = { .tv_sec = 0, .tv_nsec = 1 << 27 };
+	struct timespec abstime = { .tv_sec = due, .tv_nsec = 0 };
 
-	nanosleep(&sleeptime, NULL);
+	pthread_cleanup_push(thread_unlock, &threads_lock);
+	if (due)
+		pthread_cond_timedwait(cond, &threads_lock, &abstime);
+	else
+		pthread_cond_wait(cond, &threads_lock);
+	pthread_cleanup_pop(0);
 }
 
-static inline bool thread_dirty(unsigned int slot)
+/* Find the completion record of the mother thread - threads_lock held */
+static struct thread_parent *thread_find_parent(pthread_t self)
 {
-	return (atomic_bool_read(&threads[slot].thread_pending));
+	struct thread_parent *parent;
+
+	for (parent = thread_parents; parent; parent = parent->next) {
+		if (pthread_equal(parent->parent, self))
+			return parent;
+	}
+
+	return NULL;
 }
 
-/* Thread structure cleanup after execution when thread is kept alive. */
-static inline void thread_cleanup(struct thread_ctx *tctx)
+/* Release the completion record of the mother thread - threads_lock held */
+static void thread_put_parent(struct thread_parent *parent)
+{
+	struct thread_parent **iter;
+
+	for (iter = &thread_parents; *iter; iter = &(*iter)->next) {
+		if (*iter == parent) {
+			*iter = parent->next;
+			free(parent);
+			return;
+		}
+	}
+}
+
+/* Report the completion of a job - threads_lock held */
+static void thread_job_complete(struct thread_job *job, int ret)
+{
+	struct thread_parent *parent = job->parent;
+	struct thread_group *grp = job->group;
+
+	if (parent) {
+		parent->ret |= ret;
+		parent->outstanding--;
+		if (!parent->outstanding)
+			pthread_cond_broadcast(&threads_completion);
+	} else {
+		grp->ret_ancestor = ret;
+	}
+
+	free(job);
+}
+
+/* Drop all queued jobs of the thread group - threads_lock held */
+static void thread_job_flush(struct thread_group *grp)
+{
+	struct thread_job *job;
+
+	while (grp->head) {
+		job = grp->head;
+		grp->head = job->next;
+		thread_job_complete(job, -ESHUTDOWN);
+	}
+	grp->tail = NULL;
+	grp->queued = 0;
+	pthread_cond_broadcast(&grp->space_avail);
+
+	while (grp->delayed) {
+		job = grp->delayed;
+		grp->delayed = job->next;
+		thread_job_complete(job, -ESHUTDOWN);
+	}
+}
+
+/* Append the job to the queue of its group - threads_lock held */
+static void thread_job_enqueue(struct thread_job *job)
+{
+	struct thread_group *grp = job->group;
+
+	job->next = NULL;
+	if (grp->tail)
+		grp->tail->next = job;
+	else
+		grp->head = job;
+	grp->tail = job;
+	grp->queued++;
+}
+
+/* Move the deferred jobs which are due to the job queue - threads_lock held */
+static void thread_job_promote(struct thread_group *grp, time_t now)
+{
+	struct thread_job *job;
+
+	while (grp->delayed && grp->delayed->due <= now) {
+		job = grp->delayed;
+		grp->delayed = job->next;
+		thread_job_enqueue(job);
+	}
+}
+
+static inline bool thread_group_is_special(struct thread_group *grp)
+{
+	return (grp >= &thread_groups[THREADING_MAX_THREADS]) ? true : false;
+}
+
+/* Remove the job from the queue of its group - threads_lock held */
+static void thread_job_unlink(struct thread_job *job, struct thread_job *prev)
+{
+	struct thread_group *grp = job->group;
+
+	if (prev)
+		prev->next = job->next;
+	else
+		grp->head = job->next;
+	if (grp->tail == job)
+		grp->tail = prev;
+	grp->queued--;
+	job->next = NULL;
+
+	/* Let a caller waiting for queue space continue */
+	pthread_cond_signal(&grp->space_avail);
+}
+
+/*
+ * Fetch the next job for a worker of the thread group: the oldest job of the
+ * own queue or, if there is none, a job stolen from a thread group with a
+ * higher number - threads_lock held
+ */
+static struct thread_job *thread_job_get(struct thread_group *grp)
+{
+	struct thread_job *job;
+	time_t now = time(NULL);
+	unsigned int i;
+
+	thread_job_promote(grp, now);
+	job = grp->head;
+	if (job || thread_group_is_special(grp))
+		goto out;
+
+	for (i = (unsigned int)(grp - thread_groups) + 1; i < threads_groups;
+	     i++) {
+		thread_job_promote(&thread_groups[i], now);
+		job = thread_groups[i].head;
+		if (job)
+			break;
+	}
+
+out:
+	if (job)
+		thread_job_unlink(job, NULL);
+	return job;
+}
+
+/*
+ * Fetch a queued job of the mother thread from the last thread group -
+ * threads_lock held
+ */
+static struct thread_job *thread_job_get_child(struct thread_parent *parent)
+{
+	struct thread_group *grp = &thread_groups[threads_groups - 1];
+	struct thread_job *job, *prev = NULL;
+
+	thread_job_promote(grp, time(NULL));
+	for (job = grp->head; job; prev = job, job = job->next) {
+		if (job->parent == parent) {
+			thread_job_unlink(job, prev);
+			return job;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Wake up an idle worker of a thread group with a lower number to steal the
+ * job of the given group - threads_lock held
+ */
+static void thread_wake_thief(struct thread_group *grp)
+{
+	unsigned int i;
+
+	if (thread_group_is_special(grp))
+		return;
+
+	for (i = 0; i < (unsigned int)(grp - thread_groups); i++) {
+		if (thread_groups[i].idle) {
+			pthread_cond_signal(&thread_groups[i].job_avail);
+			return;
+		}
+	}
+}
+
+static void thread_restore_name(const char *name)
+{
+#ifdef __APPLE__
+	pthread_setname_np(name);
+#else
+	pthread_setname_np(pthread_self(), name);
+#endif
+}
+
+static int thread_create(struct thread_group *grp);
+
+/*
+ * Complete the executed job or park it with the deferred jobs of its thread
+ * group if the job requested to be executed again - threads_lock held
+ */
+static void thread_job_finish(struct thread_job *job, int ret)
 {
-	tctx->data = NULL;
-	tctx->start_routine = NULL;
+	struct thread_group *grp = job->group;
+	struct thread_job **iter;
+
+	if (!job->requeue || atomic_bool_read(&threads_in_cancel)) {
+		thread_job_complete(job, job->requeue ? -ESHUTDOWN : ret);
+		return;
+	}
 
-	/* Return values of special threads is irrelevant */
-	if (thread_is_special(tctx))
-		tctx->scheduled = false;
+	job->requeue = false;
+	for (iter = &grp->delayed; *iter; iter = &(*iter)->next) {
+		if ((*iter)->due > job->due)
+			break;
+	}
+	job->next = *iter;
+	*iter = job;
+
+	logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
+	       "Job of thread group %u deferred\n",
+	       (unsigned int)(grp - thread_groups));
+
+	/* Let an idle worker rearm its timeout, spawn one if there is none */
+	if (grp->idle)
+		pthread_cond_signal(&grp->job_avail);
+	else if (!grp->workers && thread_create(grp))
+		logger(LOGGER_WARN, LOGGER_C_THREADING,
+		       "No worker available for deferred job\n");
 }
 
-/* Thread structure cleanup when thread is terminated. */
-static inline void thread_cleanup_full(struct thread_ctx *tctx)
+/*
+ * Worker terminates - either because of a shutdown of its thread group,
+ * a cancellation or a job calling pthread_exit.
+ */
+static void thread_worker_exit(void *arg)
 {
-	thread_cleanup(tctx);
-	tctx->thread_num = 0;
-	atomic_bool_set_false(&tctx->thread_pending);
-	tctx->scheduled = false;
-	tctx->ret_ancestor = 0;
-	mutex_w_destroy(&tctx->inuse);
+	struct thread_ctx *tctx = (struct thread_ctx *)arg;
+	struct thread_group *grp = tctx->group;
+
+	mutex_w_lock(&threads_lock);
+
+	if (tctx->idle) {
+		tctx->idle = false;
+		grp->idle--;
+	}
+
+	/* The job did not return, e.g. the job invoked pthread_exit */
+	if (tctx->job) {
+		thread_job_complete(tctx->job,
+				    thread_is_special(tctx) ? 0 : -ESHUTDOWN);
+		tctx->job = NULL;
+	}
+
+	grp->workers--;
+	tctx->exited = true;
+
+	mutex_w_unlock(&threads_lock);
 }
 
 /* Worker loop of a thread */
@@ -197,207 +573,285 @@ static void *thread_worker(void *arg)
 {
 	sigset_t block, old;
 	struct thread_ctx *tctx = (struct thread_ctx *)arg;
+	struct thread_group *grp = tctx->group;
+	struct thread_job *job;
 	int ret;
 
+	pthread_cleanup_push(thread_worker_exit, tctx);
+
 	/* Block all signals from being processed by thread */
 	sigfillset(&block);
 	ret = -pthread_sigmask(SIG_BLOCK, &block, &old);
 	if (ret)
-		return NULL;
+		goto out;
 
+	mutex_w_lock(&threads_lock);
 	while (1) {
-		mutex_w_lock(&tctx->inuse);
-
-		if (atomic_bool_read(&tctx->shutdown)) {
-			/* Request for termination */
-			mutex_w_unlock(&tctx->inuse);
-			/*
-			 * As the while loop terminates, the thread will
-			 * terminate as well - clean up our structure in case
-			 * the signal handler wants to cancel all threads.
-			 * In this case, it has to identify that this thread
-			 * does not exist any more.
-			 */
-			thread_cleanup_full(tctx);
-			pthread_exit(NULL);
-			break;
-		} else if (tctx->start_routine) {
-			/* Work to do, execute */
-			tctx->ret_ancestor = tctx->start_routine(tctx->data);
-			thread_cleanup(tctx);
+		job = thread_job_get(grp);
+		if (!job) {
+			/* Request for termination and all jobs are processed */
+			if (grp->shutdown && !grp->delayed)
+				break;
+
+			/* Idle until a job is queued or a deferred job is due */
+			tctx->idle = true;
+			grp->idle++;
+			thread_cond_wait(&grp->job_avail,
+					 grp->delayed ? grp->delayed->due : 0);
+			grp->idle--;
+			tctx->idle = false;
+			continue;
+		}
+
+		tctx->job = job;
+
+		mutex_w_unlock(&threads_lock);
+
+		if (job->group != grp) {
 			logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
-			       "Thread %u completed\n", tctx->thread_num);
-			mutex_w_unlock(&tctx->inuse);
-		} else {
-			/* Idle */
-			mutex_w_unlock(&tctx->inuse);
-			thread_block();
+			       "Thread %u steals job of thread group %u\n",
+			       tctx->thread_num,
+			       (unsigned int)(job->group - thread_groups));
 		}
+
+		/* Work to do, execute */
+		thread_current_job = job;
+		ret = job->start_routine(job->data);
+		thread_current_job = NULL;
+		logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
+		       "Thread %u completed\n", tctx->thread_num);
+
+		mutex_w_lock(&threads_lock);
+		tctx->job = NULL;
+		thread_job_finish(job, ret);
 	}
+	mutex_w_unlock(&threads_lock);
 
+out:
+	pthread_cleanup_pop(1);
 	return NULL;
 }
 
-/* Spawn a thread */
-static int thread_create(struct thread_ctx *tctx, unsigned int slot)
+/*
+ * Spawn a worker for the thread group if a slot is free, -EAGAIN is returned
+ * if all slots are occupied - threads_lock held
+ */
+static int thread_create(struct thread_group *grp)
 {
+	struct thread_ctx *tctx;
+	unsigned int slot;
 	int ret;
 
+	for (slot = grp->lower; slot < grp->upper; slot++) {
+		if (!threads[slot].alive)
+			break;
+
+		/* Reap a terminated worker to reuse its slot */
+		if (threads[slot].exited && !threads[slot].joining) {
+			pthread_join(threads[slot].thread_id, NULL);
+			threads[slot].alive = false;
+			break;
+		}
+	}
+
+	if (slot >= grp->upper)
+		return -EAGAIN;
+
+	tctx = &threads[slot];
 	tctx->thread_num = slot;
-	tctx->data = NULL;
-	atomic_bool_set_true(&tctx->thread_pending);
+	tctx->group = grp;
+	tctx->job = NULL;
+	tctx->exited = false;
+	tctx->idle = false;
 
 	ret = -pthread_create(&tctx->thread_id, &pthread_attr, &thread_worker,
 			      tctx);
 	if (ret)
-		goto err;
+		return ret;
 
-	ret = -pthread_setcanceltype(PTHREAD_CANCEL_ASYNCHRONOUS, NULL);
-	if (ret)
-		goto err;
+	tctx->alive = true;
+	grp->workers++;
+
+	logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
+	       "Thread %u allocated\n", slot);
 
 	return 0;
+}
 
-err:
-	thread_cleanup_full(tctx);
-	return ret;
+/*
+ * Shall the caller wait for space in the job queue of the thread group before
+ * queueing a job? A job of the same or a higher thread group must not wait as
+ * the workers it waits for may wait for its completion - threads_lock held
+ */
+static bool thread_queue_full(struct thread_group *grp)
+{
+	struct thread_job *current = thread_current_job;
+
+	if (!grp->max_queued || grp->queued < grp->max_queued)
+		return false;
+
+	if (current && !thread_group_is_special(current->group) &&
+	    current->group >= grp)
+		return false;
+
+	return true;
 }
 
-/* Find free pthread slot and schedule the job */
+/* Queue the job with the thread group */
 static int thread_schedule(int (*start_routine)(void *), void *tdata,
 			   uint32_t thread_group, int *ret_ancestor)
 {
-	pthread_t self = pthread_self();
-	unsigned int i, upper;
-	unsigned int special_slot = thread_get_special_slot(thread_group);
+	struct thread_group *grp = thread_get_group(thread_group);
+	struct thread_parent *parent = NULL;
+	struct thread_job *job;
+	int ret = 0, cancelstate;
 
-	if (threads_groups < thread_group && !special_slot) {
+	if (!grp) {
 		logger(LOGGER_ERR, LOGGER_C_THREADING,
 		       "undefined thread group requested (%u, max thread group is %u)\n",
 		       thread_group, threads_groups);
 		return -EINVAL;
 	}
 
-	/* Get the range of slots of the thread_group */
-	if (special_slot) {
-		i = special_slot;
-		upper = special_slot + 1;
-	} else {
-		i = thread_group * threads_per_threadgroup;
-		upper = (thread_group + 1) * threads_per_threadgroup;
-	}
+	job = calloc(1, sizeof(*job));
+	CKNULL(job, -ENOMEM);
+	job->start_routine = start_routine;
+	job->data = tdata;
+	job->group = grp;
 
-	for (; i < upper; i++) {
-		if (atomic_bool_read(&threads_in_cancel))
-			return -ESHUTDOWN;
-
-		if (mutex_w_trylock(&threads[i].inuse)) {
-			/* The thread is currently executing a body of code */
-			if (threads[i].start_routine ||
-			    atomic_bool_read(&threads[i].shutdown)) {
-				mutex_w_unlock(&threads[i].inuse);
-				continue;
-			}
-
-			/*
-			 * Thread is not being picked up by thread_wait of the
-			 * mother thread, skip.
-			 */
-			if (threads[i].scheduled &&
-			    !pthread_equal(threads[i].parent, self)) {
-				mutex_w_unlock(&threads[i].inuse);
-				continue;
-			}
+	/*
+	 * A cancellation of the mother thread must not happen while holding
+	 * the lock as the terminating workers require it.
+	 */
+	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &cancelstate);
+	mutex_w_lock(&threads_lock);
 
-			/*
-			 * Create thread as we have a clean slot and all
-			 * existing threads are busy.
-			 */
-			if (!thread_dirty(i)) {
-				int ret = thread_create(&threads[i], i);
+	/* Apply back-pressure if the job queue is full */
+	while (!atomic_bool_read(&threads_in_cancel) && thread_queue_full(grp))
+		thread_cond_wait(&grp->space_avail, 0);
 
-				if (ret)
-					return ret;
+	if (atomic_bool_read(&threads_in_cancel)) {
+		ret = -ESHUTDOWN;
+		goto unlock;
+	}
 
-				logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
-				       "Thread %u for thread group %u allocated\n",
-				       i, thread_group);
+	/* Return values of special threads are not collected by thread_wait */
+	if (thread_get_special_slot(thread_group)) {
+		if (ret_ancestor)
+			*ret_ancestor = grp->ret_ancestor;
+		grp->ret_ancestor = 0;
+	} else {
+		parent = thread_find_parent(pthread_self());
+		if (!parent) {
+			parent = calloc(1, sizeof(*parent));
+			if (!parent) {
+				ret = -ENOMEM;
+				goto unlock;
 			}
+			parent->parent = pthread_self();
+			parent->next = thread_parents;
+			thread_parents = parent;
+		}
 
-			/* Catch the return code of the ancestor thread */
-			if (ret_ancestor)
-				*ret_ancestor = threads[i].ret_ancestor;
+		/*
+		 * Catch the return code of the ancestor jobs which are
+		 * therefore not reported by thread_wait any more.
+		 */
+		if (ret_ancestor) {
+			*ret_ancestor = parent->ret;
+			parent->ret = 0;
+		}
+	}
 
-			/*
-			 * Use the thread from the thread pool and schedule
-			 * job.
-			 */
-			logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
-			       "Thread %u for thread group %u assigned\n", i,
-			       thread_group);
-			threads[i].data = tdata;
-			threads[i].start_routine = start_routine;
-			threads[i].parent = pthread_self();
-			threads[i].scheduled = true;
-			mutex_w_unlock(&threads[i].inuse);
-			return 0;
+	/*
+	 * Spawn a new thread if all existing threads are busy. If all slots
+	 * are occupied, let an idle worker of another thread group steal the
+	 * job - otherwise some busy worker will pick up the job.
+	 */
+	if (grp->idle <= grp->queued) {
+		ret = thread_create(grp);
+		if (ret == -EAGAIN) {
+			thread_wake_thief(grp);
+			ret = 0;
+		} else if (ret) {
+			if (parent && !parent->outstanding)
+				thread_put_parent(parent);
+			goto unlock;
 		}
 	}
 
-	return -EAGAIN;
+	job->parent = parent;
+	if (parent)
+		parent->outstanding++;
+
+	thread_job_enqueue(job);
+	job = NULL;
+
+	logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
+	       "Job for thread group %u queued\n", thread_group);
+
+	pthread_cond_signal(&grp->job_avail);
+
+unlock:
+	mutex_w_unlock(&threads_lock);
+	pthread_setcancelstate(cancelstate, NULL);
+out:
+	free(job);
+	return ret;
 }
 
 /*
- * Wait for all threads in spawned by calling thread and fetch the return code.
+ * Wait for all jobs spawned by calling thread and fetch the return code.
  */
 int thread_wait(void)
 {
-	unsigned int i;
-	pthread_t self = pthread_self();
+	struct thread_parent *parent;
+	struct thread_job *job;
+	char name[ACVP_THREAD_MAX_NAMELEN];
 	int ret = 0;
-	bool wait = true;
-
-	while (wait) {
-		wait = false;
-
-		/* Only wait for our children */
-		for (i = 0; i < THREADING_MAX_THREADS; i++) {
-			if (atomic_bool_read(&threads[i].shutdown))
-				return -ESHUTDOWN;
-
-			/* Thread is not initialized, skip */
-			if (!thread_dirty(i))
-				continue;
 
-			/* Thread is not one of our children, skip */
-			if (!pthread_equal(threads[i].parent, self))
-				continue;
+	mutex_w_lock(&threads_lock);
 
-			/* If the thread executes a job, skip but wait wait. */
-			if (!mutex_w_trylock(&threads[i].inuse)) {
-				wait = true;
-				continue;
-			}
+	parent = thread_find_parent(pthread_self());
+	if (!parent)
+		goto out;
 
-			/*
-			 * If there is a start routine, a job is pending and we
-			 * wait for it to finish.
-			 */
-			if (threads[i].start_routine) {
-				wait = true;
-			} else {
-				/* Collect return code of our threads */
-				ret |= threads[i].ret_ancestor;
-				threads[i].scheduled = false;
-			}
+	while (parent->outstanding) {
+		if (atomic_bool_read(&threads_in_cancel)) {
+			ret = -ESHUTDOWN;
+			goto out;
+		}
 
-			mutex_w_unlock(&threads[i].inuse);
+		/* Execute our own queued jobs instead of sleeping */
+		job = thread_job_get_child(parent);
+		if (job) {
+			struct thread_job *current = thread_current_job;
+
+			mutex_w_unlock(&threads_lock);
+
+			/* The job may rename the thread used for logging */
+			if (thread_get_name(name, sizeof(name)))
+				name[0] = '\0';
+			thread_current_job = job;
+			ret = job->start_routine(job->data);
+			thread_current_job = current;
+			thread_restore_name(name);
+
+			mutex_w_lock(&threads_lock);
+			thread_job_finish(job, ret);
+			ret = 0;
+			continue;
 		}
 
-		if (wait)
-			thread_block();
+		thread_cond_wait(&threads_completion, 0);
 	}
 
+	/* Collect return code of our threads */
+	ret = parent->ret;
+	thread_put_parent(parent);
+
+out:
+	mutex_w_unlock(&threads_lock);
 	return ret;
 }
 
@@ -418,6 +872,9 @@ int thread_set_name(enum acvp_request_type type, uint32_t id)
 	case acvp_totp:
 		snprintf(name, sizeof(name), "totp%u", id);
 		break;
+	case acvp_jwt:
+		snprintf(name, sizeof(name), "jwt%u", id);
+		break;
 	default:
 		snprintf(name, sizeof(name), "%u", id);
 		break;
@@ -435,35 +892,90 @@ int thread_get_name(char *name, size_t len)
 	return -pthread_getname_np(pthread_self(), name, len);
 }
 
+/*
+ * Join all workers of the slot range which are alive. The caller must not
+ * hold threads_lock as terminating workers require it. The return code
+ * indicates whether at least one worker was joined.
+ */
+static bool thread_join_all(unsigned int upper, bool cancel)
+{
+	pthread_t self = pthread_self();
+	unsigned int i;
+	bool joined = false;
+
+	for (i = 0; i < upper; i++) {
+		pthread_t thread_id;
+
+		mutex_w_lock(&threads_lock);
+		if (!threads[i].alive || threads[i].joining ||
+		    pthread_equal(threads[i].thread_id, self)) {
+			mutex_w_unlock(&threads_lock);
+			continue;
+		}
+		thread_id = threads[i].thread_id;
+		threads[i].joining = true;
+		mutex_w_unlock(&threads_lock);
+
+		if (cancel)
+			pthread_cancel(thread_id);
+		pthread_join(thread_id, NULL);
+
+		mutex_w_lock(&threads_lock);
+		threads[i].alive = false;
+		threads[i].joining = false;
+		mutex_w_unlock(&threads_lock);
+
+		joined = true;
+		logger(LOGGER_VERBOSE, LOGGER_C_THREADING, "Thread %u %s\n", i,
+		       cancel ? "killed" : "terminated");
+	}
+
+	return joined;
+}
+
+/* Set or clear the shutdown state of the thread groups - threads_lock held */
+static void thread_shutdown_groups(unsigned int upper, bool shutdown)
+{
+	unsigned int i;
+
+	for (i = 0; i < upper; i++) {
+		thread_groups[i].shutdown = shutdown;
+		pthread_cond_broadcast(&thread_groups[i].job_avail);
+	}
+}
+
 /* Wait for all threads */
 static int thread_wait_all(bool system_threads)
 {
-	unsigned int i, upper = system_threads ? THREADING_REALLY_ALL_THREADS :
-						       THREADING_MAX_THREADS;
+	struct thread_parent *parent;
+	unsigned int upper = system_threads ? THREADING_REALLY_ALL_THREADS :
+						    THREADING_MAX_THREADS;
 	int ret = 0;
 
 	mutex_w_lock(&threads_cleanup);
 
-	/* Ensure that no new thread is spawned. */
-	for (i = 0; i < upper; i++)
-		atomic_bool_set_true(&threads[i].shutdown);
+	/* Let the workers terminate once all queued jobs are processed. */
+	mutex_w_lock(&threads_lock);
+	thread_shutdown_groups(upper, true);
+	mutex_w_unlock(&threads_lock);
 
-	/* Wait for all worker threads. */
-	for (i = 0; i < upper; i++) {
-		if (atomic_bool_read(&threads_in_cancel))
-			return -ESHUTDOWN;
-		if (thread_dirty(i)) {
-			pthread_join(threads[i].thread_id, NULL);
-			ret |= threads[i].ret_ancestor;
-			thread_cleanup_full(&threads[i]);
-			logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
-			       "Thread %u terminated\n", i);
+	/*
+	 * Wait for all worker threads. Jobs queued by the terminating jobs
+	 * spawn new workers which are reaped by the next round.
+	 */
+	while (thread_join_all(upper, false)) {
+		if (atomic_bool_read(&threads_in_cancel)) {
+			ret = -ESHUTDOWN;
+			break;
 		}
 	}
 
-	/* Allow new threads being spawned */
-	for (i = 0; i < upper; i++)
-		atomic_bool_set_false(&threads[i].shutdown);
+	/* Allow new threads being spawned and collect all return codes */
+	mutex_w_lock(&threads_lock);
+	thread_shutdown_groups(upper, false);
+	for (parent = thread_parents; parent; parent = parent->next)
+		ret |= parent->ret;
+	mutex_w_unlock(&threads_lock);
 
 	mutex_w_unlock(&threads_cleanup);
 
@@ -478,26 +990,26 @@ static void thread_cancel(bool system_threads)
 
 	atomic_bool_set_true(&threads_in_cancel);
 	mutex_w_lock(&threads_cleanup);
-	/* Ensure that no new thread is spawned. */
-	for (i = 0; i < upper; i++) {
-		atomic_bool_set_true(&threads[i].shutdown);
-		threads[i].start_routine = NULL;
+
+	/* Ensure that no queued job is executed any more. */
+	mutex_w_lock(&threads_lock);
+	for (i = 0; i < THREADING_REALLY_ALL_THREADS; i++) {
+		if (i < upper)
+			thread_job_flush(&thread_groups[i]);
+
+		/* Callers waiting for queue space must return */
+		pthread_cond_broadcast(&thread_groups[i].space_avail);
 	}
+	thread_shutdown_groups(upper, true);
+	pthread_cond_broadcast(&threads_completion);
+	mutex_w_unlock(&threads_lock);
 
 	/* Kill all worker threads. */
-	for (i = 0; i < upper; i++) {
-		if (thread_dirty(i)) {
-			pthread_cancel(threads[i].thread_id);
-			pthread_join(threads[i].thread_id, NULL);
-			thread_cleanup_full(&threads[i]);
-			logger(LOGGER_VERBOSE, LOGGER_C_THREADING,
-			       "Thread %u killed\n", i);
-		}
-	}
+	thread_join_all(upper, true);
 
 	/*
-	 * Do not set threads[i].shutdown to false any more as no new
-	 * thread shall be spawned. We are in the process of dying.
+	 * Do not clear the shutdown state of the thread groups any more as no
+	 * new thread shall be spawned. We are in the process of dying.
 	 */
 
 	mutex_w_unlock(&threads_cleanup);
@@ -506,23 +1018,36 @@ static void thread_cancel(bool system_threads)
 int thread_start(int (*start_routine)(void *), void *tdata,
 		 uint32_t thread_group, int *ret_ancestor)
 {
-	int ret;
+	return thread_schedule(start_routine, tdata, thread_group,
+			       ret_ancestor);
+}
 
-	while (1) {
-		ret = thread_schedule(start_routine, tdata, thread_group,
-				      ret_ancestor);
-		if (ret == -EAGAIN)
-			thread_block();
-		else
-			return ret;
-	}
+int thread_defer(unsigned int delay)
+{
+	struct thread_job *job = thread_current_job;
+
+	/* Only jobs of regular thread groups can be deferred */
+	if (!job || !job->parent)
+		return -EOPNOTSUPP;
+
+	/* The executing thread owns the job, no lock needed */
+	job->due = time(NULL) + (time_t)delay;
+	job->requeue = true;
 
 	return 0;
 }
 
 void thread_stop_spawning(void)
 {
+	unsigned int i;
+
 	atomic_bool_set_true(&threads_in_cancel);
+
+	/* Callers waiting for queue space must return */
+	mutex_w_lock(&threads_lock);
+	for (i = 0; i < THREADING_REALLY_ALL_THREADS; i++)
+		pthread_cond_broadcast(&thread_groups[i].space_avail);
+	mutex_w_unlock(&threads_lock);
 }
 
 int thread_release(bool force, bool system_threads)
@@ -573,6 +1098,12 @@ int thread_start(int (*start_routine)(void *), void *tdata,
 	return 0;
 }
 
+int thread_defer(unsigned int delay)
+{
+	(void)delay;
+	return -EOPNOTSUPP;
+}
+
 int thread_set_name(const char *name)
 {
 	(void)name;
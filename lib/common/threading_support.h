@@ -43,6 +43,11 @@ extern "C" {
  * group than the "child" threads. This ensures that there is no dead-lock
  * scenario where the "child" threads exhaust all threading resources
  * not allowing a "mother" thread to be created to handle the "children".
+ * The "child" thread group therefore must have a higher number than the
+ * "mother" thread group: idle threads may steal jobs from thread groups with
+ * a higher number, but never from thread groups with a lower number.
+ * Jobs of the last thread group must not spawn jobs of regular thread groups
+ * as they may be executed by their waiting mother thread.
  *
  * Special Thread Groups
  * ---------------------
@@ -63,13 +68,15 @@ extern "C" {
 #define ACVP_THREAD_TOTP_SERVER_GROUP ((uint32_t)-1)
 #define ACVP_THREAD_TOTP_PINGSERVER_GROUP ((uint32_t)-2)
 #define ACVP_THREAD_SIGHANDLER_GROUP ((uint32_t)-3)
-#define ACVP_THREAD_MAX_SPECIAL_GROUPS 3
+#define ACVP_THREAD_JWT_RENEW_GROUP ((uint32_t)-4)
+#define ACVP_THREAD_MAX_SPECIAL_GROUPS 4
 
 enum acvp_request_type {
 	acvp_testid,
 	acvp_vsid,
 	acvp_signal,
 	acvp_totp,
+	acvp_jwt,
 };
 
 /**
@@ -109,14 +116,45 @@ int thread_wait(void);
  *			     error)
  * @param tdata [in] Argument supplied to function
  * @param thread_group [in] Which thread group the thread belongs to.
- * @param ret_ancestor [out] Return code of garbage-collected ancestor. It may
- *			     be NULL if the return code is not of interest.
- *
- * @return 0 on success, < 0 on error
+ * @param ret_ancestor [out] Return code of garbage-collected ancestors. It
+ *			     may be NULL if the return code is not of
+ *			     interest. For regular thread groups, these are
+ *			     the ORed return codes of the jobs of the caller
+ *			     which completed since they were last collected.
+ *			     They are handed over to the caller and therefore
+ *			     NOT reported by thread_wait any more - a caller
+ *			     obtaining them must add them to its result. For
+ *			     special thread groups, it is the return code of
+ *			     the previous job of the thread group. In both
+ *			     cases, it is never the result of the job started
+ *			     with this call.
+ *
+ * The function only queues the job and does not wait for its execution. If
+ * the job queue of a regular thread group is full, the caller is blocked
+ * until a worker picks up a queued job. Jobs of the same or of a higher
+ * thread group are never blocked.
+ *
+ * @return 0 on success, < 0 on error - the return code only refers to the
+ *	   queueing of the job
  */
 int thread_start(int (*start_routine)(void *), void *tdata,
 		 uint32_t thread_group, int *ret_ancestor);
 
+/**
+ * @brief - Execute the currently running job again after the given delay
+ *
+ * The function may only be invoked by a job of a regular thread group. Once
+ * the job returns, it is parked without occupying a thread and started again
+ * with the same tdata after the delay passed. The return code of the job is
+ * ignored. The mother thread continues to wait for the job in thread_wait.
+ *
+ * @param delay [in] Delay in seconds
+ *
+ * @return 0 on success, -EOPNOTSUPP if the caller cannot be deferred - in
+ *	   this case the caller must perform the wait itself.
+ */
+int thread_defer(unsigned int delay);
+
 #define ACVP_THREAD_MAX_NAMELEN 16
 /**
  * @brief - Give a name to a thread that is used for logging
@@ -132,7 +132,7 @@ static int esvp_read_cc_def_one(const char *cc_dir_name, struct esvp_es_def *es)
 	struct json_object *cc_conf = NULL;
 	struct stat statbuf;
 	struct esvp_cc_def *cc = NULL;
-	char cc_file_name[FILENAME_MAX], cc_data_name[FILENAME_MAX];
+	char cc_file_name[FILENAME_MAX];
 	const char *str;
 	int ret;
 
@@ -176,10 +176,7 @@ static int esvp_read_cc_def_one(const char *cc_dir_name, struct esvp_es_def *es)
 	if (!cc->vetted) {
 		CKINT(json_get_bool(cc_conf, "bijective", &cc->bijective));
 
-		snprintf(cc_data_name, sizeof(cc_data_name), "%s/%s%s",
-			 cc->config_dir, ESVP_ES_FILE_CC_DATA,
-			 ESVP_ES_BINARY_FILE_EXTENSION);
-		CKINT(acvp_hash_file(cc_data_name, sha256, &cc->data_hash));
+		/* The data file is hashed by esvp_hash_es_files */
 	}
 
 	/*
@@ -249,13 +246,66 @@ out:
 	return ret;
 }
 
+/*
+ * Hash the raw noise, the restart and all conditioning component data files.
+ * The files are independent of each other and potentially large, so they
+ * are hashed concurrently.
+ */
+static int esvp_hash_es_files(struct esvp_es_def *es)
+{
+	struct acvp_hash_file_req *reqs;
+	struct esvp_cc_def *cc;
+	unsigned int num = 2;
+	int ret;
+
+	for (cc = es->cc; cc; cc = cc->next) {
+		if (!cc->vetted)
+			num++;
+	}
+
+	reqs = calloc(num, sizeof(*reqs));
+	CKNULL(reqs, -ENOMEM);
+
+	snprintf(reqs[0].pathname, sizeof(reqs[0].pathname), "%s/%s/%s%s",
+		 es->config_dir, ESVP_ES_DIR_ENTROPY_SOURCE,
+		 ESVP_ES_FILE_RAW_NOISE, ESVP_ES_BINARY_FILE_EXTENSION);
+	reqs[0].hash = sha256;
+	reqs[0].md = &es->raw_noise_data_hash;
+
+	snprintf(reqs[1].pathname, sizeof(reqs[1].pathname), "%s/%s/%s%s",
+		 es->config_dir, ESVP_ES_DIR_ENTROPY_SOURCE,
+		 ESVP_ES_FILE_RESTART_DATA, ESVP_ES_BINARY_FILE_EXTENSION);
+	reqs[1].hash = sha256;
+	reqs[1].md = &es->raw_noise_restart_hash;
+
+	num = 2;
+	for (cc = es->cc; cc; cc = cc->next) {
+		if (cc->vetted)
+			continue;
+
+		snprintf(reqs[num].pathname, sizeof(reqs[num].pathname),
+			 "%s/%s%s", cc->config_dir, ESVP_ES_FILE_CC_DATA,
+			 ESVP_ES_BINARY_FILE_EXTENSION);
+		reqs[num].hash = sha256;
+		reqs[num].md = &cc->data_hash;
+		num++;
+	}
+
+	ret = acvp_hash_files(reqs, num);
+
+	free(reqs);
+
+out:
+	return ret;
+}
+
 static int esvp_read_es_def(const char *directory, struct esvp_es_def **es_out)
 {
 	struct json_object *es_conf = NULL;
 	struct esvp_es_def *es = NULL;
 	struct stat statbuf;
 	const char *str;
-	char pathname[FILENAME_MAX], es_data_file[FILENAME_MAX];
+	char pathname[FILENAME_MAX];
 	int ret = 0;
 
 	CKNULL(es_out, -EINVAL);
@@ -292,17 +342,6 @@ static int esvp_read_es_def(const char *directory, struct esvp_es_def **es_out)
 	CKINT(json_get_string(es_conf, "primaryNoiseSource", &str));
 	CKINT(acvp_duplicate(&es->primary_noise_source_desc, str));
 
-	snprintf(es_data_file, sizeof(es_data_file), "%s/%s/%s%s",
-		 es->config_dir, ESVP_ES_DIR_ENTROPY_SOURCE,
-		 ESVP_ES_FILE_RAW_NOISE, ESVP_ES_BINARY_FILE_EXTENSION);
-	CKINT(acvp_hash_file(es_data_file, sha256, &es->raw_noise_data_hash));
-
-	snprintf(es_data_file, sizeof(es_data_file), "%s/%s/%s%s",
-		 es->config_dir, ESVP_ES_DIR_ENTROPY_SOURCE,
-		 ESVP_ES_FILE_RESTART_DATA, ESVP_ES_BINARY_FILE_EXTENSION);
-	CKINT(acvp_hash_file(es_data_file, sha256,
-			     &es->raw_noise_restart_hash));
-
 	CKINT(json_get_uint(es_conf, "bitsPerSample", &es->bits_per_sample));
 	CKINT(json_get_uint(es_conf, "alphabetSize", &es->alphabet_size));
 	CKINT(json_get_uint(es_conf, "numberOfRestarts",
@@ -319,6 +358,8 @@ static int esvp_read_es_def(const char *directory, struct esvp_es_def **es_out)
 
 	CKINT(esvp_read_cc_def(directory, es));
 
+	CKINT(esvp_hash_es_files(es));
+
 	*es_out = es;
 
 out:
@@ -33,6 +33,7 @@
 #include "internal.h"
 #include "json_wrapper.h"
 #include "logger.h"
+#include "mutex_w.h"
 #include "request_helper.h"
 #include "threading_support.h"
 
@@ -329,102 +330,213 @@ out:
 	return ret;
 }
 
+/*
+ * The data files are uploaded concurrently. The lock serializes the
+ * processing of the server responses which update the entropy source
+ * definition and its status file.
+ */
+static DEFINE_MUTEX_W_UNLOCKED(esvp_datafiles_lock);
+
+struct esvp_datafile_job {
+	const struct acvp_testid_ctx *testid_ctx;
+	char url[ACVP_NET_URL_MAXLEN];
+	char pathname[FILENAME_MAX];
+	bool *submitted;
+	char *data_type;
+	struct acvp_ext_buf itar;
+	struct acvp_ext_buf desc;
+	struct acvp_ext_buf *additional_keys;
+	int (*process_response)(const struct acvp_testid_ctx *testid_ctx,
+				const struct acvp_buf *response,
+				const char *pathname);
+};
+
+static bool esvp_datafile_submitted(const struct esvp_datafile_job *job)
+{
+	const struct acvp_testid_ctx *testid_ctx = job->testid_ctx;
+	const struct esvp_es_def *es = testid_ctx->es_def;
+	const struct esvp_sd_def *sd;
+	bool submitted = false;
+
+	mutex_w_lock(&esvp_datafiles_lock);
+
+	if (job->submitted && *job->submitted) {
+		submitted = true;
+		goto out;
+	}
+
+	/* Check whether supporting document file has been uploaded */
+	for (sd = es->sd; sd; sd = sd->next) {
+		if (!acvp_str_match(sd->filename, job->pathname,
+				    testid_ctx->testid)) {
+			submitted = true;
+			goto out;
+		}
+	}
+
+out:
+	mutex_w_unlock(&esvp_datafiles_lock);
+	return submitted;
+}
+
 /* POST multi */
-static int esvp_process_datafiles_post_one(
-	const struct acvp_testid_ctx *testid_ctx, const char *url,
-	char *pathname, bool *submitted, char *data_type,
-	struct acvp_ext_buf *additional_keys,
-	int (*proces_response)(const struct acvp_testid_ctx *testid_ctx,
-			       const struct acvp_buf *response,
-			       const char *pathname))
+static int esvp_process_datafiles_post_one(struct esvp_datafile_job *job)
 {
-	struct esvp_es_def *es = testid_ctx->es_def;
-	struct esvp_sd_def *sd;
+	const struct acvp_testid_ctx *testid_ctx = job->testid_ctx;
 	struct stat statbuf;
 	ACVP_EXT_BUFFER_INIT(data);
 	ACVP_BUFFER_INIT(response);
-	int ret, ret2, fd;
+	int ret, ret2, fd = -1;
 
-	if (submitted && *submitted) {
+	if (esvp_datafile_submitted(job)) {
 		logger(LOGGER_DEBUG, LOGGER_C_ANY,
 		       "Data found in %s already submitted, no resubmit\n",
-		       pathname);
+		       job->pathname);
 		return 0;
 	}
 
-	/* Check whether supporting document file has been uploaded */
-	for (sd = es->sd; sd; sd = sd->next) {
-		if (!acvp_str_match(sd->filename, pathname,
-				    testid_ctx->testid)) {
-			logger(LOGGER_DEBUG, LOGGER_C_ANY,
-			       "Data found in %s already submitted, no resubmit\n",
-			       pathname);
-			return 0;
-		}
+	fd = open(job->pathname, O_RDONLY | O_CLOEXEC);
+	if (fd < 0) {
+		ret = -errno;
+
+		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
+		       "Cannot open file %s (%d)\n", job->pathname, ret);
+		goto out;
 	}
 
-	if (stat(pathname, &statbuf)) {
-		int errsv = errno;
+	if (fstat(fd, &statbuf)) {
+		ret = -errno;
 
 		logger(LOGGER_WARN, LOGGER_C_ANY,
 		       "Accessing file %s failed (stat error code %d)\n",
-		       pathname, errsv);
-		return -errsv;
+		       job->pathname, -ret);
+		goto out;
 	}
 
 	if (!S_ISREG(statbuf.st_mode)) {
 		logger(LOGGER_ERR, LOGGER_C_ANY,
-		       "File %s is not a regular file\n", pathname);
-		return -EINVAL;
+		       "File %s is not a regular file\n", job->pathname);
+		ret = -EINVAL;
+		goto out;
 	}
 
-	fd = open(pathname, O_RDONLY | O_CLOEXEC);
-	if (fd < 0) {
-		ret = -errno;
+	/*
+	 * The file is read by the network backend during the upload, it is
+	 * never held in memory as a whole.
+	 */
+	logger(LOGGER_DEBUG, LOGGER_C_ANY, "Posting file %s\n", job->pathname);
+	data.file_fd = fd;
+	data.file_len = (uint64_t)statbuf.st_size;
+	data.data_type = job->data_type;
+	data.filename = basename(job->pathname);
+	data.next = job->additional_keys;
 
-		logger(LOGGER_WARN, LOGGER_C_DS_FILE,
-		       "Cannot open file %s (%d)\n", pathname, ret);
-		goto out;
+	logger_status(LOGGER_C_ANY, "Submitting file %s\n", job->pathname);
+
+	/* Send the data to the ESVP server. */
+	ret2 = acvp_net_op(testid_ctx, job->url, &data, &response,
+			   acvp_http_post_multi);
+
+	CKINT(acvp_request_error_handler(ret2));
+
+	mutex_w_lock(&esvp_datafiles_lock);
+	ret = job->process_response(testid_ctx, &response, job->pathname);
+	if (!ret) {
+		if (job->submitted)
+			*job->submitted = true;
+
+		ret = esvp_write_status(testid_ctx);
 	}
+	mutex_w_unlock(&esvp_datafiles_lock);
 
-	data.buf = mmap(NULL, (size_t)statbuf.st_size, PROT_READ, MAP_SHARED,
-			fd, 0);
-	if (data.buf == MAP_FAILED) {
-		logger(LOGGER_WARN, LOGGER_C_DS_FILE, "Cannot mmap file %s\n",
-		       pathname);
-		ret = -ENOMEM;
-		goto out;
+out:
+	if (fd >= 0)
+		close(fd);
+	acvp_free_buf(&response);
+	return ret;
+}
+
+#ifdef ACVP_USE_PTHREAD
+static int esvp_process_datafiles_post_thread(void *arg)
+{
+	struct esvp_datafile_job *job = arg;
+	int ret;
+
+	thread_set_name(acvp_testid, job->testid_ctx->testid);
+
+	ret = esvp_process_datafiles_post_one(job);
+	if (ret) {
+		logger(LOGGER_ERR, LOGGER_C_ANY, "Cannot post data file %s\n",
+		       job->pathname);
 	}
 
-	logger(LOGGER_DEBUG, LOGGER_C_ANY, "Posting file %s\n", pathname);
-	data.len = (uint32_t)statbuf.st_size;
-	data.data_type = data_type;
-	data.filename = basename(pathname);
-	data.next = additional_keys;
+	free(job);
+	return ret;
+}
+#endif
 
-	logger_status(LOGGER_C_ANY, "Submitting file %s\n", pathname);
+/*
+ * Upload one data file - the upload is performed in a separate thread unless
+ * threading is disabled. The job is consumed by this function. The result of
+ * a threaded upload is collected by the thread_wait of the caller.
+ */
+static int esvp_process_datafiles_post_start(struct esvp_datafile_job *job)
+{
+	int ret;
 
-	/* Send the data to the ESVP server. */
-	ret2 = acvp_net_op(testid_ctx, url, &data, &response,
-			   acvp_http_post_multi);
+#ifdef ACVP_USE_PTHREAD
+	const struct acvp_ctx *ctx = job->testid_ctx->ctx;
+	const struct acvp_opts_ctx *opts = &ctx->options;
+
+	/* Disable threading in DEBUG mode */
+	if (!opts->threading_disabled) {
+		ret = thread_start(esvp_process_datafiles_post_thread, job, 1,
+				   NULL);
+		if (ret)
+			free(job);
+		return ret;
+	}
+#endif
+
+	ret = esvp_process_datafiles_post_one(job);
+	if (ret) {
+		logger(LOGGER_ERR, LOGGER_C_ANY, "Cannot post data file %s\n",
+		       job->pathname);
+	}
 
-	ret = acvp_request_error_handler(ret2);
+	free(job);
+	return ret;
+}
 
-	munmap(data.buf, (size_t)statbuf.st_size);
-	close(fd);
+static int esvp_datafile_job_alloc(const struct acvp_testid_ctx *testid_ctx,
+				   const char *url_op, uint32_t data_id,
+				   bool *submitted, char *data_type,
+				   struct esvp_datafile_job **job_out)
+{
+	struct esvp_datafile_job *job;
+	int ret;
 
-	if (ret)
-		goto out;
+	job = calloc(1, sizeof(*job));
+	CKNULL(job, -ENOMEM);
 
-	CKINT(proces_response(testid_ctx, &response, pathname));
+	job->testid_ctx = testid_ctx;
+	job->submitted = submitted;
+	job->data_type = data_type;
+	job->process_response = esvp_process_post_one_response;
 
-	if (submitted)
-		*submitted = true;
+	CKINT_LOG(acvp_create_url(url_op, job->url, sizeof(job->url)),
+		  "Creation of request URL failed\n");
+	if (data_id) {
+		CKINT(acvp_extend_string(job->url, sizeof(job->url),
+					 "/%u/%s/%u", testid_ctx->testid,
+					 NIST_ESVP_VAL_OP_DATAFILE, data_id));
+	}
 
-	CKINT(esvp_write_status(testid_ctx));
+	*job_out = job;
 
 out:
-	acvp_free_buf(&response);
+	if (ret)
+		free(job);
 	return ret;
 }
 
@@ -432,42 +544,33 @@ static int esvp_process_datafiles_post(struct acvp_testid_ctx *testid_ctx)
 {
 	struct esvp_es_def *es = testid_ctx->es_def;
 	struct esvp_cc_def *cc;
+	struct esvp_datafile_job *job;
 	DIR *doc_dir = NULL;
 	struct dirent *doc_dirent;
-	ACVP_EXT_BUFFER_INIT(itar);
-	ACVP_EXT_BUFFER_INIT(desc);
-	char doc_dir_name[FILENAME_MAX - 256], pathname[FILENAME_MAX],
-		url[ACVP_NET_URL_MAXLEN];
+	char doc_dir_name[FILENAME_MAX - 256];
 	int ret;
 
 	/* Post the raw noise data file */
-	snprintf(pathname, sizeof(pathname), "%s/%s/%s%s", es->config_dir,
-		 ESVP_ES_DIR_ENTROPY_SOURCE, ESVP_ES_FILE_RAW_NOISE,
-		 ESVP_ES_BINARY_FILE_EXTENSION);
-	CKINT_LOG(acvp_create_url(NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT, url,
-				  sizeof(url)),
-		  "Creation of request URL failed\n");
-	CKINT(acvp_extend_string(url, sizeof(url), "/%u/%s/%u",
-				 testid_ctx->testid, NIST_ESVP_VAL_OP_DATAFILE,
-				 es->raw_noise_id));
-	CKINT_LOG(esvp_process_datafiles_post_one(
-			  testid_ctx, url, pathname, &es->raw_noise_submitted,
-			  "dataFile", NULL, esvp_process_post_one_response),
+	CKINT(esvp_datafile_job_alloc(testid_ctx,
+				      NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT,
+				      es->raw_noise_id,
+				      &es->raw_noise_submitted, "dataFile",
+				      &job));
+	snprintf(job->pathname, sizeof(job->pathname), "%s/%s/%s%s",
+		 es->config_dir, ESVP_ES_DIR_ENTROPY_SOURCE,
+		 ESVP_ES_FILE_RAW_NOISE, ESVP_ES_BINARY_FILE_EXTENSION);
+	CKINT_LOG(esvp_process_datafiles_post_start(job),
 		  "Cannot post raw noise data\n");
 
 	/* Post the restart data file */
-	snprintf(pathname, sizeof(pathname), "%s/%s/%s%s", es->config_dir,
-		 ESVP_ES_DIR_ENTROPY_SOURCE, ESVP_ES_FILE_RESTART_DATA,
-		 ESVP_ES_BINARY_FILE_EXTENSION);
-	CKINT_LOG(acvp_create_url(NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT, url,
-				  sizeof(url)),
-		  "Creation of request URL failed\n");
-	CKINT(acvp_extend_string(url, sizeof(url), "/%u/%s/%u",
-				 testid_ctx->testid, NIST_ESVP_VAL_OP_DATAFILE,
-				 es->restart_id));
-	CKINT_LOG(esvp_process_datafiles_post_one(
-			  testid_ctx, url, pathname, &es->restart_submitted,
-			  "dataFile", NULL, esvp_process_post_one_response),
+	CKINT(esvp_datafile_job_alloc(testid_ctx,
+				      NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT,
+				      es->restart_id, &es->restart_submitted,
+				      "dataFile", &job));
+	snprintf(job->pathname, sizeof(job->pathname), "%s/%s/%s%s",
+		 es->config_dir, ESVP_ES_DIR_ENTROPY_SOURCE,
+		 ESVP_ES_FILE_RESTART_DATA, ESVP_ES_BINARY_FILE_EXTENSION);
+	CKINT_LOG(esvp_process_datafiles_post_start(job),
 		  "Cannot post restart noise data\n");
 
 	/* Post all conditioning component files */
@@ -476,17 +579,13 @@ static int esvp_process_datafiles_post(struct acvp_testid_ctx *testid_ctx)
 		if (cc->vetted)
 			continue;
 
-		snprintf(pathname, sizeof(pathname), "%s/%s%s", cc->config_dir,
-			 ESVP_ES_FILE_CC_DATA, ESVP_ES_BINARY_FILE_EXTENSION);
-		CKINT_LOG(acvp_create_url(NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT,
-					  url, sizeof(url)),
-			  "Creation of request URL failed\n");
-		CKINT(acvp_extend_string(url, sizeof(url), "/%u/%s/%u",
-					 testid_ctx->testid,
-					 NIST_ESVP_VAL_OP_DATAFILE, cc->cc_id));
-		CKINT(esvp_process_datafiles_post_one(
-			testid_ctx, url, pathname, &cc->output_submitted,
-			"dataFile", NULL, esvp_process_post_one_response));
+		CKINT(esvp_datafile_job_alloc(
+			testid_ctx, NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT,
+			cc->cc_id, &cc->output_submitted, "dataFile", &job));
+		snprintf(job->pathname, sizeof(job->pathname), "%s/%s%s",
+			 cc->config_dir, ESVP_ES_FILE_CC_DATA,
+			 ESVP_ES_BINARY_FILE_EXTENSION);
+		CKINT(esvp_process_datafiles_post_start(job));
 	}
 
 	snprintf(doc_dir_name, sizeof(doc_dir_name), "%s/%s", es->config_dir,
@@ -496,34 +595,42 @@ static int esvp_process_datafiles_post(struct acvp_testid_ctx *testid_ctx)
 	CKNULL_LOG(doc_dir, -errno, "Failed to open directory %s\n",
 		   doc_dir_name);
 
-	itar.buf = (uint8_t *)(es->itar ? "true" : "false");
-	itar.len = es->itar ? 4 : 5;
-	itar.data_type = "itar";
-	itar.next = &desc;
-	desc.data_type = "sdComments";
-
 	while ((doc_dirent = readdir(doc_dir)) != NULL) {
 		if (!acvp_usable_dirent(doc_dirent, NULL))
 			continue;
 
-		snprintf(pathname, sizeof(pathname), "%s/%s", doc_dir_name,
-			 doc_dirent->d_name);
-
-		desc.buf = (uint8_t *)doc_dirent->d_name;
-		desc.len = (uint32_t)strlen(doc_dirent->d_name);
-
-		CKINT_LOG(acvp_create_url(NIST_ESVP_VAL_OP_SUPPDOC, url,
-					  sizeof(url)),
-			  "Creation of request URL failed\n");
-
-		CKINT(esvp_process_datafiles_post_one(
-			testid_ctx, url, pathname, NULL, "sdFile", &itar,
-			esvp_process_post_one_sd_response));
+		CKINT(esvp_datafile_job_alloc(testid_ctx,
+					      NIST_ESVP_VAL_OP_SUPPDOC, 0, NULL,
+					      "sdFile", &job));
+		snprintf(job->pathname, sizeof(job->pathname), "%s/%s",
+			 doc_dir_name, doc_dirent->d_name);
+		job->process_response = esvp_process_post_one_sd_response;
+
+		/* The description is the file name of the document */
+		job->itar.buf = (uint8_t *)(es->itar ? "true" : "false");
+		job->itar.len = es->itar ? 4 : 5;
+		job->itar.file_fd = -1;
+		job->itar.data_type = "itar";
+		job->itar.next = &job->desc;
+		job->desc.buf = (uint8_t *)(job->pathname +
+					    strlen(doc_dir_name) + 1);
+		job->desc.len = (uint32_t)strlen((char *)job->desc.buf);
+		job->desc.file_fd = -1;
+		job->desc.data_type = "sdComments";
+		job->additional_keys = &job->itar;
+
+		CKINT(esvp_process_datafiles_post_start(job));
 	}
 
 out:
 	if (doc_dir)
 		closedir(doc_dir);
+
+#ifdef ACVP_USE_PTHREAD
+	/* All uploads must be completed before the testID can be processed */
+	ret |= thread_wait();
+#endif
+
 	return ret;
 }
 
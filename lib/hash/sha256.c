@@ -24,6 +24,29 @@
 #include "memset_secure.h"
 #include "sha256.h"
 
+/*
+ * Accelerated block transformations which are selected at runtime if the CPU
+ * supports the required instructions.
+ */
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+# define SHA256_X86_SHANI
+# include <cpuid.h>
+# include <immintrin.h>
+#elif defined(__aarch64__) && defined(__linux__) &&			\
+      (defined(__GNUC__) || defined(__clang__))
+# define SHA256_ARMV8_CE
+# include <arm_neon.h>
+# include <sys/auxv.h>
+# ifndef HWCAP_SHA2
+#  define HWCAP_SHA2 (1 << 6)
+# endif
+# ifdef __clang__
+#  define SHA256_ARMV8_CE_TARGET __attribute__((target("crypto")))
+# else
+#  define SHA256_ARMV8_CE_TARGET __attribute__((target("+crypto")))
+# endif
+#endif
+
 struct sha_ctx {
 	uint32_t H[8];
 	size_t msg_len;
@@ -70,7 +93,8 @@ static inline uint32_t ror(uint32_t x, int n)
 #define s0(x)		(ror(x, 7) ^ ror(x, 18) ^ (x >> 3))
 #define s1(x)		(ror(x, 17) ^ ror(x, 19) ^ (x >> 10))
 
-static inline void sha256_transform(struct sha_ctx *ctx, const uint8_t *in)
+static inline void sha256_transform_block(struct sha_ctx *ctx,
+					  const uint8_t *in)
 {
 	uint32_t W[64], a, b, c, d, e, f, g, h, T1, T2;
 	unsigned int i;
@@ -102,6 +126,163 @@ static inline void sha256_transform(struct sha_ctx *ctx, const uint8_t *in)
 		W[i] = 0;
 }
 
+static void sha256_transform_c(struct sha_ctx *ctx, const uint8_t *in,
+			       size_t blocks)
+{
+	for (; blocks; blocks--, in += SHA256_SIZE_BLOCK)
+		sha256_transform_block(ctx, in);
+}
+
+#ifdef SHA256_X86_SHANI
+/*
+ * SHA-256 using the Intel SHA extensions. The state is kept in the ABEF / CDGH
+ * register layout required by the SHA256RNDS2 instruction.
+ */
+static void __attribute__((target("sha,sse4.1")))
+sha256_transform_shani(struct sha_ctx *ctx, const uint8_t *in, size_t blocks)
+{
+	const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL,
+					    0x0405060700010203ULL);
+	__m128i state0, state1, abef, cdgh, wk, tmp, msg[4];
+	unsigned int i;
+
+	tmp = _mm_loadu_si128((const __m128i *)&ctx->H[0]);
+	state1 = _mm_loadu_si128((const __m128i *)&ctx->H[4]);
+
+	tmp = _mm_shuffle_epi32(tmp, 0xB1); /* CDAB */
+	state1 = _mm_shuffle_epi32(state1, 0x1B); /* EFGH */
+	state0 = _mm_alignr_epi8(tmp, state1, 8); /* ABEF */
+	state1 = _mm_blend_epi16(state1, tmp, 0xF0); /* CDGH */
+
+	for (; blocks; blocks--, in += SHA256_SIZE_BLOCK) {
+		abef = state0;
+		cdgh = state1;
+
+		for (i = 0; i < 4; i++) {
+			msg[i] = _mm_shuffle_epi8(
+				_mm_loadu_si128((const __m128i *)(in + 16 * i)),
+				mask);
+		}
+
+		for (i = 0; i < 16; i++) {
+			/* Message schedule W[4i .. 4i+3] */
+			if (i >= 4) {
+				tmp = _mm_sha256msg1_epu32(msg[i & 3],
+							   msg[(i + 1) & 3]);
+				tmp = _mm_add_epi32(
+					tmp, _mm_alignr_epi8(msg[(i + 3) & 3],
+							     msg[(i + 2) & 3],
+							     4));
+				msg[i & 3] = _mm_sha256msg2_epu32(
+					tmp, msg[(i + 3) & 3]);
+			}
+
+			wk = _mm_add_epi32(
+				msg[i & 3],
+				_mm_loadu_si128(
+					(const __m128i *)&sha256_K[4 * i]));
+			state1 = _mm_sha256rnds2_epu32(state1, state0, wk);
+			wk = _mm_shuffle_epi32(wk, 0x0E);
+			state0 = _mm_sha256rnds2_epu32(state0, state1, wk);
+		}
+
+		state0 = _mm_add_epi32(state0, abef);
+		state1 = _mm_add_epi32(state1, cdgh);
+	}
+
+	tmp = _mm_shuffle_epi32(state0, 0x1B); /* FEBA */
+	state1 = _mm_shuffle_epi32(state1, 0xB1); /* DCHG */
+	state0 = _mm_blend_epi16(tmp, state1, 0xF0); /* DCBA */
+	state1 = _mm_alignr_epi8(state1, tmp, 8); /* HGFE */
+
+	_mm_storeu_si128((__m128i *)&ctx->H[0], state0);
+	_mm_storeu_si128((__m128i *)&ctx->H[4], state1);
+}
+
+static int sha256_shani_available(void)
+{
+	unsigned int eax, ebx, ecx, edx;
+
+	/* SSSE3 and SSE4.1 */
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) ||
+	    !(ecx & (1 << 9)) || !(ecx & (1 << 19)))
+		return 0;
+
+	/* SHA extensions */
+	if (!__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx))
+		return 0;
+
+	return !!(ebx & (1 << 29));
+}
+#endif
+
+#ifdef SHA256_ARMV8_CE
+/* SHA-256 using the ARMv8 cryptographic extensions */
+static void SHA256_ARMV8_CE_TARGET
+sha256_transform_armv8_ce(struct sha_ctx *ctx, const uint8_t *in,
+			  size_t blocks)
+{
+	uint32x4_t state0, state1, abcd, efgh, wk, tmp, msg[4];
+	unsigned int i;
+
+	state0 = vld1q_u32(&ctx->H[0]);
+	state1 = vld1q_u32(&ctx->H[4]);
+
+	for (; blocks; blocks--, in += SHA256_SIZE_BLOCK) {
+		abcd = state0;
+		efgh = state1;
+
+		for (i = 0; i < 4; i++) {
+			msg[i] = vreinterpretq_u32_u8(
+				vrev32q_u8(vld1q_u8(in + 16 * i)));
+		}
+
+		for (i = 0; i < 16; i++) {
+			wk = vaddq_u32(msg[i & 3], vld1q_u32(&sha256_K[4 * i]));
+
+			/* Message schedule W[4i + 16 .. 4i + 19] */
+			if (i < 12) {
+				msg[i & 3] = vsha256su1q_u32(
+					vsha256su0q_u32(msg[i & 3],
+							msg[(i + 1) & 3]),
+					msg[(i + 2) & 3], msg[(i + 3) & 3]);
+			}
+
+			tmp = state0;
+			state0 = vsha256hq_u32(state0, state1, wk);
+			state1 = vsha256h2q_u32(state1, tmp, wk);
+		}
+
+		state0 = vaddq_u32(state0, abcd);
+		state1 = vaddq_u32(state1, efgh);
+	}
+
+	vst1q_u32(&ctx->H[0], state0);
+	vst1q_u32(&ctx->H[4], state1);
+}
+
+static int sha256_armv8_ce_available(void)
+{
+	return !!(getauxval(AT_HWCAP) & HWCAP_SHA2);
+}
+#endif
+
+/* Transformation of full blocks with the fastest available implementation */
+static void (*sha256_transform)(struct sha_ctx *ctx, const uint8_t *in,
+				size_t blocks) = sha256_transform_c;
+
+static void __attribute__((constructor)) sha256_select(void)
+{
+#ifdef SHA256_X86_SHANI
+	if (sha256_shani_available())
+		sha256_transform = sha256_transform_shani;
+#endif
+#ifdef SHA256_ARMV8_CE
+	if (sha256_armv8_ce_available())
+		sha256_transform = sha256_transform_armv8_ce;
+#endif
+}
+
 static void sha256_update(struct sha_ctx *ctx, const uint8_t *in, size_t inlen)
 {
 	unsigned int partial = ctx->msg_len % SHA256_SIZE_BLOCK;
@@ -129,13 +310,17 @@ static void sha256_update(struct sha_ctx *ctx, const uint8_t *in, size_t inlen)
 		inlen -= todo;
 		in += todo;
 
-		sha256_transform(ctx, ctx->partial);
+		sha256_transform(ctx, ctx->partial, 1);
 	}
 
 	/* Perform a transformation of full block-size messages */
-	for (; inlen >= SHA256_SIZE_BLOCK;
-	     inlen -= SHA256_SIZE_BLOCK, in += SHA256_SIZE_BLOCK)
-		sha256_transform(ctx, in);
+	if (inlen >= SHA256_SIZE_BLOCK) {
+		size_t blocks = inlen / SHA256_SIZE_BLOCK;
+
+		sha256_transform(ctx, in, blocks);
+		inlen -= blocks * SHA256_SIZE_BLOCK;
+		in += blocks * SHA256_SIZE_BLOCK;
+	}
 
 	/* If we have data left, copy it into the partial block buffer */
 	memcpy(ctx->partial, in, inlen);
@@ -160,7 +345,7 @@ static void sha256_final(struct sha_ctx *ctx, uint8_t *digest)
 	if (partial > (SHA256_SIZE_BLOCK - (2 * sizeof(uint32_t)))) {
 		memset(ctx->partial + partial, 0, SHA256_SIZE_BLOCK - partial);
 		partial = 0;
-		sha256_transform(ctx, ctx->partial);
+		sha256_transform(ctx, ctx->partial, 1);
 	}
 
 	/* Fill the unused part of the partial buffer with zeros */
@@ -171,7 +356,7 @@ static void sha256_final(struct sha_ctx *ctx, uint8_t *digest)
 	be64_to_ptr(ctx->partial + (SHA256_SIZE_BLOCK - 8), ctx->msg_len);
 
 	/* Final transformation */
-	sha256_transform(ctx, ctx->partial);
+	sha256_transform(ctx, ctx->partial, 1);
 
 	memset_secure(ctx->partial, 0, SHA256_SIZE_BLOCK);
 
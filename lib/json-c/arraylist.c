@@ -35,30 +35,46 @@
 #endif
 
 #include "arraylist.h"
+#include "json_arena.h"
 
 struct array_list*
-array_list_new(array_list_free_fn *free_fn)
+array_list_new_arena(array_list_free_fn *free_fn, struct json_arena *arena)
 {
   struct array_list *arr;
 
-  arr = (struct array_list*)calloc(1, sizeof(struct array_list));
+  if (arena)
+    arr = (struct array_list*)json_arena_calloc(arena, 1, sizeof(struct array_list));
+  else
+    arr = (struct array_list*)calloc(1, sizeof(struct array_list));
   if(!arr) return NULL;
   arr->size = ARRAY_LIST_DEFAULT_SIZE;
   arr->length = 0;
   arr->free_fn = free_fn;
-  if(!(arr->array = (void**)calloc(sizeof(void*), arr->size))) {
-    free(arr);
+  arr->arena = arena;
+  if (arena)
+    arr->array = (void**)json_arena_calloc(arena, sizeof(void*), arr->size);
+  else
+    arr->array = (void**)calloc(sizeof(void*), arr->size);
+  if(!arr->array) {
+    if (!arena) free(arr);
     return NULL;
   }
   return arr;
 }
 
+struct array_list*
+array_list_new(array_list_free_fn *free_fn)
+{
+  return array_list_new_arena(free_fn, NULL);
+}
+
 extern void
 array_list_free(struct array_list *arr)
 {
   size_t i;
   for(i = 0; i < arr->length; i++)
     if(arr->array[i]) arr->free_fn(arr->array[i]);
+  if (arr->arena) return;
   free(arr->array);
   free(arr);
 }
@@ -86,7 +102,12 @@ static int array_list_expand_internal(struct array_list *arr, size_t max)
       new_size = max;
   }
   if (new_size > (~((size_t)0)) / sizeof(void*)) return -1;
-  if (!(t = realloc(arr->array, new_size*sizeof(void*)))) return -1;
+  if (arr->arena)
+  {
+    if (!(t = json_arena_alloc(arr->arena, new_size*sizeof(void*)))) return -1;
+    memcpy(t, arr->array, arr->size*sizeof(void*));
+  }
+  else if (!(t = realloc(arr->array, new_size*sizeof(void*)))) return -1;
   arr->array = (void**)t;
   (void)memset(arr->array + arr->size, 0, (new_size-arr->size)*sizeof(void*));
   arr->size = new_size;
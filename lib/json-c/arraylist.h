@@ -26,18 +26,26 @@ extern "C" {
 
 typedef void (array_list_free_fn) (void *data);
 
+struct json_arena;
+
 struct array_list
 {
   void **array;
   size_t length;
   size_t size;
   array_list_free_fn *free_fn;
+  /* Arena the list is allocated from, NULL for the heap */
+  struct json_arena *arena;
 };
 typedef struct array_list array_list;
 
 extern struct array_list*
 array_list_new(array_list_free_fn *free_fn);
 
+/* The memory of the list is released with the arena */
+extern struct array_list*
+array_list_new_arena(array_list_free_fn *free_fn, struct json_arena *arena);
+
 extern void
 array_list_free(struct array_list *al);
 
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2021 Stephan Mueller <smueller@chronox.de>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "json_arena.h"
+#include "json_object.h"
+#include "json_object_private.h"
+
+/* Size of the first chunk, the chunk size doubles up to the maximum */
+#define JSON_ARENA_CHUNK_MIN	(16 * 1024)
+#define JSON_ARENA_CHUNK_MAX	(1024 * 1024)
+/* Alignment of all allocations */
+#define JSON_ARENA_ALIGN	16
+
+struct json_arena_chunk {
+	struct json_arena_chunk *next;
+	size_t size;
+	size_t used;
+	/* Keep the data aligned */
+	uint64_t pad;
+	unsigned char data[];
+};
+
+struct json_arena_cleanup {
+	struct json_arena_cleanup *next;
+	void (*cleanup)(void *);
+	void *data;
+};
+
+struct json_arena {
+	/* Current chunk at the head followed by the full chunks */
+	struct json_arena_chunk *chunks;
+	struct json_arena_cleanup *cleanups;
+	struct json_object *owner;
+	size_t next_size;
+	size_t allocated;
+};
+
+#if defined(HAVE___THREAD)
+static SPEC___THREAD struct json_arena *json_arena_active = NULL;
+#else
+#error Thread-local storage is required for the JSON arena
+#endif
+
+struct json_arena *json_arena_new(void)
+{
+	return calloc(1, sizeof(struct json_arena));
+}
+
+void json_arena_free(struct json_arena *arena)
+{
+	struct json_arena_cleanup *c;
+	struct json_arena_chunk *chunk;
+
+	if (!arena)
+		return;
+
+	/* The cleanup entries live in the chunks */
+	for (c = arena->cleanups; c; c = c->next)
+		c->cleanup(c->data);
+
+	while (arena->chunks) {
+		chunk = arena->chunks;
+		arena->chunks = chunk->next;
+		free(chunk);
+	}
+
+	if (json_arena_active == arena)
+		json_arena_active = NULL;
+
+	free(arena);
+}
+
+struct json_arena *json_arena_set(struct json_arena *arena)
+{
+	struct json_arena *prev = json_arena_active;
+
+	json_arena_active = arena;
+	return prev;
+}
+
+struct json_arena *json_arena_get(void)
+{
+	return json_arena_active;
+}
+
+int json_arena_set_owner(struct json_object *jso)
+{
+	if (!jso || !jso->_arena)
+		return -1;
+
+	jso->_arena->owner = jso;
+	return 0;
+}
+
+int json_arena_is_owner(const struct json_object *jso)
+{
+	return (jso->_arena && jso->_arena->owner == jso);
+}
+
+size_t json_arena_size(const struct json_arena *arena)
+{
+	return arena ? arena->allocated : 0;
+}
+
+void *json_arena_alloc(struct json_arena *arena, size_t size)
+{
+	struct json_arena_chunk *chunk = arena->chunks;
+	size_t chunk_size;
+	void *ptr;
+
+	size = (size + JSON_ARENA_ALIGN - 1) & ~((size_t)JSON_ARENA_ALIGN - 1);
+	if (!size)
+		size = JSON_ARENA_ALIGN;
+
+	if (chunk && chunk->size - chunk->used >= size) {
+		ptr = chunk->data + chunk->used;
+		chunk->used += size;
+		return ptr;
+	}
+
+	if (!arena->next_size)
+		arena->next_size = JSON_ARENA_CHUNK_MIN;
+
+	/* Large allocations obtain a chunk of their own */
+	if (size > arena->next_size / 4) {
+		if (size > SIZE_MAX - sizeof(*chunk))
+			return NULL;
+
+		chunk = malloc(sizeof(*chunk) + size);
+		if (!chunk)
+			return NULL;
+		chunk->size = size;
+		chunk->used = size;
+		arena->allocated += size;
+
+		/* Keep the current chunk at the head */
+		if (arena->chunks) {
+			chunk->next = arena->chunks->next;
+			arena->chunks->next = chunk;
+		} else {
+			chunk->next = NULL;
+			arena->chunks = chunk;
+		}
+
+		return chunk->data;
+	}
+
+	chunk_size = arena->next_size;
+	if (arena->next_size < JSON_ARENA_CHUNK_MAX)
+		arena->next_size <<= 1;
+
+	chunk = malloc(sizeof(*chunk) + chunk_size);
+	if (!chunk)
+		return NULL;
+	chunk->size = chunk_size;
+	chunk->used = size;
+	chunk->next = arena->chunks;
+	arena->chunks = chunk;
+	arena->allocated += chunk_size;
+
+	return chunk->data;
+}
+
+void *json_arena_calloc(struct json_arena *arena, size_t nmemb, size_t size)
+{
+	void *ptr;
+
+	if (size && nmemb > SIZE_MAX / size)
+		return NULL;
+
+	ptr = json_arena_alloc(arena, nmemb * size);
+	if (ptr)
+		memset(ptr, 0, nmemb * size);
+	return ptr;
+}
+
+char *json_arena_strdup(struct json_arena *arena, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *ptr = json_arena_alloc(arena, len);
+
+	if (ptr)
+		memcpy(ptr, str, len);
+	return ptr;
+}
+
+int json_arena_add_cleanup(struct json_arena *arena, void (*cleanup)(void *),
+			   void *data)
+{
+	struct json_arena_cleanup *c = json_arena_alloc(arena, sizeof(*c));
+
+	if (!c)
+		return -1;
+
+	c->cleanup = cleanup;
+	c->data = data;
+	c->next = arena->cleanups;
+	arena->cleanups = c;
+	return 0;
+}
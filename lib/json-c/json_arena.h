@@ -0,0 +1,91 @@
+/*
+ * Copyright (c) 2021 Stephan Mueller <smueller@chronox.de>
+ *
+ * This library is free software; you can redistribute it and/or modify
+ * it under the terms of the MIT license. See COPYING for details.
+ *
+ */
+
+/**
+ * @file
+ * @brief Arena allocator for JSON object trees
+ *
+ * While an arena is active for the calling thread, all JSON objects created
+ * by this thread together with their hash tables, arrays, keys and strings
+ * are allocated from the arena. An arena is released in one bulk operation
+ * either with json_arena_free() or when the reference count of its owner
+ * drops to zero.
+ *
+ * The objects of an arena are never freed individually: json_object_put()
+ * on an object of an arena only maintains the reference count. Therefore, a
+ * reference obtained with json_object_get() for an object of an arena does
+ * not keep the object alive beyond the lifetime of its arena.
+ *
+ * Objects of an arena added to an object or array outside of the arena (and
+ * vice versa) are copied into the memory of the containing object.
+ */
+#ifndef _json_arena_h_
+#define _json_arena_h_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct json_arena;
+struct json_object;
+
+/**
+ * Allocate a new arena.
+ *
+ * @returns the arena or NULL if no memory is available
+ */
+extern struct json_arena *json_arena_new(void);
+
+/**
+ * Release all memory of the arena including all JSON objects allocated from
+ * it.
+ */
+extern void json_arena_free(struct json_arena *arena);
+
+/**
+ * Set the arena the calling thread allocates JSON objects from.
+ *
+ * @param arena arena to use, NULL to allocate from the heap
+ * @returns the previously active arena which should be restored with
+ *	    another call once the objects are created
+ */
+extern struct json_arena *json_arena_set(struct json_arena *arena);
+
+/**
+ * Get the arena the calling thread allocates JSON objects from.
+ */
+extern struct json_arena *json_arena_get(void);
+
+/**
+ * Make the object the owner of its arena: the arena is released once the
+ * reference count of the object drops to zero.
+ *
+ * @returns 0 on success, -1 if the object is not allocated from an arena
+ */
+extern int json_arena_set_owner(struct json_object *jso);
+
+/**
+ * Number of bytes allocated by the arena.
+ */
+extern size_t json_arena_size(const struct json_arena *arena);
+
+/* Allocation functions used by the JSON-C implementation */
+extern void *json_arena_alloc(struct json_arena *arena, size_t size);
+extern void *json_arena_calloc(struct json_arena *arena, size_t nmemb,
+			       size_t size);
+extern char *json_arena_strdup(struct json_arena *arena, const char *str);
+extern int json_arena_add_cleanup(struct json_arena *arena,
+				  void (*cleanup)(void *), void *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -26,6 +26,7 @@
 #include "printbuf.h"
 #include "linkhash.h"
 #include "arraylist.h"
+#include "json_arena.h"
 #include "json_inttypes.h"
 #include "json_object.h"
 #include "json_object_private.h"
@@ -49,6 +50,7 @@ const char *json_hex_chars = "0123456789abcdefABCDEF";
 
 static void json_object_generic_delete(struct json_object* jso);
 static struct json_object* json_object_new(enum json_type o_type);
+static json_object_delete_fn json_object_arena_userdata;
 
 static json_object_to_json_string_fn json_object_object_to_json_string;
 static json_object_to_json_string_fn json_object_boolean_to_json_string;
@@ -106,6 +108,13 @@ get_string_component(const struct json_object *jso)
 
 /* string escaping */
 
+/* Characters that may need to be escaped, all others are copied in runs */
+static const unsigned char json_escape_chars[256] = {
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+	['"'] = 1, ['/'] = 1, ['\\'] = 1,
+};
+
 static int json_escape_str(struct printbuf *pb, const char *str, size_t len, int flags)
 {
 	int pos = 0, start_offset = 0;
@@ -113,6 +122,11 @@ static int json_escape_str(struct printbuf *pb, const char *str, size_t len, int
 	while (len--)
 	{
 		c = (unsigned char)str[pos];
+		if (!json_escape_chars[c])
+		{
+			pos++;
+			continue;
+		}
 		switch(c)
 		{
 		case '\b':
@@ -130,7 +144,7 @@ static int json_escape_str(struct printbuf *pb, const char *str, size_t len, int
 			}
 
 			if(pos - start_offset > 0)
-				printbuf_memappend(pb, str + start_offset, pos - start_offset);
+				printbuf_memappend_fast(pb, str + start_offset, pos - start_offset);
 
 			if(c == '\b') printbuf_memappend(pb, "\\b", 2);
 			else if(c == '\n') printbuf_memappend(pb, "\\n", 2);
@@ -162,7 +176,7 @@ static int json_escape_str(struct printbuf *pb, const char *str, size_t len, int
 		}
 	}
 	if (pos - start_offset > 0)
-		printbuf_memappend(pb, str + start_offset, pos - start_offset);
+		printbuf_memappend_fast(pb, str + start_offset, pos - start_offset);
 	return 0;
 }
 
@@ -208,6 +222,15 @@ int json_object_put(struct json_object *jso)
 
 	if (jso->_user_delete)
 		jso->_user_delete(jso, jso->_userdata);
+
+	/* Objects of an arena are only released with their arena */
+	if (jso->_arena)
+	{
+		if (json_arena_is_owner(jso))
+			json_arena_free(jso->_arena);
+		return 1;
+	}
+
 	jso->_delete(jso);
 	return 1;
 }
@@ -215,6 +238,32 @@ int json_object_put(struct json_object *jso)
 
 /* generic object construction and destruction parts */
 
+/*
+ * A value allocated from a different arena than the containing object (or
+ * from the heap) is copied into the memory of the containing object. The
+ * reference to the original value is consumed as if the value was added.
+ */
+static int json_object_arena_import(struct json_object *jso,
+				    struct json_object **val)
+{
+	struct json_arena *prev;
+	struct json_object *copy = NULL;
+	int rc;
+
+	if (!*val || (*val)->_arena == jso->_arena)
+		return 0;
+
+	prev = json_arena_set(jso->_arena);
+	rc = json_object_deep_copy(*val, &copy, NULL);
+	json_arena_set(prev);
+	if (rc < 0)
+		return -1;
+
+	json_object_put(*val);
+	*val = copy;
+	return 0;
+}
+
 static void json_object_generic_delete(struct json_object* jso)
 {
 #ifdef REFCOUNT_DEBUG
@@ -223,16 +272,22 @@ static void json_object_generic_delete(struct json_object* jso)
 	lh_table_delete(json_object_table, jso);
 #endif /* REFCOUNT_DEBUG */
 	printbuf_free(jso->_pb);
-	free(jso);
+	if (!jso->_arena)
+		free(jso);
 }
 
 static struct json_object* json_object_new(enum json_type o_type)
 {
+	struct json_arena *arena = json_arena_get();
 	struct json_object *jso;
 
-	jso = (struct json_object*)calloc(sizeof(struct json_object), 1);
+	if (arena)
+		jso = (struct json_object*)json_arena_calloc(arena, sizeof(struct json_object), 1);
+	else
+		jso = (struct json_object*)calloc(sizeof(struct json_object), 1);
 	if (!jso)
 		return NULL;
+	jso->_arena = arena;
 	jso->o_type = o_type;
 	jso->_ref_count = 1;
 	jso->_delete = &json_object_generic_delete;
@@ -323,6 +378,25 @@ void json_object_set_serializer(json_object *jso,
 
 /* extended conversion to string */
 
+static void json_object_printbuf_cleanup(void *data)
+{
+	printbuf_free((struct printbuf *)data);
+}
+
+/* The print buffer of an object of an arena is released with the arena */
+static struct printbuf *json_object_new_printbuf(struct json_object *jso)
+{
+	struct printbuf *pb = printbuf_new();
+
+	if (pb && jso->_arena &&
+	    json_arena_add_cleanup(jso->_arena, json_object_printbuf_cleanup, pb))
+	{
+		printbuf_free(pb);
+		return NULL;
+	}
+	return pb;
+}
+
 const char* json_object_to_json_string_length(struct json_object *jso, int flags, size_t *length)
 {
 	const char *r = NULL;
@@ -333,7 +407,7 @@ const char* json_object_to_json_string_length(struct json_object *jso, int flags
 		s = 4;
 		r = "null";
 	}
-	else if ((jso->_pb) || (jso->_pb = printbuf_new()))
+	else if ((jso->_pb) || (jso->_pb = json_object_new_printbuf(jso)))
 	{
 		printbuf_reset(jso->_pb);
 
@@ -349,6 +423,24 @@ const char* json_object_to_json_string_length(struct json_object *jso, int flags
 	return r;
 }
 
+int json_object_to_printbuf(struct json_object *jso, struct printbuf *pb,
+			    int flags, size_t *length)
+{
+	size_t start = pb->flushed + (size_t)pb->bpos;
+
+	if (!jso)
+	{
+		if (printbuf_strappend(pb, "null") < 0)
+			return -1;
+	}
+	else if (jso->_to_json_string(jso, pb, 0, flags) < 0)
+		return -1;
+
+	if (length)
+		*length = pb->flushed + (size_t)pb->bpos - start;
+	return 0;
+}
+
 const char* json_object_to_json_string_ext(struct json_object *jso, int flags)
 {
 	return json_object_to_json_string_length(jso, flags, NULL);
@@ -446,8 +538,9 @@ struct json_object* json_object_new_object(void)
 		return NULL;
 	jso->_delete = &json_object_object_delete;
 	jso->_to_json_string = &json_object_object_to_json_string;
-	jso->o.c_object = lh_kchar_table_new(JSON_OBJECT_DEF_HASH_ENTRIES,
-					     &json_object_lh_entry_free);
+	jso->o.c_object = lh_kchar_table_new_arena(JSON_OBJECT_DEF_HASH_ENTRIES,
+						   &json_object_lh_entry_free,
+						   jso->_arena);
 	if (!jso->o.c_object)
 	{
 		json_object_generic_delete(jso);
@@ -472,8 +565,8 @@ struct lh_table* json_object_get_object(const struct json_object *jso)
 
 int json_object_object_add_ex(struct json_object* jso,
 	const char *const key,
-	struct json_object *const val,
-	const unsigned opts)
+	struct json_object *val,
+	unsigned opts)
 {
 	struct json_object *existing_value = NULL;
 	struct lh_entry *existing_entry;
@@ -493,10 +586,23 @@ int json_object_object_add_ex(struct json_object* jso,
 	if (jso == val)
 		return -1;
 
+	if (json_object_arena_import(jso, &val))
+		return -1;
+
 	if (!existing_entry)
 	{
-		const void *const k = (opts & JSON_C_OBJECT_KEY_IS_CONSTANT) ?
-					(const void *)key : strdup(key);
+		const void *k;
+
+		if (opts & JSON_C_OBJECT_KEY_IS_CONSTANT)
+			k = (const void *)key;
+		else if (jso->_arena)
+		{
+			/* The key is released with the arena */
+			k = json_arena_strdup(jso->_arena, key);
+			opts |= JSON_C_OBJECT_KEY_IS_CONSTANT;
+		}
+		else
+			k = strdup(key);
 		if (k == NULL)
 			return -1;
 		return lh_table_insert_w_hash(jso->o.c_object, k, val, hash, opts);
@@ -623,10 +729,18 @@ static int json_object_int_to_json_string(struct json_object* jso,
 	(void)level;
 	(void)flags;
 
-	/* room for 19 digits, the sign char, and a null term */
-	char sbuf[21];
-	snprintf(sbuf, sizeof(sbuf), "%" PRId64, jso->o.c_int64);
-	return printbuf_memappend (pb, sbuf, (int)strlen(sbuf));
+	/* room for 19 digits and the sign char, converted without snprintf */
+	char sbuf[21], *p = sbuf + sizeof(sbuf);
+	uint64_t val = (jso->o.c_int64 < 0) ? 0 - (uint64_t)jso->o.c_int64 :
+					      (uint64_t)jso->o.c_int64;
+
+	do {
+		*--p = (char)('0' + val % 10);
+		val /= 10;
+	} while (val);
+	if (jso->o.c_int64 < 0)
+		*--p = '-';
+	return printbuf_memappend (pb, p, (int)(sbuf + sizeof(sbuf) - p));
 }
 
 struct json_object* json_object_new_int(int32_t i)
@@ -918,7 +1032,7 @@ struct json_object* json_object_new_double_s(double d, const char *ds)
 	if (!jso)
 		return NULL;
 
-	new_ds = strdup(ds);
+	new_ds = jso->_arena ? json_arena_strdup(jso->_arena, ds) : strdup(ds);
 	if (!new_ds)
 	{
 		json_object_generic_delete(jso);
@@ -926,7 +1040,8 @@ struct json_object* json_object_new_double_s(double d, const char *ds)
 		return NULL;
 	}
 	json_object_set_serializer(jso, json_object_userdata_to_json_string,
-	    new_ds, json_object_free_userdata);
+	    new_ds, jso->_arena ? json_object_arena_userdata :
+				  json_object_free_userdata);
 	return jso;
 }
 
@@ -949,6 +1064,13 @@ void json_object_free_userdata(struct json_object *jso, void *userdata)
 	free(userdata);
 }
 
+/* The userdata of an object of an arena is released with the arena */
+static void json_object_arena_userdata(struct json_object *jso, void *userdata)
+{
+	(void)jso;
+	(void)userdata;
+}
+
 double json_object_get_double(const struct json_object *jso)
 {
   double cdouble;
@@ -1020,6 +1142,14 @@ static int json_object_string_to_json_string(struct json_object* jso,
 	return 0;
 }
 
+/* Allocate the buffer of a string that is not stored in the object */
+static char *json_object_string_alloc(struct json_object *jso, size_t len)
+{
+	if (jso->_arena)
+		return (char *)json_arena_alloc(jso->_arena, len);
+	return (char *)malloc(len);
+}
+
 static void json_object_string_delete(struct json_object* jso)
 {
 	if(jso->o.c_string.len >= LEN_DIRECT_STRING_DATA)
@@ -1038,8 +1168,12 @@ struct json_object* json_object_new_string(const char *s)
 	if(jso->o.c_string.len < LEN_DIRECT_STRING_DATA) {
 		memcpy(jso->o.c_string.str.data, s, (size_t)jso->o.c_string.len);
 	} else {
-		jso->o.c_string.str.ptr = strdup(s);
-		if (!jso->o.c_string.str.ptr)
+		jso->o.c_string.str.ptr = json_object_string_alloc(jso,
+				(size_t)jso->o.c_string.len + 1);
+		if (jso->o.c_string.str.ptr)
+			memcpy(jso->o.c_string.str.ptr, s,
+			       (size_t)jso->o.c_string.len + 1);
+		else
 		{
 			json_object_generic_delete(jso);
 			errno = ENOMEM;
@@ -1060,7 +1194,7 @@ struct json_object* json_object_new_string_len(const char *s, int len)
 	if(len < LEN_DIRECT_STRING_DATA) {
 		dstbuf = jso->o.c_string.str.data;
 	} else {
-		jso->o.c_string.str.ptr = (char*)malloc((unsigned long)(len + 1));
+		jso->o.c_string.str.ptr = json_object_string_alloc(jso, (size_t)len + 1);
 		if (!jso->o.c_string.str.ptr)
 		{
 			json_object_generic_delete(jso);
@@ -1110,11 +1244,11 @@ int json_object_set_string_len(json_object* jso, const char* s, int len){
 	if (jso==NULL || jso->o_type!=json_type_string) return 0; 	
 	if (len<LEN_DIRECT_STRING_DATA) {
 		dstbuf=jso->o.c_string.str.data;
-		if (jso->o.c_string.len>=LEN_DIRECT_STRING_DATA) free(jso->o.c_string.str.ptr); 
+		if (jso->o.c_string.len>=LEN_DIRECT_STRING_DATA && !jso->_arena) free(jso->o.c_string.str.ptr); 
 	} else {
-		dstbuf=(char *)malloc((unsigned long)(len+1));
+		dstbuf=json_object_string_alloc(jso, (size_t)len+1);
 		if (dstbuf==NULL) return 0;
-		if (jso->o.c_string.len>=LEN_DIRECT_STRING_DATA) free(jso->o.c_string.str.ptr);
+		if (jso->o.c_string.len>=LEN_DIRECT_STRING_DATA && !jso->_arena) free(jso->o.c_string.str.ptr);
 		jso->o.c_string.str.ptr=dstbuf;
 	}
 	jso->o.c_string.len=len;
@@ -1186,10 +1320,11 @@ struct json_object* json_object_new_array(void)
 		return NULL;
 	jso->_delete = &json_object_array_delete;
 	jso->_to_json_string = &json_object_array_to_json_string;
-	jso->o.c_array = array_list_new(&json_object_array_entry_free);
+	jso->o.c_array = array_list_new_arena(&json_object_array_entry_free,
+					      jso->_arena);
         if(jso->o.c_array == NULL)
 	{
-	    free(jso);
+	    json_object_generic_delete(jso);
 	    return NULL;
 	}
 	return jso;
@@ -1240,6 +1375,8 @@ size_t json_object_array_length(const struct json_object *jso)
 int json_object_array_add(struct json_object *jso,struct json_object *val)
 {
 	assert(json_object_get_type(jso) == json_type_array);
+	if (json_object_arena_import(jso, &val))
+		return -1;
 	return array_list_add(jso->o.c_array, val);
 }
 
@@ -1247,6 +1384,8 @@ int json_object_array_put_idx(struct json_object *jso, size_t idx,
 			      struct json_object *val)
 {
 	assert(json_object_get_type(jso) == json_type_array);
+	if (json_object_arena_import(jso, &val))
+		return -1;
 	return array_list_put_idx(jso->o.c_array, idx, val);
 }
 
@@ -1354,7 +1493,17 @@ static int json_object_copy_serializer_data(struct json_object *src, struct json
 
 	if (dst->_to_json_string == json_object_userdata_to_json_string)
 	{
+		if (dst->_arena)
+		{
+			dst->_userdata = json_arena_strdup(dst->_arena, src->_userdata);
+			dst->_user_delete = json_object_arena_userdata;
+			return dst->_userdata ? 0 : -1;
+		}
 		dst->_userdata = strdup(src->_userdata);
+		if (!dst->_userdata)
+			return -1;
+		dst->_user_delete = json_object_free_userdata;
+		return 0;
 	}
 	// else if ... other supported serializers ...
 	else
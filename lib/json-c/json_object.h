@@ -260,6 +260,23 @@ flags);
 JSON_EXPORT const char* json_object_to_json_string_length(struct json_object *obj, int
 flags, size_t *length);
 
+/** Stringify object to json format and append it to a print buffer
+ *
+ * Contrary to json_object_to_json_string_ext() the string is not kept with
+ * the object. The buffer is either one created with printbuf_new() that
+ * grows as needed and whose data can be taken over with printbuf_steal(),
+ * or one created with printbuf_new_fd() that is written to a file descriptor
+ * whenever it is full.
+ *
+ * @param obj the json_object instance
+ * @param pb the print buffer to append to
+ * @param flags formatting options, see JSON_C_TO_STRING_PRETTY and other constants
+ * @param length a pointer where, if not NULL, the number of appended bytes is stored
+ * @returns 0 on success, -1 on error
+ */
+JSON_EXPORT int json_object_to_printbuf(struct json_object *obj,
+struct printbuf *pb, int flags, size_t *length);
+
 /**
  * Returns the userdata set by json_object_set_userdata() or
  * json_object_set_serializer()
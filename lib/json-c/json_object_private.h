@@ -50,8 +50,13 @@ struct json_object
   } o;
   json_object_delete_fn *_user_delete;
   void *_userdata;
+  /* Arena the object is allocated from, NULL for the heap */
+  struct json_arena *_arena;
 };
 
+/* Is the object the owner of its arena? */
+int json_arena_is_owner(const struct json_object *jso);
+
 void _json_c_set_last_err(const char *err_fmt, ...);
 
 extern const char *json_number_chars;
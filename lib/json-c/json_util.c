@@ -156,30 +156,27 @@ int json_object_to_fd(int fd, struct json_object *obj, int flags)
 }
 static int _json_object_to_fd(int fd, struct json_object *obj, int flags, const char *filename)
 {
-	int ret;
-	const char *json_str;
-	unsigned int wpos, wsize;
+	struct printbuf *pb;
+	int ret = 0;
 
 	filename = filename ? filename : "(fd)";
 
-	if (!(json_str = json_object_to_json_string_ext(obj,flags))) {
+	/* Stream the string to the file without keeping it with the object */
+	if (!(pb = printbuf_new_fd(fd))) {
+		_json_c_set_last_err("json_object_to_file: error allocating buffer for file %s: %s\n",
+			 filename, strerror(errno));
 		return -1;
 	}
 
-	wsize = (unsigned int)(strlen(json_str) & UINT_MAX); /* CAW: probably unnecessary, but the most 64bit safe */
-	wpos = 0;
-	while(wpos < wsize) {
-		if((ret = (int)write(fd, json_str + wpos, wsize-wpos)) < 0) {
-		  _json_c_set_last_err("json_object_to_file: error writing file %s: %s\n",
+	if (json_object_to_printbuf(obj, pb, flags, NULL) < 0 ||
+	    printbuf_flush(pb) < 0) {
+		_json_c_set_last_err("json_object_to_file: error writing file %s: %s\n",
 			 filename, strerror(errno));
-		  return -1;
-		}
-
-		/* because of the above check for ret < 0, we can safely cast and add */
-		wpos += (unsigned int)ret;
+		ret = -1;
 	}
 
-	return 0;
+	printbuf_free(pb);
+	return ret;
 }
 
 // backwards compatible "format and write to file" function
@@ -29,6 +29,7 @@
 #endif
 
 #include "random_seed.h"
+#include "json_arena.h"
 #include "linkhash.h"
 
 /* hash functions */
@@ -481,24 +482,33 @@ static int lh_char_equal(const void *k1, const void *k2)
 	return (strcmp((const char*)k1, (const char*)k2) == 0);
 }
 
-struct lh_table* lh_table_new(int size,
-			      lh_entry_free_fn *free_fn,
-			      lh_hash_fn *hash_fn,
-			      lh_equal_fn *equal_fn)
+struct lh_table* lh_table_new_arena(int size,
+				    lh_entry_free_fn *free_fn,
+				    lh_hash_fn *hash_fn,
+				    lh_equal_fn *equal_fn,
+				    struct json_arena *arena)
 {
 	int i;
 	struct lh_table *t;
 
-	t = (struct lh_table*)calloc(1, sizeof(struct lh_table));
+	if (arena)
+		t = (struct lh_table*)json_arena_calloc(arena, 1, sizeof(struct lh_table));
+	else
+		t = (struct lh_table*)calloc(1, sizeof(struct lh_table));
 	if (!t)
 		return NULL;
 
 	t->count = 0;
 	t->size = size;
-	t->table = (struct lh_entry*)calloc((unsigned long)size, sizeof(struct lh_entry));
+	t->arena = arena;
+	if (arena)
+		t->table = (struct lh_entry*)json_arena_calloc(arena, (size_t)size, sizeof(struct lh_entry));
+	else
+		t->table = (struct lh_entry*)calloc((unsigned long)size, sizeof(struct lh_entry));
 	if (!t->table)
 	{
-		free(t);
+		if (!arena)
+			free(t);
 		return NULL;
 	}
 	t->free_fn = free_fn;
@@ -508,12 +518,28 @@ struct lh_table* lh_table_new(int size,
 	return t;
 }
 
+struct lh_table* lh_table_new(int size,
+			      lh_entry_free_fn *free_fn,
+			      lh_hash_fn *hash_fn,
+			      lh_equal_fn *equal_fn)
+{
+	return lh_table_new_arena(size, free_fn, hash_fn, equal_fn, NULL);
+}
+
 struct lh_table* lh_kchar_table_new(int size,
 				    lh_entry_free_fn *free_fn)
 {
 	return lh_table_new(size, free_fn, char_hash_fn, lh_char_equal);
 }
 
+struct lh_table* lh_kchar_table_new_arena(int size,
+					  lh_entry_free_fn *free_fn,
+					  struct json_arena *arena)
+{
+	return lh_table_new_arena(size, free_fn, char_hash_fn, lh_char_equal,
+				  arena);
+}
+
 struct lh_table* lh_kptr_table_new(int size,
 				   lh_entry_free_fn *free_fn)
 {
@@ -525,7 +551,8 @@ int lh_table_resize(struct lh_table *t, int new_size)
 	struct lh_table *new_t;
 	struct lh_entry *ent;
 
-	new_t = lh_table_new(new_size, NULL, t->hash_fn, t->equal_fn);
+	new_t = lh_table_new_arena(new_size, NULL, t->hash_fn, t->equal_fn,
+				   t->arena);
 	if (new_t == NULL)
 		return -1;
 
@@ -541,12 +568,14 @@ int lh_table_resize(struct lh_table *t, int new_size)
 			return -1;
 		}
 	}
-	free(t->table);
+	if (!t->arena)
+		free(t->table);
 	t->table = new_t->table;
 	t->size = new_size;
 	t->head = new_t->head;
 	t->tail = new_t->tail;
-	free(new_t);
+	if (!new_t->arena)
+		free(new_t);
 
 	return 0;
 }
@@ -558,6 +587,8 @@ void lh_table_free(struct lh_table *t)
 		for(c = t->head; c != NULL; c = c->next)
 			t->free_fn(c);
 	}
+	if (t->arena)
+		return;
 	free(t->table);
 	free(t);
 }
@@ -65,6 +65,7 @@ extern "C" {
 int json_global_set_string_hash(const int h);
 
 struct lh_entry;
+struct json_arena;
 
 /**
  * callback function prototypes
@@ -138,6 +139,11 @@ struct lh_table {
 	lh_entry_free_fn *free_fn;
 	lh_hash_fn *hash_fn;
 	lh_equal_fn *equal_fn;
+
+	/**
+	 * Arena the table is allocated from, NULL for the heap.
+	 */
+	struct json_arena *arena;
 };
 typedef struct lh_table lh_table;
 
@@ -194,6 +200,34 @@ extern struct lh_table* lh_table_new(int size,
 extern struct lh_table* lh_kchar_table_new(int size,
 					   lh_entry_free_fn *free_fn);
 
+/**
+ * Create a new linkhash table allocated from an arena.
+ *
+ * The memory of the table is released with the arena, lh_table_free only
+ * invokes the free_fn for the entries.
+ *
+ * @param size initial table size.
+ * @param free_fn callback function used to free memory for entries.
+ * @param hash_fn function used to hash keys.
+ * @param equal_fn comparison function to compare keys.
+ * @param arena arena to allocate from, NULL for the heap.
+ * @return On success, a pointer to the new linkhash table is returned.
+ * 	On error, a null pointer is returned.
+ */
+extern struct lh_table* lh_table_new_arena(int size,
+					   lh_entry_free_fn *free_fn,
+					   lh_hash_fn *hash_fn,
+					   lh_equal_fn *equal_fn,
+					   struct json_arena *arena);
+
+/**
+ * Convenience function to create a new linkhash table with char keys
+ * allocated from an arena.
+ */
+extern struct lh_table* lh_kchar_table_new_arena(int size,
+						 lh_entry_free_fn *free_fn,
+						 struct json_arena *arena);
+
 
 /**
  * Convenience function to create a new linkhash table with ptr keys.
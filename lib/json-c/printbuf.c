@@ -15,10 +15,15 @@
 
 #include "config.h"
 
+#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif /* HAVE_UNISTD_H */
+
 #ifdef HAVE_STDARG_H
 # include <stdarg.h>
 #else /* !HAVE_STDARG_H */
@@ -30,16 +35,20 @@
 #include "snprintf_compat.h"
 #include "vasprintf_compat.h"
 
+/* Size of a buffer flushed to a file descriptor */
+#define PRINTBUF_FD_SIZE (64 * 1024)
+
 static int printbuf_extend(struct printbuf *p, int min_size);
 
-struct printbuf* printbuf_new(void)
+static struct printbuf* printbuf_alloc(int size, int fd)
 {
   struct printbuf *p;
 
   p = (struct printbuf*)calloc(1, sizeof(struct printbuf));
   if(!p) return NULL;
-  p->size = 32;
+  p->size = size;
   p->bpos = 0;
+  p->fd = fd;
   if(!(p->buf = (char*)malloc((unsigned long)p->size))) {
     free(p);
     return NULL;
@@ -48,6 +57,67 @@ struct printbuf* printbuf_new(void)
   return p;
 }
 
+struct printbuf* printbuf_new(void)
+{
+  return printbuf_alloc(32, -1);
+}
+
+struct printbuf* printbuf_new_fd(int fd)
+{
+  if (fd < 0) {
+    errno = EBADF;
+    return NULL;
+  }
+  return printbuf_alloc(PRINTBUF_FD_SIZE, fd);
+}
+
+static int printbuf_write(struct printbuf *p, const char *buf, size_t len)
+{
+  ssize_t ret;
+
+  if (p->write_err) {
+    errno = p->write_err;
+    return -1;
+  }
+
+  while (len) {
+    ret = write(p->fd, buf, len);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      p->write_err = errno;
+      return -1;
+    }
+    buf += ret;
+    len -= (size_t)ret;
+  }
+  return 0;
+}
+
+int printbuf_flush(struct printbuf *p)
+{
+  if (p->fd < 0) {
+    errno = EBADF;
+    return -1;
+  }
+  if (printbuf_write(p, p->buf, (size_t)p->bpos) < 0)
+    return -1;
+  p->flushed += (size_t)p->bpos;
+  p->bpos = 0;
+  p->buf[0] = '\0';
+  return 0;
+}
+
+char* printbuf_steal(struct printbuf *p, int *len)
+{
+  char *buf = p->buf;
+
+  if (len)
+    *len = p->bpos;
+  free(p);
+  return buf;
+}
+
 
 /**
  * Extend the buffer p so it has a size of at least min_size.
@@ -83,7 +153,17 @@ static int printbuf_extend(struct printbuf *p, int min_size)
 int printbuf_memappend(struct printbuf *p, const char *buf, int size)
 {
   if (p->size <= p->bpos + size + 1) {
-    if (printbuf_extend(p, p->bpos + size + 1) < 0)
+    if (p->fd >= 0) {
+      if (printbuf_flush(p) < 0)
+        return -1;
+      /* Data that does not fit into the buffer is written directly */
+      if (p->size <= size + 1) {
+        if (printbuf_write(p, buf, (size_t)size) < 0)
+          return -1;
+        p->flushed += (size_t)size;
+        return size;
+      }
+    } else if (printbuf_extend(p, p->bpos + size + 1) < 0)
       return -1;
   }
   memcpy(p->buf + p->bpos, buf, size);
@@ -98,6 +178,26 @@ int printbuf_memset(struct printbuf *pb, int offset, int charvalue, int len)
 
 	if (offset == -1)
 		offset = pb->bpos;
+
+	/* A buffer backed by a file descriptor is only appended to */
+	if (pb->fd >= 0 && offset == pb->bpos)
+	{
+		while (pb->bpos + len >= pb->size)
+		{
+			int part = pb->size - pb->bpos - 1;
+
+			memset(pb->buf + pb->bpos, charvalue, part);
+			pb->bpos += part;
+			len -= part;
+			if (printbuf_flush(pb) < 0)
+				return -1;
+		}
+		memset(pb->buf + pb->bpos, charvalue, len);
+		pb->bpos += len;
+		pb->buf[pb->bpos] = '\0';
+		return 0;
+	}
+
 	size_needed = offset + len;
 	if (pb->size < size_needed)
 	{
@@ -31,12 +31,44 @@ struct printbuf {
   char *buf;
   int bpos;
   int size;
+  /* File descriptor the buffer is flushed to, -1 if not backed by a file */
+  int fd;
+  /* Number of bytes already flushed to the file descriptor */
+  size_t flushed;
+  /* First write error, all further writes fail with it */
+  int write_err;
 };
 typedef struct printbuf printbuf;
 
 extern struct printbuf*
 printbuf_new(void);
 
+/**
+ * Create a buffer of a fixed size that is written to the file descriptor
+ * whenever it is full instead of growing. The remaining data is written
+ * with printbuf_flush().
+ *
+ * Only appending data is supported, the buffer content is not
+ * NUL-terminated.
+ */
+extern struct printbuf*
+printbuf_new_fd(int fd);
+
+/**
+ * Write the buffered data to the file descriptor of the buffer.
+ *
+ * @return 0 on success, -1 on a write error (see errno)
+ */
+extern int
+printbuf_flush(struct printbuf *p);
+
+/**
+ * Free the buffer but keep the data which is returned to the caller who
+ * must free it. The length of the data is returned in len if not NULL.
+ */
+extern char*
+printbuf_steal(struct printbuf *p, int *len);
+
 /* As an optimization, printbuf_memappend_fast() is defined as a macro
  * that handles copying data if the buffer is large enough; otherwise
  * it invokes printbuf_memappend() which performs the heavy
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../lib/common/buffer.c"
+#include "../../lib/common/compression.c"
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+/* Test data resembling a vector set of hex encoded values */
+static int generate_data(struct acvp_buf *data)
+{
+	static const char hex[] = "0123456789abcdef";
+	unsigned int i, j;
+	char entry[128];
+	int ret;
+
+	memset(data, 0, sizeof(*data));
+
+	for (i = 0; i < 2000; i++) {
+		memcpy(entry, "{\"tcId\":1,\"key\":\"", 17);
+		for (j = 0; j < 64; j++)
+			entry[17 + j] = hex[(i * 7 + j * j) & 0xf];
+		memcpy(entry + 81, "\"},", 4);
+
+		ret = acvp_buf_append(data, (uint8_t *)entry,
+				      (uint32_t)strlen(entry));
+		if (ret)
+			return ret;
+	}
+
+	return 0;
+}
+
+static int chunk_cb(void *priv, const uint8_t *buf, size_t buflen)
+{
+	size_t *total = priv;
+
+	(void)buf;
+
+	if (!buflen || buflen > ACVP_COMPRESSION_CHUNK)
+		return -EINVAL;
+
+	*total += buflen;
+	return 0;
+}
+
+/* Compressed data decompresses to the original data */
+static int roundtrip_test(void)
+{
+	ACVP_BUFFER_INIT(data);
+	ACVP_BUFFER_INIT(compressed);
+	ACVP_BUFFER_INIT(decompressed);
+	size_t total = 0;
+	int ret = 1;
+
+	if (generate_data(&data) || acvp_compress(&data, &compressed)) {
+		printf("Compression failed\n");
+		goto out;
+	}
+
+	/* The gzip header allows the use of the common tools */
+	if (compressed.len >= data.len || compressed.buf[0] != 0x1f ||
+	    compressed.buf[1] != 0x8b) {
+		printf("Compressed data is invalid\n");
+		goto out;
+	}
+
+	if (acvp_decompress(compressed.buf, compressed.len, &decompressed,
+			    data.len) ||
+	    decompressed.len != data.len ||
+	    memcmp(decompressed.buf, data.buf, data.len) ||
+	    decompressed.buf[decompressed.len]) {
+		printf("Decompressed data does not match\n");
+		goto out;
+	}
+
+	if (acvp_decompress_stream(compressed.buf, compressed.len, chunk_cb,
+				   &total) ||
+	    total != data.len) {
+		printf("Streamed decompression failed\n");
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	acvp_free_buf(&data);
+	acvp_free_buf(&compressed);
+	acvp_free_buf(&decompressed);
+	return ret;
+}
+
+/* Corrupted and oversized data is rejected */
+static int corrupt_test(void)
+{
+	ACVP_BUFFER_INIT(data);
+	ACVP_BUFFER_INIT(compressed);
+	ACVP_BUFFER_INIT(decompressed);
+	int ret = 1;
+
+	if (generate_data(&data) || acvp_compress(&data, &compressed)) {
+		printf("Compression failed\n");
+		goto out;
+	}
+
+	if (acvp_decompress(compressed.buf, compressed.len - 10,
+			    &decompressed, data.len) != -EINVAL ||
+	    decompressed.buf) {
+		printf("Truncated data not rejected\n");
+		goto out;
+	}
+
+	compressed.buf[compressed.len / 2] ^= 0x55;
+	if (acvp_decompress(compressed.buf, compressed.len, &decompressed,
+			    data.len) != -EINVAL) {
+		printf("Corrupted data not rejected\n");
+		goto out;
+	}
+	compressed.buf[compressed.len / 2] ^= 0x55;
+
+	if (acvp_decompress(compressed.buf, compressed.len, &decompressed,
+			    data.len - 1) != -ERANGE) {
+		printf("Oversized data not rejected\n");
+		goto out;
+	}
+
+	if (acvp_decompress(data.buf, data.len, &decompressed, data.len) !=
+	    -EINVAL) {
+		printf("Uncompressed data not rejected\n");
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	acvp_free_buf(&data);
+	acvp_free_buf(&compressed);
+	acvp_free_buf(&decompressed);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = 0;
+
+	(void)argc;
+	(void)argv;
+
+	ret |= roundtrip_test();
+	ret |= corrupt_test();
+
+	return ret;
+}
@@ -0,0 +1,30 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./compression"
+NAME="$(basename $EXEC)"
+
+# Test 1
+#
+# Purpose: Compress and decompress data, decompress corrupted data
+# Expected result: Data survives the round trip, corrupted data is rejected
+test1()
+{
+	local result=$($EXEC)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME 1: $result"
+	else
+		echo_pass "Test $NAME 1"
+	fi
+
+	gcov_analyze "compression_test.c" "test1"
+}
+
+init_common
+
+test1
+
+exit_test
@@ -0,0 +1,1009 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../lib/common/datastore_file.c"
+
+/* Number of vsIDs of the test session */
+#define TEST_VSIDS 20
+
+/* Number of times the concurrent writers write the files of all vsIDs */
+#define TEST_ROUNDS 20
+
+static char test_base[] = "datastore_catalog_test.XXXXXX";
+static char test_datadir[FILENAME_MAX];
+static char test_securedir[FILENAME_MAX];
+
+static struct def_vendor test_vendor = {
+	.vendor_name_filesafe = "vendor",
+};
+static struct def_info test_info = {
+	.module_name_filesafe = "module",
+	.module_version_filesafe = "1.0",
+};
+static struct definition test_def = {
+	.vendor = &test_vendor,
+	.info = &test_info,
+};
+static struct acvp_ctx test_ctx = {
+	.datastore = {
+		.basedir = test_datadir,
+		.secure_basedir = test_securedir,
+		.vectorfile = ACVP_DS_TESTREQUEST,
+		.resultsfile = ACVP_DS_TESTRESPONSE,
+		.verdictfile = ACVP_DS_VERDICT,
+		.processedfile = ACVP_DS_PROCESSED,
+		.expectedfile = ACVP_DS_EXPECTED,
+	},
+};
+static struct acvp_testid_ctx test_testid = {
+	.testid = 1234,
+	.def = &test_def,
+	.ctx = &test_ctx,
+};
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+/* The test uses the regular file operations */
+const struct acvp_datastore_io acvp_datastore_io_log;
+const struct acvp_datastore_io acvp_datastore_io_uring;
+
+bool acvp_datastore_log_present(const char *basedir)
+{
+	(void)basedir;
+	return false;
+}
+
+bool acvp_datastore_uring_available(void)
+{
+	return false;
+}
+
+void acvp_register_ds(const struct acvp_datastore_be *datastore)
+{
+	(void)datastore;
+}
+
+bool acvp_op_get_interrupted(void)
+{
+	return false;
+}
+
+int acvp_duplicate(char **dst, const char *src)
+{
+	char *tmp = strdup(src);
+
+	if (!tmp)
+		return -ENOMEM;
+	free(*dst);
+	*dst = tmp;
+	return 0;
+}
+
+int acvp_datastore_file_dir(char *dirname, const bool createdir)
+{
+	struct stat statbuf;
+
+	if (!stat(dirname, &statbuf))
+		return 0;
+	if (errno != ENOENT || !createdir)
+		return -errno;
+	if (mkdir(dirname, 0700) && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+/* Set while the test runs single threaded */
+static bool test_locks_checked = false;
+static unsigned int test_locked_parsing = 0;
+
+/* Files of the vsIDs must not be parsed while a catalog lock is held */
+static void test_check_unlocked(void)
+{
+	struct acvp_datastore_catalog_cache *cache;
+
+	if (!test_locks_checked)
+		return;
+
+	if (!mutex_trylock(&acvp_datastore_catalog_lock)) {
+		test_locked_parsing++;
+		return;
+	}
+
+	for (cache = acvp_datastore_catalogs; cache; cache = cache->next) {
+		if (mutex_w_trylock(&cache->lock))
+			mutex_w_unlock(&cache->lock);
+		else
+			test_locked_parsing++;
+	}
+
+	mutex_unlock(&acvp_datastore_catalog_lock);
+}
+
+/* The summary is obtained from the JSON data written by the test */
+int acvp_get_algoinfo_json(const struct acvp_buf *buf,
+			   struct acvp_test_verdict_status *verdict)
+{
+	struct json_object *obj = json_tokener_parse((const char *)buf->buf);
+	const char *str;
+	int ret;
+
+	test_check_unlocked();
+
+	CKNULL(obj, -EINVAL);
+	CKINT(json_get_string(obj, "algorithm", &str));
+	CKINT(acvp_duplicate(&verdict->cipher_name, str));
+	if (!json_get_string(obj, "mode", &str))
+		CKINT(acvp_duplicate(&verdict->cipher_mode, str));
+
+out:
+	ACVP_JSON_PUT_NULL(obj);
+	return ret;
+}
+
+int acvp_get_verdict_json(const struct acvp_buf *verdict_buf,
+			  enum acvp_test_verdict *verdict_stat)
+{
+	struct json_object *obj =
+		json_tokener_parse((const char *)verdict_buf->buf);
+	bool passed;
+	int ret;
+
+	test_check_unlocked();
+
+	CKNULL(obj, -EINVAL);
+	CKINT(json_get_bool(obj, "passed", &passed));
+	*verdict_stat = passed ? acvp_verdict_pass : acvp_verdict_fail;
+
+out:
+	ACVP_JSON_PUT_NULL(obj);
+	return ret;
+}
+
+/* The response processing is not part of the test */
+int acvp_get_proto(const struct acvp_net_proto **proto)
+{
+	(void)proto;
+	return -EOPNOTSUPP;
+}
+
+int acvp_get_net(const struct acvp_net_ctx **net)
+{
+	(void)net;
+	return -EOPNOTSUPP;
+}
+
+int acvp_get_testsession_expiry_epoch(const struct acvp_buf *meta_buf,
+				      time_t *epoch)
+{
+	(void)meta_buf;
+	(void)epoch;
+	return -EOPNOTSUPP;
+}
+
+int acvp_cert_ref(struct acvp_buf *buf)
+{
+	(void)buf;
+	return -EOPNOTSUPP;
+}
+
+int acvp_match_def(const struct acvp_testid_ctx *testid_ctx,
+		   const struct json_object *def_config)
+{
+	(void)testid_ctx;
+	(void)def_config;
+	return -EOPNOTSUPP;
+}
+
+void acvp_release_vsid_ctx(struct acvp_vsid_ctx *vsid_ctx)
+{
+	free(vsid_ctx);
+}
+
+int thread_start(int (*start_routine)(void *), void *tdata,
+		 uint32_t thread_group, int *ret_ancestor)
+{
+	(void)start_routine;
+	(void)tdata;
+	(void)thread_group;
+	(void)ret_ancestor;
+	return -EOPNOTSUPP;
+}
+
+int thread_wait(void)
+{
+	return 0;
+}
+
+int thread_set_name(enum acvp_request_type type, uint32_t id)
+{
+	(void)type;
+	(void)id;
+	return 0;
+}
+
+/* Expected state of a vsID written by test_write_session */
+static unsigned int test_state(uint32_t vsid)
+{
+	unsigned int state = ACVP_DS_CATALOG_VECTOR | ACVP_DS_CATALOG_EXPECTED;
+
+	if (vsid % 2)
+		state |= ACVP_DS_CATALOG_PROCESSED;
+	if (!(vsid % 3))
+		state |= ACVP_DS_CATALOG_VERDICT;
+	return state;
+}
+
+static int test_write(uint32_t vsid, const char *filename,
+		      const bool secure_location, const char *str)
+{
+	struct acvp_vsid_ctx vsid_ctx = { .vsid = vsid,
+					  .testid_ctx = &test_testid };
+	struct acvp_buf buf = { .buf = (uint8_t *)str,
+				.len = (uint32_t)strlen(str) };
+
+	return acvp_datastore_file_write_vsid(&vsid_ctx, filename,
+					      secure_location, &buf);
+}
+
+static int test_write_vector(uint32_t vsid)
+{
+	char str[128];
+
+	snprintf(str, sizeof(str),
+		 "{ \"vsId\": %u, \"algorithm\": \"ALG-%u\", \"mode\": \"mode%u\" }",
+		 vsid, vsid, vsid);
+	return test_write(vsid, ACVP_DS_TESTREQUEST, false, str);
+}
+
+static int test_write_verdict(uint32_t vsid, bool passed)
+{
+	return test_write(vsid, ACVP_DS_VERDICT, false,
+			  passed ? "{ \"passed\": true }" :
+				   "{ \"passed\": false }");
+}
+
+/* Write the files of all vsIDs of the test session */
+static int test_write_session(void)
+{
+	uint32_t vsid;
+	int ret = 0;
+
+	for (vsid = 1; vsid <= TEST_VSIDS; vsid++) {
+		CKINT(test_write_vector(vsid));
+		CKINT(test_write(vsid, ACVP_DS_EXPECTED, false, "{}"));
+		if (vsid % 2)
+			CKINT(test_write(vsid, ACVP_DS_PROCESSED, true, "done"));
+		if (!(vsid % 3))
+			CKINT(test_write_verdict(vsid, vsid % 2));
+	}
+
+out:
+	return ret;
+}
+
+static int test_catalog_path(char *path, size_t len)
+{
+	return acvp_datastore_catalog_path(&test_testid, path, len, false);
+}
+
+/* Path of a file of a vsID */
+static int test_vsid_path(uint32_t vsid, const char *filename,
+			  const bool secure_location, char *path, size_t len)
+{
+	struct acvp_vsid_ctx vsid_ctx = { .vsid = vsid,
+					  .testid_ctx = &test_testid };
+	int ret;
+
+	CKINT(acvp_datastore_file_vectordir_vsid(&vsid_ctx, path, len, false,
+						 secure_location));
+	CKINT(acvp_extend_string(path, len, "/%s", filename));
+
+out:
+	return ret;
+}
+
+static bool test_catalog_present(void)
+{
+	struct stat statbuf;
+	char path[FILENAME_MAX];
+
+	if (test_catalog_path(path, sizeof(path)))
+		return false;
+	return !stat(path, &statbuf);
+}
+
+static unsigned int test_cached_catalogs(void)
+{
+	struct acvp_datastore_catalog_cache *cache;
+	unsigned int num = 0;
+
+	mutex_lock(&acvp_datastore_catalog_lock);
+	for (cache = acvp_datastore_catalogs; cache; cache = cache->next)
+		num++;
+	mutex_unlock(&acvp_datastore_catalog_lock);
+
+	return num;
+}
+
+/* Compare the state of a vsID in the catalog */
+static int test_check_state(const struct acvp_datastore_catalog *catalog,
+			    uint32_t vsid, unsigned int state)
+{
+	const struct acvp_datastore_catalog_vsid *entry;
+
+	entry = acvp_datastore_catalog_find(catalog, vsid, NULL);
+	if (!entry || entry->state != state) {
+		printf("vsID %u has state %u instead of %u\n", vsid,
+		       entry ? entry->state : 0, state);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Compare the catalog entry and its summary with the expected state */
+static int test_check_entry(const struct acvp_datastore_catalog *catalog,
+			    uint32_t vsid, unsigned int state,
+			    enum acvp_test_verdict verdict)
+{
+	const struct acvp_datastore_catalog_vsid *entry;
+	char name[32];
+
+	entry = acvp_datastore_catalog_find(catalog, vsid, NULL);
+	if (!entry) {
+		printf("vsID %u missing in catalog\n", vsid);
+		return -EINVAL;
+	}
+
+	if (entry->state != state) {
+		printf("vsID %u has state %u instead of %u\n", vsid,
+		       entry->state, state);
+		return -EINVAL;
+	}
+
+	snprintf(name, sizeof(name), "ALG-%u", vsid);
+	if ((state & ACVP_DS_CATALOG_VECTOR) &&
+	    (!(entry->summary & ACVP_DS_CATALOG_VECTOR) ||
+	     !entry->cipher_name || strcmp(entry->cipher_name, name))) {
+		printf("vsID %u has wrong algorithm %s\n", vsid,
+		       entry->cipher_name ? entry->cipher_name : "(none)");
+		return -EINVAL;
+	}
+
+	if (!!(state & ACVP_DS_CATALOG_VERDICT) !=
+		    !!(entry->summary & ACVP_DS_CATALOG_VERDICT) ||
+	    ((state & ACVP_DS_CATALOG_VERDICT) && entry->verdict != verdict)) {
+		printf("vsID %u has wrong verdict %u\n", vsid, entry->verdict);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Check the catalog held in the data store, skip names a removed vsID and
+ * extra is the number of vsIDs added outside of the proxy
+ */
+static int test_check_stored(uint32_t skip, unsigned int extra)
+{
+	struct acvp_datastore_catalog catalog;
+	char path[FILENAME_MAX];
+	uint32_t vsid;
+	int ret;
+
+	CKINT(test_catalog_path(path, sizeof(path)));
+	CKINT(acvp_datastore_catalog_load(path, &catalog));
+
+	if (catalog.num != TEST_VSIDS - !!skip + extra) {
+		printf("Catalog holds %u vsIDs\n", catalog.num);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (vsid = 1; vsid <= TEST_VSIDS; vsid++) {
+		if (vsid == skip)
+			continue;
+		CKINT(test_check_entry(&catalog, vsid, test_state(vsid),
+				       vsid % 2 ? acvp_verdict_pass :
+						  acvp_verdict_fail));
+	}
+
+out:
+	acvp_datastore_catalog_free(&catalog);
+	return ret;
+}
+
+/*
+ * The writes are collected in the cached catalog which is written once when
+ * the test session is released.
+ */
+static int test_batched(void)
+{
+	struct acvp_datastore_catalog_cache *cache;
+	struct acvp_datastore_catalog catalog = { 0 };
+	char path[FILENAME_MAX];
+	uint32_t vsid;
+	int ret;
+
+	CKINT(test_write_session());
+
+	/* The outdated catalog is removed while the changes are held back */
+	if (test_catalog_present()) {
+		printf("Catalog present while changes are held back\n");
+		return -EINVAL;
+	}
+	if (test_cached_catalogs() != 1) {
+		printf("Catalog not cached\n");
+		return -EINVAL;
+	}
+
+	CKINT(acvp_datastore_catalog_cache_get(&test_testid, &cache));
+	if (!cache->dirty) {
+		printf("Cached catalog not marked as changed\n");
+		ret = -EINVAL;
+	}
+	for (vsid = 1; vsid <= TEST_VSIDS && !ret; vsid++) {
+		ret = test_check_entry(&cache->catalog, vsid, test_state(vsid),
+				       vsid % 2 ? acvp_verdict_pass :
+						  acvp_verdict_fail);
+	}
+	mutex_w_unlock(&cache->lock);
+	if (ret)
+		goto out;
+
+	acvp_datastore_file_release_testid(&test_testid);
+	if (!test_catalog_present() || test_cached_catalogs()) {
+		printf("Catalog not written when releasing the test session\n");
+		return -EINVAL;
+	}
+	CKINT(test_check_stored(0, 0));
+
+	/* Writing files already recorded does not change the catalog */
+	for (vsid = 1; vsid <= TEST_VSIDS; vsid++)
+		CKINT(test_write(vsid, ACVP_DS_EXPECTED, false, "{}"));
+	if (!test_catalog_present()) {
+		printf("Catalog removed without a change\n");
+		return -EINVAL;
+	}
+
+	/* A changed verdict of a recorded vsID is a change of the catalog */
+	CKINT(test_write_verdict(3, false));
+	if (test_catalog_present()) {
+		printf("Outdated catalog present\n");
+		return -EINVAL;
+	}
+	acvp_datastore_file_release_testid(&test_testid);
+
+	CKINT(test_catalog_path(path, sizeof(path)));
+	CKINT(acvp_datastore_catalog_load(path, &catalog));
+	CKINT(test_check_entry(&catalog, 3, test_state(3), acvp_verdict_fail));
+
+	CKINT(test_write_verdict(3, true));
+	acvp_datastore_file_release_testid(&test_testid);
+	CKINT(test_check_stored(0, 0));
+
+out:
+	acvp_datastore_catalog_free(&catalog);
+	return ret;
+}
+
+static int test_unlink(uint32_t vsid, const char *filename,
+		       const bool secure_location)
+{
+	char path[FILENAME_MAX];
+	int ret;
+
+	CKINT(test_vsid_path(vsid, filename, secure_location, path,
+			     sizeof(path)));
+	if (unlink(path))
+		ret = -errno;
+
+out:
+	return ret;
+}
+
+/* Write a file of a vsID without the data store backend */
+static int test_write_external(uint32_t vsid, const char *filename,
+			       const char *str)
+{
+	struct acvp_buf buf = { .buf = (uint8_t *)str,
+				.len = (uint32_t)strlen(str) };
+	char path[FILENAME_MAX];
+	int ret;
+
+	CKINT(acvp_datastore_file_vectordir(&test_testid, path, sizeof(path),
+					    false, false));
+	CKINT(acvp_extend_string(path, sizeof(path), "/%u", vsid));
+	if (mkdir(path, 0700) && errno != EEXIST) {
+		ret = -errno;
+		goto out;
+	}
+	CKINT(acvp_extend_string(path, sizeof(path), "/%s", filename));
+	CKINT(acvp_datastore_io_file_write(path, &buf));
+
+out:
+	return ret;
+}
+
+/* Remove the directories of a vsID without the data store backend */
+static int test_remove_external(uint32_t vsid)
+{
+	char path[FILENAME_MAX], cmd[FILENAME_MAX + 16];
+	int ret;
+
+	CKINT(test_vsid_path(vsid, "", false, path, sizeof(path)));
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+	if (system(cmd))
+		return -EIO;
+
+	CKINT(test_vsid_path(vsid, "", true, path, sizeof(path)));
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", path);
+	if (system(cmd))
+		return -EIO;
+
+out:
+	return ret;
+}
+
+/* Obtain the catalog the way the response processing does */
+static int test_catalog_get(struct acvp_datastore_catalog *catalog)
+{
+	char path[FILENAME_MAX];
+	int ret;
+
+	mutex_lock(&acvp_datastore_catalog_lock);
+	ret = acvp_datastore_catalog_path(&test_testid, path, sizeof(path),
+					  true);
+	if (!ret)
+		ret = acvp_datastore_catalog_flush(path);
+	if (!ret)
+		ret = acvp_datastore_catalog_get(&test_testid, catalog, path,
+						 sizeof(path));
+	mutex_unlock(&acvp_datastore_catalog_lock);
+
+	return ret;
+}
+
+/* Revalidate all vsIDs of the catalog */
+static int test_catalog_revalidate(struct acvp_datastore_catalog *catalog)
+{
+	struct acvp_vsid_ctx vsid_ctx = { .testid_ctx = &test_testid };
+	unsigned int n, state;
+	int ret = 0;
+
+	for (n = 0; n < catalog->num; n++) {
+		vsid_ctx.vsid = catalog->vsids[n].vsid;
+		CKINT(acvp_datastore_catalog_revalidate(
+			&vsid_ctx, &catalog->vsids[n], &state));
+		if (state != catalog->vsids[n].state) {
+			printf("Revalidated state of vsID %u not recorded\n",
+			       vsid_ctx.vsid);
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+out:
+	return ret;
+}
+
+/*
+ * Files changed behind the back of the proxy are detected when the state of
+ * the vsIDs is revalidated, vsID directories added or removed are detected
+ * when the catalog is read.
+ */
+static int test_revalidate(void)
+{
+	struct acvp_datastore_catalog catalog = { 0 };
+	struct timespec times[2] = { { 0, UTIME_OMIT }, { 0, 0 } };
+	char path[FILENAME_MAX];
+	int ret;
+
+	CKINT(test_write_session());
+	acvp_datastore_file_release_testid(&test_testid);
+
+	/* The user removes files and obtains a verdict manually */
+	CKINT(test_unlink(3, ACVP_DS_VERDICT, false));
+	CKINT(test_unlink(5, ACVP_DS_PROCESSED, true));
+	CKINT(test_unlink(8, ACVP_DS_EXPECTED, false));
+	CKINT(test_write_external(4, ACVP_DS_VERDICT, "{ \"passed\": false }"));
+
+	/* The catalog still holds the previous state */
+	CKINT(test_catalog_get(&catalog));
+	CKINT(test_check_entry(&catalog, 3, test_state(3), acvp_verdict_pass));
+
+	CKINT(test_catalog_revalidate(&catalog));
+	CKINT(test_check_state(&catalog, 3,
+			       test_state(3) & ~ACVP_DS_CATALOG_VERDICT));
+	CKINT(test_check_state(&catalog, 4,
+			       test_state(4) | ACVP_DS_CATALOG_VERDICT));
+	CKINT(test_check_state(&catalog, 5,
+			       test_state(5) & ~ACVP_DS_CATALOG_PROCESSED));
+	CKINT(test_check_state(&catalog, 8,
+			       test_state(8) & ~ACVP_DS_CATALOG_EXPECTED));
+	acvp_datastore_catalog_free(&catalog);
+
+	/* The corrections including the new verdict are written */
+	acvp_datastore_file_release_testid(&test_testid);
+	CKINT(test_catalog_path(path, sizeof(path)));
+	CKINT(acvp_datastore_catalog_load(path, &catalog));
+	CKINT(test_check_entry(&catalog, 3,
+			       test_state(3) & ~ACVP_DS_CATALOG_VERDICT, 0));
+	CKINT(test_check_entry(&catalog, 4,
+			       test_state(4) | ACVP_DS_CATALOG_VERDICT,
+			       acvp_verdict_fail));
+	CKINT(test_check_entry(&catalog, 5,
+			       test_state(5) & ~ACVP_DS_CATALOG_PROCESSED, 0));
+	CKINT(test_check_entry(&catalog, 8,
+			       test_state(8) & ~ACVP_DS_CATALOG_EXPECTED, 0));
+	acvp_datastore_catalog_free(&catalog);
+
+	/* Restore the files */
+	CKINT(test_write_verdict(3, true));
+	CKINT(test_write(5, ACVP_DS_PROCESSED, true, "done"));
+	CKINT(test_write(8, ACVP_DS_EXPECTED, false, "{}"));
+	CKINT(test_unlink(4, ACVP_DS_VERDICT, false));
+
+	/* The user removes a vsID and adds one outside of the proxy */
+	CKINT(test_remove_external(7));
+	CKINT(test_write_external(TEST_VSIDS + 1, ACVP_DS_TESTREQUEST,
+				  "{ \"algorithm\": \"ALG-21\" }"));
+
+	/* The directory change is detected even within the same second */
+	CKINT(acvp_datastore_file_vectordir(&test_testid, path, sizeof(path),
+					    false, false));
+	times[1].tv_sec = time(NULL) + 10;
+	if (utimensat(AT_FDCWD, path, times, 0)) {
+		ret = -errno;
+		goto out;
+	}
+
+	CKINT(test_catalog_get(&catalog));
+	if (acvp_datastore_catalog_find(&catalog, 7, NULL)) {
+		printf("Removed vsID still cataloged\n");
+		ret = -EINVAL;
+		goto out;
+	}
+	CKINT(test_check_state(&catalog, TEST_VSIDS + 1,
+			       ACVP_DS_CATALOG_VECTOR));
+	CKINT(test_catalog_revalidate(&catalog));
+	acvp_datastore_catalog_free(&catalog);
+
+	acvp_datastore_file_release_testid(&test_testid);
+	CKINT(test_check_stored(7, 1));
+
+out:
+	acvp_datastore_catalog_free(&catalog);
+	return ret;
+}
+
+/*
+ * Summaries missing in a catalog are obtained without holding a catalog lock
+ * and recorded in the cached catalog.
+ */
+static int test_backfill(void)
+{
+	struct acvp_datastore_catalog_cache *cache;
+	struct acvp_datastore_catalog catalog = { 0 };
+	char path[FILENAME_MAX];
+	unsigned int n;
+	uint32_t vsid;
+	int ret;
+
+	CKINT(test_write_session());
+	acvp_datastore_file_release_testid(&test_testid);
+
+	/* Catalog written before the summaries were recorded */
+	CKINT(test_catalog_path(path, sizeof(path)));
+	CKINT(acvp_datastore_catalog_load(path, &catalog));
+	for (n = 0; n < catalog.num; n++) {
+		acvp_datastore_catalog_summary_free(&catalog.vsids[n]);
+		catalog.vsids[n].summary = 0;
+	}
+	CKINT(acvp_datastore_catalog_store(path, &catalog));
+	acvp_datastore_catalog_free(&catalog);
+
+	CKINT(test_catalog_get(&catalog));
+	for (n = 0; n < catalog.num; n++) {
+		if (catalog.vsids[n].summary) {
+			printf("Summary of vsID %u present\n",
+			       catalog.vsids[n].vsid);
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	CKINT(acvp_datastore_catalog_backfill(&test_testid, &catalog));
+	for (vsid = 1; vsid <= TEST_VSIDS; vsid++) {
+		CKINT(test_check_entry(&catalog, vsid, test_state(vsid),
+				       vsid % 2 ? acvp_verdict_pass :
+						  acvp_verdict_fail));
+	}
+	acvp_datastore_catalog_free(&catalog);
+
+	/* The summaries are recorded in the cached catalog */
+	CKINT(acvp_datastore_catalog_cache_get(&test_testid, &cache));
+	if (!cache->dirty) {
+		printf("Cached catalog not marked as changed\n");
+		ret = -EINVAL;
+	}
+	for (vsid = 1; vsid <= TEST_VSIDS && !ret; vsid++) {
+		ret = test_check_entry(&cache->catalog, vsid, test_state(vsid),
+				       vsid % 2 ? acvp_verdict_pass :
+						  acvp_verdict_fail);
+	}
+	mutex_w_unlock(&cache->lock);
+	if (ret)
+		goto out;
+
+	acvp_datastore_file_release_testid(&test_testid);
+	CKINT(test_check_stored(0, 0));
+
+	/* A complete catalog needs no update */
+	CKINT(test_catalog_get(&catalog));
+	CKINT(acvp_datastore_catalog_backfill(&test_testid, &catalog));
+	if (test_cached_catalogs()) {
+		printf("Complete catalog updated\n");
+		ret = -EINVAL;
+	}
+
+out:
+	acvp_datastore_catalog_free(&catalog);
+	return ret;
+}
+
+static atomic_t test_writers_done = ATOMIC_INIT(0);
+
+/* Each writer writes one kind of file of all vsIDs in every round */
+static void *test_writer(void *arg)
+{
+	const uintptr_t kind = (uintptr_t)arg;
+	unsigned int round;
+	uint32_t vsid;
+	int ret = 0;
+
+	for (round = 0; round < TEST_ROUNDS; round++) {
+		for (vsid = 1; vsid <= TEST_VSIDS; vsid++) {
+			switch (kind) {
+			case 0:
+				CKINT(test_write_vector(vsid));
+				break;
+			case 1:
+				CKINT(test_write(vsid, ACVP_DS_EXPECTED, false,
+						 "{}"));
+				break;
+			case 2:
+				if (vsid % 2)
+					CKINT(test_write(vsid,
+							 ACVP_DS_PROCESSED,
+							 true, "done"));
+				break;
+			default:
+				/* The verdict changes until the last round */
+				if (!(vsid % 3))
+					CKINT(test_write_verdict(
+						vsid,
+						(vsid + round + 1 -
+						 TEST_ROUNDS) % 2));
+				break;
+			}
+		}
+	}
+
+out:
+	return (void *)(intptr_t)ret;
+}
+
+/* Check the cached catalog while it is updated */
+static int test_check_cached(void)
+{
+	struct acvp_datastore_catalog_cache *cache;
+	const struct acvp_datastore_catalog_vsid *entry;
+	char name[32];
+	unsigned int n;
+	int ret;
+
+	CKINT(acvp_datastore_catalog_cache_get(&test_testid, &cache));
+
+	for (n = 0; n < cache->catalog.num; n++) {
+		entry = &cache->catalog.vsids[n];
+
+		if (n && entry->vsid <= cache->catalog.vsids[n - 1].vsid) {
+			printf("Catalog not sorted at vsID %u\n", entry->vsid);
+			ret = -EINVAL;
+			break;
+		}
+
+		if (entry->state & ~test_state(entry->vsid)) {
+			printf("vsID %u has unexpected state %u\n",
+			       entry->vsid, entry->state);
+			ret = -EINVAL;
+			break;
+		}
+
+		snprintf(name, sizeof(name), "ALG-%u", entry->vsid);
+		if ((entry->summary & ACVP_DS_CATALOG_VECTOR) &&
+		    (!entry->cipher_name || strcmp(entry->cipher_name, name))) {
+			printf("vsID %u has wrong algorithm\n", entry->vsid);
+			ret = -EINVAL;
+			break;
+		}
+	}
+
+	mutex_w_unlock(&cache->lock);
+
+out:
+	return ret;
+}
+
+/* Read the catalog and release the test session while it is updated */
+static void *test_reader(void *arg)
+{
+	struct acvp_datastore_catalog catalog;
+	unsigned int round = 0;
+	int ret = 0;
+
+	(void)arg;
+
+	while (!atomic_add(0, &test_writers_done)) {
+		CKINT(test_check_cached());
+
+		if (round++ % 4)
+			continue;
+
+		/* The catalog is written and read again from the data store */
+		CKINT(test_catalog_get(&catalog));
+		acvp_datastore_catalog_free(&catalog);
+		acvp_datastore_file_release_testid(&test_testid);
+	}
+
+out:
+	return (void *)(intptr_t)ret;
+}
+
+/*
+ * The cached catalog remains consistent while the files of the same vsIDs are
+ * written concurrently and the catalog is written and read again.
+ */
+static int test_concurrent(void)
+{
+	pthread_t writers[4], reader;
+	char path[FILENAME_MAX];
+	unsigned int i, started = 0;
+	void *thread_ret;
+	int ret;
+
+	/* The reader starts with the empty test session */
+	CKINT(acvp_datastore_file_vectordir(&test_testid, path, sizeof(path),
+					    true, false));
+	CKINT(acvp_datastore_file_vectordir(&test_testid, path, sizeof(path),
+					    true, true));
+
+	if (pthread_create(&reader, NULL, test_reader, NULL))
+		return -EFAULT;
+
+	for (i = 0; i < ARRAY_SIZE(writers); i++) {
+		if (pthread_create(&writers[i], NULL, test_writer,
+				   (void *)(uintptr_t)i)) {
+			ret = -EFAULT;
+			break;
+		}
+		started++;
+	}
+
+	for (i = 0; i < started; i++) {
+		pthread_join(writers[i], &thread_ret);
+		if (thread_ret) {
+			printf("Writer %u failed: %d\n", i,
+			       (int)(intptr_t)thread_ret);
+			ret = -EINVAL;
+		}
+	}
+
+	atomic_inc(&test_writers_done);
+	pthread_join(reader, &thread_ret);
+	if (thread_ret) {
+		printf("Reader failed: %d\n", (int)(intptr_t)thread_ret);
+		ret = -EINVAL;
+	}
+	if (ret)
+		return ret;
+
+	CKINT(test_check_cached());
+	acvp_datastore_file_release_testid(&test_testid);
+	CKINT(test_check_stored(0, 0));
+
+out:
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	char cmd[FILENAME_MAX];
+	int ret;
+
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	if (!mkdtemp(test_base)) {
+		printf("cannot create test directory\n");
+		return errno;
+	}
+	snprintf(test_datadir, sizeof(test_datadir), "%s/data", test_base);
+	snprintf(test_securedir, sizeof(test_securedir), "%s/secure",
+		 test_base);
+
+	test_locks_checked = true;
+
+	switch (atoi(argv[1])) {
+	case 1:
+		/* Catalog changes written when the test session is released */
+		ret = test_batched();
+		break;
+	case 2:
+		/* Catalog corrected for files changed outside of the proxy */
+		ret = test_revalidate();
+		break;
+	case 3:
+		/* Missing summaries obtained outside of the catalog locks */
+		ret = test_backfill();
+		break;
+	case 4:
+		/* Concurrent updates of the catalog */
+		test_locks_checked = false;
+		ret = test_concurrent();
+		break;
+	default:
+		printf("unknown test %s\n", argv[1]);
+		ret = EINVAL;
+		break;
+	}
+
+	if (test_locked_parsing) {
+		printf("%u files parsed while holding a catalog lock\n",
+		       test_locked_parsing);
+		ret = EINVAL;
+	}
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", test_base);
+	if (system(cmd))
+		printf("cannot remove test directory %s\n", test_base);
+
+	return ret ? 1 : 0;
+}
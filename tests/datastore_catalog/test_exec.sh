@@ -0,0 +1,75 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./datastore_catalog"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "../../lib/json-c/datastore_catalog.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Write the files of the vsIDs of a test session and release the
+#	   test session
+# Expected result: The changes are collected in the cached catalog and the
+#		   outdated catalog is removed from the data store, the catalog
+#		   is written once the test session is released
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Remove and add files and vsID directories outside of the proxy
+# Expected result: The revalidation of the vsIDs corrects the catalog
+#		   state, added and removed vsIDs are detected when the catalog
+#		   is read
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: Read a catalog which was stored without algorithm summaries
+# Expected result: The summaries are obtained without holding a catalog lock
+#		   and are recorded in the cached and the stored catalog
+test3()
+{
+	run_test 3
+}
+
+# Test 4
+#
+# Purpose: Write the files of the same vsIDs concurrently while the catalog
+#	   is read and written
+# Expected result: The catalog stays sorted and consistent, the final catalog
+#		   matches the files
+test4()
+{
+	run_test 4
+}
+
+init_common
+test1
+test2
+test3
+test4
+
+exit_test
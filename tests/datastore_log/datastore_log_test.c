@@ -0,0 +1,506 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+#include "../../lib/common/datastore_log.c"
+
+/* Size of the file overwritten to trigger a compaction */
+#define TEST_BIGFILE (64 * 1024)
+#define TEST_OVERWRITES (ACVP_DS_LOG_COMPACT_MIN / TEST_BIGFILE + 2)
+
+static char test_base[] = "datastore_log_test.XXXXXX";
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+static void test_unmap(struct acvp_datastore_map *map)
+{
+	if (map->addr)
+		munmap(map->addr, map->len);
+	memset(map, 0, sizeof(*map));
+}
+
+/* All files of the test are held in the log, only mappings are released */
+const struct acvp_datastore_io acvp_datastore_io_file = {
+	.unmap = test_unmap,
+};
+
+int acvp_req_check_string(char *string, const size_t slen)
+{
+	(void)string;
+	(void)slen;
+	return 0;
+}
+
+int acvp_duplicate(char **dst, const char *src)
+{
+	*dst = strdup(src);
+	return *dst ? 0 : -ENOMEM;
+}
+
+void acvp_datastore_list_free(char **names, const unsigned int num)
+{
+	unsigned int i;
+
+	for (i = 0; i < num; i++)
+		free(names[i]);
+	free(names);
+}
+
+int acvp_datastore_file_dir(char *dirname, const bool createdir)
+{
+	(void)createdir;
+
+	if (mkdir(dirname, 0700) && errno != EEXIST)
+		return -errno;
+	return 0;
+}
+
+static void test_path(char *path, size_t len, const char *name)
+{
+	snprintf(path, len, "%s/%s", test_base, name);
+}
+
+static int test_open(void)
+{
+	return acvp_datastore_io_log.base(test_base, true, true);
+}
+
+/* Forget the in-memory state as if the process was restarted */
+static int test_restart(void)
+{
+	acvp_datastore_log_release();
+	return test_open();
+}
+
+static int test_write(const char *name, const uint8_t *data, uint32_t len)
+{
+	struct acvp_buf buf;
+	char path[FILENAME_MAX];
+
+	test_path(path, sizeof(path), name);
+	buf.buf = (uint8_t *)data;
+	buf.len = len;
+	buf.size = 0;
+
+	return acvp_datastore_io_log.write(path, &buf);
+}
+
+static int test_write_str(const char *name, const char *str)
+{
+	return test_write(name, (const uint8_t *)str, (uint32_t)strlen(str));
+}
+
+static int test_check(const char *name, const uint8_t *data, size_t len)
+{
+	char path[FILENAME_MAX];
+	uint8_t *buf = NULL;
+	size_t buflen;
+	int ret;
+
+	test_path(path, sizeof(path), name);
+	ret = acvp_datastore_io_log.read(path, &buf, &buflen);
+	if (ret) {
+		printf("Cannot read %s: %d\n", name, ret);
+		return 1;
+	}
+
+	if (buflen != len || memcmp(buf, data, len)) {
+		printf("Unexpected content of %s\n", name);
+		ret = 1;
+	}
+
+	free(buf);
+	return ret;
+}
+
+static int test_check_str(const char *name, const char *str)
+{
+	return test_check(name, (const uint8_t *)str, strlen(str));
+}
+
+static int test_absent(const char *name)
+{
+	struct acvp_datastore_stat st;
+	char path[FILENAME_MAX];
+
+	test_path(path, sizeof(path), name);
+	if (acvp_datastore_io_log.stat(path, &st) != -ENOENT) {
+		printf("File %s is present\n", name);
+		return 1;
+	}
+
+	return 0;
+}
+
+static off_t test_logsize(void)
+{
+	struct stat statbuf;
+	char path[FILENAME_MAX];
+
+	test_path(path, sizeof(path), ACVP_DS_LOGFILE);
+	if (stat(path, &statbuf))
+		return -1;
+
+	return statbuf.st_size;
+}
+
+static int test_logflip(off_t off)
+{
+	char path[FILENAME_MAX];
+	uint8_t byte;
+	int fd, ret = 0;
+
+	test_path(path, sizeof(path), ACVP_DS_LOGFILE);
+	fd = open(path, O_RDWR);
+	if (fd < 0)
+		return -errno;
+
+	if (pread(fd, &byte, 1, off) != 1) {
+		ret = -EIO;
+		goto out;
+	}
+	byte ^= 0x80;
+	if (pwrite(fd, &byte, 1, off) != 1)
+		ret = -EIO;
+
+out:
+	close(fd);
+	return ret;
+}
+
+static int test_logtruncate(off_t size)
+{
+	char path[FILENAME_MAX];
+
+	test_path(path, sizeof(path), ACVP_DS_LOGFILE);
+	if (truncate(path, size))
+		return -errno;
+
+	return 0;
+}
+
+/*
+ * Overwrite the file until the superseded records trigger a compaction, the
+ * data of the last write is filled with TEST_OVERWRITES - 1.
+ */
+static int test_overwrite(const char *name, uint8_t *data)
+{
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < TEST_OVERWRITES; i++) {
+		memset(data, (int)i, TEST_BIGFILE);
+		CKINT(test_write(name, data, TEST_BIGFILE));
+	}
+
+out:
+	return ret;
+}
+
+static int test_replay(void)
+{
+	char path[FILENAME_MAX], newpath[FILENAME_MAX];
+	char **names = NULL;
+	unsigned int num = 0;
+	int ret;
+
+	CKINT(test_open());
+
+	test_path(path, sizeof(path), "dir");
+	CKINT(acvp_datastore_io_log.dir(path, true));
+	CKINT(test_write_str("dir/file1", "one"));
+	CKINT(test_write_str("dir/file2", "two"));
+	CKINT(test_write_str("dir/file1", "three"));
+	CKINT(test_write_str("dir/file4", "four"));
+
+	test_path(path, sizeof(path), "dir/file2");
+	test_path(newpath, sizeof(newpath), "dir/file3");
+	CKINT(acvp_datastore_io_log.rename(path, newpath));
+	test_path(path, sizeof(path), "dir/file4");
+	CKINT(acvp_datastore_io_log.unlink(path));
+
+	CKINT(test_restart());
+
+	ret = test_check_str("dir/file1", "three");
+	ret |= test_check_str("dir/file3", "two");
+	ret |= test_absent("dir/file2");
+	ret |= test_absent("dir/file4");
+	if (ret)
+		goto out;
+
+	test_path(path, sizeof(path), "dir");
+	CKINT(acvp_datastore_io_log.list(path, &names, &num));
+	if (num != 2 || strcmp(names[0], "file1") ||
+	    strcmp(names[1], "file3")) {
+		printf("Unexpected directory content\n");
+		ret = 1;
+	}
+
+out:
+	acvp_datastore_list_free(names, num);
+	return ret;
+}
+
+static int test_torn_tail(void)
+{
+	off_t size, end;
+	int ret;
+
+	CKINT(test_open());
+	CKINT(test_write_str("file1", "one"));
+	size = test_logsize();
+	CKINT(test_write_str("file2", "two"));
+	end = test_logsize();
+
+	/* A partially written last record is removed */
+	acvp_datastore_log_release();
+	CKINT(test_logtruncate(end - 1));
+	CKINT(test_open());
+	ret = test_check_str("file1", "one");
+	ret |= test_absent("file2");
+	if (ret)
+		goto out;
+	if (test_logsize() != size) {
+		printf("Torn record was not removed\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* A last record with a wrong checksum is removed */
+	CKINT(test_write_str("file2", "two"));
+	acvp_datastore_log_release();
+	CKINT(test_logflip(end - 1));
+	CKINT(test_open());
+	ret = test_check_str("file1", "one");
+	ret |= test_absent("file2");
+	if (ret)
+		goto out;
+	if (test_logsize() != size) {
+		printf("Damaged record was not removed\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* A damaged record followed by an intact record is no torn tail */
+	CKINT(test_write_str("file2", "two"));
+	acvp_datastore_log_release();
+	CKINT(test_logflip(size - 1));
+	if (test_open() != -EIO) {
+		printf("Corrupted log was not detected\n");
+		ret = 1;
+		goto out;
+	}
+	if (test_logsize() != end) {
+		printf("Corrupted log was modified\n");
+		ret = 1;
+	}
+
+out:
+	return ret;
+}
+
+static int test_catch_up(void)
+{
+	struct acvp_ds_log *log;
+	uint8_t *data = NULL;
+	ino_t ino;
+	pid_t pid;
+	int ret, status;
+
+	CKINT(test_open());
+	CKINT(test_write_str("file1", "parent"));
+
+	data = malloc(TEST_BIGFILE);
+	CKNULL(data, -ENOMEM);
+
+	/* Records appended by another process are applied */
+	pid = fork();
+	if (pid < 0) {
+		ret = -errno;
+		goto out;
+	}
+	if (!pid)
+		_exit(test_write_str("file2", "child") ? 1 : 0);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		printf("Writing from child failed\n");
+		ret = 1;
+		goto out;
+	}
+
+	ret = test_check_str("file2", "child");
+	ret |= test_check_str("file1", "parent");
+	if (ret)
+		goto out;
+
+	/* A log compacted by another process is picked up */
+	log = acvp_ds_logs;
+	ino = log->ino;
+	pid = fork();
+	if (pid < 0) {
+		ret = -errno;
+		goto out;
+	}
+	if (!pid)
+		_exit(test_overwrite("file3", data) ? 1 : 0);
+	if (waitpid(pid, &status, 0) != pid || !WIFEXITED(status) ||
+	    WEXITSTATUS(status)) {
+		printf("Compaction in child failed\n");
+		ret = 1;
+		goto out;
+	}
+
+	memset(data, TEST_OVERWRITES - 1, TEST_BIGFILE);
+	ret = test_check("file3", data, TEST_BIGFILE);
+	ret |= test_check_str("file2", "child");
+	ret |= test_check_str("file1", "parent");
+	if (ret)
+		goto out;
+	if (log->ino == ino) {
+		printf("Compacted log was not picked up\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* Both processes continue to append to the compacted log */
+	CKINT(test_write_str("file4", "parent"));
+	CKINT(test_restart());
+	ret = test_check_str("file4", "parent");
+	ret |= test_check("file3", data, TEST_BIGFILE);
+
+out:
+	free(data);
+	return ret;
+}
+
+static int test_compaction(void)
+{
+	struct acvp_datastore_map map;
+	char path[FILENAME_MAX];
+	uint8_t *data = NULL;
+	off_t size;
+	int ret;
+
+	data = malloc(TEST_BIGFILE);
+	CKNULL(data, -ENOMEM);
+
+	CKINT(test_open());
+	test_path(path, sizeof(path), "dir");
+	CKINT(acvp_datastore_io_log.dir(path, true));
+	CKINT(test_write_str("dir/file1", "one"));
+
+	/* A mapping of a superseded record stays valid */
+	memset(data, 0xff, TEST_BIGFILE);
+	CKINT(test_write("dir/file2", data, TEST_BIGFILE));
+	test_path(path, sizeof(path), "dir/file2");
+	CKINT(acvp_datastore_io_log.map(path, &map));
+
+	CKINT(test_overwrite("dir/file2", data));
+
+	size = test_logsize();
+	if (size < 0 || size >= ACVP_DS_LOG_COMPACT_MIN) {
+		printf("Log was not compacted: %lld bytes\n", (long long)size);
+		ret = 1;
+		goto unmap;
+	}
+
+	if (map.buf.len != TEST_BIGFILE || map.buf.buf[0] != 0xff ||
+	    map.buf.buf[TEST_BIGFILE - 1] != 0xff) {
+		printf("Mapping of superseded record changed\n");
+		ret = 1;
+		goto unmap;
+	}
+
+	ret = test_check_str("dir/file1", "one");
+	ret |= test_check("dir/file2", data, TEST_BIGFILE);
+	if (ret)
+		goto unmap;
+
+	CKINT(test_restart());
+	ret = test_check_str("dir/file1", "one");
+	ret |= test_check("dir/file2", data, TEST_BIGFILE);
+
+unmap:
+	acvp_datastore_io_log.unmap(&map);
+out:
+	free(data);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	char cmd[FILENAME_MAX];
+	int ret;
+
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	if (!mkdtemp(test_base)) {
+		printf("cannot create test directory\n");
+		return errno;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		/* Replay of all record types */
+		ret = test_replay();
+		break;
+	case 2:
+		/* Removal of a torn tail, detection of a corrupted log */
+		ret = test_torn_tail();
+		break;
+	case 3:
+		/* Catch up with the writes and compactions of another process */
+		ret = test_catch_up();
+		break;
+	case 4:
+		/* Compaction of superseded records */
+		ret = test_compaction();
+		break;
+	default:
+		printf("unknown test %s\n", argv[1]);
+		ret = EINVAL;
+		break;
+	}
+
+	acvp_datastore_log_release();
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", test_base);
+	if (system(cmd))
+		printf("cannot remove test directory %s\n", test_base);
+
+	return ret ? 1 : 0;
+}
@@ -0,0 +1,76 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./datastore_log"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "../../lib/common/datastore_log.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Replay the log holding writes, overwrites, renames and deletions
+#	   after a restart
+# Expected result: The files and directories are restored with the content
+#		   of the last write
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Open a log with an incomplete or damaged last record and a log
+#	   with a damaged record followed by an intact record
+# Expected result: The damaged last record is removed while all previous
+#		   records are kept, the damaged record within the log is
+#		   reported as corruption and the log is left untouched
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: Write to the log and compact the log from another process
+# Expected result: The writes of the other process are visible, the replaced
+#		   log file is picked up and both processes continue to use it
+test3()
+{
+	run_test 3
+}
+
+# Test 4
+#
+# Purpose: Overwrite a file until the superseded records exceed the live
+#	   records
+# Expected result: The log is compacted to the live records, existing
+#		   mappings and all file contents remain valid
+test4()
+{
+	run_test 4
+}
+
+init_common
+
+test1
+test2
+test3
+test4
+
+exit_test
@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../lib/acvp/definition.c"
+
+/* Number of generated definitions */
+#define TEST_DEFS 300
+
+const struct acvp_datastore_be *ds = NULL;
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+/* The network definitions are not needed for the test */
+int acvp_get_proto(const struct acvp_net_proto **proto)
+{
+	(void)proto;
+	return -EOPNOTSUPP;
+}
+
+int acvp_get_net(const struct acvp_net_ctx **net)
+{
+	(void)net;
+	return -EOPNOTSUPP;
+}
+
+int acvp_duplicate(char **dst, const char *src)
+{
+	char *tmp = NULL;
+
+	if (src) {
+		tmp = strdup(src);
+		if (!tmp)
+			return -ENOMEM;
+	}
+
+	free(*dst);
+	*dst = tmp;
+	return 0;
+}
+
+int acvp_sanitize_string(char *string)
+{
+	(void)string;
+	return 0;
+}
+
+bool acvp_req_is_production(void)
+{
+	return false;
+}
+
+int acvp_module_type_name_to_enum(const char *str, enum def_mod_type *env_type)
+{
+	(void)str;
+	(void)env_type;
+	return -EOPNOTSUPP;
+}
+
+int acvp_module_oe_type(const enum def_mod_type env_type,
+			const char **out_string)
+{
+	(void)env_type;
+	(void)out_string;
+	return -EOPNOTSUPP;
+}
+
+int esvp_def_config(const char *directory, struct esvp_es_def **es)
+{
+	(void)directory;
+	(void)es;
+	return -EOPNOTSUPP;
+}
+
+void esvp_def_es_free(struct esvp_es_def *es)
+{
+	(void)es;
+}
+
+static char *test_strdup(const char *fmt, unsigned int val)
+{
+	char *str;
+
+	if (asprintf(&str, fmt, val) < 0) {
+		printf("Allocation failed\n");
+		exit(1);
+	}
+
+	return str;
+}
+
+static struct def_dependency *test_dep(enum def_dependency_type type,
+				       char *name)
+{
+	struct def_dependency *def_dep = calloc(1, sizeof(*def_dep));
+
+	if (!def_dep) {
+		printf("Allocation failed\n");
+		exit(1);
+	}
+
+	def_dep->def_dependency_type = type;
+	if (type == def_dependency_hardware)
+		def_dep->proc_name = name;
+	else
+		def_dep->name = name;
+
+	return def_dep;
+}
+
+/*
+ * Register a definition - the search strings are varied to cover exact
+ * matches, fuzzy matches and the fields that match any search string.
+ */
+static struct definition *test_def(unsigned int i)
+{
+	struct definition *def = calloc(1, sizeof(*def));
+	struct def_info *info = calloc(1, sizeof(*info));
+	struct def_vendor *vendor = calloc(1, sizeof(*vendor));
+	struct def_oe *oe = calloc(1, sizeof(*oe));
+
+	if (!def || !info || !vendor || !oe) {
+		printf("Allocation failed\n");
+		exit(1);
+	}
+
+	info->module_name = test_strdup(i % 5 ? "Module %u" :
+						"Crypto Library %u", i);
+	if (i % 11)
+		info->orig_module_name = strdup(info->module_name);
+	if (i % 4)
+		info->module_version = test_strdup("%u.0", i % 3);
+	vendor->vendor_name = test_strdup("Vendor %u", i % 10);
+
+	switch (i % 3) {
+	case 1:
+		oe->def_dep = test_dep(def_dependency_os,
+				       test_strdup("Linux %u", i % 6));
+		break;
+	case 2:
+		oe->def_dep = test_dep(def_dependency_software,
+				       test_strdup("Windows %u", i % 2));
+		oe->def_dep->next = test_dep(def_dependency_hardware,
+					     test_strdup("Xeon %u", i % 4));
+		break;
+	default:
+		/* No dependencies */
+		break;
+	}
+
+	def->info = info;
+	def->vendor = vendor;
+	def->oe = oe;
+
+	acvp_register_def(def);
+
+	return def;
+}
+
+/*
+ * Compare the search result obtained with the index with the result of a
+ * linear scan of the definition list.
+ */
+static int test_compare(const struct acvp_search_ctx *search,
+			unsigned int *found)
+{
+	const struct definition *def = NULL, *ref = def_head;
+
+	*found = 0;
+
+	for (;;) {
+		while (ref && acvp_def_search_verify(search, ref))
+			ref = ref->next;
+
+		def = acvp_find_def(search, def);
+
+		if (!def_index.valid) {
+			printf("Search index not used\n");
+			return -EINVAL;
+		}
+
+		if (def != ref) {
+			printf("Search result mismatch after %u definitions: %s / %s\n",
+			       *found, def ? def->info->module_name : "none",
+			       ref ? ref->info->module_name : "none");
+			return -EINVAL;
+		}
+
+		if (!def)
+			return 0;
+
+		(*found)++;
+		ref = ref->next;
+	}
+}
+
+static int test_expect(struct acvp_search_ctx *search, const char *desc,
+		       unsigned int expected)
+{
+	unsigned int found;
+	int ret = test_compare(search, &found);
+
+	if (ret) {
+		printf("Search for %s failed\n", desc);
+		return ret;
+	}
+
+	if (found != expected) {
+		printf("Search for %s found %u definitions, expected %u\n",
+		       desc, found, expected);
+		return -EINVAL;
+	}
+
+	memset(search, 0, sizeof(*search));
+
+	return 0;
+}
+
+static void test_register(void)
+{
+	unsigned int i;
+
+	for (i = 0; i < TEST_DEFS; i++)
+		test_def(i);
+}
+
+/* Searches with the index return the definitions of a linear scan */
+static int test_search(void)
+{
+	struct acvp_search_ctx search;
+	int ret;
+
+	test_register();
+	memset(&search, 0, sizeof(search));
+
+	/* All definitions */
+	CKINT(test_expect(&search, "all definitions", TEST_DEFS));
+
+	search.modulename = "Module 17";
+	CKINT(test_expect(&search, "exact module name", 1));
+
+	search.modulename = "Module 1000";
+	CKINT(test_expect(&search, "unknown module name", 0));
+
+	search.modulename = "ule 1";
+	search.modulename_fuzzy_search = true;
+	CKINT(test_expect(&search, "module name substring", 89));
+
+	search.modulename = "MODULE";
+	search.modulename_fuzzy_search = true;
+	CKINT(test_expect(&search, "module name in upper case", 0));
+
+	/* Too short for the trigram index */
+	search.modulename = "17";
+	search.modulename_fuzzy_search = true;
+	CKINT(test_expect(&search, "short module name substring", 13));
+
+	/* Definitions without original module name match as well */
+	search.orig_modulename = "Module 23";
+	CKINT(test_expect(&search, "original module name",
+			  1 + (TEST_DEFS + 10) / 11));
+
+	search.orig_modulename = "Module 1000";
+	CKINT(test_expect(&search, "unknown original module name",
+			  (TEST_DEFS + 10) / 11));
+
+	/* Definitions without version match any version */
+	search.moduleversion = "1.0";
+	CKINT(test_expect(&search, "module version", 75 + 75));
+
+	search.vendorname = "endor 3";
+	search.vendorname_fuzzy_search = true;
+	CKINT(test_expect(&search, "vendor name substring", TEST_DEFS / 10));
+
+	/* Definitions without software dependency match as well */
+	search.execenv = "Linux 4";
+	CKINT(test_expect(&search, "execution environment", 50 + 100));
+
+	search.processor = "eon";
+	search.processor_fuzzy_search = true;
+	CKINT(test_expect(&search, "processor substring", TEST_DEFS));
+
+	search.processor = "Xeon 3";
+	CKINT(test_expect(&search, "processor", 200 + 25));
+
+	search.modulename = "Crypto";
+	search.modulename_fuzzy_search = true;
+	search.vendorname = "Vendor 5";
+	search.execenv = "Windows";
+	search.execenv_fuzzy_search = true;
+	CKINT(test_expect(&search, "combined search", 20));
+
+out:
+	return ret;
+}
+
+/* Renamed definitions are found with their new names only */
+static int test_rename(void)
+{
+	struct acvp_search_ctx search;
+	struct definition *def;
+	int ret;
+
+	test_register();
+	memset(&search, 0, sizeof(search));
+
+	/* Create the index */
+	search.modulename = "Module 42";
+	CKINT(test_expect(&search, "module name before rename", 1));
+
+	def = def_index.defs[42];
+	CKINT(acvp_duplicate(&def->info->module_name, "Renamed Module"));
+	acvp_def_index_invalidate();
+	if (def_index.valid) {
+		printf("Search index not invalidated\n");
+		return -EINVAL;
+	}
+
+	search.modulename = "Module 42";
+	CKINT(test_expect(&search, "old module name", 0));
+
+	search.modulename = "Renamed Module";
+	CKINT(test_expect(&search, "new module name", 1));
+
+	search.modulename = "named Mod";
+	search.modulename_fuzzy_search = true;
+	CKINT(test_expect(&search, "new module name substring", 1));
+
+	/* Rename of the OE */
+	def = def_index.defs[43];
+	CKINT(acvp_duplicate(&def->oe->def_dep->name, "Renamed OS"));
+	acvp_def_index_invalidate();
+
+	search.execenv = "Renamed OS";
+	CKINT(test_expect(&search, "new execution environment", 1 + 100));
+
+	search.execenv = "Linux 1";
+	CKINT(test_expect(&search, "old execution environment", 49 + 100));
+
+	/* Rename of the version */
+	def = def_index.defs[45];
+	CKINT(acvp_duplicate(&def->info->module_version, "9.9"));
+	acvp_def_index_invalidate();
+
+	search.moduleversion = "9.9";
+	CKINT(test_expect(&search, "new module version", 1 + 75));
+
+out:
+	return ret;
+}
+
+/* Definitions registered after the index was created are found */
+static int test_late_register(void)
+{
+	struct acvp_search_ctx search;
+	const struct definition *def;
+	struct definition *late;
+	int ret;
+
+	test_register();
+	memset(&search, 0, sizeof(search));
+
+	search.modulename = "Module 1";
+	search.modulename_fuzzy_search = true;
+	CKINT(test_expect(&search, "module name substring", 89));
+
+	late = test_def(1);
+	if (def_index.valid) {
+		printf("Search index not invalidated by registration\n");
+		return -EINVAL;
+	}
+
+	search.modulename = "Module 1";
+	CKINT(test_expect(&search, "module name with late definition", 2));
+
+	/* Continue the search after the processed definition */
+	search.modulename = "Module 1";
+	def = acvp_find_def(&search, NULL);
+	if (!def || def == late) {
+		printf("First match is not the initial definition\n");
+		return -EINVAL;
+	}
+	def = acvp_find_def(&search, def);
+	if (def != late) {
+		printf("Second match is not the late definition\n");
+		return -EINVAL;
+	}
+	def = acvp_find_def(&search, def);
+	if (def) {
+		printf("Unexpected third match\n");
+		return -EINVAL;
+	}
+
+	/* Unknown definitions are rejected as processed pointer */
+	late = calloc(1, sizeof(*late));
+	CKNULL(late, -ENOMEM);
+	late->registry_pos = 1;
+	def = acvp_find_def(&search, late);
+	free(late);
+	if (def) {
+		printf("Search continued after unknown definition\n");
+		return -EINVAL;
+	}
+
+out:
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		return test_search();
+	case 2:
+		return test_rename();
+	case 3:
+		return test_late_register();
+	default:
+		printf("unknown test %s\n", argv[1]);
+		return EINVAL;
+	}
+}
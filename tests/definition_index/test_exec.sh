@@ -0,0 +1,64 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./definition_index"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "../../lib/acvp/definition.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Search the registered definitions with exact, fuzzy and wildcard
+#	   search criteria using the search index
+# Expected result: The index returns the same definitions in the same order
+#		   as a linear scan of the definition list
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Rename the module name, the OE and the version of definitions
+#	   after the search index was created
+# Expected result: The index is invalidated, the definitions are only found
+#		   with their new names
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: Register a definition after the search index was created and
+#	   continue a search after a processed definition
+# Expected result: The new definition is found after the existing ones, an
+#		   unknown processed definition ends the search
+test3()
+{
+	run_test 3
+}
+
+init_common
+
+test1
+test2
+test3
+
+exit_test
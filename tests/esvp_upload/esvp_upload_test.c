@@ -0,0 +1,657 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../lib/esvp/esvp_submit.c"
+
+/*
+ * The ESVP server is simulated by acvp_net_op. It reads the uploaded data
+ * files from the file descriptor as the network backend does and verifies
+ * their content. All other services of the proxy are not needed.
+ */
+
+#define TEST_TESTID 42
+#define TEST_RAW_NOISE_ID 11
+#define TEST_RESTART_ID 12
+#define TEST_CC_ID 13
+#define TEST_DOCS 3
+
+/* Delay of one upload in microseconds */
+#define TEST_SERVER_DELAY 50000
+
+static DEFINE_MUTEX_W_UNLOCKED(test_lock);
+static unsigned int test_uploads = 0;
+static unsigned int test_inflight = 0;
+static unsigned int test_max_inflight = 0;
+static unsigned int test_sd_id = 100;
+static unsigned int test_fail_id = 0;
+static bool test_status_active = false;
+static unsigned int test_status_writes = 0;
+static bool test_error = false;
+
+static struct acvp_net_proto test_proto = {
+	.url_base = "esv/v1",
+	.proto_version = "1.0",
+	.proto_version_keyword = "esvVersion",
+	.proto_name = "ESVP",
+	.proto = esv_protocol,
+};
+
+static struct acvp_net_ctx test_net = {
+	.server_name = "esvp.example.com",
+	.server_port = 443,
+	.proto = &test_proto,
+};
+
+const struct acvp_datastore_be *ds = NULL;
+
+static void test_fail(const char *msg)
+{
+	mutex_w_lock(&test_lock);
+	printf("%s\n", msg);
+	test_error = true;
+	mutex_w_unlock(&test_lock);
+}
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+int acvp_get_net(const struct acvp_net_ctx **net)
+{
+	*net = &test_net;
+	return 0;
+}
+
+int acvp_get_proto(const struct acvp_net_proto **proto)
+{
+	*proto = &test_proto;
+	return 0;
+}
+
+int acvp_duplicate(char **dst, const char *src)
+{
+	*dst = strdup(src);
+	return *dst ? 0 : -ENOMEM;
+}
+
+int acvp_str_match(const char *exp, const char *found, const uint32_t id)
+{
+	(void)id;
+
+	if (!exp || !found)
+		return 0;
+	return strcmp(exp, found) ? -ENOENT : 0;
+}
+
+int acvp_init_acvp_auth_ctx(struct acvp_auth_ctx **auth)
+{
+	*auth = calloc(1, sizeof(**auth));
+	return *auth ? 0 : -ENOMEM;
+}
+
+int acvp_set_authtoken_temp(struct acvp_auth_ctx *auth, const char *authtoken)
+{
+	(void)auth;
+	(void)authtoken;
+	return 0;
+}
+
+int acvp_request_error_handler(const int request_ret)
+{
+	return request_ret;
+}
+
+void esvp_def_sd_free(struct esvp_sd_def *sd)
+{
+	if (!sd)
+		return;
+	free(sd->sd_auth);
+	free(sd->filename);
+	free(sd);
+}
+
+int esvp_write_status(const struct acvp_testid_ctx *testid_ctx)
+{
+	(void)testid_ctx;
+
+	/* The status updates must be serialized */
+	if (__atomic_exchange_n(&test_status_active, true, __ATOMIC_SEQ_CST))
+		test_fail("Concurrent update of the status file");
+	usleep(1000);
+	__atomic_add_fetch(&test_status_writes, 1, __ATOMIC_SEQ_CST);
+	__atomic_store_n(&test_status_active, false, __ATOMIC_SEQ_CST);
+
+	return 0;
+}
+
+/* Services of the proxy not used by the upload of the data files */
+int acvp_copy_auth(struct acvp_auth_ctx *dst, const struct acvp_auth_ctx *src)
+{
+	(void)dst;
+	(void)src;
+	return -EOPNOTSUPP;
+}
+
+int acvp_export_def_search(const struct acvp_testid_ctx *testid_ctx)
+{
+	(void)testid_ctx;
+	return -EOPNOTSUPP;
+}
+
+int acvp_get_testid(struct acvp_testid_ctx *testid_ctx,
+		    struct json_object *request,
+		    struct json_object *register_response)
+{
+	(void)testid_ctx;
+	(void)request;
+	(void)register_response;
+	return -EOPNOTSUPP;
+}
+
+int acvp_init_auth(struct acvp_testid_ctx *testid_ctx)
+{
+	(void)testid_ctx;
+	return -EOPNOTSUPP;
+}
+
+int acvp_init_testid_ctx(struct acvp_testid_ctx *testid_ctx,
+			 const struct acvp_ctx *ctx,
+			 const struct definition *def, const uint32_t testid)
+{
+	(void)testid_ctx;
+	(void)ctx;
+	(void)def;
+	(void)testid;
+	return -EOPNOTSUPP;
+}
+
+int acvp_process_testids(const struct acvp_ctx *ctx,
+			 int (*cb)(const struct acvp_ctx *ctx,
+				   const struct definition *def,
+				   const uint32_t testid))
+{
+	(void)ctx;
+	(void)cb;
+	return -EOPNOTSUPP;
+}
+
+int acvp_register_cb(const struct acvp_ctx *ctx,
+		     int (*cb)(const struct acvp_ctx *ctx,
+			       const struct definition *def, uint32_t testid))
+{
+	(void)ctx;
+	(void)cb;
+	return -EOPNOTSUPP;
+}
+
+void acvp_release_auth(struct acvp_testid_ctx *testid_ctx)
+{
+	(void)testid_ctx;
+}
+
+void acvp_release_testid(struct acvp_testid_ctx *testid_ctx)
+{
+	(void)testid_ctx;
+}
+
+int acvp_store_register_debug(const struct acvp_testid_ctx *testid_ctx,
+			      const struct acvp_buf *buf, const int err)
+{
+	(void)testid_ctx;
+	(void)buf;
+	(void)err;
+	return 0;
+}
+
+int acvp_testids_refresh(const struct acvp_ctx *ctx)
+{
+	(void)ctx;
+	return -EOPNOTSUPP;
+}
+
+int esvp_certify(struct acvp_testid_ctx *testid_ctx)
+{
+	(void)testid_ctx;
+	return -EOPNOTSUPP;
+}
+
+int esvp_read_status(const struct acvp_testid_ctx *testid_ctx,
+		     struct json_object *status)
+{
+	(void)testid_ctx;
+	(void)status;
+	return -EOPNOTSUPP;
+}
+
+/* Content of the data files */
+static uint8_t test_pattern(uint64_t offset, uint64_t len)
+{
+	return (uint8_t)((offset + len) % 251);
+}
+
+/* Read the data file as the network backend does and verify its content */
+static bool test_verify_file(const struct acvp_ext_buf *data)
+{
+	uint8_t buf[4096];
+	uint64_t offset = 0;
+	ssize_t rc, i;
+
+	if (data->file_fd < 0 || !data->file_len)
+		return false;
+
+	while (offset < data->file_len) {
+		rc = pread(data->file_fd, buf, sizeof(buf), (off_t)offset);
+		if (rc <= 0)
+			return false;
+
+		for (i = 0; i < rc; i++) {
+			if (buf[i] != test_pattern(offset + (uint64_t)i,
+						   data->file_len))
+				return false;
+		}
+		offset += (uint64_t)rc;
+	}
+
+	return (offset == data->file_len);
+}
+
+/* Simulated ESVP server */
+int acvp_net_op(const struct acvp_testid_ctx *testid_ctx, const char *url,
+		const struct acvp_ext_buf *submit, struct acvp_buf *response,
+		enum acvp_http_type nettype)
+{
+	const struct acvp_ext_buf *itar, *desc;
+	unsigned int id = 0;
+	bool sd = false, fail;
+	char resp[256], expected[ACVP_NET_URL_MAXLEN];
+	const char *p;
+
+	mutex_w_lock(&test_lock);
+	test_uploads++;
+	test_inflight++;
+	if (test_inflight > test_max_inflight)
+		test_max_inflight = test_inflight;
+	mutex_w_unlock(&test_lock);
+
+	usleep(TEST_SERVER_DELAY);
+
+	if (nettype != acvp_http_post_multi)
+		test_fail("Upload does not use a multipart POST");
+
+	if (!test_verify_file(submit))
+		test_fail("Uploaded data does not match the file");
+
+	if (!strcmp(submit->data_type, "sdFile")) {
+		sd = true;
+
+		snprintf(expected, sizeof(expected),
+			 "https://esvp.example.com:443/esv/v1/%s",
+			 NIST_ESVP_VAL_OP_SUPPDOC);
+		itar = submit->next;
+		desc = itar ? itar->next : NULL;
+		if (strcmp(url, expected) || !itar || !desc ||
+		    strcmp(itar->data_type, "itar") ||
+		    itar->len != 5 || memcmp(itar->buf, "false", 5) ||
+		    strcmp(desc->data_type, "sdComments") ||
+		    desc->len != strlen(submit->filename) ||
+		    memcmp(desc->buf, submit->filename, desc->len))
+			test_fail("Unexpected supporting document upload");
+	} else {
+		snprintf(expected, sizeof(expected),
+			 "https://esvp.example.com:443/esv/v1/%s/%u/%s/",
+			 NIST_ESVP_VAL_OP_ENTROPY_ASSESSMENT, testid_ctx->testid,
+			 NIST_ESVP_VAL_OP_DATAFILE);
+		if (strcmp(submit->data_type, "dataFile") ||
+		    strncmp(url, expected, strlen(expected)))
+			test_fail("Unexpected data file upload");
+
+		p = url + strlen(expected);
+		id = (unsigned int)strtoul(p, NULL, 10);
+	}
+
+	mutex_w_lock(&test_lock);
+	test_inflight--;
+	fail = (id && id == test_fail_id);
+	if (sd) {
+		snprintf(resp, sizeof(resp),
+			 "[{\"esvVersion\":\"1.0\"},{\"status\":\"success\",\"accessToken\":\"token\",\"sdId\":%u}]",
+			 test_sd_id++);
+	} else {
+		snprintf(resp, sizeof(resp),
+			 "[{\"esvVersion\":\"1.0\"},{\"status\":\"%s\"}]",
+			 fail ? "error" : "success");
+	}
+	mutex_w_unlock(&test_lock);
+
+	return acvp_buf_append(response, (uint8_t *)resp,
+			       (uint32_t)strlen(resp));
+}
+
+/******************************************************************************
+ * Test configuration
+ ******************************************************************************/
+struct test_config {
+	char dir[64];
+	struct acvp_ctx ctx;
+	struct acvp_testid_ctx testid_ctx;
+	struct esvp_es_def es;
+	struct esvp_cc_def cc[2];
+};
+
+static int test_write_file(const char *dir, const char *name, uint64_t len)
+{
+	char pathname[FILENAME_MAX];
+	uint8_t buf[4096];
+	uint64_t offset = 0;
+	size_t todo, i;
+	FILE *f;
+	int ret = 0;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", dir, name);
+	f = fopen(pathname, "w");
+	CKNULL(f, -errno);
+
+	while (offset < len) {
+		todo = (size_t)((len - offset < sizeof(buf)) ? len - offset :
+							       sizeof(buf));
+		for (i = 0; i < todo; i++)
+			buf[i] = test_pattern(offset + i, len);
+		if (fwrite(buf, 1, todo, f) != todo) {
+			ret = -EIO;
+			break;
+		}
+		offset += todo;
+	}
+
+	fclose(f);
+
+out:
+	return ret;
+}
+
+static void test_config_remove(struct test_config *config)
+{
+	char pathname[FILENAME_MAX];
+	unsigned int i;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s/%s%s", config->dir,
+		 ESVP_ES_DIR_ENTROPY_SOURCE, ESVP_ES_FILE_RAW_NOISE,
+		 ESVP_ES_BINARY_FILE_EXTENSION);
+	unlink(pathname);
+	snprintf(pathname, sizeof(pathname), "%s/%s/%s%s", config->dir,
+		 ESVP_ES_DIR_ENTROPY_SOURCE, ESVP_ES_FILE_RESTART_DATA,
+		 ESVP_ES_BINARY_FILE_EXTENSION);
+	unlink(pathname);
+	snprintf(pathname, sizeof(pathname), "%s/%s", config->dir,
+		 ESVP_ES_DIR_ENTROPY_SOURCE);
+	rmdir(pathname);
+
+	for (i = 0; i < ARRAY_SIZE(config->cc); i++) {
+		snprintf(pathname, sizeof(pathname), "%s/cc%u/%s%s",
+			 config->dir, i, ESVP_ES_FILE_CC_DATA,
+			 ESVP_ES_BINARY_FILE_EXTENSION);
+		unlink(pathname);
+		snprintf(pathname, sizeof(pathname), "%s/cc%u", config->dir,
+			 i);
+		rmdir(pathname);
+		free(config->cc[i].config_dir);
+	}
+
+	for (i = 0; i < TEST_DOCS; i++) {
+		snprintf(pathname, sizeof(pathname), "%s/%s/doc%u.pdf",
+			 config->dir, ESVP_ES_DIR_DOCUMENTATION, i);
+		unlink(pathname);
+	}
+	snprintf(pathname, sizeof(pathname), "%s/%s", config->dir,
+		 ESVP_ES_DIR_DOCUMENTATION);
+	rmdir(pathname);
+	rmdir(config->dir);
+
+	while (config->es.sd) {
+		struct esvp_sd_def *sd = config->es.sd;
+
+		config->es.sd = sd->next;
+		esvp_def_sd_free(sd);
+	}
+}
+
+/*
+ * Entropy source with raw noise and restart data, one non-vetted and one
+ * vetted conditioning component and supporting documents.
+ */
+static int test_config_create(struct test_config *config, bool threading)
+{
+	char pathname[FILENAME_MAX], name[32];
+	unsigned int i;
+	int ret;
+
+	memset(config, 0, sizeof(*config));
+	snprintf(config->dir, sizeof(config->dir), "esvp_upload.XXXXXX");
+	CKNULL(mkdtemp(config->dir), -errno);
+
+	config->ctx.options.threading_disabled = !threading;
+	config->testid_ctx.ctx = &config->ctx;
+	config->testid_ctx.testid = TEST_TESTID;
+	config->testid_ctx.es_def = &config->es;
+
+	config->es.config_dir = config->dir;
+	config->es.raw_noise_id = TEST_RAW_NOISE_ID;
+	config->es.restart_id = TEST_RESTART_ID;
+	config->es.cc = &config->cc[0];
+	config->cc[0].next = &config->cc[1];
+	config->cc[0].cc_id = TEST_CC_ID;
+	config->cc[1].vetted = true;
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", config->dir,
+		 ESVP_ES_DIR_ENTROPY_SOURCE);
+	CKINT(mkdir(pathname, 0700) ? -errno : 0);
+	CKINT(test_write_file(pathname,
+			      ESVP_ES_FILE_RAW_NOISE ESVP_ES_BINARY_FILE_EXTENSION,
+			      1000000));
+	CKINT(test_write_file(pathname,
+			      ESVP_ES_FILE_RESTART_DATA
+				      ESVP_ES_BINARY_FILE_EXTENSION,
+			      100000));
+
+	for (i = 0; i < ARRAY_SIZE(config->cc); i++) {
+		snprintf(pathname, sizeof(pathname), "%s/cc%u", config->dir,
+			 i);
+		CKINT(mkdir(pathname, 0700) ? -errno : 0);
+		CKINT(acvp_duplicate(&config->cc[i].config_dir, pathname));
+		CKINT(test_write_file(pathname,
+				      ESVP_ES_FILE_CC_DATA
+					      ESVP_ES_BINARY_FILE_EXTENSION,
+				      200000 + i));
+	}
+
+	snprintf(pathname, sizeof(pathname), "%s/%s", config->dir,
+		 ESVP_ES_DIR_DOCUMENTATION);
+	CKINT(mkdir(pathname, 0700) ? -errno : 0);
+	for (i = 0; i < TEST_DOCS; i++) {
+		snprintf(name, sizeof(name), "doc%u.pdf", i);
+		CKINT(test_write_file(pathname, name, 5000 + i));
+	}
+
+out:
+	return ret;
+}
+
+/* Uploads of one run: raw noise, restart, one conditioning component, docs */
+#define TEST_UPLOADS (3 + TEST_DOCS)
+
+static int test_check_run(struct test_config *config, unsigned int uploads,
+			  bool threading)
+{
+	struct esvp_sd_def *sd;
+	unsigned int docs = 0;
+
+	if (test_error)
+		return 1;
+
+	if (test_uploads != uploads) {
+		printf("%u instead of %u uploads\n", test_uploads, uploads);
+		return 1;
+	}
+	if (!threading && test_max_inflight > 1) {
+		printf("Concurrent uploads without threading\n");
+		return 1;
+	}
+	if (threading && uploads > 1 && test_max_inflight < 2) {
+		printf("Data files were not uploaded concurrently\n");
+		return 1;
+	}
+
+	if (!config->es.raw_noise_submitted || !config->cc[0].output_submitted ||
+	    config->cc[1].output_submitted) {
+		printf("Unexpected submission state\n");
+		return 1;
+	}
+
+	for (sd = config->es.sd; sd; sd = sd->next)
+		docs++;
+	if (docs != TEST_DOCS) {
+		printf("%u instead of %u supporting documents registered\n",
+		       docs, TEST_DOCS);
+		return 1;
+	}
+
+	return 0;
+}
+
+static int test_upload(bool threading)
+{
+	struct test_config config;
+	int ret;
+
+	CKINT(thread_init(2));
+	CKINT(test_config_create(&config, threading));
+
+	ret = esvp_process_datafiles_post(&config.testid_ctx);
+	if (ret) {
+		printf("Upload failed: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	CKINT(test_check_run(&config, TEST_UPLOADS, threading));
+	if (!config.es.restart_submitted) {
+		printf("Restart data not submitted\n");
+		ret = 1;
+		goto out;
+	}
+	if (test_status_writes != TEST_UPLOADS) {
+		printf("%u instead of %u status updates\n", test_status_writes,
+		       TEST_UPLOADS);
+		ret = 1;
+		goto out;
+	}
+
+	/* Files already submitted are not uploaded again */
+	test_uploads = 0;
+	test_max_inflight = 0;
+	ret = esvp_process_datafiles_post(&config.testid_ctx);
+	if (ret) {
+		printf("Second upload failed: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+	CKINT(test_check_run(&config, 0, threading));
+
+out:
+	test_config_remove(&config);
+	thread_release(false, true);
+	return ret;
+}
+
+static int test_upload_error(void)
+{
+	struct test_config config;
+	int ret;
+
+	CKINT(thread_init(2));
+	CKINT(test_config_create(&config, true));
+
+	/* The server rejects the restart data */
+	test_fail_id = TEST_RESTART_ID;
+
+	ret = esvp_process_datafiles_post(&config.testid_ctx);
+	if (!ret) {
+		printf("Upload error not reported\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* All other uploads are completed */
+	CKINT(test_check_run(&config, TEST_UPLOADS, true));
+	if (config.es.restart_submitted) {
+		printf("Rejected restart data marked as submitted\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* Only the rejected file is uploaded again */
+	test_fail_id = 0;
+	test_uploads = 0;
+	ret = esvp_process_datafiles_post(&config.testid_ctx);
+	if (ret || !config.es.restart_submitted) {
+		printf("Resubmission failed: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+	CKINT(test_check_run(&config, 1, true));
+
+out:
+	test_config_remove(&config);
+	thread_release(false, true);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		return test_upload(true);
+	case 2:
+		return test_upload(false);
+	case 3:
+		return test_upload_error();
+	default:
+		printf("unknown test %s\n", argv[1]);
+		return EINVAL;
+	}
+}
@@ -0,0 +1,61 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./esvp_upload"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "../../lib/esvp/esvp_submit.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Upload the data files and supporting documents of an entropy source
+# Expected result: All files are streamed to the server concurrently with the
+#		   correct content, the server responses are processed one
+#		   at a time and submitted files are not uploaded again
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Upload the data files and supporting documents without threading
+# Expected result: All files are uploaded one after the other
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: The server rejects one data file
+# Expected result: The error is reported after all other uploads completed,
+#		   only the rejected file is uploaded again
+test3()
+{
+	run_test 3
+}
+
+init_common
+
+test1
+test2
+test3
+
+exit_test
@@ -0,0 +1,216 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../../lib/hash/sha256.c"
+#include "sha512.h"
+
+struct sha256_impl {
+	const char *name;
+	void (*transform)(struct sha_ctx *ctx, const uint8_t *in,
+			  size_t blocks);
+	int (*available)(void);
+};
+
+static int sha256_c_available(void)
+{
+	return 1;
+}
+
+static const struct sha256_impl sha256_impls[] = {
+	{ "C", sha256_transform_c, sha256_c_available },
+#ifdef SHA256_X86_SHANI
+	{ "SHA-NI", sha256_transform_shani, sha256_shani_available },
+#endif
+#ifdef SHA256_ARMV8_CE
+	{ "ARMv8-CE", sha256_transform_armv8_ce, sha256_armv8_ce_available },
+#endif
+};
+
+static void hash_buf(const struct hash *hash, const uint8_t *in, size_t inlen,
+		     uint8_t *digest)
+{
+	HASH_CTX_ON_STACK(ctx);
+
+	hash->init(ctx);
+	hash->update(ctx, in, inlen);
+	hash->final(ctx, digest);
+}
+
+static int hash_kat(const struct hash *hash, const char *name,
+		    const char *msg, size_t repeat, const uint8_t *exp)
+{
+	HASH_CTX_ON_STACK(ctx);
+	uint8_t digest[SHA512_SIZE_DIGEST];
+	size_t i;
+
+	hash->init(ctx);
+	for (i = 0; i < repeat; i++)
+		hash->update(ctx, (const uint8_t *)msg, strlen(msg));
+	hash->final(ctx, digest);
+
+	if (memcmp(digest, exp, hash->digestsize)) {
+		printf("%s Test FAIL for message \"%.16s\"\n", name, msg);
+		return 1;
+	}
+
+	printf("%s Test PASS for message \"%.16s\"\n", name, msg);
+	return 0;
+}
+
+/*
+ * FIPS 180-2 test vectors.
+ */
+static int sha256_kat(const char *name)
+{
+	static const uint8_t exp_abc[] = {
+		0xba, 0x78, 0x16, 0xbf, 0x8f, 0x01, 0xcf, 0xea,
+		0x41, 0x41, 0x40, 0xde, 0x5d, 0xae, 0x22, 0x23,
+		0xb0, 0x03, 0x61, 0xa3, 0x96, 0x17, 0x7a, 0x9c,
+		0xb4, 0x10, 0xff, 0x61, 0xf2, 0x00, 0x15, 0xad
+	};
+	static const uint8_t exp_448[] = {
+		0x24, 0x8d, 0x6a, 0x61, 0xd2, 0x06, 0x38, 0xb8,
+		0xe5, 0xc0, 0x26, 0x93, 0x0c, 0x3e, 0x60, 0x39,
+		0xa3, 0x3c, 0xe4, 0x59, 0x64, 0xff, 0x21, 0x67,
+		0xf6, 0xec, 0xed, 0xd4, 0x19, 0xdb, 0x06, 0xc1
+	};
+	static const uint8_t exp_million_a[] = {
+		0xcd, 0xc7, 0x6e, 0x5c, 0x99, 0x14, 0xfb, 0x92,
+		0x81, 0xa1, 0xc7, 0xe2, 0x84, 0xd7, 0x3e, 0x67,
+		0xf1, 0x80, 0x9a, 0x48, 0xa4, 0x97, 0x20, 0x0e,
+		0x04, 0x6d, 0x39, 0xcc, 0xc7, 0x11, 0x2c, 0xd0
+	};
+	int ret = 0;
+
+	ret += hash_kat(sha256, name, "abc", 1, exp_abc);
+	ret += hash_kat(sha256, name,
+			"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq",
+			1, exp_448);
+	ret += hash_kat(sha256, name, "aaaaaaaaaa", 100000, exp_million_a);
+
+	return ret;
+}
+
+static int sha512_kat(void)
+{
+	static const uint8_t exp_abc[] = {
+		0xdd, 0xaf, 0x35, 0xa1, 0x93, 0x61, 0x7a, 0xba,
+		0xcc, 0x41, 0x73, 0x49, 0xae, 0x20, 0x41, 0x31,
+		0x12, 0xe6, 0xfa, 0x4e, 0x89, 0xa9, 0x7e, 0xa2,
+		0x0a, 0x9e, 0xee, 0xe6, 0x4b, 0x55, 0xd3, 0x9a,
+		0x21, 0x92, 0x99, 0x2a, 0x27, 0x4f, 0xc1, 0xa8,
+		0x36, 0xba, 0x3c, 0x23, 0xa3, 0xfe, 0xeb, 0xbd,
+		0x45, 0x4d, 0x44, 0x23, 0x64, 0x3c, 0xe8, 0x0e,
+		0x2a, 0x9a, 0xc9, 0x4f, 0xa5, 0x4c, 0xa4, 0x9f
+	};
+
+	return hash_kat(sha512, "SHA-512", "abc", 1, exp_abc);
+}
+
+/*
+ * Compare the accelerated implementation with the C implementation for all
+ * message lengths covering the partial block handling.
+ */
+static int sha256_compare(const char *name)
+{
+	static uint8_t msg[4096];
+	uint8_t exp[SHA256_SIZE_DIGEST], digest[SHA256_SIZE_DIGEST];
+	void (*transform)(struct sha_ctx *ctx, const uint8_t *in,
+			  size_t blocks) = sha256_transform;
+	size_t i;
+
+	for (i = 0; i < sizeof(msg); i++)
+		msg[i] = (uint8_t)(i * 131 + 7);
+
+	for (i = 0; i <= sizeof(msg); i += (i < 300) ? 1 : 61) {
+		sha256_transform = sha256_transform_c;
+		hash_buf(sha256, msg, i, exp);
+		sha256_transform = transform;
+		hash_buf(sha256, msg, i, digest);
+
+		if (memcmp(exp, digest, sizeof(exp))) {
+			printf("%s Test FAIL for message length %zu\n", name,
+			       i);
+			return 1;
+		}
+	}
+
+	printf("%s Test PASS for message lengths up to %zu\n", name,
+	       sizeof(msg));
+	return 0;
+}
+
+static double bench_hash(const struct hash *hash)
+{
+	static uint8_t buf[1 << 20];
+	HASH_CTX_ON_STACK(ctx);
+	uint8_t digest[SHA512_SIZE_DIGEST];
+	struct timespec start, end;
+	unsigned int i, rounds = 256;
+
+	hash->init(ctx);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (i = 0; i < rounds; i++)
+		hash->update(ctx, buf, sizeof(buf));
+	hash->final(ctx, digest);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	return (double)rounds * sizeof(buf) / (1 << 20) /
+	       ((double)(end.tv_sec - start.tv_sec) +
+		(double)(end.tv_nsec - start.tv_nsec) / 1e9);
+}
+
+int main(int argc, char *argv[])
+{
+	int benchmark = (argc > 1 && !strcmp(argv[1], "-b"));
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(sha256_impls) / sizeof(sha256_impls[0]); i++) {
+		const struct sha256_impl *impl = &sha256_impls[i];
+		char name[32];
+
+		if (!impl->available()) {
+			printf("SHA-256 %s not supported by CPU\n", impl->name);
+			continue;
+		}
+
+		snprintf(name, sizeof(name), "SHA-256 %s", impl->name);
+		sha256_transform = impl->transform;
+
+		if (benchmark) {
+			printf("%s: %.1f MB/s\n", name, bench_hash(sha256));
+			continue;
+		}
+
+		ret += sha256_kat(name);
+		ret += sha256_compare(name);
+	}
+
+	if (benchmark)
+		printf("SHA-512: %.1f MB/s\n", bench_hash(sha512));
+	else
+		ret += sha512_kat();
+
+	return ret;
+}
@@ -0,0 +1,31 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./hash"
+NAME="$(basename $EXEC)"
+
+# Test 1
+#
+# Purpose: Execute FIPS 180-2 tests with all SHA-256 implementations supported
+#	   by the CPU and compare them with the C implementation
+# Expected result: Test results match expected results
+test1()
+{
+	local result=$($EXEC)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME 1: $result"
+	else
+		echo_pass "Test $NAME 1"
+	fi
+
+	gcov_analyze "hash_test.c" "test1"
+}
+
+init_common
+
+test1
+
+exit_test
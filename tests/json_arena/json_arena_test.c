@@ -0,0 +1,380 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <json-c/json.h>
+#include <json-c/json_arena.h>
+
+/* Number of keys of the generated object which forces the hash to grow */
+#define TEST_KEYS 500
+
+static const char *test_docs[] = {
+	"{}",
+	"[]",
+	"\"top level string\"",
+	"[ true, false, null, 0, -1, 9223372036854775807, -9223372036854775808 ]",
+	"[ 1.5, 1.50, -0.0, 1e10, 3.14159265358979, 12345678901234567890 ]",
+	"{ \"short\": \"abc\", \"long\": \"a string which does not fit into the object itself\" }",
+	"{ \"escapes\": \"quote \\\" backslash \\\\ slash \\/ tab \\t newline \\n\", \"unicode\": \"\\u00e4\\u20ac\\ud83d\\ude00\" }",
+	"{ \"vsId\": 123456, \"algorithm\": \"ACVP-AES-GCM\", \"revision\": \"1.0\", \"testGroups\": [ { \"tgId\": 1, \"testType\": \"AFT\", \"tests\": [ { \"tcId\": 1, \"key\": \"00112233445566778899AABBCCDDEEFF\", \"pt\": \"\" }, { \"tcId\": 2, \"key\": \"FFEEDDCCBBAA99887766554433221100\", \"pt\": \"0123456789ABCDEF\" } ] } ] }",
+	"[ [ [ [ [ { \"deep\": [ { \"deeper\": { } } ] } ] ] ] ] ]",
+	"{ \"dup\": 1, \"dup\": 2, \"other\": [ 1, 2, 3 ] }",
+};
+
+static const int test_flags[] = {
+	JSON_C_TO_STRING_PLAIN,
+	JSON_C_TO_STRING_SPACED,
+	JSON_C_TO_STRING_PRETTY,
+	JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_NOSLASHESCAPE,
+};
+
+/* Compare the serialized forms of two JSON objects */
+static int test_compare(struct json_object *heap, struct json_object *arena,
+			const char *desc)
+{
+	char *heap_str;
+	unsigned int i;
+	int ret = 0;
+
+	for (i = 0; i < sizeof(test_flags) / sizeof(test_flags[0]); i++) {
+		heap_str = strdup(
+			json_object_to_json_string_ext(heap, test_flags[i]));
+		if (!heap_str)
+			return -ENOMEM;
+
+		if (strcmp(heap_str, json_object_to_json_string_ext(
+					     arena, test_flags[i]))) {
+			printf("Output mismatch of %s with flags %d:\n%s\n%s\n",
+			       desc, test_flags[i], heap_str,
+			       json_object_to_json_string_ext(arena,
+							      test_flags[i]));
+			ret = -EINVAL;
+		}
+		free(heap_str);
+		if (ret)
+			return ret;
+	}
+
+	if (!json_object_equal(heap, arena)) {
+		printf("JSON objects of %s differ\n", desc);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/* Parse the data with the arena owned by the resulting object */
+static struct json_object *test_parse_arena(const char *data)
+{
+	struct json_arena *arena = json_arena_new(), *prev;
+	struct json_object *jso;
+
+	if (!arena)
+		return NULL;
+
+	prev = json_arena_set(arena);
+	jso = json_tokener_parse(data);
+	json_arena_set(prev);
+
+	if (!jso || json_arena_set_owner(jso)) {
+		json_arena_free(arena);
+		return NULL;
+	}
+
+	return jso;
+}
+
+static char *test_generate(void)
+{
+	struct json_object *jso = json_object_new_object(), *array;
+	char key[32], *data;
+	unsigned int i;
+
+	if (!jso)
+		return NULL;
+
+	for (i = 0; i < TEST_KEYS; i++) {
+		snprintf(key, sizeof(key), "key%u", i);
+		array = json_object_new_array();
+		json_object_array_add(array, json_object_new_int((int32_t)i));
+		json_object_array_add(array,
+				      json_object_new_string(key + i % 4));
+		json_object_object_add(jso, key, array);
+	}
+
+	data = strdup(json_object_to_json_string(jso));
+	json_object_put(jso);
+
+	return data;
+}
+
+/* Parsed documents are identical with and without arena */
+static int test_parse(void)
+{
+	struct json_object *heap = NULL, *arena = NULL;
+	char *generated = test_generate();
+	unsigned int i;
+	int ret = 0;
+
+	if (!generated)
+		return -ENOMEM;
+
+	for (i = 0; i <= sizeof(test_docs) / sizeof(test_docs[0]); i++) {
+		const char *doc = i < sizeof(test_docs) / sizeof(test_docs[0]) ?
+					  test_docs[i] :
+					  generated;
+
+		heap = json_tokener_parse(doc);
+		arena = test_parse_arena(doc);
+		if (!heap || !arena) {
+			printf("Parsing of document %u failed\n", i);
+			ret = -EINVAL;
+			goto out;
+		}
+
+		if (json_arena_get()) {
+			printf("Arena still active after parsing\n");
+			ret = -EINVAL;
+			goto out;
+		}
+
+		ret = test_compare(heap, arena, doc);
+		if (ret)
+			goto out;
+
+		json_object_put(heap);
+		json_object_put(arena);
+		heap = NULL;
+		arena = NULL;
+	}
+
+out:
+	json_object_put(heap);
+	json_object_put(arena);
+	free(generated);
+	return ret;
+}
+
+/*
+ * Build a tree with the JSON-C API including modifications which replace
+ * and remove values.
+ */
+static struct json_object *test_build(void)
+{
+	struct json_object *jso = json_object_new_object(), *array, *str;
+	char key[32];
+	unsigned int i;
+
+	if (!jso)
+		return NULL;
+
+	array = json_object_new_array();
+	for (i = 0; i < 100; i++) {
+		if (i % 3)
+			json_object_array_add(array,
+					      json_object_new_int64(i * 1000));
+		else
+			json_object_array_add(array,
+					      json_object_new_double_s(
+						      i / 3.0, i % 2 ?
+							       "1.50" : "2.0"));
+	}
+	json_object_array_put_idx(array, 150, json_object_new_boolean(1));
+	json_object_array_put_idx(array, 5, json_object_new_string("replaced"));
+	json_object_array_del_idx(array, 10, 20);
+	json_object_object_add(jso, "array", array);
+
+	for (i = 0; i < TEST_KEYS; i++) {
+		snprintf(key, sizeof(key), "key%u", i);
+		json_object_object_add(jso, key,
+				       json_object_new_string_len(key, (int)i % 5));
+	}
+	for (i = 0; i < TEST_KEYS; i += 3) {
+		snprintf(key, sizeof(key), "key%u", i);
+		json_object_object_del(jso, key);
+	}
+
+	/* Replace the value of an existing key */
+	json_object_object_add(jso, "key1", json_object_new_int(-1));
+	json_object_object_add_ex(jso, "constant", NULL,
+				  JSON_C_OBJECT_KEY_IS_CONSTANT);
+
+	/* Switch between the direct and the allocated string storage */
+	str = json_object_new_string("short");
+	json_object_set_string(str,
+			       "a string which does not fit into the object");
+	json_object_set_string(str, "short again");
+	json_object_set_string(str, "another string which does not fit into the object");
+	json_object_object_add(jso, "string", str);
+
+	return jso;
+}
+
+/* Trees built with the API are identical with and without arena */
+static int test_api(void)
+{
+	struct json_arena *arena = json_arena_new(), *prev;
+	struct json_object *heap, *jso;
+	int ret;
+
+	if (!arena)
+		return -ENOMEM;
+
+	heap = test_build();
+
+	prev = json_arena_set(arena);
+	jso = test_build();
+	json_arena_set(prev);
+
+	if (!heap || !jso) {
+		printf("Building of the trees failed\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (!json_arena_size(arena)) {
+		printf("Tree not allocated from the arena\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = test_compare(heap, jso, "tree built with the API");
+
+out:
+	json_object_put(heap);
+	json_object_put(jso);
+	json_arena_free(arena);
+	return ret;
+}
+
+static void *test_thread(void *arg)
+{
+	struct json_object *jso = json_object_new_object();
+
+	(void)arg;
+
+	/* The arena of the other thread is not used */
+	if (json_arena_get())
+		return jso;
+
+	json_object_put(jso);
+	return NULL;
+}
+
+/*
+ * Values moved between trees of the heap and of an arena remain valid after
+ * the arena is released.
+ */
+static int test_mixed(void)
+{
+	struct json_arena *arena = json_arena_new(), *filler, *prev;
+	struct json_object *heap, *jso, *expected, *val;
+	pthread_t thread;
+	void *thread_ret = NULL;
+	unsigned int i;
+	int ret = 0;
+
+	if (!arena)
+		return -ENOMEM;
+
+	heap = json_tokener_parse("{ \"heap\": [ 1, 2 ] }");
+	expected = json_tokener_parse(
+		"{ \"heap\": [ 1, 2, \"arena value which is stored outside of the object\" ], \"arena\": { \"value\": [ \"heap value which is stored outside of the object\" ] } }");
+
+	prev = json_arena_set(arena);
+	jso = json_tokener_parse("{ \"value\": [ ] }");
+
+	if (pthread_create(&thread, NULL, test_thread, NULL) ||
+	    pthread_join(thread, &thread_ret) || thread_ret) {
+		json_arena_set(prev);
+		printf("Arena used by other thread\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* Arena value added to a heap tree */
+	val = json_object_new_string(
+		"arena value which is stored outside of the object");
+	json_arena_set(prev);
+
+	if (!heap || !expected || !jso || !val || json_arena_set_owner(jso)) {
+		printf("Creation of the trees failed\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	json_object_array_add(json_object_object_get(heap, "heap"), val);
+
+	/* Heap value added to an arena tree */
+	json_object_array_add(
+		json_object_object_get(jso, "value"),
+		json_object_new_string(
+			"heap value which is stored outside of the object"));
+
+	/* Arena tree added to a heap tree, the arena is released */
+	json_object_object_add(heap, "arena", jso);
+	jso = NULL;
+
+	/* Reuse the released memory */
+	filler = json_arena_new();
+	if (!filler) {
+		ret = -ENOMEM;
+		goto out;
+	}
+	prev = json_arena_set(filler);
+	for (i = 0; i < 1000; i++)
+		json_object_new_string("filler data which is stored outside");
+	json_arena_set(prev);
+
+	ret = test_compare(expected, heap, "mixed trees");
+
+	json_arena_free(filler);
+
+out:
+	json_object_put(heap);
+	json_object_put(expected);
+	json_object_put(jso);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		return test_parse();
+	case 2:
+		return test_api();
+	case 3:
+		return test_mixed();
+	default:
+		printf("unknown test %s\n", argv[1]);
+		return EINVAL;
+	}
+}
@@ -0,0 +1,60 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./json_arena"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "../../lib/json-c/json_arena.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Parse JSON documents with and without an arena
+# Expected result: The serialized output and the parsed objects are identical
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Build and modify a JSON tree with the JSON-C API with and without
+#	   an arena
+# Expected result: The serialized output and the objects are identical
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: Move values between trees of the heap and an arena and release
+#	   the arena
+# Expected result: The heap tree holds copies of the arena values, the arena
+#		   is not visible to other threads
+test3()
+{
+	run_test 3
+}
+
+init_common
+test1
+test2
+test3
+
+exit_test
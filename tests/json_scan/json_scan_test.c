@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../lib/common/json_scanner.c"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+struct syntax_test {
+	const char *json;
+	int valid;
+};
+
+static const struct syntax_test syntax_tests[] = {
+	{ "{}", 1 },
+	{ "[]", 1 },
+	{ " [ { \"a\" : 1 } , { } ] ", 1 },
+	{ "[{\"acvVersion\":\"1.0\"},{\"retry\":30}]", 1 },
+	{ "{\"a\":[1,-2,3.5,-0.5e10,1E+2,true,false,null,\"x\"]}", 1 },
+	{ "\"str\\\"ing\\u00e4\\n\"", 1 },
+	{ "0", 1 },
+	{ "", 0 },
+	{ "[", 0 },
+	{ "{\"a\":1", 0 },
+	{ "{\"a\" 1}", 0 },
+	{ "{\"a\":1,}", 0 },
+	{ "[1,]", 0 },
+	{ "[1 2]", 0 },
+	{ "{1:2}", 0 },
+	{ "[01]", 0 },
+	{ "[1.]", 0 },
+	{ "[.5]", 0 },
+	{ "[1e]", 0 },
+	{ "[tru]", 0 },
+	{ "[\"\\x\"]", 0 },
+	{ "[\"\\u12g4\"]", 0 },
+	{ "[\"a\tb\"]", 0 },
+	{ "[\"open]", 0 },
+	{ "{]", 0 },
+	{ "[}", 0 },
+	{ "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]",
+	  0 },
+	{ "[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[[]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]]",
+	  1 },
+};
+
+static int count_cb(void *priv, const struct json_scan_event *ev)
+{
+	unsigned int *count = priv;
+
+	(void)ev;
+	(*count)++;
+	return 0;
+}
+
+static int syntax_test(void)
+{
+	unsigned int i, count;
+	int ret = 0;
+
+	for (i = 0; i < ARRAY_SIZE(syntax_tests); i++) {
+		const struct syntax_test *t = syntax_tests + i;
+		int rc;
+
+		count = 0;
+		rc = json_scan(t->json, strlen(t->json), count_cb, &count);
+		if ((rc == 0) != (t->valid == 1)) {
+			printf("Syntax test %u failed: %s (%d)\n", i, t->json,
+			       rc);
+			ret = 1;
+		}
+	}
+
+	return ret;
+}
+
+/* Collect the members of the top-level object */
+struct key_test {
+	struct json_scan_key *keys;
+	unsigned int nkeys;
+	unsigned int events;
+};
+
+static int key_cb(void *priv, const struct json_scan_event *ev)
+{
+	struct key_test *t = priv;
+
+	t->events++;
+	if (ev->depth == 1)
+		json_scan_match_key(ev, t->keys, t->nkeys);
+	return 0;
+}
+
+static int key_test(void)
+{
+	static const char json[] =
+		"{\"vsId\":1437,\"nested\":{\"algorithm\":\"wrong\"},"
+		"\"algorithm\":\"ACVP-AES-\\\"GCM\\\"\\/\\u00e4\\ud83d\\ude00\","
+		"\"isSample\":true,\"large\":4294967296,\"neg\":-1,"
+		"\"tests\":[{\"tcId\":1},{\"tcId\":2}]}";
+	struct json_scan_key keys[] = {
+		{ .name = "vsId" },	{ .name = "algorithm" },
+		{ .name = "isSample" }, { .name = "large" },
+		{ .name = "neg" },	{ .name = "mode" },
+		{ .name = "tests" },
+	};
+	struct key_test t = { keys, ARRAY_SIZE(keys), 0 };
+	char *str = NULL;
+	uint32_t val;
+	bool b;
+	int ret = 0;
+
+	if (json_scan(json, strlen(json), key_cb, &t)) {
+		printf("Key test: scan failed\n");
+		return 1;
+	}
+
+	/* Start and end of 4 objects and 1 array plus 8 scalar values */
+	if (t.events != 18) {
+		printf("Key test: unexpected number of events %u\n", t.events);
+		ret = 1;
+	}
+
+	if (json_scan_get_uint(&keys[0], &val) || val != 1437) {
+		printf("Key test: vsId not found\n");
+		ret = 1;
+	}
+
+	if (json_scan_get_string(&keys[1], &str) ||
+	    strcmp(str, "ACVP-AES-\"GCM\"/\xc3\xa4\xf0\x9f\x98\x80")) {
+		printf("Key test: algorithm not decoded: %s\n",
+		       str ? str : "<none>");
+		ret = 1;
+	}
+	free(str);
+
+	if (json_scan_get_bool(&keys[2], &b) || !b) {
+		printf("Key test: isSample not found\n");
+		ret = 1;
+	}
+
+	if (json_scan_get_uint(&keys[3], &val) != -EINVAL ||
+	    json_scan_get_uint(&keys[4], &val) != -EINVAL) {
+		printf("Key test: out of range integer accepted\n");
+		ret = 1;
+	}
+
+	if (json_scan_get_uint(&keys[5], &val) != -ENOENT) {
+		printf("Key test: missing key found\n");
+		ret = 1;
+	}
+
+	if (!keys[6].found || keys[6].type != json_type_array ||
+	    json_scan_get_string(&keys[6], &str) != -EINVAL) {
+		printf("Key test: array value not reported\n");
+		ret = 1;
+	}
+
+	return ret;
+}
+
+static int stop_cb(void *priv, const struct json_scan_event *ev)
+{
+	unsigned int *count = priv;
+
+	(*count)++;
+	return (ev->key && ev->keylen == 4 && !memcmp(ev->key, "stop", 4));
+}
+
+/* The scan terminates successfully when the callback asks to stop */
+static int stop_test(void)
+{
+	static const char json[] = "{\"a\":1,\"stop\":2,\"b\": invalid";
+	unsigned int count = 0;
+
+	if (json_scan(json, strlen(json), stop_cb, &count) || count != 3) {
+		printf("Stop test failed\n");
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(int argc, char *argv[])
+{
+	int ret = 0;
+
+	(void)argc;
+	(void)argv;
+
+	ret |= syntax_test();
+	ret |= key_test();
+	ret |= stop_test();
+
+	return ret;
+}
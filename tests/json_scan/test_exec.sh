@@ -0,0 +1,30 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./json_scan"
+NAME="$(basename $EXEC)"
+
+# Test 1
+#
+# Purpose: Scan valid and invalid JSON data and extract keys from it
+# Expected result: Invalid JSON data is rejected, found keys match the data
+test1()
+{
+	local result=$($EXEC)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME 1: $result"
+	else
+		echo_pass "Test $NAME 1"
+	fi
+
+	gcov_analyze "json_scan_test.c" "test1"
+}
+
+init_common
+
+test1
+
+exit_test
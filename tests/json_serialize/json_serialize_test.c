@@ -0,0 +1,458 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "../../lib/common/json_wrapper.c"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* String larger than the buffer of a print buffer backed by a file */
+static char data_buf[100 * 1024];
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+/* The protocol definitions are not needed for the test */
+int acvp_get_proto(const struct acvp_net_proto **proto)
+{
+	(void)proto;
+	return -EOPNOTSUPP;
+}
+
+static const int test_flags[] = {
+	JSON_C_TO_STRING_PLAIN,
+	JSON_C_TO_STRING_SPACED,
+	JSON_C_TO_STRING_PRETTY,
+	JSON_C_TO_STRING_PRETTY | JSON_C_TO_STRING_PRETTY_TAB,
+	JSON_C_TO_STRING_NOSLASHESCAPE,
+};
+
+static const int64_t test_ints[] = {
+	0, 1, -1, 9, 10, -10, 99, 100, 4294967295LL, 4294967296LL,
+	999999999999999999LL, 1000000000000000000LL, INT64_MAX, INT64_MIN,
+	INT64_MIN + 1,
+};
+
+/* Object holding values which exercise all serialization paths */
+static struct json_object *test_object(unsigned int size)
+{
+	struct json_object *jso = json_object_new_object(), *array, *nested;
+	char str[256], key[32];
+	unsigned int i;
+
+	if (!jso)
+		return NULL;
+
+	/* All characters including those which must be escaped */
+	for (i = 1; i < sizeof(str); i++)
+		str[i - 1] = (char)i;
+	json_object_object_add(jso, "all_chars",
+			       json_object_new_string_len(str, 255));
+	json_object_object_add(jso, "escapes", json_object_new_string(
+		"\"quoted\" back\\slash /path/ \b\f\n\r\t"));
+	json_object_object_add(jso, "utf8",
+			       json_object_new_string("\xc3\xa4\xe2\x82\xac"
+						      "\xf0\x9f\x98\x80"));
+	json_object_object_add(jso, "empty", json_object_new_string(""));
+	json_object_object_add(jso, "null", NULL);
+	json_object_object_add(jso, "true", json_object_new_boolean(1));
+	json_object_object_add(jso, "key \"with\" escapes\n",
+			       json_object_new_boolean(0));
+
+	array = json_object_new_array();
+	for (i = 0; i < ARRAY_SIZE(test_ints); i++)
+		json_object_array_add(array,
+				      json_object_new_int64(test_ints[i]));
+	json_object_array_add(array, json_object_new_double(0.1));
+	json_object_array_add(array, json_object_new_double(-1.0e-300));
+	json_object_array_add(array, json_object_new_double(123456789.125));
+	json_object_array_add(array, json_object_new_double_s(1.5, "1.50"));
+	json_object_object_add(jso, "numbers", array);
+
+	json_object_object_add(jso, "empty_array", json_object_new_array());
+	json_object_object_add(jso, "empty_object", json_object_new_object());
+
+	/* Nesting for the pretty indentation within the parser depth limit */
+	nested = json_object_new_string("deep");
+	for (i = 0; i < 12; i++) {
+		struct json_object *tmp = json_object_new_object();
+
+		json_object_object_add(tmp, "level", nested);
+		nested = json_object_new_array();
+		json_object_array_add(nested, tmp);
+	}
+	json_object_object_add(jso, "nested", nested);
+
+	/* Test vector like data of the requested size */
+	array = json_object_new_array();
+	for (i = 0; i < size; i++) {
+		struct json_object *tc = json_object_new_object();
+
+		snprintf(key, sizeof(key), "%08X%08X", i, ~i);
+		json_object_object_add(tc, "tcId", json_object_new_int((int)i));
+		json_object_object_add(tc, "key", json_object_new_string(key));
+		json_object_array_add(array, tc);
+	}
+	json_object_object_add(jso, "tests", array);
+
+	return jso;
+}
+
+/* Parse the serialized data and compare it with the original object */
+static int test_roundtrip(struct json_object *jso, const char *data,
+			  size_t len, int flags)
+{
+	struct json_object *parsed;
+	const char *ref;
+	size_t ref_len;
+	int ret = 0;
+
+	ref = json_object_to_json_string_length(jso, flags, &ref_len);
+	if (len != ref_len || memcmp(ref, data, len)) {
+		printf("Serialized data with flags %d differs (%zu, %zu)\n",
+		       flags, len, ref_len);
+		return -EINVAL;
+	}
+
+	parsed = json_tokener_parse(data);
+	if (!parsed || !json_object_equal(jso, parsed)) {
+		printf("Serialized data with flags %d does not parse to the original object\n",
+		       flags);
+		ret = -EINVAL;
+	}
+
+	json_object_put(parsed);
+	return ret;
+}
+
+/* Serialization into growing print buffers */
+static int test_printbuf(void)
+{
+	struct json_object *jso = test_object(100), *val;
+	struct printbuf *pb = NULL;
+	struct acvp_buf buf = { 0 };
+	char *data = NULL, sbuf[32];
+	unsigned int i;
+	size_t len;
+	int ret = 0, data_len;
+
+	if (!jso)
+		return -ENOMEM;
+
+	for (i = 0; i < ARRAY_SIZE(test_flags); i++) {
+		pb = printbuf_new();
+		if (!pb) {
+			ret = -ENOMEM;
+			goto out;
+		}
+
+		/* The reported length only covers the appended data */
+		printbuf_strappend(pb, "prefix");
+		if (json_object_to_printbuf(jso, pb, test_flags[i], &len) < 0) {
+			printf("Serialization into print buffer failed\n");
+			ret = -EINVAL;
+			goto out;
+		}
+
+		data = printbuf_steal(pb, &data_len);
+		pb = NULL;
+		if ((size_t)data_len != len + 6 ||
+		    strlen(data) != (size_t)data_len) {
+			printf("Wrong length of serialized data\n");
+			ret = -EINVAL;
+			goto out;
+		}
+
+		ret = test_roundtrip(jso, data + 6, len, test_flags[i]);
+		if (ret)
+			goto out;
+		free(data);
+		data = NULL;
+
+		ret = json_to_buf(jso, test_flags[i], &buf);
+		if (ret)
+			goto out;
+		if (buf.len != strlen((char *)buf.buf) ||
+		    buf.size != buf.len + 1) {
+			printf("Wrong length of JSON buffer\n");
+			ret = -EINVAL;
+			goto out;
+		}
+		ret = test_roundtrip(jso, (char *)buf.buf, buf.len,
+				     test_flags[i]);
+		if (ret)
+			goto out;
+	}
+
+	/* Integers are converted identical to snprintf */
+	for (i = 0; i < ARRAY_SIZE(test_ints); i++) {
+		val = json_object_new_int64(test_ints[i]);
+		snprintf(sbuf, sizeof(sbuf), "%" PRId64, test_ints[i]);
+		if (strcmp(sbuf, json_object_to_json_string(val))) {
+			printf("Integer %s converted to %s\n", sbuf,
+			       json_object_to_json_string(val));
+			ret = -EINVAL;
+		}
+		json_object_put(val);
+		if (ret)
+			goto out;
+	}
+
+out:
+	if (pb)
+		printbuf_free(pb);
+	free(data);
+	acvp_free_buf(&buf);
+	json_object_put(jso);
+	return ret;
+}
+
+static int test_read_fd(int fd, char **data, size_t *len)
+{
+	struct stat sb;
+	ssize_t rc;
+
+	if (fstat(fd, &sb) || lseek(fd, 0, SEEK_SET))
+		return -errno;
+
+	*data = calloc(1, (size_t)sb.st_size + 1);
+	if (!*data)
+		return -ENOMEM;
+
+	rc = pread(fd, *data, (size_t)sb.st_size, 0);
+	if (rc != sb.st_size) {
+		free(*data);
+		*data = NULL;
+		return -EIO;
+	}
+
+	*len = (size_t)sb.st_size;
+	return 0;
+}
+
+/* Serialization streamed to a file exceeding the buffer size */
+static int test_fd(void)
+{
+	struct json_object *jso = test_object(5000);
+	struct printbuf *pb = NULL;
+	char tmpl[] = "/tmp/json_serialize.XXXXXX", *data = NULL;
+	unsigned int i;
+	size_t len, data_len;
+	int fd, ret = 0;
+	FILE *stream = NULL;
+
+	if (!jso)
+		return -ENOMEM;
+
+	fd = mkstemp(tmpl);
+	if (fd < 0) {
+		json_object_put(jso);
+		return -errno;
+	}
+	unlink(tmpl);
+
+	/* Large string written without going through the buffer */
+	memset(data_buf, 'a', sizeof(data_buf) - 1);
+	json_object_object_add(jso, "large",
+			       json_object_new_string(data_buf));
+
+	for (i = 0; i < ARRAY_SIZE(test_flags); i++) {
+		if (ftruncate(fd, 0) || lseek(fd, 0, SEEK_SET)) {
+			ret = -errno;
+			goto out;
+		}
+
+		pb = printbuf_new_fd(fd);
+		if (!pb) {
+			ret = -errno;
+			goto out;
+		}
+		if (json_object_to_printbuf(jso, pb, test_flags[i], &len) < 0 ||
+		    printbuf_flush(pb) < 0) {
+			printf("Serialization into file failed\n");
+			ret = -EINVAL;
+			goto out;
+		}
+		printbuf_free(pb);
+		pb = NULL;
+
+		ret = test_read_fd(fd, &data, &data_len);
+		if (ret)
+			goto out;
+		if (data_len != len || data_len < 64 * 1024) {
+			printf("Wrong length of file data (%zu, %zu)\n",
+			       data_len, len);
+			ret = -EINVAL;
+			goto out;
+		}
+		ret = test_roundtrip(jso, data, data_len, test_flags[i]);
+		if (ret)
+			goto out;
+		free(data);
+		data = NULL;
+
+		/* Same data written with json_object_to_fd */
+		if (ftruncate(fd, 0) || lseek(fd, 0, SEEK_SET)) {
+			ret = -errno;
+			goto out;
+		}
+		if (json_object_to_fd(fd, jso, test_flags[i])) {
+			printf("json_object_to_fd failed\n");
+			ret = -EINVAL;
+			goto out;
+		}
+		ret = test_read_fd(fd, &data, &data_len);
+		if (ret)
+			goto out;
+		ret = test_roundtrip(jso, data, data_len, test_flags[i]);
+		if (ret)
+			goto out;
+		free(data);
+		data = NULL;
+	}
+
+	/* Data buffered by the stream precedes the JSON data */
+	if (ftruncate(fd, 0) || lseek(fd, 0, SEEK_SET)) {
+		ret = -errno;
+		goto out;
+	}
+	stream = fdopen(dup(fd), "w");
+	if (!stream) {
+		ret = -errno;
+		goto out;
+	}
+	fputs("prefix", stream);
+	ret = json_print(stream, jso, JSON_C_TO_STRING_PRETTY);
+	fclose(stream);
+	if (ret)
+		goto out;
+
+	ret = test_read_fd(fd, &data, &data_len);
+	if (ret)
+		goto out;
+	if (data_len < 7 || strncmp(data, "prefix", 6) ||
+	    data[data_len - 1] != '\n') {
+		printf("Wrong framing of printed JSON data\n");
+		ret = -EINVAL;
+		goto out;
+	}
+	data[data_len - 1] = '\0';
+	ret = test_roundtrip(jso, data + 6, data_len - 7,
+			     JSON_C_TO_STRING_PRETTY);
+
+out:
+	if (pb)
+		printbuf_free(pb);
+	free(data);
+	close(fd);
+	json_object_put(jso);
+	return ret;
+}
+
+/* Write errors of a file backed print buffer are reported */
+static int test_fd_error(void)
+{
+	struct json_object *jso = test_object(5000);
+	struct printbuf *pb = NULL;
+	int fd = open("/dev/full", O_WRONLY), ret = 0;
+
+	if (!jso || fd < 0) {
+		printf("Test setup failed\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	pb = printbuf_new_fd(fd);
+	if (!pb) {
+		ret = -errno;
+		goto out;
+	}
+
+	errno = 0;
+	if (json_object_to_printbuf(jso, pb, JSON_C_TO_STRING_PLAIN, NULL) >=
+		    0 &&
+	    printbuf_flush(pb) >= 0) {
+		printf("Write error not reported\n");
+		ret = -EINVAL;
+		goto out;
+	}
+	if (errno != ENOSPC) {
+		printf("Unexpected error %d\n", errno);
+		ret = -EINVAL;
+		goto out;
+	}
+
+	/* The error is sticky */
+	if (printbuf_strappend(pb, "x") >= 0 && printbuf_flush(pb) >= 0) {
+		printf("Write error not kept\n");
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (json_object_to_fd(fd, jso, JSON_C_TO_STRING_PLAIN) != -1) {
+		printf("json_object_to_fd did not report write error\n");
+		ret = -EINVAL;
+	}
+
+out:
+	if (pb)
+		printbuf_free(pb);
+	if (fd >= 0)
+		close(fd);
+	json_object_put(jso);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		return test_printbuf();
+	case 2:
+		return test_fd();
+	case 3:
+		return test_fd_error();
+	default:
+		printf("unknown test %s\n", argv[1]);
+		return EINVAL;
+	}
+}
@@ -0,0 +1,278 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "json_wrapper.h"
+#include "threading_support.h"
+
+/*
+ * The ACVP server is simulated: it holds TEST_ENTRIES entries with the IDs
+ * 0 to TEST_ENTRIES - 1 and returns at most TEST_SERVER_LIMIT entries per
+ * page, independent of the requested limit.
+ */
+#define TEST_ENTRIES 2345
+#define TEST_SERVER_LIMIT 100
+#define TEST_URL "https://acvp.example.com/acvp/v1/vendors"
+
+/* Delay of one server request in microseconds */
+#define TEST_SERVER_DELAY 20000
+
+static mutex_w_t test_lock;
+static unsigned int test_requests = 0;
+static unsigned int test_inflight = 0;
+static unsigned int test_max_inflight = 0;
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+int acvp_store_file(const struct acvp_testid_ctx *testid_ctx,
+		    const struct acvp_buf *buf, const int err, const char *file)
+{
+	(void)testid_ctx;
+	(void)buf;
+	(void)err;
+	(void)file;
+	return 0;
+}
+
+static struct acvp_net_proto test_proto = {
+	.url_base = "acvp/v1",
+	.proto_version = "1.0",
+	.proto_version_keyword = "acvVersion",
+	.proto_name = "ACVP",
+	.proto = acv_protocol,
+};
+
+int acvp_get_proto(const struct acvp_net_proto **proto)
+{
+	*proto = &test_proto;
+	return 0;
+}
+
+/* The network definitions are not needed for the test */
+int acvp_get_net(const struct acvp_net_ctx **net)
+{
+	(void)net;
+	return -EOPNOTSUPP;
+}
+
+int acvp_duplicate(char **dst, const char *src)
+{
+	(void)dst;
+	(void)src;
+	return -EOPNOTSUPP;
+}
+
+static unsigned int test_url_param(const char *url, const char *param,
+				   unsigned int def)
+{
+	const char *p = strstr(url, param);
+
+	if (!p)
+		return def;
+	return (unsigned int)strtoul(p + strlen(param), NULL, 10);
+}
+
+/* Simulated ACVP server */
+int acvp_process_retry_testid(const struct acvp_testid_ctx *testid_ctx,
+			      struct acvp_buf *result_data, const char *url)
+{
+	unsigned int i, offset, limit, entries;
+	int ret;
+	char entry[64];
+
+	(void)testid_ctx;
+
+	mutex_w_lock(&test_lock);
+	test_requests++;
+	test_inflight++;
+	if (test_inflight > test_max_inflight)
+		test_max_inflight = test_inflight;
+	mutex_w_unlock(&test_lock);
+
+	usleep(TEST_SERVER_DELAY);
+
+	offset = test_url_param(url, "offset=", 0);
+	limit = test_url_param(url, "limit=", TEST_SERVER_LIMIT);
+	if (limit > TEST_SERVER_LIMIT)
+		limit = TEST_SERVER_LIMIT;
+	entries = (offset < TEST_ENTRIES) ? TEST_ENTRIES - offset : 0;
+	if (entries > limit)
+		entries = limit;
+
+	snprintf(entry, sizeof(entry),
+		 "[{\"acvVersion\":\"1.0\"},{\"totalCount\":%u,\"incomplete\":%s,",
+		 TEST_ENTRIES,
+		 (offset + entries < TEST_ENTRIES) ? "true" : "false");
+	CKINT(acvp_buf_append(result_data, (uint8_t *)entry,
+			      (uint32_t)strlen(entry)));
+
+	snprintf(entry, sizeof(entry),
+		 "\"links\":{\"nextPage\":\"/acvp/v1/vendors?offset=%u&limit=%u\"},",
+		 offset + entries, limit);
+	CKINT(acvp_buf_append(result_data, (uint8_t *)entry,
+			      (uint32_t)strlen(entry)));
+
+	CKINT(acvp_buf_append(result_data, (uint8_t *)"\"data\":[", 8));
+	for (i = 0; i < entries; i++) {
+		snprintf(entry, sizeof(entry), "%s{\"id\":%u}", i ? "," : "",
+			 offset + i);
+		CKINT(acvp_buf_append(result_data, (uint8_t *)entry,
+				      (uint32_t)strlen(entry)));
+	}
+	CKINT(acvp_buf_append(result_data, (uint8_t *)"]}]", 3));
+
+out:
+	mutex_w_lock(&test_lock);
+	test_inflight--;
+	mutex_w_unlock(&test_lock);
+	return ret;
+}
+
+struct test_walk {
+	pthread_t caller;
+	unsigned int next_id;
+	unsigned int stop;
+	bool fail;
+};
+
+static int test_cb(void *private, struct json_object *dataentry)
+{
+	struct test_walk *walk = private;
+	uint32_t id;
+
+	/* Callbacks run in the calling thread in the order of the entries */
+	if (!pthread_equal(walk->caller, pthread_self()) ||
+	    json_get_uint(dataentry, "id", &id) || id != walk->next_id) {
+		walk->fail = true;
+		return -EINVAL;
+	}
+
+	walk->next_id++;
+	if (walk->next_id == walk->stop)
+		return EINTR;
+
+	return 0;
+}
+
+static int test_paging(bool threading_disabled, unsigned int stop,
+		       unsigned int pagesize)
+{
+	struct acvp_ctx ctx;
+	struct acvp_testid_ctx testid_ctx;
+	struct test_walk walk;
+	unsigned int expected = stop ? stop : TEST_ENTRIES;
+	int ret;
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&testid_ctx, 0, sizeof(testid_ctx));
+	memset(&walk, 0, sizeof(walk));
+	ctx.options.threading_disabled = threading_disabled;
+	testid_ctx.ctx = &ctx;
+	walk.caller = pthread_self();
+	walk.stop = stop;
+
+	mutex_w_init(&test_lock, 0);
+	CKINT(thread_init(2));
+
+	ret = acvp_paging_get(&testid_ctx, TEST_URL, 0, &walk, test_cb);
+	if (ret < 0 || walk.fail) {
+		printf("Paging failed at entry %u: %d\n", walk.next_id, ret);
+		ret = 1;
+		goto out;
+	}
+	if (walk.next_id != expected) {
+		printf("Processed %u entries instead of %u\n", walk.next_id,
+		       expected);
+		ret = 1;
+		goto out;
+	}
+
+	/* Pages are fetched concurrently only with threading */
+	if (threading_disabled && test_max_inflight != 1) {
+		printf("Pages fetched concurrently without threading\n");
+		ret = 1;
+		goto out;
+	}
+	if (!threading_disabled && test_max_inflight < 2) {
+		printf("Pages were not prefetched\n");
+		ret = 1;
+		goto out;
+	}
+
+	/* Each page is fetched exactly once */
+	if (!stop && test_requests != (TEST_ENTRIES + pagesize - 1) / pagesize) {
+		printf("Unexpected number of requests: %u\n", test_requests);
+		ret = 1;
+		goto out;
+	}
+
+	ret = 0;
+
+out:
+	thread_release(false, true);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		/* Offset fan-out with a smaller server page size */
+		return test_paging(false, 0, TEST_SERVER_LIMIT);
+	case 2:
+		/* Following the nextPage links without threading */
+		return test_paging(true, 0, TEST_SERVER_LIMIT);
+	case 3:
+		/* Interruption by the callback while pages are prefetched */
+		return test_paging(false, TEST_SERVER_LIMIT * 3 / 2,
+				   TEST_SERVER_LIMIT);
+	case 4:
+		/* Page size requested by the user */
+		setenv(ACVP_PAGING_LIMIT_ENV, "50", 1);
+		return test_paging(false, 0, 50);
+	default:
+		printf("unknown test %s\n", argv[1]);
+		return EINVAL;
+	}
+}
@@ -0,0 +1,72 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./paging"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "../../lib/acvp/acvp_paging.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Page through the entries of a server using a smaller page size
+#	   than requested
+# Expected result: All entries are processed once in order by the caller,
+#		   the pages are fetched concurrently and only once
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Page through the entries of a server without threading
+# Expected result: All entries are processed once in order, the pages are
+#		   fetched one after the other following the nextPage links
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: Interrupt the processing while pages are fetched ahead
+# Expected result: The processing stops at the requested entry, the pending
+#		   page fetches are completed before returning
+test3()
+{
+	run_test 3
+}
+
+# Test 4
+#
+# Purpose: Set the page size with ACVPPROXY_PAGING_LIMIT
+# Expected result: The pages are requested with the given page size
+test4()
+{
+	run_test 4
+}
+
+init_common
+
+test1
+test2
+test3
+test4
+
+exit_test
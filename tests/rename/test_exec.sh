@@ -234,4 +234,34 @@ init_test
 test_rename_oename
 cleanup_test
 
+# Repeat the tests with the data stores converted into data store logs
+export ACVPPROXY_DATASTORE=log
+
+init_test
+test_rename_name
+cleanup_test
+
+init_test
+test_rename_version
+cleanup_test
+
+init_test
+test_rename_oename
+cleanup_test
+
+# Repeat the tests with the files accessed with io_uring
+export ACVPPROXY_DATASTORE=uring
+
+init_test
+test_rename_name
+cleanup_test
+
+init_test
+test_rename_version
+cleanup_test
+
+init_test
+test_rename_oename
+cleanup_test
+
 exit_test
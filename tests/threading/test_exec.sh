@@ -0,0 +1,97 @@
+#!/bin/bash
+
+. ../libtest.sh
+
+EXEC="./threading"
+NAME="$(basename $EXEC)"
+
+run_test()
+{
+	local testnum=$1
+	local result
+
+	result=$($EXEC $testnum)
+
+	if [ $? -ne 0 ]
+	then
+		echo_fail "Test $NAME $testnum: $result"
+	else
+		echo_pass "Test $NAME $testnum"
+	fi
+
+	gcov_analyze "threading_test.c" "test$testnum"
+}
+
+# Test 1
+#
+# Purpose: Execute many queued jobs, wait for the jobs of one mother thread
+# Expected result: All jobs are executed and their return codes are reported,
+#		   a mother thread does not wait for jobs of another mother
+test1()
+{
+	run_test 1
+}
+
+# Test 2
+#
+# Purpose: Fetch the return code of the ancestors when starting a job
+# Expected result: Regular thread groups report the ORed return codes of the
+#		   completed jobs of the caller, special thread groups report
+#		   the return code of their last job
+test2()
+{
+	run_test 2
+}
+
+# Test 3
+#
+# Purpose: Queue a job while all slots of a child thread group are busy
+# Expected result: An idle worker of the mother thread group steals the job
+test3()
+{
+	run_test 3
+}
+
+# Test 4
+#
+# Purpose: Queue a job while all slots of a mother thread group are busy
+# Expected result: The idle worker of the child thread group does not steal
+#		   the job, it is executed once a slot of its group is free
+test4()
+{
+	run_test 4
+}
+
+# Test 5
+#
+# Purpose: Defer jobs with different delays, defer outside of a regular job
+# Expected result: The deferred jobs are executed again in the order of their
+#		   due time but not before it, deferring is rejected outside
+#		   of regular jobs
+test5()
+{
+	run_test 5
+}
+
+# Test 6
+#
+# Purpose: Queue more jobs than the job queue of a thread group holds from a
+#	   mother thread and from a job of the thread group
+# Expected result: The mother thread is blocked while the queue is full and
+#		   continues once the jobs complete, the job of the thread
+#		   group is not blocked
+test6()
+{
+	run_test 6
+}
+
+init_common
+
+test1
+test2
+test3
+test4
+test5
+test6
+
+exit_test
@@ -0,0 +1,717 @@
+/*
+ * Copyright (C) 2021, Stephan Mueller <smueller@chronox.de>
+ *
+ * License: see LICENSE file in root directory
+ *
+ * THIS SOFTWARE IS PROVIDED ``AS IS'' AND ANY EXPRESS OR IMPLIED
+ * WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED WARRANTIES
+ * OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE, ALL OF
+ * WHICH ARE HEREBY DISCLAIMED.  IN NO EVENT SHALL THE AUTHOR BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT
+ * OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ * (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE
+ * USE OF THIS SOFTWARE, EVEN IF NOT ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#define _GNU_SOURCE
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../../lib/common/threading_support.c"
+
+/* The logger is not needed for the test */
+void _logger(const enum logger_verbosity severity,
+	     const enum logger_class class, const char *file, const char *func,
+	     const uint32_t line, const char *fmt, ...)
+{
+	(void)severity;
+	(void)class;
+	(void)file;
+	(void)func;
+	(void)line;
+	(void)fmt;
+}
+
+/* Number of jobs queued by the job queue test */
+#define TEST_JOBS 200
+
+/* Maximum time in seconds to wait for an event of a job */
+#define TEST_TIMEOUT 10
+
+static unsigned int test_read(unsigned int *val)
+{
+	return __atomic_load_n(val, __ATOMIC_SEQ_CST);
+}
+
+static void test_set(unsigned int *val, unsigned int set)
+{
+	__atomic_store_n(val, set, __ATOMIC_SEQ_CST);
+}
+
+static unsigned int test_inc(unsigned int *val)
+{
+	return __atomic_add_fetch(val, 1, __ATOMIC_SEQ_CST);
+}
+
+/* Wait until the value reaches the expected value, false on timeout */
+static bool test_wait_for(unsigned int *val, unsigned int expected)
+{
+	unsigned int i;
+
+	for (i = 0; i < TEST_TIMEOUT * 1000; i++) {
+		if (test_read(val) >= expected)
+			return true;
+		usleep(1000);
+	}
+
+	return false;
+}
+
+/* Wait until all jobs spawned by the calling thread completed */
+static bool test_wait_completed(void)
+{
+	struct thread_parent *parent;
+	unsigned int i;
+	bool done;
+
+	for (i = 0; i < TEST_TIMEOUT * 1000; i++) {
+		mutex_w_lock(&threads_lock);
+		parent = thread_find_parent(pthread_self());
+		done = !parent || !parent->outstanding;
+		mutex_w_unlock(&threads_lock);
+
+		if (done)
+			return true;
+		usleep(1000);
+	}
+
+	return false;
+}
+
+/******************************************************************************
+ * Job queue
+ ******************************************************************************/
+static unsigned int test_queue_executed = 0;
+
+static int test_queue_job(void *arg)
+{
+	unsigned int num = (unsigned int)(uintptr_t)arg;
+
+	test_inc(&test_queue_executed);
+
+	/* One job reports an error */
+	return (num == TEST_JOBS / 2) ? 4 : 0;
+}
+
+/* Child of the first mother which blocks until it is released */
+static unsigned int test_queue_blocked_started = 0;
+static unsigned int test_queue_blocked_release = 0;
+static unsigned int test_queue_mother2_done = 0;
+
+static int test_queue_blocked(void *arg)
+{
+	(void)arg;
+
+	test_inc(&test_queue_blocked_started);
+	if (!test_wait_for(&test_queue_blocked_release, 1))
+		return 1;
+	return 0;
+}
+
+static int test_queue_quick(void *arg)
+{
+	(void)arg;
+	return 0;
+}
+
+static int test_queue_mother1(void *arg)
+{
+	int ret;
+
+	(void)arg;
+
+	CKINT(thread_start(test_queue_blocked, NULL, 1, NULL));
+	ret = thread_wait();
+
+out:
+	return ret;
+}
+
+static int test_queue_mother2(void *arg)
+{
+	int ret;
+
+	(void)arg;
+
+	/* Do not start before the child of the first mother blocks */
+	if (!test_wait_for(&test_queue_blocked_started, 1))
+		return 8;
+
+	CKINT(thread_start(test_queue_quick, NULL, 1, NULL));
+
+	/* Must not wait for the blocked child of the first mother */
+	CKINT(thread_wait());
+	test_set(&test_queue_mother2_done, 1);
+
+out:
+	return ret;
+}
+
+static int test_queue(void)
+{
+	unsigned int i;
+	int ret;
+
+	CKINT(thread_init(2));
+
+	/* All jobs are executed and their return codes are ORed together */
+	for (i = 0; i < TEST_JOBS; i++) {
+		CKINT(thread_start(test_queue_job, (void *)(uintptr_t)i, 1,
+				   NULL));
+	}
+
+	ret = thread_wait();
+	if (ret != 4) {
+		printf("Unexpected return code of all jobs: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+	if (test_read(&test_queue_executed) != TEST_JOBS) {
+		printf("Only %u of %u jobs executed\n",
+		       test_read(&test_queue_executed), TEST_JOBS);
+		ret = 1;
+		goto out;
+	}
+
+	/* thread_wait only waits for the jobs of the calling mother thread */
+	CKINT(thread_start(test_queue_mother1, NULL, 0, NULL));
+	CKINT(thread_start(test_queue_mother2, NULL, 0, NULL));
+
+	if (!test_wait_for(&test_queue_mother2_done, 1)) {
+		printf("Mother thread waited for jobs of other mother\n");
+		test_set(&test_queue_blocked_release, 1);
+		thread_wait();
+		ret = 1;
+		goto out;
+	}
+
+	test_set(&test_queue_blocked_release, 1);
+	ret = thread_wait();
+	if (ret) {
+		printf("Unexpected return code of mother threads: %d\n", ret);
+		ret = 1;
+	}
+
+out:
+	thread_release(false, true);
+	return ret;
+}
+
+/******************************************************************************
+ * Return code of ancestors
+ ******************************************************************************/
+static int test_ancestor_job(void *arg)
+{
+	return (int)(uintptr_t)arg;
+}
+
+/* Wait until the last job of the special thread group reported its result */
+static bool test_wait_special(uint32_t thread_group)
+{
+	struct thread_group *grp = thread_get_group(thread_group);
+	unsigned int i;
+	bool done;
+
+	for (i = 0; i < TEST_TIMEOUT * 1000; i++) {
+		mutex_w_lock(&threads_lock);
+		done = !!grp->ret_ancestor;
+		mutex_w_unlock(&threads_lock);
+
+		if (done)
+			return true;
+		usleep(1000);
+	}
+
+	return false;
+}
+
+static int test_ancestor(void)
+{
+	int ret, ret_ancestor = -1;
+
+	CKINT(thread_init(2));
+
+	/*
+	 * Regular thread group: the ORed return codes of the completed jobs
+	 * of the caller are returned and not reported by thread_wait any more.
+	 */
+	CKINT(thread_start(test_ancestor_job, (void *)(uintptr_t)1, 0,
+			   &ret_ancestor));
+	if (ret_ancestor) {
+		printf("Unexpected ancestor return code: %d\n", ret_ancestor);
+		ret = 1;
+		goto out;
+	}
+	CKINT(thread_start(test_ancestor_job, (void *)(uintptr_t)2, 0, NULL));
+	if (!test_wait_completed()) {
+		printf("Jobs did not complete\n");
+		ret = 1;
+		goto out;
+	}
+
+	CKINT(thread_start(test_ancestor_job, (void *)(uintptr_t)0, 0,
+			   &ret_ancestor));
+	if (ret_ancestor != 3) {
+		printf("Unexpected ancestor return code of regular group: %d\n",
+		       ret_ancestor);
+		ret = 1;
+		goto out;
+	}
+
+	ret = thread_wait();
+	if (ret) {
+		printf("Collected return code reported again: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	/* Special thread group: the return code of the last job is returned */
+	CKINT(thread_start(test_ancestor_job, (void *)(uintptr_t)5,
+			   ACVP_THREAD_JWT_RENEW_GROUP, &ret_ancestor));
+	if (ret_ancestor) {
+		printf("Unexpected ancestor return code: %d\n", ret_ancestor);
+		ret = 1;
+		goto out;
+	}
+	if (!test_wait_special(ACVP_THREAD_JWT_RENEW_GROUP)) {
+		printf("Job of special thread group did not complete\n");
+		ret = 1;
+		goto out;
+	}
+
+	CKINT(thread_start(test_ancestor_job, (void *)(uintptr_t)0,
+			   ACVP_THREAD_JWT_RENEW_GROUP, &ret_ancestor));
+	if (ret_ancestor != 5) {
+		printf("Unexpected ancestor return code of special group: %d\n",
+		       ret_ancestor);
+		ret = 1;
+		goto out;
+	}
+
+	/* Return codes of special thread groups are not collected */
+	ret = thread_wait();
+	if (ret) {
+		printf("Return code of special group reported: %d\n", ret);
+		ret = 1;
+	}
+
+out:
+	thread_release(false, true);
+	return ret;
+}
+
+/******************************************************************************
+ * Work stealing
+ ******************************************************************************/
+static unsigned int test_steal_started = 0;
+static unsigned int test_steal_release = 0;
+static unsigned int test_steal_executed = 0;
+static unsigned int test_steal_group = UINT_MAX;
+
+/* Thread group of the worker executing the calling job */
+static unsigned int test_current_group(void)
+{
+	unsigned int i, group = UINT_MAX;
+
+	mutex_w_lock(&threads_lock);
+	for (i = 0; i < THREADING_REALLY_ALL_THREADS; i++) {
+		if (threads[i].alive &&
+		    pthread_equal(threads[i].thread_id, pthread_self())) {
+			group = (unsigned int)(threads[i].group - thread_groups);
+			break;
+		}
+	}
+	mutex_w_unlock(&threads_lock);
+
+	return group;
+}
+
+static int test_steal_blocked(void *arg)
+{
+	(void)arg;
+
+	test_inc(&test_steal_started);
+	if (!test_wait_for(&test_steal_release, 1))
+		return 1;
+	return 0;
+}
+
+static int test_steal_job(void *arg)
+{
+	(void)arg;
+
+	test_set(&test_steal_group, test_current_group());
+	test_inc(&test_steal_executed);
+	return 0;
+}
+
+/*
+ * Occupy all slots of the busy thread group and queue one more job while the
+ * other thread group has an idle worker.
+ */
+static int test_steal_prepare(uint32_t busy, uint32_t idle)
+{
+	unsigned int i;
+	int ret;
+
+	/* 2 thread slots per thread group */
+	CKINT(thread_init(256));
+
+	/* Leave an idle worker in the other thread group */
+	CKINT(thread_start(test_queue_quick, NULL, idle, NULL));
+	CKINT(thread_wait());
+
+	for (i = 0; i < threads_per_threadgroup; i++)
+		CKINT(thread_start(test_steal_blocked, NULL, busy, NULL));
+	if (!test_wait_for(&test_steal_started, threads_per_threadgroup)) {
+		printf("Blocking jobs did not start\n");
+		ret = 1;
+		goto out;
+	}
+
+	CKINT(thread_start(test_steal_job, NULL, busy, NULL));
+
+out:
+	return ret;
+}
+
+static int test_steal(void)
+{
+	int ret;
+
+	/* Child thread group busy, the idle mother thread group steals */
+	CKINT(test_steal_prepare(1, 0));
+
+	if (!test_wait_for(&test_steal_executed, 1)) {
+		printf("Job of busy thread group was not stolen\n");
+		ret = 1;
+		goto out;
+	}
+	if (test_read(&test_steal_group) != 0) {
+		printf("Job executed by thread group %u\n",
+		       test_read(&test_steal_group));
+		ret = 1;
+		goto out;
+	}
+
+out:
+	test_set(&test_steal_release, 1);
+	if (!ret)
+		ret = thread_wait();
+	thread_release(false, true);
+	return ret;
+}
+
+static int test_steal_reverse(void)
+{
+	int ret;
+
+	/* Mother thread group busy, the idle child thread group must not steal */
+	CKINT(test_steal_prepare(0, 1));
+
+	sleep(2);
+	if (test_read(&test_steal_executed)) {
+		printf("Job of mother thread group was stolen by thread group %u\n",
+		       test_read(&test_steal_group));
+		ret = 1;
+		goto out;
+	}
+
+	/* The job is executed by its own thread group once a slot is free */
+	test_set(&test_steal_release, 1);
+	if (!test_wait_for(&test_steal_executed, 1)) {
+		printf("Job of mother thread group was not executed\n");
+		ret = 1;
+		goto out;
+	}
+	if (test_read(&test_steal_group) != 0) {
+		printf("Job executed by thread group %u\n",
+		       test_read(&test_steal_group));
+		ret = 1;
+		goto out;
+	}
+
+out:
+	test_set(&test_steal_release, 1);
+	if (!ret)
+		ret = thread_wait();
+	thread_release(false, true);
+	return ret;
+}
+
+/******************************************************************************
+ * Deferred jobs
+ ******************************************************************************/
+#define TEST_DEFER_JOBS 3
+
+struct test_defer {
+	unsigned int delay; /* Delay requested by the first execution */
+	unsigned int runs; /* Number of executions */
+	time_t due; /* Earliest point in time of the second execution */
+	time_t executed; /* Point in time of the second execution */
+	unsigned int order; /* Position of the second execution */
+};
+
+static unsigned int test_defer_order = 0;
+
+static int test_defer_job(void *arg)
+{
+	struct test_defer *defer = (struct test_defer *)arg;
+	int ret;
+
+	if (test_inc(&defer->runs) == 1) {
+		defer->due = time(NULL) + (time_t)defer->delay;
+		CKINT(thread_defer(defer->delay));
+
+		/* The return code of the deferred execution is ignored */
+		return 16;
+	}
+
+	defer->executed = time(NULL);
+	defer->order = test_inc(&test_defer_order);
+	ret = 0;
+
+out:
+	return ret;
+}
+
+static int test_defer_special(void *arg)
+{
+	int *ret = (int *)arg;
+
+	*ret = thread_defer(1);
+
+	/* Indicate the completion with a return code */
+	return 1;
+}
+
+static int test_defer(void)
+{
+	/* Delays differ by 2 seconds to tolerate a second boundary */
+	struct test_defer defer[TEST_DEFER_JOBS] = {
+		{ .delay = 5 }, { .delay = 1 }, { .delay = 3 }
+	};
+	/* Expected position of the second execution */
+	static const unsigned int order[TEST_DEFER_JOBS] = { 3, 1, 2 };
+	unsigned int i;
+	int ret, special_ret = 0;
+
+	CKINT(thread_init(2));
+
+	/* Only jobs of regular thread groups can be deferred */
+	if (thread_defer(1) != -EOPNOTSUPP) {
+		printf("Caller outside of a job deferred\n");
+		ret = 1;
+		goto out;
+	}
+	CKINT(thread_start(test_defer_special, &special_ret,
+			   ACVP_THREAD_JWT_RENEW_GROUP, NULL));
+	if (!test_wait_special(ACVP_THREAD_JWT_RENEW_GROUP) ||
+	    special_ret != -EOPNOTSUPP) {
+		printf("Job of special thread group deferred\n");
+		ret = 1;
+		goto out;
+	}
+
+	for (i = 0; i < TEST_DEFER_JOBS; i++)
+		CKINT(thread_start(test_defer_job, &defer[i], 0, NULL));
+
+	/* The mother thread waits for the deferred jobs */
+	ret = thread_wait();
+	if (ret) {
+		printf("Unexpected return code of deferred jobs: %d\n", ret);
+		ret = 1;
+		goto out;
+	}
+
+	for (i = 0; i < TEST_DEFER_JOBS; i++) {
+		if (test_read(&defer[i].runs) != 2) {
+			printf("Deferred job %u executed %u times\n", i,
+			       test_read(&defer[i].runs));
+			ret = 1;
+			goto out;
+		}
+		if (defer[i].executed < defer[i].due) {
+			printf("Deferred job %u executed before its due time\n",
+			       i);
+			ret = 1;
+			goto out;
+		}
+		if (defer[i].order != order[i]) {
+			printf("Deferred job %u executed at position %u\n", i,
+			       defer[i].order);
+			ret = 1;
+			goto out;
+		}
+	}
+
+out:
+	thread_release(false, true);
+	return ret;
+}
+
+/******************************************************************************
+ * Back-pressure of the job queue
+ ******************************************************************************/
+static unsigned int test_pressure_running = 0;
+static unsigned int test_pressure_release = 0;
+static unsigned int test_pressure_started = 0;
+static unsigned int test_pressure_spawned = 0;
+static unsigned int test_pressure_done = 0;
+static int test_pressure_ret = -1;
+
+static int test_pressure_blocked(void *arg)
+{
+	(void)arg;
+
+	test_inc(&test_pressure_running);
+	if (!test_wait_for(&test_pressure_release, 1))
+		return 1;
+	return 0;
+}
+
+/* Mother thread queueing more jobs than the job queue holds */
+static void *test_pressure_mother(void *arg)
+{
+	unsigned int i, jobs = (unsigned int)(uintptr_t)arg;
+	int ret = 0;
+
+	for (i = 0; i < jobs; i++) {
+		CKINT(thread_start(test_pressure_blocked, NULL, 0, NULL));
+		test_inc(&test_pressure_started);
+	}
+
+	ret = thread_wait();
+
+out:
+	test_pressure_ret = ret;
+	test_set(&test_pressure_done, 1);
+	return NULL;
+}
+
+/* Job queueing jobs of its own thread group must not be blocked */
+static int test_pressure_spawner(void *arg)
+{
+	unsigned int i, jobs = (unsigned int)(uintptr_t)arg;
+	int ret = 0;
+
+	for (i = 0; i < jobs; i++) {
+		CKINT(thread_start(test_pressure_blocked, NULL, 0, NULL));
+		test_inc(&test_pressure_spawned);
+	}
+
+out:
+	return ret;
+}
+
+static int test_pressure(void)
+{
+	struct thread_group *grp;
+	pthread_t mother;
+	unsigned int queued, slots, max_queued;
+	int ret;
+
+	/* 2 thread slots per thread group */
+	CKINT(thread_init(256));
+	grp = thread_get_group(0);
+	slots = threads_per_threadgroup;
+	max_queued = grp->max_queued;
+
+	/* The mother blocks once all slots are busy and the queue is full */
+	CKINT(-pthread_create(&mother, NULL, test_pressure_mother,
+			      (void *)(uintptr_t)(slots + max_queued + 2)));
+	if (!test_wait_for(&test_pressure_running, slots) ||
+	    !test_wait_for(&test_pressure_started, slots + max_queued)) {
+		printf("Jobs were not queued\n");
+		ret = 1;
+		goto release;
+	}
+
+	sleep(1);
+	mutex_w_lock(&threads_lock);
+	queued = grp->queued;
+	mutex_w_unlock(&threads_lock);
+	if (test_read(&test_pressure_started) != slots + max_queued ||
+	    queued != max_queued) {
+		printf("Job queue exceeded its limit: %u jobs started, %u queued\n",
+		       test_read(&test_pressure_started), queued);
+		ret = 1;
+		goto release;
+	}
+
+	/* Once the jobs complete, the mother queues the remaining jobs */
+	test_set(&test_pressure_release, 1);
+	if (!test_wait_for(&test_pressure_done, 1) ||
+	    test_read(&test_pressure_started) != slots + max_queued + 2 ||
+	    test_pressure_ret) {
+		printf("Blocked mother did not complete: %d\n",
+		       test_pressure_ret);
+		ret = 1;
+		goto release;
+	}
+	pthread_join(mother, NULL);
+
+	/* A job of the thread group may exceed the queue limit */
+	test_set(&test_pressure_release, 0);
+	test_set(&test_pressure_running, 0);
+	CKINT(thread_start(test_pressure_spawner,
+			   (void *)(uintptr_t)(slots + max_queued + 2), 0,
+			   NULL));
+	if (!test_wait_for(&test_pressure_spawned,
+			   slots + max_queued + 2)) {
+		printf("Job was blocked by the queue of its thread group\n");
+		ret = 1;
+		goto release;
+	}
+
+	ret = 0;
+
+release:
+	test_set(&test_pressure_release, 1);
+	if (!ret)
+		ret = thread_wait();
+out:
+	thread_release(false, true);
+	return ret;
+}
+
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		printf("provide test number\n");
+		return EINVAL;
+	}
+
+	switch (atoi(argv[1])) {
+	case 1:
+		return test_queue();
+	case 2:
+		return test_ancestor();
+	case 3:
+		return test_steal();
+	case 4:
+		return test_steal_reverse();
+	case 5:
+		return test_defer();
+	case 6:
+		return test_pressure();
+	default:
+		printf("unknown test %s\n", argv[1]);
+		return EINVAL;
+	}
+}